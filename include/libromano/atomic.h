@@ -226,6 +226,123 @@ ROMANO_FORCE_INLINE Atomic64 atomic_exchange_64(Atomic64* volatile dest,
 #endif /* defined(ROMANO_MSVC) */
 }
 
+/* Pointer-sized atomics, for lock-free linked structures */
+
+ROMANO_FORCE_INLINE void* atomic_load_ptr(void* volatile* dest,
+                                          MemoryOrder mo)
+{
+#if defined(ROMANO_MSVC)
+    ROMANO_UNUSED(mo);
+    return InterlockedCompareExchangePointer(dest, NULL, NULL);
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+    return __atomic_load_n(dest, mo);
+#endif /* defined(ROMANO_MSVC) */
+}
+
+ROMANO_FORCE_INLINE void atomic_store_ptr(void* volatile* dest,
+                                          void* value,
+                                          MemoryOrder mo)
+{
+#if defined(ROMANO_MSVC)
+    ROMANO_UNUSED(mo);
+    InterlockedExchangePointer(dest, value);
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+    __atomic_store_n(dest, value, mo);
+#endif /* defined(ROMANO_MSVC) */
+}
+
+ROMANO_FORCE_INLINE void* atomic_exchange_ptr(void* volatile* dest,
+                                              void* exchange,
+                                              MemoryOrder mo)
+{
+#if defined(ROMANO_MSVC)
+    ROMANO_UNUSED(mo);
+    return InterlockedExchangePointer(dest, exchange);
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+    return __atomic_exchange_n(dest, exchange, mo);
+#endif /* defined(ROMANO_MSVC) */
+}
+
+ROMANO_FORCE_INLINE bool atomic_compare_exchange_ptr(void* volatile* dest,
+                                                     void* exchange,
+                                                     void* compare,
+                                                     MemoryOrder mo)
+{
+#if defined(ROMANO_MSVC)
+    ROMANO_UNUSED(mo);
+    return (bool)(InterlockedCompareExchangePointer(dest, exchange, compare) == compare);
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+    return __atomic_compare_exchange_n(dest, &compare, exchange, false, mo, mo);
+#endif /* defined(ROMANO_MSVC) */
+}
+
+/*
+ * Double-word compare exchange, for pointer + counter pairs. Available when
+ * ROMANO_HAS_ATOMIC_128 is defined (x86_64 with cmpxchg16b, aarch64).
+ * Unlike the other compare exchange functions, compare is updated with the current value of
+ * dest when the exchange fails. Always sequentially consistent
+ */
+
+typedef struct ROMANO_ALIGN(16) Atomic128 {
+    uint64_t lo;
+    uint64_t hi;
+} Atomic128;
+
+#if (defined(ROMANO_X86_64) || defined(ROMANO_AARCH64)) && \
+    (defined(ROMANO_MSVC) || defined(ROMANO_GCC) || defined(ROMANO_CLANG))
+#define ROMANO_HAS_ATOMIC_128 1
+
+ROMANO_FORCE_INLINE bool atomic_compare_exchange_128(Atomic128* volatile dest,
+                                                     Atomic128 exchange,
+                                                     Atomic128* compare)
+{
+#if defined(ROMANO_MSVC)
+    return _InterlockedCompareExchange128((__int64 volatile*)dest,
+                                          (__int64)exchange.hi,
+                                          (__int64)exchange.lo,
+                                          (__int64*)compare) != 0;
+#elif defined(ROMANO_X86_64)
+    bool result;
+
+    __asm__ __volatile__("lock cmpxchg16b %1"
+                         : "=@ccz" (result), "+m" (*dest), "+a" (compare->lo), "+d" (compare->hi)
+                         : "b" (exchange.lo), "c" (exchange.hi)
+                         : "memory");
+
+    return result;
+#else
+    uint64_t lo;
+    uint64_t hi;
+    uint32_t failed;
+
+    do
+    {
+        __asm__ __volatile__("ldaxp %0, %1, %2"
+                             : "=&r" (lo), "=&r" (hi)
+                             : "Q" (*dest)
+                             : "memory");
+
+        if(lo != compare->lo || hi != compare->hi)
+        {
+            __asm__ __volatile__("clrex" : : : "memory");
+
+            compare->lo = lo;
+            compare->hi = hi;
+
+            return false;
+        }
+
+        __asm__ __volatile__("stlxp %w0, %2, %3, %1"
+                             : "=&r" (failed), "=Q" (*dest)
+                             : "r" (exchange.lo), "r" (exchange.hi)
+                             : "memory");
+    } while(failed != 0);
+
+    return true;
+#endif /* defined(ROMANO_MSVC) */
+}
+#endif /* (defined(ROMANO_X86_64) || defined(ROMANO_AARCH64)) && ... */
+
 ROMANO_FORCE_INLINE void atomic_thread_fence(MemoryOrder mo)
 {
 #if defined(ROMANO_MSVC)
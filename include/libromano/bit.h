@@ -195,6 +195,33 @@ ROMANO_FORCE_INLINE uint64_t clsb_u64(const uint64_t x)
     return x & (x - 1ULL);
 }
 
+/* Full 64x64 -> 128 bits product, returns the low part and stores the high part in hi */
+
+ROMANO_FORCE_INLINE uint64_t mul128_u64(const uint64_t x, const uint64_t y, uint64_t* hi)
+{
+#if defined(ROMANO_MSVC) && defined(ROMANO_X86_64)
+    return _umul128(x, y, hi);
+#elif defined(__SIZEOF_INT128__)
+    const __uint128_t product = (__uint128_t)x * y;
+    *hi = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    const uint64_t x_lo = x & 0xFFFFFFFFULL;
+    const uint64_t x_hi = x >> 32;
+    const uint64_t y_lo = y & 0xFFFFFFFFULL;
+    const uint64_t y_hi = y >> 32;
+    const uint64_t lo_lo = x_lo * y_lo;
+    const uint64_t hi_lo = x_hi * y_lo;
+    const uint64_t lo_hi = x_lo * y_hi;
+    const uint64_t hi_hi = x_hi * y_hi;
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+
+    *hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+
+    return (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+#endif /* defined(ROMANO_MSVC) && defined(ROMANO_X86_64) */
+}
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_BIT) */
@@ -228,6 +228,29 @@ typedef long long ssize_t;
 #define ROMANO_PACKED_STRUCT(__struct__) __struct__
 #endif /* defined(ROMANO_MSVC) */
 
+#if defined(ROMANO_MSVC)
+#define ROMANO_ALIGN(alignment) __declspec(align(alignment))
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+#define ROMANO_ALIGN(alignment) __attribute__((aligned(alignment)))
+#else
+#define ROMANO_ALIGN(alignment)
+#endif /* defined(ROMANO_MSVC) */
+
+#if defined(ROMANO_MSVC)
+#define ROMANO_THREAD_LOCAL __declspec(thread)
+#elif defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+#define ROMANO_THREAD_LOCAL __thread
+#else
+#define ROMANO_THREAD_LOCAL
+#endif /* defined(ROMANO_MSVC) */
+
+/* Apple Silicon has 128 bytes cache lines */
+#if defined(ROMANO_APPLE) && defined(ROMANO_AARCH64)
+#define ROMANO_CACHE_LINE_SIZE 128
+#else
+#define ROMANO_CACHE_LINE_SIZE 64
+#endif /* defined(ROMANO_APPLE) && defined(ROMANO_AARCH64) */
+
 #if defined(ROMANO_CLANG)
 #define dump_struct(s) __builtin_dump_struct(s, printf)
 #else
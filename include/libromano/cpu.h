@@ -21,6 +21,9 @@ ROMANO_CPP_ENTER
 #define cpuid(__regs, __mode) asm volatile ("cpuid" : "=a" ((__regs)[0]), "=b" ((__regs)[1]), "=c" ((__regs)[2]), "=d" ((__regs)[3]) : "a" (__mode), "c" (0))
 #endif /* defined(ROMANO_MSVC) */
 #elif defined(ROMANO_AARCH64)
+#if defined(ROMANO_MSVC)
+#include <intrin.h>
+#endif /* defined(ROMANO_MSVC) */
 #endif /* defined(ROMANO_X86_64) */
 
 ROMANO_API void cpu_check(void);
@@ -40,6 +43,68 @@ ROMANO_API void cpu_get_current_frequency_set_refresh_frequency(const uint32_t r
 
 ROMANO_API uint64_t cpu_rdtsc(void);
 
+/* Spin-wait hint (pause on x86-64, yield on aarch64) to use in busy-waiting loops */
+ROMANO_FORCE_INLINE void cpu_pause(void)
+{
+#if defined(ROMANO_X86_64)
+#if defined(ROMANO_MSVC)
+    _mm_pause();
+#else
+    __asm__ __volatile__("pause");
+#endif /* defined(ROMANO_MSVC) */
+#elif defined(ROMANO_AARCH64)
+#if defined(ROMANO_MSVC)
+    __yield();
+#else
+    __asm__ __volatile__("yield");
+#endif /* defined(ROMANO_MSVC) */
+#endif /* defined(ROMANO_X86_64) */
+}
+
+/* Topology */
+
+#define CPU_TOPOLOGY_UNKNOWN UINT32_MAX
+
+typedef struct CPULogicalProcessor {
+    /* Id of the processor as seen by the OS (used for affinity) */
+    uint32_t id;
+
+    /* Dense index of the physical core, unique across packages */
+    uint32_t core_id;
+
+    /* Index of the hardware thread inside the physical core (0 for the first SMT sibling) */
+    uint32_t smt_index;
+
+    uint32_t package_id;
+    uint32_t numa_node;
+
+    /* Processors sharing a cache level have the same id (CPU_TOPOLOGY_UNKNOWN if not found) */
+    uint32_t l2_id;
+    uint32_t l3_id;
+} CPULogicalProcessor;
+
+typedef struct CPUTopology {
+    CPULogicalProcessor* processors;
+    uint32_t processors_count;
+    uint32_t cores_count;
+    uint32_t packages_count;
+    uint32_t numa_nodes_count;
+} CPUTopology;
+
+/*
+ * Discovers the logical processors, physical cores, SMT siblings, shared caches and NUMA nodes
+ * (sysfs on Linux, GetLogicalProcessorInformationEx on Windows, sysctl on macOS).
+ * On Linux, only the processors the process is allowed to run on (affinity mask) are reported.
+ * If the topology cannot be found, every logical processor is reported as its own core.
+ * Returns false on memory allocation failure
+ */
+ROMANO_API bool cpu_topology_init(CPUTopology* topology);
+
+/*
+ * Releases the topology
+ */
+ROMANO_API void cpu_topology_release(CPUTopology* topology);
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_CPU) */
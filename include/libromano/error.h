@@ -39,6 +39,11 @@ typedef enum ErrorCode {
     ErrorCode_JsonUnexpectedCharacter,
     ErrorCode_JsonExpectedKey,
     ErrorCode_JsonExpectedColon,
+    ErrorCode_JsonUnterminatedString,
+    ErrorCode_JsonMaxDepthExceeded,
+    ErrorCode_JsonInvalidPath,
+    ErrorCode_JsonSchemaMismatch,
+    ErrorCode_JsonMissingField,
 
     /* Regex errors */
     ErrorCode_RegexUnexpectedCharacter,
@@ -63,6 +68,10 @@ typedef enum ErrorCode {
     ErrorCode_CLITooManyPositionalArgs,
     ErrorCode_CLIMissingPositionalArgs,
     ErrorCode_CLIMissingRequiredArg,
+
+    /* Number parsing errors */
+    ErrorCode_ParseInvalidNumber,
+    ErrorCode_ParseNumberOutOfRange,
 } ErrorCode;
 
 /* Reserved for internal use only */
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_FIBER)
+#define __LIBROMANO_FIBER
+
+#include "libromano/common.h"
+#include "libromano/thread.h"
+#include "libromano/socket.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Fibers are stackful coroutines executed on the workers of a ThreadPool. A fiber waiting for
+ * a socket to be ready gives its worker back to the pool, and is resumed on any worker once
+ * the socket is ready, so many blocking-style I/O calls can run on a handful of threads.
+ * The context switch is implemented in assembly for x86-64 and aarch64 (GCC/Clang), and uses
+ * the Win32 fiber API on Windows.
+ */
+
+struct FiberRuntime;
+typedef struct FiberRuntime FiberRuntime;
+
+#define FIBER_DEFAULT_STACK_SIZE (64 * 1024)
+
+typedef enum FiberIOEvent {
+    FiberIOEvent_Read = 0x1,
+    FiberIOEvent_Write = 0x2,
+} FiberIOEvent;
+
+/*
+ * Creates a fiber runtime scheduling its fibers on the given threadpool. Stacks are allocated
+ * with a guard page and reused between fibers. If stack_size is 0, FIBER_DEFAULT_STACK_SIZE is used.
+ * Returns NULL on failure
+ */
+ROMANO_API FiberRuntime* fiber_runtime_new(ThreadPool* threadpool, size_t stack_size);
+
+/*
+ * Starts a new fiber executing func(arg) on the threadpool. The return value of func is ignored.
+ * If no waiter is needed, pass NULL as the ThreadPool waiter
+ */
+ROMANO_API bool fiber_spawn(FiberRuntime* runtime, ThreadFunc func, void* arg, ThreadPoolWaiter* waiter);
+
+/* Returns true if the calling code is executed by a fiber */
+ROMANO_API bool fiber_is_in_fiber(void);
+
+/*
+ * Gives the worker back to the threadpool, the fiber is resumed later on any worker.
+ * Outside of a fiber, yields the current thread
+ */
+ROMANO_API void fiber_yield(void);
+
+/*
+ * Suspends the fiber until the socket is ready for the given events (FiberIOEvent flags).
+ * Outside of a fiber, blocks the current thread until the socket is ready.
+ * Returns the ready events, that can also be 0 if the socket has been closed or is in error
+ */
+ROMANO_API uint32_t fiber_wait_socket(Socket s, uint32_t events);
+
+/*
+ * Same as socket_recv/socket_send, but the fiber is suspended while the socket would block.
+ * The socket must be non-blocking (see socket_set_nonblocking)
+ */
+ROMANO_API ssize_t fiber_socket_recv(Socket s, void* buffer, size_t buffer_sz, int flags);
+
+ROMANO_API ssize_t fiber_socket_send(Socket s, const void* buffer, size_t buffer_sz, int flags);
+
+/* Releases the fiber runtime. All the fibers must have finished */
+ROMANO_API void fiber_runtime_free(FiberRuntime* runtime);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_FIBER) */
@@ -49,6 +49,27 @@ ROMANO_API void fs_file_content_release(FileContent* content);
  */
 ROMANO_API void fs_file_content_free(FileContent* content);
 
+typedef struct FileMapping {
+    char* data;
+    size_t size;
+#if defined(ROMANO_WIN)
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#endif /* defined(ROMANO_WIN) */
+} FileMapping;
+
+/*
+ * Maps the content of a file in memory. If writable is true, the mapping is private
+ * (copy-on-write), writes are only visible to the process and never reach the file.
+ * Empty files are mapped with a NULL data. Returns false on error
+ */
+ROMANO_API bool fs_file_map(FileMapping* mapping, const char* path, bool writable);
+
+/*
+ * Unmaps a file mapped with fs_file_map
+ */
+ROMANO_API void fs_file_unmap(FileMapping* mapping);
+
 /*
  * Returns true if the given path exists, false otherwise
  */
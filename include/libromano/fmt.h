@@ -41,6 +41,16 @@ ROMANO_API int fmt_size_f64(double f64, int precision);
  */
 ROMANO_API int fmt_f64(char* buffer, double f64, int precision);
 
+#define FMT_F64_SHORTEST_MAX_SIZE 24
+
+/*
+ * Formats f64 with the fewest digits that parse back to the same double, in fixed notation for
+ * decimal exponents in [-4, 16) (with at least one fractional digit, as in 1.0), and in
+ * scientific notation otherwise (as in 1e16 or 2.5e-7).
+ * buffer should be at least FMT_F64_SHORTEST_MAX_SIZE bytes, and there will be no null terminator added
+ */
+ROMANO_API int fmt_f64_shortest(char* buffer, double f64);
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_FMT) */
@@ -16,6 +16,10 @@ ROMANO_CPP_ENTER
 #define JSON_INVALID_I64 ((int64_t)(0x7FFFFFFFFFFFFFFF))
 #define JSON_INVALID_F64 ((double)(0xFFFFFFFF7FF7FFFF))
 
+#define JSON_DICT_INDEX_THRESHOLD 16
+
+#define JSON_POOL_SIZE 8
+
 typedef union JsonValueUnion {
     bool b;
     uint64_t u64;
@@ -35,17 +39,13 @@ typedef struct JsonKeyValue {
     JsonValue* value;
 } JsonKeyValue;
 
-typedef struct JsonArrayElement {
-    JsonValue* value;
-    struct JsonArrayElement* next;
-} JsonArrayElement;
-
 typedef struct JsonArrayIterator {
-    JsonArrayElement* current;
+    size_t index;
 } JsonArrayIterator;
 
 typedef struct JsonDictElement {
     JsonKeyValue* key_value;
+    struct JsonDictElement* previous;
     struct JsonDictElement* next;
 } JsonDictElement;
 
@@ -53,10 +53,19 @@ typedef struct JsonDictIterator {
     JsonDictElement* current;
 } JsonDictIterator;
 
+struct FileMapping;
+
 typedef struct Json {
     JsonValue* root;
     Arena string_arena;
     Arena value_arena;
+    /* File mapped by json_loadf, the document strings point into it */
+    struct FileMapping* mapping;
+    /* Parser scratch buffers, kept by documents reused with json_loads_into */
+    uint32_t* indices;
+    size_t indices_capacity;
+    JsonValue** stack;
+    size_t stack_capacity;
 } Json;
 
 /*******************/
@@ -196,6 +205,12 @@ ROMANO_API void json_array_append(Json* json, JsonValue* array, JsonValue* value
  */
 ROMANO_API void json_array_pop(Json* json, JsonValue* array, size_t index);
 
+/*
+ * Returns the element at the given index. If the index is out of bounds or the JsonValue is not an
+ * array, returns NULL
+ */
+ROMANO_API JsonValue* json_array_get(JsonValue* array, size_t index);
+
 /*
  * Returns the next element of the array. If there is no element left, returns NULL
  */
@@ -206,6 +221,12 @@ ROMANO_API JsonValue* json_array_get_next(Json* json, JsonValue* array, JsonArra
  */
 ROMANO_API size_t json_array_get_size(JsonValue* value);
 
+/*
+ * Converts a numeric (u64, i64, f64) array to doubles, out must hold json_array_get_size(array)
+ * elements. Returns false if the JsonValue is not an array or holds non-numeric elements
+ */
+ROMANO_API bool json_array_to_f64(JsonValue* array, double* out);
+
 /* Dict */
 
 /*
@@ -221,7 +242,9 @@ ROMANO_API JsonValue* json_dict_new(Json* json, JsonValue* value);
 ROMANO_API void json_dict_append(Json* json, JsonValue* dict, const char* key, JsonValue* value, bool reference);
 
 /*
- * Returns a ptr to the associated value. If not found, returns NULL
+ * Returns a ptr to the associated value. If not found, returns NULL.
+ * Dicts holding at least JSON_DICT_INDEX_THRESHOLD keys build a hashed key index on their first
+ * lookup, making subsequent lookups and pops O(1)
  */
 ROMANO_API JsonValue* json_dict_find(Json* json, JsonValue* dict, const char* key);
 
@@ -238,6 +261,14 @@ ROMANO_API JsonKeyValue* json_dict_get_next(Json* json, JsonValue* dict, JsonDic
  */
 ROMANO_API size_t json_dict_get_size(JsonValue* value);
 
+/*
+ * Decodes the escape sequences of a json string body (without quotes), \uXXXX sequences
+ * (and surrogate pairs) are encoded as UTF-8. dst must hold src_sz + 1 bytes and can be equal to
+ * src to decode in place. The result is null-terminated.
+ * Returns false on invalid escape sequences
+ */
+ROMANO_API bool json_unescape(char* dst, const char* src, size_t src_sz, size_t* dst_sz);
+
 /**************/
 /* Json funcs */
 /**************/
@@ -254,16 +285,60 @@ ROMANO_API void json_set_root(Json* json, JsonValue* root);
 
 /*
  * Reads a Json document from a string. Returns NULL on error, otherwise returns a heap-allocated
- * Json document
+ * Json document.
+ * The structural index stores 32 bits positions: inputs larger than 4 GiB (UINT32_MAX bytes) are
+ * refused with ErrorCode_SizeOverflow, for all the loading functions and json_ondemand_new
  */
 ROMANO_API Json* json_loads(const char* str, size_t len);
 
 /*
- * Reads a Json document from a file. Returns NULL on error, otherwise returns a heap-allocated
- * Json document
+ * Reads a Json document from a mutable string, parsed in-situ: strings and keys are decoded in
+ * str and point into it, nothing is copied. str is modified and must outlive the document.
+ * Returns NULL on error, otherwise returns a heap-allocated Json document
+ */
+ROMANO_API Json* json_loads_insitu(char* str, size_t len);
+
+/*
+ * Reads a Json document from a file. The file is memory-mapped (copy-on-write) and parsed in-situ,
+ * the mapping is released with the document.
+ * Returns NULL on error, otherwise returns a heap-allocated Json document
  */
 ROMANO_API Json* json_loadf(const char* file_path);
 
+/*
+ * Clears a Json document to be reused. The arenas blocks and the parser scratch buffers are kept,
+ * so parsing into a reset document does not allocate once it is warm
+ */
+ROMANO_API void json_reset(Json* json);
+
+/*
+ * Resets the document and reads a new one from a string into it. Returns false on error, the
+ * document being left empty
+ */
+ROMANO_API bool json_loads_into(Json* json, const char* str, size_t len);
+
+/*
+ * Same as json_loads_into, parsing in-situ. See json_loads_insitu
+ */
+ROMANO_API bool json_loads_insitu_into(Json* json, char* str, size_t len);
+
+/*
+ * Per-thread pool of reusable documents, up to JSON_POOL_SIZE documents are kept by each thread.
+ * Returns a document from the calling thread pool, or a new one if the pool is empty.
+ * Returns NULL on error
+ */
+ROMANO_API Json* json_pool_acquire(void);
+
+/*
+ * Resets and gives back a document to the calling thread pool, freeing it if the pool is full
+ */
+ROMANO_API void json_pool_release(Json* json);
+
+/*
+ * Frees the documents held by the calling thread pool, to be called before the thread exits
+ */
+ROMANO_API void json_pool_clear(void);
+
 /*
  */
 ROMANO_API char* json_dumps(Json* json, size_t indent_size, size_t* dumps_size);
@@ -277,6 +352,102 @@ ROMANO_API bool json_dumpf(Json* json, size_t indent_size, const char* file_path
  */
 ROMANO_API void json_free(Json* json);
 
+/************************/
+/* On-demand Json funcs */
+/************************/
+
+/*
+ * On-demand parsing only builds the structural index of the input and the matching position of
+ * each bracket. Values are reached through cursors over the raw text, unneeded subtrees are
+ * skipped in constant time, and only the accessed values are parsed.
+ * The grammar of skipped values is not validated. The input is not copied and must outlive the
+ * on-demand document. As with json_loads, the input is limited to 4 GiB
+ */
+
+struct JsonOnDemand;
+typedef struct JsonOnDemand JsonOnDemand;
+
+typedef struct JsonCursor {
+    JsonOnDemand* doc;
+    size_t index;
+} JsonCursor;
+
+typedef enum JsonCursorType {
+    JsonCursorType_Null,
+    JsonCursorType_Bool,
+    JsonCursorType_Number,
+    JsonCursorType_Str,
+    JsonCursorType_Array,
+    JsonCursorType_Dict,
+    JsonCursorType_Invalid,
+} JsonCursorType;
+
+/*
+ * Indexes the given string. Returns NULL on error (unterminated string, unbalanced brackets)
+ */
+ROMANO_API JsonOnDemand* json_ondemand_new(const char* str, size_t str_sz);
+
+/*
+ * Sets root to the top-level value. Returns false if the document is empty
+ */
+ROMANO_API bool json_ondemand_get_root(JsonOnDemand* doc, JsonCursor* root);
+
+/*
+ * Releases an on-demand document, the values materialized from its cursors are released too
+ */
+ROMANO_API void json_ondemand_free(JsonOnDemand* doc);
+
+ROMANO_API JsonCursorType json_cursor_get_type(const JsonCursor* cursor);
+
+/*
+ * Finds the value of the given key in a dict. Fields before it are skipped without being parsed.
+ * Returns false if the cursor is not a dict or if the key is not found
+ */
+ROMANO_API bool json_cursor_find_field(const JsonCursor* dict, const char* key, JsonCursor* value);
+
+/*
+ * Sets element to the first element of an array or the first value of a dict.
+ * Returns false if the cursor is not a container or if it is empty
+ */
+ROMANO_API bool json_cursor_first_element(const JsonCursor* container, JsonCursor* element);
+
+/*
+ * Moves element to its next sibling, skipping its subtree. Returns false at the end of the container
+ */
+ROMANO_API bool json_cursor_next_element(JsonCursor* element);
+
+/*
+ * Returns the key of a dict value cursor (null-terminated, size in key_sz if not NULL), or NULL if
+ * the cursor is not in a dict
+ */
+ROMANO_API const char* json_cursor_get_key(const JsonCursor* value, size_t* key_sz);
+
+/*
+ * Returns the number of elements of an array or of a dict, counting them by skipping subtrees
+ */
+ROMANO_API size_t json_cursor_get_size(const JsonCursor* container);
+
+/*
+ * Typed accessors, parsing the value under the cursor. Return false if the value has another type
+ */
+ROMANO_API bool json_cursor_get_bool(const JsonCursor* cursor, bool* b);
+
+ROMANO_API bool json_cursor_get_u64(const JsonCursor* cursor, uint64_t* u64);
+
+ROMANO_API bool json_cursor_get_i64(const JsonCursor* cursor, int64_t* i64);
+
+/* Integers are converted to double */
+ROMANO_API bool json_cursor_get_f64(const JsonCursor* cursor, double* f64);
+
+/* The string is decoded and owned by the on-demand document */
+ROMANO_API const char* json_cursor_get_str(const JsonCursor* cursor, size_t* str_sz);
+
+/*
+ * Parses the value under the cursor and its whole subtree. The value is owned by the on-demand
+ * document. Returns NULL on error
+ */
+ROMANO_API JsonValue* json_cursor_get_value(const JsonCursor* cursor);
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_JSON) */
@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_JSON_BINARY)
+#define __LIBROMANO_JSON_BINARY
+
+#include "libromano/common.h"
+#include "libromano/json.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Compact binary encoding of json documents, to cache documents and reload them without parsing.
+ * A binary document is read in place (from memory or a memory-mapped file): values are reached
+ * through offset tables, arrays and dicts are indexed in constant time and keys are found by a
+ * binary search in large dicts. Strings are deduplicated, stored once and null-terminated.
+ *
+ * Layout (little-endian, offsets are 32 bits from the start of the data):
+ * - Header: magic "RJSB", version, total size, root offset, strings table offset
+ * - Values, children being written before their container: a tag byte followed by
+ *   - u64: a varint, i64: a zigzag varint, f64: 8 bytes, str: the varint id of the string
+ *   - array: varint count, count value offsets
+ *   - dict: varint count, count (key string id, value offset) pairs in insertion order, and for
+ *     dicts of at least JSON_DICT_INDEX_THRESHOLD entries, the entries indices sorted by key
+ * - Strings table: varint count, count string offsets, each string being a varint size followed by
+ *   its bytes and a null terminator
+ */
+
+#define JSON_BINARY_VERSION 1
+
+struct JsonBinary;
+typedef struct JsonBinary JsonBinary;
+
+typedef struct JsonBinaryValue {
+    const JsonBinary* binary;
+    uint32_t offset;
+} JsonBinaryValue;
+
+typedef enum JsonBinaryType {
+    JsonBinaryType_Null,
+    JsonBinaryType_Bool,
+    JsonBinaryType_U64,
+    JsonBinaryType_I64,
+    JsonBinaryType_F64,
+    JsonBinaryType_Str,
+    JsonBinaryType_Array,
+    JsonBinaryType_Dict,
+    JsonBinaryType_Invalid,
+} JsonBinaryType;
+
+/*
+ * Encodes a json document. Returns NULL on error, otherwise returns a heap-allocated buffer to be
+ * freed with free, its size being set in binary_size
+ */
+ROMANO_API char* json_binary_encode(Json* json, size_t* binary_size);
+
+/*
+ * Encodes a json text. See json_binary_encode
+ */
+ROMANO_API char* json_binary_encode_text(const char* str, size_t str_sz, size_t* binary_size);
+
+/*
+ * Encodes a json document to a file. Returns false on error
+ */
+ROMANO_API bool json_binary_dumpf(Json* json, const char* file_path);
+
+/*
+ * Opens a binary document from memory, only the header is checked. The data is not copied and must
+ * outlive the binary document. Returns NULL if the data is not a valid binary document
+ */
+ROMANO_API JsonBinary* json_binary_open(const char* data, size_t size);
+
+/*
+ * Opens a binary document from a file, which is memory-mapped. Returns NULL on error
+ */
+ROMANO_API JsonBinary* json_binary_loadf(const char* file_path);
+
+ROMANO_API JsonBinaryValue json_binary_get_root(const JsonBinary* binary);
+
+/*
+ * Decodes a binary document to a json document. Returns NULL on error
+ */
+ROMANO_API Json* json_binary_to_json(const JsonBinary* binary);
+
+/*
+ * Decodes a binary document to json text. Returns NULL on error, otherwise returns a
+ * heap-allocated string
+ */
+ROMANO_API char* json_binary_to_text(const JsonBinary* binary, size_t indent_size, size_t* text_size);
+
+/*
+ * Releases a binary document, unmapping its file if it has been loaded from one
+ */
+ROMANO_API void json_binary_free(JsonBinary* binary);
+
+/*
+ * Returns JsonBinaryType_Invalid if the value is out of the document bounds or corrupted
+ */
+ROMANO_API JsonBinaryType json_binary_get_type(JsonBinaryValue value);
+
+/*
+ * Typed accessors. Return false if the value has another type. Integers are converted to double
+ * by json_binary_get_f64, and positive integers to int64_t by json_binary_get_i64
+ */
+ROMANO_API bool json_binary_get_bool(JsonBinaryValue value, bool* b);
+
+ROMANO_API bool json_binary_get_u64(JsonBinaryValue value, uint64_t* u64);
+
+ROMANO_API bool json_binary_get_i64(JsonBinaryValue value, int64_t* i64);
+
+ROMANO_API bool json_binary_get_f64(JsonBinaryValue value, double* f64);
+
+/*
+ * Returns the string, pointing into the binary data, or NULL if the value is not a string.
+ * The string is null-terminated, but can hold nulls when decoded from \u0000 escapes: use str_sz
+ */
+ROMANO_API const char* json_binary_get_str(JsonBinaryValue value, size_t* str_sz);
+
+/*
+ * Returns the number of elements of an array or of a dict, 0 for other values
+ */
+ROMANO_API size_t json_binary_get_size(JsonBinaryValue value);
+
+/*
+ * Gets the element at the given index of an array. Returns false if out of bounds
+ */
+ROMANO_API bool json_binary_array_get(JsonBinaryValue array, size_t index, JsonBinaryValue* element);
+
+/*
+ * Gets the key and the value at the given index of a dict, in insertion order. Returns false if
+ * out of bounds
+ */
+ROMANO_API bool json_binary_dict_get(JsonBinaryValue dict, size_t index, const char** key, JsonBinaryValue* value);
+
+/*
+ * Finds the value of the given key in a dict. Returns false if the key is not found
+ */
+ROMANO_API bool json_binary_dict_find(JsonBinaryValue dict, const char* key, JsonBinaryValue* value);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_JSON_BINARY) */
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_JSON_PATH)
+#define __LIBROMANO_JSON_PATH
+
+#include "libromano/common.h"
+#include "libromano/json.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Compiled json paths, to run the same query over many documents. A path is parsed once, its keys
+ * are decoded and hashed, and it can then be executed against a Json document or an on-demand
+ * cursor.
+ *
+ * Two syntaxes are accepted:
+ * - Json Pointer (RFC 6901): "/payload/items/0/price", "" being the root. ~0 and ~1 escape '~' and
+ *   '/'. A numeric segment indexes arrays and is used as a key in dicts. A "*" segment is a
+ *   wildcard matching all the elements of an array or a dict
+ * - A JsonPath subset: "$.payload.items[*].price", "$['key with spaces'][0]", ".*" and "[*]"
+ *   being wildcards
+ */
+
+struct JsonPath;
+typedef struct JsonPath JsonPath;
+
+typedef enum JsonPathOutput {
+    JsonPathOutput_U64,
+    JsonPathOutput_I64,
+    JsonPathOutput_F64,
+    JsonPathOutput_Bool,
+    JsonPathOutput_Str,
+} JsonPathOutput;
+
+/*
+ * Compiles a path. Returns NULL if the path is invalid
+ */
+ROMANO_API JsonPath* json_path_compile(const char* path);
+
+/*
+ * Returns true if the path contains a wildcard and can match several values
+ */
+ROMANO_API bool json_path_has_wildcard(const JsonPath* path);
+
+/*
+ * Returns the first value matched by the path from root, or NULL if there is none
+ */
+ROMANO_API JsonValue* json_path_find(const JsonPath* path, Json* json, JsonValue* root);
+
+/*
+ * Writes up to results_capacity matched values to results, in document order.
+ * Returns the number of values written
+ */
+ROMANO_API size_t json_path_find_all(const JsonPath* path,
+                                     Json* json,
+                                     JsonValue* root,
+                                     JsonValue** results,
+                                     size_t results_capacity);
+
+/*
+ * Sets result to the first value matched by the path from root. Returns false if there is none
+ */
+ROMANO_API bool json_path_find_cursor(const JsonPath* path, const JsonCursor* root, JsonCursor* result);
+
+/*
+ * Batch extraction: converts the matched values and writes up to out_capacity of them to out, whose
+ * type depends on output: uint64_t*, int64_t*, double*, bool* or const char** (strings owned by the
+ * document). Matched values that cannot be converted are skipped, integers are converted to double
+ * for JsonPathOutput_F64.
+ * Returns the number of values written
+ */
+ROMANO_API size_t json_path_extract(const JsonPath* path,
+                                    Json* json,
+                                    JsonValue* root,
+                                    JsonPathOutput output,
+                                    void* out,
+                                    size_t out_capacity);
+
+/*
+ * Same as json_path_extract, running on an on-demand cursor. Only the matched values are parsed
+ */
+ROMANO_API size_t json_path_extract_cursor(const JsonPath* path,
+                                           const JsonCursor* root,
+                                           JsonPathOutput output,
+                                           void* out,
+                                           size_t out_capacity);
+
+/*
+ * Releases a compiled path
+ */
+ROMANO_API void json_path_free(JsonPath* path);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_JSON_PATH) */
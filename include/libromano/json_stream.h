@@ -0,0 +1,222 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_JSON_STREAM)
+#define __LIBROMANO_JSON_STREAM
+
+#include "libromano/common.h"
+#include "libromano/buffer.h"
+#include "libromano/json.h"
+#include "libromano/socket.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Streaming json tokenizer, reading its input in fixed-size chunks without building a document.
+ * Memory usage is bounded by the chunk size, the largest token (up to JSON_STREAM_MAX_TOKEN_SIZE)
+ * and the nesting depth (up to JSON_STREAM_MAX_DEPTH).
+ * Input comes either from a read function (pulled when needed), or is fed by the caller chunk by
+ * chunk, in which case the tokenizer returns JsonTokenType_NeedMoreData and resumes where it stopped
+ * on the next feed. Several top-level values can follow each other in the same stream.
+ */
+
+#define JSON_STREAM_DEFAULT_CHUNK_SIZE 65536
+#define JSON_STREAM_MAX_TOKEN_SIZE (64 * 1024 * 1024)
+#define JSON_STREAM_MAX_DEPTH 1024
+
+typedef enum JsonTokenType {
+    JsonTokenType_BeginDict,
+    JsonTokenType_EndDict,
+    JsonTokenType_BeginArray,
+    JsonTokenType_EndArray,
+    JsonTokenType_Key,
+    JsonTokenType_Str,
+    JsonTokenType_U64,
+    JsonTokenType_I64,
+    JsonTokenType_F64,
+    JsonTokenType_Bool,
+    JsonTokenType_Null,
+    JsonTokenType_NeedMoreData,
+    JsonTokenType_End,
+    JsonTokenType_Error,
+} JsonTokenType;
+
+/*
+ * Keys and strings point into the stream buffer, and are valid until the next call on the stream
+ */
+typedef struct JsonToken {
+    JsonTokenType type;
+    JsonValueUnion value;
+    size_t str_size;
+} JsonToken;
+
+/*
+ * Reads up to buffer_size bytes into buffer. Returns the number of bytes read, 0 at the end of the
+ * input and a negative value on error
+ */
+typedef ssize_t (*JsonStreamReadFunc)(void* user_data, char* buffer, size_t buffer_size);
+
+struct JsonStream;
+typedef struct JsonStream JsonStream;
+
+/*
+ * Creates a new stream. If read_func is NULL, the input has to be fed with json_stream_feed.
+ * A chunk_size of 0 uses JSON_STREAM_DEFAULT_CHUNK_SIZE. Returns NULL on failure
+ */
+ROMANO_API JsonStream* json_stream_new(JsonStreamReadFunc read_func, void* user_data, size_t chunk_size);
+
+/*
+ * Creates a new stream reading the given file. Returns NULL on failure
+ */
+ROMANO_API JsonStream* json_stream_new_from_file(const char* file_path, size_t chunk_size);
+
+/*
+ * Creates a new stream receiving from the given socket. The socket is not owned by the stream.
+ * Returns NULL on failure
+ */
+ROMANO_API JsonStream* json_stream_new_from_socket(Socket socket, size_t chunk_size);
+
+/*
+ * Appends data to a stream created without read function. Returns false on allocation failure
+ */
+ROMANO_API bool json_stream_feed(JsonStream* stream, const char* data, size_t data_size);
+
+/*
+ * Marks the end of the input of a stream created without read function
+ */
+ROMANO_API void json_stream_finish(JsonStream* stream);
+
+/*
+ * Reads the next token. Returns JsonTokenType_End once the input is exhausted,
+ * JsonTokenType_NeedMoreData if the fed input ends within a token, and JsonTokenType_Error on
+ * invalid input (the error is available through error_get_last)
+ */
+ROMANO_API JsonTokenType json_stream_next(JsonStream* stream, JsonToken* token);
+
+/*
+ * Returns the current nesting depth of the stream
+ */
+ROMANO_API size_t json_stream_get_depth(JsonStream* stream);
+
+/*
+ * Callbacks for event-based parsing, NULL callbacks are skipped. Returning false stops the parsing
+ */
+typedef struct JsonSaxCallbacks {
+    bool (*begin_dict)(void* user_data);
+    bool (*end_dict)(void* user_data);
+    bool (*begin_array)(void* user_data);
+    bool (*end_array)(void* user_data);
+    bool (*key)(void* user_data, const char* key, size_t key_size);
+    bool (*scalar)(void* user_data, const JsonToken* token);
+} JsonSaxCallbacks;
+
+/*
+ * Runs the tokenizer, dispatching tokens to the callbacks until the end of the input (or until
+ * more data is needed for fed streams, parsing can then resume after the next feed).
+ * Returns false on error or when a callback stopped the parsing
+ */
+ROMANO_API bool json_stream_parse(JsonStream* stream, const JsonSaxCallbacks* callbacks, void* user_data);
+
+/*
+ * Releases the stream, closing the file it reads from if any
+ */
+ROMANO_API void json_stream_free(JsonStream* stream);
+
+/*
+ * Streaming json writer. Values are formatted into a fixed-size buffer, which is handed to a write
+ * function each time it is full, so memory usage does not depend on the output size. Calls are
+ * checked against the document structure (keys in dicts only, matching ends). Several top-level
+ * values can be written, they are separated by newlines.
+ * Errors are sticky: once a call failed, the following ones fail too
+ */
+
+#define JSON_STREAM_WRITER_DEFAULT_BUFFER_SIZE 65536
+
+/*
+ * Writes data_size bytes of data. Returns false on error, after setting the error code
+ */
+typedef bool (*JsonStreamWriteFunc)(void* user_data, const char* data, size_t data_size);
+
+struct JsonStreamWriter;
+typedef struct JsonStreamWriter JsonStreamWriter;
+
+/*
+ * Creates a new writer. A buffer_size of 0 uses JSON_STREAM_WRITER_DEFAULT_BUFFER_SIZE, an
+ * indent_size of 0 writes compact json. Returns NULL on failure
+ */
+ROMANO_API JsonStreamWriter* json_stream_writer_new(JsonStreamWriteFunc write_func,
+                                                    void* user_data,
+                                                    size_t buffer_size,
+                                                    size_t indent_size);
+
+/*
+ * Creates a new writer writing to the given file, created or truncated. Returns NULL on failure
+ */
+ROMANO_API JsonStreamWriter* json_stream_writer_new_to_file(const char* file_path,
+                                                            size_t buffer_size,
+                                                            size_t indent_size);
+
+/*
+ * Creates a new writer sending to the given socket. The socket is not owned by the writer.
+ * Returns NULL on failure
+ */
+ROMANO_API JsonStreamWriter* json_stream_writer_new_to_socket(Socket socket, size_t buffer_size, size_t indent_size);
+
+/*
+ * Creates a new writer appending to the given buffer, which must outlive the writer.
+ * Returns NULL on failure
+ */
+ROMANO_API JsonStreamWriter* json_stream_writer_new_to_buffer(Buffer* buffer, size_t buffer_size, size_t indent_size);
+
+ROMANO_API bool json_stream_writer_begin_dict(JsonStreamWriter* writer);
+
+ROMANO_API bool json_stream_writer_end_dict(JsonStreamWriter* writer);
+
+ROMANO_API bool json_stream_writer_begin_array(JsonStreamWriter* writer);
+
+ROMANO_API bool json_stream_writer_end_array(JsonStreamWriter* writer);
+
+/*
+ * Writes a dict key, the next call writes its value
+ */
+ROMANO_API bool json_stream_writer_key(JsonStreamWriter* writer, const char* key, size_t key_size);
+
+ROMANO_API bool json_stream_writer_str(JsonStreamWriter* writer, const char* str, size_t str_size);
+
+ROMANO_API bool json_stream_writer_u64(JsonStreamWriter* writer, uint64_t u64);
+
+ROMANO_API bool json_stream_writer_i64(JsonStreamWriter* writer, int64_t i64);
+
+/*
+ * Written with the fewest digits that decode back to the same double, non-finite values are
+ * written as null
+ */
+ROMANO_API bool json_stream_writer_f64(JsonStreamWriter* writer, double f64);
+
+ROMANO_API bool json_stream_writer_bool(JsonStreamWriter* writer, bool b);
+
+ROMANO_API bool json_stream_writer_null(JsonStreamWriter* writer);
+
+/*
+ * Writes a value of a Json document, and all its children
+ */
+ROMANO_API bool json_stream_writer_value(JsonStreamWriter* writer, Json* json, JsonValue* value);
+
+/*
+ * Writes the buffered data. Returns false if a previous call or the write failed
+ */
+ROMANO_API bool json_stream_writer_flush(JsonStreamWriter* writer);
+
+/*
+ * Flushes and releases the writer, closing the file it writes to if any. Returns false if the
+ * writer failed, if arrays or dicts are still open (the document is truncated), or if the final
+ * flush or closing the file failed
+ */
+ROMANO_API bool json_stream_writer_free(JsonStreamWriter* writer);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_JSON_STREAM) */
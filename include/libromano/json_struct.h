@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_JSON_STRUCT)
+#define __LIBROMANO_JSON_STRUCT
+
+#include "libromano/common.h"
+#include "libromano/arena.h"
+#include "libromano/buffer.h"
+
+#include <stddef.h>
+
+ROMANO_CPP_ENTER
+
+/*
+ * Schema-driven decoding of json text into C structs, and encoding of C structs to json text.
+ * A struct is described by a table of fields (json key, type and offset in the struct). Decoding
+ * walks the text once and writes the values directly into the caller structs, without building a
+ * Json document.
+ *
+ * - Keys missing from the text, and null values, leave the struct fields untouched, unless the
+ *   field is flagged as required
+ * - Unknown keys are skipped
+ * - Strings and arrays are allocated in the arena given to the decoder
+ * - Integers out of the field range, floats overflowing the field, floats decoded into integer
+ *   fields and strings longer than a string buffer are schema mismatches
+ *
+ * Example:
+ *
+ * typedef struct Point { double x; double y; } Point;
+ *
+ * static const JsonField point_fields[] = {
+ *     JSON_FIELD("x", Point, x, JsonFieldType_F64, JsonFieldFlag_Required),
+ *     JSON_FIELD("y", Point, y, JsonFieldType_F64, JsonFieldFlag_Required),
+ * };
+ *
+ * static const JsonStruct point_struct = JSON_STRUCT(Point, point_fields);
+ */
+
+#define JSON_STRUCT_MAX_FIELDS 256
+#define JSON_STRUCT_MAX_DEPTH 1024
+
+typedef enum JsonFieldType {
+    /* bool */
+    JsonFieldType_Bool,
+    /* int32_t */
+    JsonFieldType_I32,
+    /* int64_t */
+    JsonFieldType_I64,
+    /* uint32_t */
+    JsonFieldType_U32,
+    /* uint64_t */
+    JsonFieldType_U64,
+    /* float */
+    JsonFieldType_F32,
+    /* double */
+    JsonFieldType_F64,
+    /* const char*, null-terminated and allocated in the arena, NULL being encoded as null */
+    JsonFieldType_Str,
+    /* char[size], null-terminated */
+    JsonFieldType_StrBuffer,
+    /* Nested struct, described by descriptor */
+    JsonFieldType_Struct,
+    /*
+     * Pointer to elements of element_type allocated in the arena, their number being a size_t at
+     * count_offset. Elements cannot be arrays nor string buffers
+     */
+    JsonFieldType_Array,
+} JsonFieldType;
+
+typedef enum JsonFieldFlag {
+    JsonFieldFlag_Required = 0x1,
+} JsonFieldFlag;
+
+struct JsonStruct;
+
+typedef struct JsonField {
+    const char* name;
+    JsonFieldType type;
+    size_t offset;
+    /* Capacity of string buffers */
+    size_t size;
+    /* Arrays elements type, and offset of the elements count */
+    JsonFieldType element_type;
+    size_t count_offset;
+    /* Descriptor of structs, and of arrays of structs */
+    const struct JsonStruct* descriptor;
+    uint32_t flags;
+} JsonField;
+
+typedef struct JsonStruct {
+    const JsonField* fields;
+    size_t fields_count;
+    size_t size;
+} JsonStruct;
+
+#define JSON_FIELD(name, struct_type, member, field_type, flags)                                   \
+    { name, field_type, offsetof(struct_type, member), 0, JsonFieldType_Bool, 0, NULL, flags }
+
+#define JSON_FIELD_STR_BUFFER(name, struct_type, member, flags)                                    \
+    { name, JsonFieldType_StrBuffer, offsetof(struct_type, member),                                \
+      sizeof(((struct_type*)0)->member), JsonFieldType_Bool, 0, NULL, flags }
+
+#define JSON_FIELD_STRUCT(name, struct_type, member, descriptor, flags)                            \
+    { name, JsonFieldType_Struct, offsetof(struct_type, member), 0, JsonFieldType_Bool, 0,         \
+      descriptor, flags }
+
+#define JSON_FIELD_ARRAY(name, struct_type, member, count_member, element_type, descriptor, flags) \
+    { name, JsonFieldType_Array, offsetof(struct_type, member), 0, element_type,                   \
+      offsetof(struct_type, count_member), descriptor, flags }
+
+#define JSON_STRUCT(struct_type, fields) { fields, sizeof(fields) / sizeof(fields[0]), sizeof(struct_type) }
+
+/*
+ * Decodes a json dict into out, a struct described by descriptor. arena can be NULL if the
+ * descriptor holds no strings nor arrays. Returns false on error, out being partially written
+ */
+ROMANO_API bool json_struct_decode(const JsonStruct* descriptor,
+                                   const char* str,
+                                   size_t str_sz,
+                                   void* out,
+                                   Arena* arena);
+
+/*
+ * Decodes a json array of dicts into an array of structs allocated in the arena, its size being
+ * set in count. Returns false on error
+ */
+ROMANO_API bool json_struct_decode_array(const JsonStruct* descriptor,
+                                         const char* str,
+                                         size_t str_sz,
+                                         Arena* arena,
+                                         void** out,
+                                         size_t* count);
+
+/*
+ * Encodes a struct described by descriptor as a json dict, appended to buffer.
+ * Returns false on error
+ */
+ROMANO_API bool json_struct_encode(const JsonStruct* descriptor, const void* data, Buffer* buffer);
+
+/*
+ * Encodes an array of count structs as a json array, appended to buffer. Returns false on error
+ */
+ROMANO_API bool json_struct_encode_array(const JsonStruct* descriptor,
+                                         const void* data,
+                                         size_t count,
+                                         Buffer* buffer);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_JSON_STRUCT) */
@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_LOCKFREE_STACK)
+#define __LIBROMANO_LOCKFREE_STACK
+
+#include "libromano/common.h"
+#include "libromano/atomic.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Lock-free intrusive stack (Treiber stack). The head is a pointer and a counter updated
+ * together with a double-word CAS, or packed in a single word on platforms without it, so a
+ * node popped and pushed back between a load and a CAS (ABA) does not corrupt the stack.
+ *
+ * A popping thread may read the next pointer of a node that has just been popped by another
+ * thread: nodes must stay readable after being popped, either because they are never freed
+ * while the stack is in use (free lists, pools), or by retiring them with reclamation.h
+ */
+
+typedef struct LockFreeStackNode {
+    struct LockFreeStackNode* next;
+} LockFreeStackNode;
+
+typedef struct LockFreeStack {
+#if defined(ROMANO_HAS_ATOMIC_128)
+    /* lo: head pointer, hi: counter */
+    Atomic128 head;
+#else
+    /* Head pointer in the low bits, counter in the high bits */
+    Atomic64 head;
+#endif /* defined(ROMANO_HAS_ATOMIC_128) */
+} LockFreeStack;
+
+ROMANO_API void lockfreestack_init(LockFreeStack* stack);
+
+ROMANO_API bool lockfreestack_is_empty(LockFreeStack* stack);
+
+ROMANO_API void lockfreestack_push(LockFreeStack* stack, LockFreeStackNode* node);
+
+/* Pushes a list of nodes already linked from first to last, with a single CAS */
+ROMANO_API void lockfreestack_push_batch(LockFreeStack* stack,
+                                         LockFreeStackNode* first,
+                                         LockFreeStackNode* last);
+
+/* Returns NULL if the stack is empty */
+ROMANO_API LockFreeStackNode* lockfreestack_pop(LockFreeStack* stack);
+
+/* Detaches all the nodes at once, and returns them as a list linked in pop order */
+ROMANO_API LockFreeStackNode* lockfreestack_pop_all(LockFreeStack* stack);
+
+/*
+ * Work stack of pointers shared between threads, for work-stack heavy algorithms (tree
+ * traversals, DFS...). Each thread works in its own cache of two chunks, and only touches the
+ * shared lock-free stack to publish a full chunk or to take one when its cache is empty.
+ * Values in a thread cache (at most 2 * WORKSTACK_CHUNK_SIZE) are not visible to the other
+ * threads until they overflow or are flushed.
+ */
+
+#define WORKSTACK_CHUNK_SIZE 64
+
+struct WorkStack;
+typedef struct WorkStack WorkStack;
+
+struct WorkStackCache;
+typedef struct WorkStackCache WorkStackCache;
+
+/* Creates a new work stack. Returns NULL on failure */
+ROMANO_API WorkStack* workstack_new(void);
+
+/* Creates the cache a thread uses to access the work stack. Returns NULL on failure */
+ROMANO_API WorkStackCache* workstack_cache_new(WorkStack* stack);
+
+ROMANO_API bool workstack_push(WorkStackCache* cache, void* value);
+
+/* Pops from the thread cache first, then from the shared stack. Returns false if both are empty */
+ROMANO_API bool workstack_pop(WorkStackCache* cache, void** value);
+
+/* Publishes the values of the thread cache to the shared stack */
+ROMANO_API void workstack_flush(WorkStackCache* cache);
+
+/* Flushes and frees the thread cache */
+ROMANO_API void workstack_cache_free(WorkStackCache* cache);
+
+/* Frees the work stack, all the caches must have been freed */
+ROMANO_API void workstack_free(WorkStack* stack);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_LOCKFREE_STACK) */
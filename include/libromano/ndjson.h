@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_NDJSON)
+#define __LIBROMANO_NDJSON
+
+#include "libromano/common.h"
+#include "libromano/json.h"
+#include "libromano/thread.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Newline-delimited json (NDJSON / JSON Lines) loader. The input is split in batches of lines
+ * ending on a newline, batches are parsed in parallel on a threadpool and each record is handed
+ * to a callback. Blank lines are skipped, and lines may end with \r\n.
+ * Workers parse into json documents that are reused from a record (or a batch) to the next one,
+ * so the records passed to the callback are only valid during the call.
+ */
+
+#define NDJSON_BATCH_SIZE (256 * 1024)
+
+/*
+ * Called for each record, the record root is json->root. Return false to stop the loading.
+ * The json document must not be freed by the callback
+ */
+typedef bool (*NDJsonRecordFunc)(Json* json, void* user_data);
+
+typedef enum NDJsonOrder {
+    /* Records are passed to the callback in input order, on the calling thread */
+    NDJsonOrder_Ordered,
+
+    /* Records are passed to the callback as soon as they are parsed, on the workers threads */
+    NDJsonOrder_Unordered,
+} NDJsonOrder;
+
+/*
+ * Loads the records of a newline-delimited json buffer. If threadpool is NULL, records are
+ * parsed on the calling thread.
+ * Returns false if a record is invalid (its byte offset is logged) or if the callback stopped
+ * the loading. In unordered mode, records following the invalid one might have been passed to
+ * the callback
+ */
+ROMANO_API bool ndjson_loads(ThreadPool* threadpool,
+                             const char* data,
+                             size_t data_size,
+                             NDJsonOrder order,
+                             NDJsonRecordFunc func,
+                             void* user_data);
+
+/*
+ * Loads the records of a newline-delimited json file, the file is memory-mapped and the
+ * records are parsed in-situ.
+ * See ndjson_loads
+ */
+ROMANO_API bool ndjson_loadf(ThreadPool* threadpool,
+                             const char* file_path,
+                             NDJsonOrder order,
+                             NDJsonRecordFunc func,
+                             void* user_data);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_NDJSON) */
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_PARSE)
+#define __LIBROMANO_PARSE
+
+#include "libromano/common.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Number parsing from non null-terminated strings. Digits are parsed 8 at a time, and doubles are
+ * correctly rounded (Clinger fast path, then Eisel-Lemire, then strtod for the rare ambiguous cases).
+ *
+ * All functions parse the number at the start of str, and stop at the first character that cannot
+ * be part of it. On success, pos is set to the number of characters parsed. On error, pos is set to
+ * the offset of the invalid character in str, and the error code is set.
+ *
+ * Accepted syntax: [+-]digits[.digits][(e|E)[+-]digits], the integer or fractional digits being
+ * optional (".5", "5."), and inf, infinity or nan (case-insensitive) for doubles.
+ * With ParseFlags_Json, the json syntax is enforced: no leading +, no leading zeros, digits on both
+ * sides of the point, and no inf nor nan.
+ */
+
+typedef enum ParseFlags {
+    ParseFlags_Json = 0x1,
+} ParseFlags;
+
+typedef enum ParsedNumberType {
+    ParsedNumberType_U64,
+    ParsedNumberType_I64,
+    ParsedNumberType_F64,
+} ParsedNumberType;
+
+typedef struct ParsedNumber {
+    ParsedNumberType type;
+    union {
+        uint64_t u64;
+        int64_t i64;
+        double f64;
+    } value;
+} ParsedNumber;
+
+/*
+ * Parses a number, as an u64 if it is a positive integer, an i64 if it is a negative integer, and as
+ * a f64 if it has a fractional part, an exponent, or does not fit in 64 bits
+ */
+ROMANO_API bool parse_number(const char* str, size_t str_sz, uint32_t flags, ParsedNumber* number, size_t* pos);
+
+/*
+ * Parses an unsigned integer, a leading - being invalid. Returns false if it does not fit in 64 bits
+ */
+ROMANO_API bool parse_u64(const char* str, size_t str_sz, uint64_t* u64, size_t* pos);
+
+/*
+ * Parses a signed integer. Returns false if it does not fit in 64 bits
+ */
+ROMANO_API bool parse_i64(const char* str, size_t str_sz, int64_t* i64, size_t* pos);
+
+/*
+ * Parses a double, integers included. Out of range values become zero or infinity
+ */
+ROMANO_API bool parse_f64(const char* str, size_t str_sz, double* f64, size_t* pos);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_PARSE) */
@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_RECLAMATION)
+#define __LIBROMANO_RECLAMATION
+
+#include "libromano/common.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Safe memory reclamation for lock-free structures: nodes unlinked by a writer are retired
+ * instead of being freed, and are freed once no reader can hold a reference to them anymore.
+ * Each thread accessing a structure registers itself in the domain protecting it, and retires
+ * nodes into its own list, which is reclaimed in batches.
+ */
+
+/* Called to free a retired pointer */
+typedef void (*ReclaimFunc)(void* ptr);
+
+/*
+ * Epoch-based reclamation. Readers wrap their accesses in epoch_enter/epoch_exit, which only
+ * costs a store and a fence. A retired node is freed after the global epoch advanced twice,
+ * which requires every thread inside a critical section to have observed the new epoch: a
+ * reader blocked in a critical section delays the reclamation of all the retired nodes
+ */
+
+struct EpochDomain;
+typedef struct EpochDomain EpochDomain;
+
+struct EpochThread;
+typedef struct EpochThread EpochThread;
+
+/* Creates a new epoch domain. Returns NULL on failure */
+ROMANO_API EpochDomain* epoch_domain_new(void);
+
+/* Registers the calling thread in the domain. Returns NULL on failure */
+ROMANO_API EpochThread* epoch_thread_register(EpochDomain* domain);
+
+/*
+ * Unregisters a thread, which must not be in a critical section. Its pending retired pointers
+ * are handed over to the domain, or kept with the thread record (reclaimed by the next thread
+ * reusing it, or when the domain is freed) if memory is exhausted
+ */
+ROMANO_API void epoch_thread_unregister(EpochThread* thread);
+
+/* Enters a critical section, critical sections can be nested */
+ROMANO_API void epoch_enter(EpochThread* thread);
+
+ROMANO_API void epoch_exit(EpochThread* thread);
+
+/*
+ * Retires a pointer unlinked from the structure, func(ptr) is called once it is safe.
+ * Can be called inside or outside a critical section. Returns false if memory is exhausted,
+ * even after reclaiming: the pointer has not been retired and is still owned by the caller
+ */
+ROMANO_API bool epoch_retire(EpochThread* thread, void* ptr, ReclaimFunc func);
+
+/*
+ * Tries to advance the global epoch and frees the retired pointers of the thread that are safe
+ * to free. Returns the number of retired pointers still pending in the thread
+ */
+ROMANO_API size_t epoch_reclaim(EpochThread* thread);
+
+/*
+ * Frees all the pending retired pointers, and the thread records. No thread may use the domain
+ * anymore
+ */
+ROMANO_API void epoch_domain_free(EpochDomain* domain);
+
+/*
+ * Hazard pointers. Readers publish the pointers they are about to dereference in a few slots,
+ * and retired pointers are freed once they are not published anymore. Slower for readers than
+ * epochs, but a stalled reader only prevents the reclamation of the nodes it protects
+ */
+
+struct HazardDomain;
+typedef struct HazardDomain HazardDomain;
+
+struct HazardThread;
+typedef struct HazardThread HazardThread;
+
+/* Creates a new hazard pointer domain, each thread gets slots_count slots. Returns NULL on failure */
+ROMANO_API HazardDomain* hazard_domain_new(uint32_t slots_count);
+
+/* Registers the calling thread in the domain. Returns NULL on failure */
+ROMANO_API HazardThread* hazard_thread_register(HazardDomain* domain);
+
+/*
+ * Clears the slots of the thread and unregisters it. Its pending retired pointers are handed over
+ * to the domain, or kept with the thread record if memory is exhausted, as for epochs
+ */
+ROMANO_API void hazard_thread_unregister(HazardThread* thread);
+
+/*
+ * Loads the pointer stored at src and publishes it in the given slot, retrying until the
+ * published pointer is still the one stored at src. The returned pointer can be dereferenced
+ * until the slot is cleared or reused
+ */
+ROMANO_API void* hazard_protect(HazardThread* thread, uint32_t slot, void* volatile* src);
+
+/* Publishes an already protected (or not yet shared) pointer in the given slot */
+ROMANO_API void hazard_set(HazardThread* thread, uint32_t slot, void* ptr);
+
+ROMANO_API void hazard_clear(HazardThread* thread, uint32_t slot);
+
+/*
+ * Retires a pointer unlinked from the structure, func(ptr) is called once no slot publishes it.
+ * Returns false if memory is exhausted, as epoch_retire
+ */
+ROMANO_API bool hazard_retire(HazardThread* thread, void* ptr, ReclaimFunc func);
+
+/* Frees the retired pointers of the thread that are not protected. Returns the number still pending */
+ROMANO_API size_t hazard_reclaim(HazardThread* thread);
+
+/* Frees all the pending retired pointers, and the thread records. No thread may use the domain anymore */
+ROMANO_API void hazard_domain_free(HazardDomain* domain);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_RECLAMATION) */
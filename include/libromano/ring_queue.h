@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_RING_QUEUE)
+#define __LIBROMANO_RING_QUEUE
+
+#include "libromano/common.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Bounded lock-free ring queues of pointers. The capacity is fixed at creation (rounded up to
+ * the next power of two) and no memory is allocated afterwards. Producer and consumer indices
+ * live on separate cache lines.
+ * The try_ functions never block, the others spin then yield until they succeed.
+ */
+
+/* Single producer, single consumer */
+
+struct SPSCQueue;
+typedef struct SPSCQueue SPSCQueue;
+
+/* Creates a new queue that can hold at least capacity values. Returns NULL on failure */
+ROMANO_API SPSCQueue* spscqueue_new(uint32_t capacity);
+
+/* Returns the number of values the queue can hold */
+ROMANO_API uint32_t spscqueue_capacity(SPSCQueue* queue);
+
+/* Returns the approximate number of values in the queue */
+ROMANO_API uint32_t spscqueue_size_approx(SPSCQueue* queue);
+
+/* Pushes a value, returns false if the queue is full */
+ROMANO_API bool spscqueue_try_push(SPSCQueue* queue, void* value);
+
+/* Pushes as many values as possible, returns the number of values pushed */
+ROMANO_API uint32_t spscqueue_try_push_batch(SPSCQueue* queue, void** values, uint32_t count);
+
+/* Pops a value, returns false if the queue is empty */
+ROMANO_API bool spscqueue_try_pop(SPSCQueue* queue, void** value);
+
+/* Pops up to max_count values, returns the number of values popped */
+ROMANO_API uint32_t spscqueue_try_pop_batch(SPSCQueue* queue, void** values, uint32_t max_count);
+
+/* Pushes a value, waiting while the queue is full */
+ROMANO_API void spscqueue_push(SPSCQueue* queue, void* value);
+
+/* Pops a value, waiting while the queue is empty */
+ROMANO_API void* spscqueue_pop(SPSCQueue* queue);
+
+ROMANO_API void spscqueue_free(SPSCQueue* queue);
+
+/* Multiple producers, multiple consumers (Dmitry Vyukov's bounded queue) */
+
+struct MPMCQueue;
+typedef struct MPMCQueue MPMCQueue;
+
+/* Creates a new queue that can hold at least capacity values (at least 2). Returns NULL on failure */
+ROMANO_API MPMCQueue* mpmcqueue_new(uint32_t capacity);
+
+/* Returns the number of values the queue can hold */
+ROMANO_API uint32_t mpmcqueue_capacity(MPMCQueue* queue);
+
+/* Returns the approximate number of values in the queue */
+ROMANO_API uint32_t mpmcqueue_size_approx(MPMCQueue* queue);
+
+/* Pushes a value, returns false if the queue is full */
+ROMANO_API bool mpmcqueue_try_push(MPMCQueue* queue, void* value);
+
+/* Pushes as many values as possible in contiguous slots, returns the number of values pushed */
+ROMANO_API uint32_t mpmcqueue_try_push_batch(MPMCQueue* queue, void** values, uint32_t count);
+
+/* Pops a value, returns false if the queue is empty */
+ROMANO_API bool mpmcqueue_try_pop(MPMCQueue* queue, void** value);
+
+/* Pops up to max_count values in contiguous slots, returns the number of values popped */
+ROMANO_API uint32_t mpmcqueue_try_pop_batch(MPMCQueue* queue, void** values, uint32_t max_count);
+
+/* Pushes a value, waiting while the queue is full */
+ROMANO_API void mpmcqueue_push(MPMCQueue* queue, void* value);
+
+/* Pops a value, waiting while the queue is empty */
+ROMANO_API void* mpmcqueue_pop(MPMCQueue* queue);
+
+ROMANO_API void mpmcqueue_free(MPMCQueue* queue);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_RING_QUEUE) */
@@ -76,7 +76,7 @@ ROMANO_API bool strview_endswith(const StringView s, const char* substr, const i
 ROMANO_API StringView strview_trim(const char* data);
 
 /*
- * Parses an integer from a StringView.
+ * Parses an integer from a StringView, skipping leading whitespace.
  * Returns the parsed integer value, or 0 if invalid or overflows.
  */
 ROMANO_API int strview_parse_int(const StringView s);
@@ -89,7 +89,7 @@ ROMANO_API int strview_parse_int(const StringView s);
 ROMANO_API bool strview_parse_bool(const StringView s);
 
 /*
- * Parses a double from a StringView.
+ * Parses a double from a StringView, skipping leading whitespace.
  * Returns the parsed double value, or 0.0 if invalid.
  */
 ROMANO_API double strview_parse_double(const StringView s);
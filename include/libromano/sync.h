@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_SYNC)
+#define __LIBROMANO_SYNC
+
+#include "libromano/common.h"
+#include "libromano/atomic.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Lightweight synchronization primitives, complementing the Mutex and ConditionalVariable
+ * of thread.h. All of them are plain structs meant to be embedded and initialized with x_init,
+ * they do not hold any system resource and do not need to be released.
+ * None of the locks are recursive.
+ */
+
+#define SYNC_WAIT_INFINITE UINT64_MAX
+
+/*
+ * Blocks the calling thread while *address == expected, or until the timeout (in nanoseconds)
+ * expires. Uses futex on Linux, WaitOnAddress on Windows and ulock on macOS.
+ * Can return spuriously, returns false only if the timeout expired
+ */
+ROMANO_API bool address_wait(Atomic32* address, Atomic32 expected, uint64_t timeout_ns);
+
+/* Wakes one thread blocked in address_wait on the given address */
+ROMANO_API void address_wake_one(Atomic32* address);
+
+/* Wakes all the threads blocked in address_wait on the given address */
+ROMANO_API void address_wake_all(Atomic32* address);
+
+/* Test and test-and-set spinlock, with exponential backoff */
+
+typedef struct SpinLock {
+    Atomic32 locked;
+} SpinLock;
+
+ROMANO_API void spinlock_init(SpinLock* lock);
+
+ROMANO_API bool spinlock_try_lock(SpinLock* lock);
+
+ROMANO_API void spinlock_lock(SpinLock* lock);
+
+ROMANO_API void spinlock_unlock(SpinLock* lock);
+
+/* Ticket spinlock, the lock is granted in FIFO order. Degrades when threads outnumber cores */
+
+typedef struct TicketLock {
+    Atomic32 next;
+    Atomic32 serving;
+} TicketLock;
+
+ROMANO_API void ticketlock_init(TicketLock* lock);
+
+ROMANO_API bool ticketlock_try_lock(TicketLock* lock);
+
+ROMANO_API void ticketlock_lock(TicketLock* lock);
+
+ROMANO_API void ticketlock_unlock(TicketLock* lock);
+
+/*
+ * Mutex that never enters the kernel when uncontended. When contended, it spins for an adaptive
+ * amount of iterations (learnt from the previous acquisitions) before blocking on the address
+ */
+
+typedef struct FastMutex {
+    /* 0: unlocked, 1: locked, 2: locked with possible waiters */
+    Atomic32 state;
+    Atomic32 spins;
+} FastMutex;
+
+ROMANO_API void fastmutex_init(FastMutex* mutex);
+
+ROMANO_API bool fastmutex_try_lock(FastMutex* mutex);
+
+ROMANO_API void fastmutex_lock(FastMutex* mutex);
+
+ROMANO_API void fastmutex_unlock(FastMutex* mutex);
+
+/*
+ * Readers-writer lock. Writers are preferred: once a writer waits, new readers block until
+ * it has acquired and released the lock
+ */
+
+typedef struct RWLock {
+    /* Readers count, RWLOCK_WRITER bit when owned by a writer */
+    Atomic32 state;
+    Atomic32 writers_waiting;
+    Atomic32 sleepers;
+    /* Bumped on every unlock that can unblock sleepers, which wait on it */
+    Atomic32 wake_seq;
+} RWLock;
+
+ROMANO_API void rwlock_init(RWLock* lock);
+
+ROMANO_API bool rwlock_try_read_lock(RWLock* lock);
+
+ROMANO_API void rwlock_read_lock(RWLock* lock);
+
+ROMANO_API void rwlock_read_unlock(RWLock* lock);
+
+ROMANO_API bool rwlock_try_write_lock(RWLock* lock);
+
+ROMANO_API void rwlock_write_lock(RWLock* lock);
+
+ROMANO_API void rwlock_write_unlock(RWLock* lock);
+
+/*
+ * Sequence lock for read-mostly data. Readers never write shared memory, they retry when a
+ * writer ran concurrently:
+ *
+ * do {
+ *     seq = seqlock_read_begin(&lock);
+ *     copy = data;
+ * } while(seqlock_read_retry(&lock, seq));
+ *
+ * The data must be read with relaxed atomics (or copied and validated before use), as readers
+ * may observe a partially written value before retrying
+ */
+
+typedef struct SeqLock {
+    Atomic32 sequence;
+} SeqLock;
+
+ROMANO_API void seqlock_init(SeqLock* lock);
+
+/* Writers are serialized between themselves */
+ROMANO_API void seqlock_write_begin(SeqLock* lock);
+
+ROMANO_API void seqlock_write_end(SeqLock* lock);
+
+ROMANO_API uint32_t seqlock_read_begin(SeqLock* lock);
+
+/* Returns true if the data read since seqlock_read_begin may be inconsistent */
+ROMANO_API bool seqlock_read_retry(SeqLock* lock, uint32_t sequence);
+
+/* Events */
+
+typedef enum EventMode {
+    /* Once set, the event releases all the current and future waiters until it is reset */
+    EventMode_OneShot,
+    /* Setting the event releases a single waiter, and the event is reset when it wakes */
+    EventMode_AutoReset,
+} EventMode;
+
+typedef struct Event {
+    Atomic32 signaled;
+    Atomic32 sleepers;
+    EventMode mode;
+} Event;
+
+ROMANO_API void event_init(Event* event, EventMode mode);
+
+ROMANO_API void event_set(Event* event);
+
+ROMANO_API void event_reset(Event* event);
+
+/* Returns true if the event was set (and consumes it in auto-reset mode), never blocks */
+ROMANO_API bool event_try_wait(Event* event);
+
+ROMANO_API void event_wait(Event* event);
+
+/* Returns false if the timeout (in nanoseconds) expired before the event was set */
+ROMANO_API bool event_wait_for(Event* event, uint64_t timeout_ns);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_SYNC) */
@@ -94,6 +94,12 @@ ROMANO_API void thread_detach(Thread* thread);
 /* Waits until the given thread has finished and destroy it */
 ROMANO_API void thread_join(Thread* thread);
 
+/*
+ * Pins the calling thread to the given logical processor (as reported by cpu_topology_init).
+ * Returns false if the affinity could not be set (always on macOS which has no affinity API)
+ */
+ROMANO_API bool thread_set_current_affinity(uint32_t processor);
+
 /* Macros for tsan when using cq acquire/release */
 #if defined(__SANITIZE_THREAD__)
 #define ROMANO_TP_TSAN 1
@@ -125,6 +131,25 @@ ROMANO_API ThreadPoolWaiter threadpool_waiter_new(void);
 /* Creates a threadpool with x workers and waits for work */
 ROMANO_API ThreadPool* threadpool_init(uint32_t workers_count);
 
+typedef enum ThreadPoolPlacement {
+    /* Workers are not pinned and left to the OS scheduler */
+    ThreadPoolPlacement_None,
+
+    /* One worker pinned per logical processor, physical cores are filled before SMT siblings */
+    ThreadPoolPlacement_PerLogicalCore,
+
+    /* One worker pinned per physical core, SMT siblings are skipped */
+    ThreadPoolPlacement_PerPhysicalCore,
+} ThreadPoolPlacement;
+
+/*
+ * Creates a threadpool whose workers are pinned following the given placement policy.
+ * If workers_count is 0, it is set to the number of processors the placement uses.
+ * Idle workers steal from workers on the same numa node first
+ */
+ROMANO_API ThreadPool* threadpool_init_with_placement(uint32_t workers_count,
+                                                      ThreadPoolPlacement placement);
+
 /*
  * Adds some work to the threadpool.
  * If no waiter is needed, pass NULL as the ThreadPool waiter
@@ -134,6 +159,41 @@ ROMANO_API bool threadpool_work_add(ThreadPool* threadpool,
                                     void* arg,
                                     ThreadPoolWaiter* waiter);
 
+typedef enum ThreadPoolPriority {
+    /* Latency sensitive work */
+    ThreadPoolPriority_High,
+
+    /* Default priority of threadpool_work_add */
+    ThreadPoolPriority_Normal,
+
+    /* Bulk work (compaction, file scanning...) */
+    ThreadPoolPriority_Background,
+
+    ThreadPoolPriority_Count,
+} ThreadPoolPriority;
+
+/*
+ * Adds some work to the given priority lane. Workers drain the high priority lane first, but
+ * regularly look into the normal and background lanes first so they cannot starve
+ */
+ROMANO_API bool threadpool_work_add_with_priority(ThreadPool* threadpool,
+                                                  ThreadFunc func,
+                                                  void* arg,
+                                                  ThreadPoolWaiter* waiter,
+                                                  ThreadPoolPriority priority);
+
+#define THREADPOOL_NO_DEADLINE UINT64_MAX
+
+/*
+ * Adds some work with a deadline (a time_get_monotonic_ns timestamp). Works with a deadline are
+ * executed before the high priority lane, in earliest deadline first order
+ */
+ROMANO_API bool threadpool_work_add_with_deadline(ThreadPool* threadpool,
+                                                  ThreadFunc func,
+                                                  void* arg,
+                                                  ThreadPoolWaiter* waiter,
+                                                  uint64_t deadline_ns);
+
 /* Wait for all the work to be done */
 ROMANO_API void threadpool_wait(ThreadPool* threadpool);
 
@@ -142,6 +202,145 @@ ROMANO_API void threadpool_waiter_wait(ThreadPoolWaiter* waiter);
 /* Release all the workers and the threadpool */
 ROMANO_API void threadpool_release(ThreadPool* threadpool);
 
+/* Telemetry, counters are accumulated since the creation of the threadpool */
+typedef struct ThreadPoolWorkerStats {
+    /* Tasks executed by the worker, including the stolen ones */
+    uint64_t tasks_executed;
+
+    /* Tasks taken from other workers queues */
+    uint64_t tasks_stolen;
+
+    /* Steal attempts (a pass over all the other workers) that did not find any task */
+    uint64_t failed_steals;
+
+    /* Time spent executing tasks and looking for tasks, in nanoseconds */
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+
+    /* Approximate number of tasks in the worker queue when the snapshot was taken */
+    uint64_t queue_depth;
+
+    /* Maximum approximate number of tasks seen in the worker queue after an enqueue */
+    uint64_t max_queue_depth;
+} ThreadPoolWorkerStats;
+
+/* Returns the number of workers of the threadpool */
+ROMANO_API uint32_t threadpool_get_workers_count(ThreadPool* threadpool);
+
+/*
+ * Takes a snapshot of the workers counters, stats must be able to hold stats_count entries.
+ * Returns the number of entries written (at most the number of workers)
+ */
+ROMANO_API uint32_t threadpool_get_stats(ThreadPool* threadpool,
+                                         ThreadPoolWorkerStats* stats,
+                                         uint32_t stats_count);
+
+/* Logs the workers counters with the logger at the info level */
+ROMANO_API void threadpool_log_stats(ThreadPool* threadpool);
+
+/*
+ * Starts a thread logging the workers counters every interval_ms milliseconds.
+ * Passing 0 stops the periodic logging. Returns false if the thread could not be created
+ */
+ROMANO_API bool threadpool_set_stats_log_interval(ThreadPool* threadpool, uint32_t interval_ms);
+
+/*
+ * Task graphs let tasks declare predecessors: a task is scheduled on the threadpool as soon as
+ * all of its predecessors have been executed, without any barrier between stages.
+ * A graph can be submitted again once a previous submission has completed.
+ */
+
+struct TaskGraph;
+typedef struct TaskGraph TaskGraph;
+
+#define TASKGRAPH_INVALID_TASK UINT32_MAX
+
+/* Creates a new empty task graph. Returns NULL on failure */
+ROMANO_API TaskGraph* taskgraph_new(void);
+
+/*
+ * Adds a task to the graph and returns its id.
+ * Returns TASKGRAPH_INVALID_TASK on failure, or if the graph is currently executing
+ */
+ROMANO_API uint32_t taskgraph_add_task(TaskGraph* graph, ThreadFunc func, void* arg);
+
+/*
+ * Declares that task will only be scheduled after predecessor has been executed.
+ * Returns false if one of the ids is invalid, or if the graph is currently executing
+ */
+ROMANO_API bool taskgraph_add_dependency(TaskGraph* graph, uint32_t task, uint32_t predecessor);
+
+/* Returns the number of tasks in the graph */
+ROMANO_API uint32_t taskgraph_get_tasks_count(TaskGraph* graph);
+
+/* Returns true if a submission of the graph is still executing */
+ROMANO_API bool taskgraph_is_running(TaskGraph* graph);
+
+/*
+ * Schedules all the tasks of the graph on the threadpool. Tasks without predecessors are scheduled
+ * immediately, the others when their last predecessor has been executed.
+ * The waiter (can be NULL) will reach zero once all the tasks of the graph have been executed.
+ * Returns false if the graph contains a cycle, or if a previous submission is still executing
+ */
+ROMANO_API bool threadpool_graph_submit(ThreadPool* threadpool,
+                                        TaskGraph* graph,
+                                        ThreadPoolWaiter* waiter);
+
+/* Releases and frees the task graph. The graph must not be executing */
+ROMANO_API void taskgraph_free(TaskGraph* graph);
+
+/*
+ * Futures hold the value returned by the ThreadFunc of a work. They are allocated from a pool
+ * owned by the threadpool, and must all be released before releasing the threadpool.
+ */
+
+struct Future;
+typedef struct Future Future;
+
+typedef enum FutureState {
+    FutureState_Pending,
+    FutureState_Running,
+    FutureState_Done,
+    FutureState_Cancelled,
+} FutureState;
+
+/*
+ * Adds some work to the threadpool and returns a future that will hold the value returned by func.
+ * Returns NULL on failure
+ */
+ROMANO_API Future* threadpool_work_add_future(ThreadPool* threadpool, ThreadFunc func, void* arg);
+
+/* Returns the current state of the future */
+ROMANO_API FutureState future_get_state(Future* future);
+
+/*
+ * Waits for the future to be done and returns its value (NULL if it has been cancelled).
+ * While waiting, the calling thread executes pending work of the threadpool
+ */
+ROMANO_API void* future_get(Future* future);
+
+/*
+ * Cancels the future if its work has not started yet. Continuations of a cancelled future are
+ * cancelled too. Returns true if the future has been cancelled
+ */
+ROMANO_API bool future_cancel(Future* future);
+
+/*
+ * Returns a future whose work, func, is added to the threadpool once the given future is done,
+ * with the value of the given future as argument. Returns NULL on failure
+ */
+ROMANO_API Future* future_then(Future* future, ThreadFunc func);
+
+/*
+ * Returns a future that completes once all the given futures are done or cancelled. It is cancelled
+ * if any of the given futures has been cancelled, and done otherwise. Its value is NULL.
+ * Returns NULL on failure
+ */
+ROMANO_API Future* future_when_all(ThreadPool* threadpool, Future** futures, uint32_t futures_count);
+
+/* Releases the future, the work associated to it still executes unless cancelled */
+ROMANO_API void future_release(Future* future);
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_THREAD) */
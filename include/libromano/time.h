@@ -46,6 +46,9 @@ typedef struct timeval timeval_t;
 
 #endif /* defined(ROMANO_WIN) */
 
+/* Returns a monotonic timestamp in nanoseconds, only meaningful to compute durations */
+ROMANO_API uint64_t time_get_monotonic_ns(void);
+
 ROMANO_CPP_END
 
 #endif /* !defined(__LIBROMANO_TIME) */
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_TIMER_WHEEL)
+#define __LIBROMANO_TIMER_WHEEL
+
+#include "libromano/common.h"
+#include "libromano/thread.h"
+
+ROMANO_CPP_ENTER
+
+/*
+ * Hashed hierarchical timer wheel (4 levels of 256 slots), with O(1) add and cancel.
+ * Time is measured in ticks of tick_ns nanoseconds, timers fire at the first tick at or after
+ * their expiry. Delays up to 2^32 ticks are handled in a single placement, longer ones are
+ * cascaded again when they reach the top level.
+ *
+ * The wheel can be embedded in an event loop (call timerwheel_advance with the current time, and
+ * use timerwheel_next_expiry to compute the poll timeout), or driven by its own thread with
+ * timerwheel_start, which submits the expired timers to a ThreadPool.
+ * Adding and cancelling timers is thread-safe, timerwheel_advance must be called by a single
+ * thread at a time.
+ */
+
+struct TimerWheel;
+typedef struct TimerWheel TimerWheel;
+
+/* Identifies a timer, stays valid until a one-shot timer fires or a timer is cancelled */
+typedef uint64_t TimerId;
+
+#define TIMER_INVALID_ID 0
+
+#define TIMERWHEEL_NO_EXPIRY UINT64_MAX
+
+/*
+ * Creates a new timer wheel, with the given tick duration in nanoseconds. The wheel starts at
+ * the current time_get_monotonic_ns time. Returns NULL on failure
+ */
+ROMANO_API TimerWheel* timerwheel_new(uint64_t tick_ns);
+
+/*
+ * Adds a timer calling func(arg) after delay_ns nanoseconds (at least one tick), and then every
+ * period_ns nanoseconds if period_ns is not 0. The return value of func is ignored.
+ * Returns TIMER_INVALID_ID on failure
+ */
+ROMANO_API TimerId timerwheel_add(TimerWheel* wheel,
+                                  uint64_t delay_ns,
+                                  uint64_t period_ns,
+                                  ThreadFunc func,
+                                  void* arg);
+
+/*
+ * Cancels a timer. Returns false if the timer already fired (one-shot) or has already been
+ * cancelled. A timer whose callback is being executed can still be cancelled, but the running
+ * callback is not interrupted
+ */
+ROMANO_API bool timerwheel_cancel(TimerWheel* wheel, TimerId timer);
+
+/* Returns the number of pending timers */
+ROMANO_API size_t timerwheel_get_timers_count(TimerWheel* wheel);
+
+/*
+ * Advances the wheel up to now_ns (a time_get_monotonic_ns timestamp) and fires the expired
+ * timers from the calling thread. Returns the number of timers fired
+ */
+ROMANO_API size_t timerwheel_advance(TimerWheel* wheel, uint64_t now_ns);
+
+/*
+ * Returns the earliest time (a time_get_monotonic_ns timestamp) at which timerwheel_advance may
+ * have something to do, or TIMERWHEEL_NO_EXPIRY if the wheel is empty. Timers in the upper
+ * levels are reported at the time they are cascaded, so it may be earlier than their expiry
+ */
+ROMANO_API uint64_t timerwheel_next_expiry(TimerWheel* wheel);
+
+/*
+ * Starts a thread driving the wheel. Expired timers are submitted to the given threadpool,
+ * or executed on the wheel thread if threadpool is NULL.
+ * Returns false if the thread could not be started or is already running
+ */
+ROMANO_API bool timerwheel_start(TimerWheel* wheel, ThreadPool* threadpool);
+
+/* Stops the thread started with timerwheel_start, pending timers are kept */
+ROMANO_API void timerwheel_stop(TimerWheel* wheel);
+
+/* Stops the wheel thread if needed, and frees the wheel and all its pending timers */
+ROMANO_API void timerwheel_free(TimerWheel* wheel);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_TIMER_WHEEL) */
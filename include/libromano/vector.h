@@ -40,6 +40,11 @@ ROMANO_FORCE_INLINE size_t vector_capacity(Vector* vector) { ROMANO_ASSERT(vecto
  */
 ROMANO_FORCE_INLINE size_t vector_element_size(Vector* vector) { ROMANO_ASSERT(vector != NULL, "Vector is NULL"); return ((size_t*)vector->data)[2]; }
 
+/*
+ * Removes all the elements of the given vector, keeping its capacity
+ */
+ROMANO_FORCE_INLINE void vector_clear(Vector* vector) { ROMANO_ASSERT(vector != NULL, "Vector is NULL"); ((size_t*)vector->data)[0] = 0; }
+
 /*
  * Resizes the given vector to the given capacity
  */
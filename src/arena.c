@@ -66,17 +66,41 @@ ROMANO_FORCE_INLINE bool arena_check_resize(Arena* arena,
     return (arena->current_block->offset + new_size) >= arena->current_block->capacity;
 }
 
-bool arena_resize(Arena* arena)
+/*
+ * Moves to the next block able to hold min_size bytes. Blocks kept by arena_clear are reused when
+ * they are large enough, otherwise a new block (larger than block_size for large pushes) is inserted
+ * after the current one
+ */
+bool arena_resize(Arena* arena, const size_t min_size)
 {
-    ArenaBlock* new_block = arena_block_init(arena->block_size);
+    ArenaBlock* current_block = arena->current_block;
+    ArenaBlock* next_block = current_block->next;
+    size_t block_size;
+
+    if(next_block != NULL && next_block->capacity > min_size)
+    {
+        next_block->offset = 0;
+        arena->current_block = next_block;
+        return true;
+    }
+
+    block_size = min_size >= arena->block_size ? min_size + 1 : arena->block_size;
+
+    ArenaBlock* new_block = arena_block_init(block_size);
 
     if(new_block == NULL)
         return false;
 
-    new_block->previous = arena->current_block;
+    new_block->previous = current_block;
+    new_block->next = next_block;
+
+    if(next_block != NULL)
+        next_block->previous = new_block;
+
+    current_block->next = new_block;
 
     arena->current_block = new_block;
-    arena->capacity += arena->block_size;
+    arena->capacity += block_size;
 
     return true;
 }
@@ -84,7 +108,7 @@ bool arena_resize(Arena* arena)
 void* arena_push(Arena* arena, void* data, const size_t data_size)
 {
     if(arena_check_resize(arena, data_size))
-        if(!arena_resize(arena))
+        if(!arena_resize(arena, data_size))
             return NULL;
 
     void* data_address = (void*)((char*)arena->current_block->address + arena->current_block->offset);
@@ -5,6 +5,7 @@
 #include "libromano/cli.h"
 #define __ROMANO_DEFINE_ERROR_EXTERNS
 #include "libromano/error.h"
+#include "libromano/parse.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -297,6 +298,27 @@ bool cli_parser_validate_argument_type(CLIArgType type, char* arg_str)
     }
 }
 
+/* The whole argument must be a number */
+bool cli_parser_parse_int(char* arg_str, int64_t* i64)
+{
+    size_t arg_sz;
+    size_t parsed_sz;
+
+    arg_sz = strlen(arg_str);
+
+    return parse_i64(arg_str, arg_sz, i64, &parsed_sz) && parsed_sz == arg_sz;
+}
+
+bool cli_parser_parse_float(char* arg_str, double* f64)
+{
+    size_t arg_sz;
+    size_t parsed_sz;
+
+    arg_sz = strlen(arg_str);
+
+    return parse_f64(arg_str, arg_sz, f64, &parsed_sz) && parsed_sz == arg_sz;
+}
+
 bool cli_parser_parse_bool(char* arg_str)
 {
     if(strcmp(arg_str, "true") == 0 || strcmp(arg_str, "True") == 0)
@@ -477,13 +499,23 @@ bool cli_parser_parse_named_argument(CLIParser* parser, char* arg_str, int* next
         }
         case CLIArgType_Int:
         {
-            arg->data.i64 = strtoll(value_str, NULL, 10);
+            if(!cli_parser_parse_int(value_str, &arg->data.i64))
+            {
+                g_current_error = ErrorCode_CLIInvalidArgumentType;
+                return false;
+            }
+
             arg->data_sz = sizeof(int64_t);
             break;
         }
         case CLIArgType_Float:
         {
-            arg->data.f64 = strtod(value_str, NULL);
+            if(!cli_parser_parse_float(value_str, &arg->data.f64))
+            {
+                g_current_error = ErrorCode_CLIInvalidArgumentType;
+                return false;
+            }
+
             arg->data_sz = sizeof(double);
             break;
         }
@@ -563,13 +595,23 @@ bool cli_parser_parse_positional_argument(CLIParser* parser, char* arg_str, size
         }
         case CLIArgType_Int:
         {
-            arg->data.i64 = strtoll(arg_str, NULL, 10);
+            if(!cli_parser_parse_int(arg_str, &arg->data.i64))
+            {
+                g_current_error = ErrorCode_CLIInvalidArgumentType;
+                return false;
+            }
+
             arg->data_sz = sizeof(int64_t);
             break;
         }
         case CLIArgType_Float:
         {
-            arg->data.f64 = strtod(arg_str, NULL);
+            if(!cli_parser_parse_float(arg_str, &arg->data.f64))
+            {
+                g_current_error = ErrorCode_CLIInvalidArgumentType;
+                return false;
+            }
+
             arg->data_sz = sizeof(double);
             break;
         }
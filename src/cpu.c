@@ -4,8 +4,34 @@
 
 #include "libromano/cpu.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(ROMANO_WIN)
+#include <windows.h>
+#if defined(ROMANO_X86_64)
+#include <powerbase.h>
+#endif /* defined(ROMANO_X86_64) */
+#elif defined(ROMANO_LINUX)
+#include <unistd.h>
+#include <sched.h>
+#if defined(ROMANO_X86_64)
+#include <x86intrin.h>
+#else
+#include <sys/sysctl.h>
+#endif /* defined(ROMANO_X86_64) */
+#elif defined(ROMANO_APPLE)
+#include <sys/sysctl.h>
+#endif /* defined(ROMANO_WIN) */
+
+#if defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
+#if !defined(__USE_POSIX199309)
+#define __USE_POSIX199309
+#endif /* !defined(__USE_POSIX199309) */
+#include <time.h>
+#endif /* defined(ROMANO_LINUX) || defined(ROMANO_APPLE) */
+
 static uint64_t g_get_frequency_counter = 0;
 static uint32_t g_frequency = 0;
 static uint32_t g_refresh = 10000;
@@ -13,9 +39,6 @@ static uint32_t g_cpu_freq_mhz = 0;
 
 #if defined(ROMANO_X86_64)
 #if defined(ROMANO_WIN)
-#include <windows.h>
-#include <powerbase.h>
-
 typedef struct _PROCESSOR_POWER_INFORMATION
 {
    ULONG Number;
@@ -26,13 +49,6 @@ typedef struct _PROCESSOR_POWER_INFORMATION
    ULONG CurrentIdleState;
 } PROCESSOR_POWER_INFORMATION, *PPROCESSOR_POWER_INFORMATION;
 
-#elif defined(ROMANO_LINUX)
-#include <x86intrin.h>
-
-#if !defined(__USE_POSIX199309)
-#define __USE_POSIX199309
-#endif /* !defined(__USE_POSIX199309) */
-#include <time.h>
 #endif /* defined(ROMANO_WIN) */
 
 uint32_t _get_cpu_frequency(void)
@@ -159,14 +175,6 @@ uint64_t cpu_rdtsc(void)
 
 #elif defined(ROMANO_AARCH64)
 
-#if defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
-#include <sys/sysctl.h>
-#if !defined(__USE_POSIX199309)
-#define __USE_POSIX199309
-#endif /* !defined(__USE_POSIX199309) */
-#include <time.h>
-#endif /* defined(ROMANO_LINUX) || defined(ROMANO_APPLE) */
-
 uint32_t _get_cpu_frequency(void)
 {
     if(g_get_frequency_counter % g_refresh == 0)
@@ -236,3 +244,614 @@ uint64_t cpu_rdtsc(void)
 }
 
 #endif /* defined(ROMANO_X86_64) */
+
+/* Topology */
+
+bool cpu_topology_alloc(CPUTopology* topology, uint32_t processors_count)
+{
+    topology->processors = (CPULogicalProcessor*)calloc(processors_count,
+                                                        sizeof(CPULogicalProcessor));
+
+    if(topology->processors == NULL)
+        return false;
+
+    topology->processors_count = processors_count;
+
+    return true;
+}
+
+/* Used when the topology cannot be queried: one core per logical processor */
+void cpu_topology_flat(CPUTopology* topology)
+{
+    uint32_t i;
+
+    for(i = 0; i < topology->processors_count; i++)
+    {
+        topology->processors[i].id = i;
+        topology->processors[i].core_id = i;
+        topology->processors[i].smt_index = 0;
+        topology->processors[i].package_id = 0;
+        topology->processors[i].numa_node = 0;
+        topology->processors[i].l2_id = CPU_TOPOLOGY_UNKNOWN;
+        topology->processors[i].l3_id = CPU_TOPOLOGY_UNKNOWN;
+    }
+
+    topology->cores_count = topology->processors_count;
+    topology->packages_count = 1;
+    topology->numa_nodes_count = 1;
+}
+
+/* Computes the dense core ids, smt indices and the packages/numa nodes counts */
+void cpu_topology_finalize(CPUTopology* topology, const uint32_t* raw_core_ids)
+{
+    uint32_t i;
+    uint32_t j;
+
+    topology->cores_count = 0;
+    topology->packages_count = 0;
+    topology->numa_nodes_count = 0;
+
+    for(i = 0; i < topology->processors_count; i++)
+    {
+        CPULogicalProcessor* processor = &topology->processors[i];
+        bool new_package = true;
+        bool new_node = true;
+
+        processor->core_id = CPU_TOPOLOGY_UNKNOWN;
+        processor->smt_index = 0;
+
+        for(j = 0; j < i; j++)
+        {
+            CPULogicalProcessor* other = &topology->processors[j];
+
+            if(other->package_id == processor->package_id)
+            {
+                new_package = false;
+
+                if(raw_core_ids[j] == raw_core_ids[i])
+                {
+                    processor->core_id = other->core_id;
+                    processor->smt_index++;
+                }
+            }
+
+            if(other->numa_node == processor->numa_node)
+                new_node = false;
+        }
+
+        if(processor->core_id == CPU_TOPOLOGY_UNKNOWN)
+            processor->core_id = topology->cores_count++;
+
+        topology->packages_count += (uint32_t)new_package;
+        topology->numa_nodes_count += (uint32_t)new_node;
+    }
+}
+
+#if defined(ROMANO_LINUX)
+
+#define CPU_SYSFS_PATH "/sys/devices/system"
+
+bool cpu_sysfs_read(const char* path, char* buffer, size_t buffer_sz)
+{
+    FILE* file;
+    size_t read_sz;
+
+    file = fopen(path, "r");
+
+    if(file == NULL)
+        return false;
+
+    read_sz = fread(buffer, sizeof(char), buffer_sz - 1, file);
+
+    fclose(file);
+
+    buffer[read_sz] = '\0';
+
+    return read_sz > 0;
+}
+
+uint32_t cpu_sysfs_read_u32(const char* path, uint32_t default_value)
+{
+    char buffer[32];
+
+    if(!cpu_sysfs_read(path, buffer, sizeof(buffer)))
+        return default_value;
+
+    return (uint32_t)strtoul(buffer, NULL, 10);
+}
+
+/* Iterates over a cpu list ("0-3,8,10-11"), stops and returns false if func returns false */
+typedef bool (*cpu_list_func)(uint32_t cpu, void* data);
+
+bool cpu_list_iterate(const char* list, cpu_list_func func, void* data)
+{
+    char* end;
+
+    while(*list != '\0')
+    {
+        uint32_t first;
+        uint32_t last;
+        uint32_t cpu;
+
+        while(*list == ',' || *list == ' ' || *list == '\n')
+            list++;
+
+        if(*list < '0' || *list > '9')
+            break;
+
+        first = (uint32_t)strtoul(list, &end, 10);
+        last = first;
+        list = end;
+
+        if(*list == '-')
+        {
+            last = (uint32_t)strtoul(list + 1, &end, 10);
+            list = end;
+        }
+
+        for(cpu = first; cpu <= last; cpu++)
+            if(!func(cpu, data))
+                return false;
+    }
+
+    return true;
+}
+
+/* Processors the process is allowed to run on, NULL if the mask cannot be read (all are allowed) */
+const cpu_set_t* cpu_affinity_get(cpu_set_t* mask)
+{
+    CPU_ZERO(mask);
+
+    if(sched_getaffinity(0, sizeof(cpu_set_t), mask) != 0)
+        return NULL;
+
+    return mask;
+}
+
+bool cpu_affinity_allows(const cpu_set_t* mask, uint32_t cpu)
+{
+    return mask == NULL || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, mask));
+}
+
+typedef struct CPUListFillData {
+    CPUTopology* topology;
+    const cpu_set_t* mask;
+    uint32_t index;
+} CPUListFillData;
+
+bool cpu_list_count_func(uint32_t cpu, void* data)
+{
+    CPUListFillData* fill = (CPUListFillData*)data;
+
+    if(cpu_affinity_allows(fill->mask, cpu))
+        fill->index++;
+
+    return true;
+}
+
+bool cpu_list_fill_func(uint32_t cpu, void* data)
+{
+    CPUListFillData* fill = (CPUListFillData*)data;
+
+    if(!cpu_affinity_allows(fill->mask, cpu))
+        return true;
+
+    if(fill->index >= fill->topology->processors_count)
+        return false;
+
+    fill->topology->processors[fill->index++].id = cpu;
+
+    return true;
+}
+
+typedef struct CPUListNodeData {
+    CPUTopology* topology;
+    uint32_t node;
+} CPUListNodeData;
+
+bool cpu_list_node_func(uint32_t cpu, void* data)
+{
+    CPUListNodeData* node_data = (CPUListNodeData*)data;
+    uint32_t i;
+
+    for(i = 0; i < node_data->topology->processors_count; i++)
+    {
+        if(node_data->topology->processors[i].id == cpu)
+        {
+            node_data->topology->processors[i].numa_node = node_data->node;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/* Reads the cpu list of a NUMA node and assigns the node to its processors */
+bool cpu_list_node_list_func(uint32_t node, void* data)
+{
+    CPUListNodeData node_data;
+    char path[256];
+    char list[1024];
+
+    snprintf(path, sizeof(path), CPU_SYSFS_PATH "/node/node%u/cpulist", node);
+
+    if(!cpu_sysfs_read(path, list, sizeof(list)))
+        return true;
+
+    node_data.topology = (CPUTopology*)data;
+    node_data.node = node;
+
+    cpu_list_iterate(list, cpu_list_node_func, &node_data);
+
+    return true;
+}
+
+bool cpu_list_first_func(uint32_t cpu, void* data)
+{
+    *(uint32_t*)data = cpu;
+    return false;
+}
+
+bool cpu_topology_query(CPUTopology* topology)
+{
+    char path[256];
+    char list[1024];
+    uint32_t* raw_core_ids;
+    uint32_t count;
+    uint32_t i;
+    cpu_set_t mask;
+    CPUListFillData fill;
+
+    if(!cpu_sysfs_read(CPU_SYSFS_PATH "/cpu/online", list, sizeof(list)))
+        return false;
+
+    /* Only the online processors the process can run on are part of the topology */
+    fill.topology = topology;
+    fill.mask = cpu_affinity_get(&mask);
+    fill.index = 0;
+    cpu_list_iterate(list, cpu_list_count_func, &fill);
+
+    count = fill.index;
+
+    if(count == 0 || !cpu_topology_alloc(topology, count))
+        return false;
+
+    raw_core_ids = (uint32_t*)calloc(count, sizeof(uint32_t));
+
+    if(raw_core_ids == NULL)
+    {
+        free(topology->processors);
+        topology->processors = NULL;
+        return false;
+    }
+
+    fill.index = 0;
+    cpu_list_iterate(list, cpu_list_fill_func, &fill);
+
+    for(i = 0; i < count; i++)
+    {
+        CPULogicalProcessor* processor = &topology->processors[i];
+        uint32_t cache_index;
+
+        snprintf(path, sizeof(path), CPU_SYSFS_PATH "/cpu/cpu%u/topology/physical_package_id", processor->id);
+        processor->package_id = cpu_sysfs_read_u32(path, 0);
+
+        snprintf(path, sizeof(path), CPU_SYSFS_PATH "/cpu/cpu%u/topology/core_id", processor->id);
+        raw_core_ids[i] = cpu_sysfs_read_u32(path, processor->id);
+
+        processor->numa_node = 0;
+        processor->l2_id = CPU_TOPOLOGY_UNKNOWN;
+        processor->l3_id = CPU_TOPOLOGY_UNKNOWN;
+
+        for(cache_index = 0; cache_index < 8; cache_index++)
+        {
+            uint32_t level;
+            uint32_t first = CPU_TOPOLOGY_UNKNOWN;
+
+            snprintf(path, sizeof(path), CPU_SYSFS_PATH "/cpu/cpu%u/cache/index%u/level", processor->id, cache_index);
+            level = cpu_sysfs_read_u32(path, 0);
+
+            if(level == 0)
+                break;
+
+            if(level != 2 && level != 3)
+                continue;
+
+            snprintf(path, sizeof(path), CPU_SYSFS_PATH "/cpu/cpu%u/cache/index%u/shared_cpu_list", processor->id, cache_index);
+
+            if(!cpu_sysfs_read(path, list, sizeof(list)))
+                continue;
+
+            cpu_list_iterate(list, cpu_list_first_func, &first);
+
+            if(level == 2)
+                processor->l2_id = first;
+            else
+                processor->l3_id = first;
+        }
+    }
+
+    /* NUMA nodes, if the kernel has been built without NUMA support everything stays on node 0 */
+    if(cpu_sysfs_read(CPU_SYSFS_PATH "/node/online", list, sizeof(list)))
+        cpu_list_iterate(list, cpu_list_node_list_func, topology);
+
+    cpu_topology_finalize(topology, raw_core_ids);
+
+    free(raw_core_ids);
+
+    return true;
+}
+
+uint32_t cpu_topology_get_processors_count(void)
+{
+    cpu_set_t mask;
+
+    if(cpu_affinity_get(&mask) != NULL)
+        return (uint32_t)CPU_COUNT(&mask);
+
+    return (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+#elif defined(ROMANO_WIN)
+
+/* Only the first processor group (64 logical processors) is supported */
+bool cpu_topology_query(CPUTopology* topology)
+{
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info;
+    CPULogicalProcessor processors[64];
+    uint32_t raw_core_ids[64];
+    uint32_t compact_core_ids[64];
+    bool present[64];
+    DWORD length;
+    char* buffer;
+    char* ptr;
+    uint32_t core;
+    uint32_t package;
+    uint32_t count;
+    uint32_t i;
+
+    length = 0;
+
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &length);
+
+    if(length == 0)
+        return false;
+
+    buffer = (char*)malloc(length);
+
+    if(buffer == NULL)
+        return false;
+
+    if(!GetLogicalProcessorInformationEx(RelationAll,
+                                         (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)buffer,
+                                         &length))
+    {
+        free(buffer);
+        return false;
+    }
+
+    memset(present, 0, sizeof(present));
+    memset(processors, 0, sizeof(processors));
+
+    for(i = 0; i < 64; i++)
+    {
+        processors[i].id = i;
+        processors[i].l2_id = CPU_TOPOLOGY_UNKNOWN;
+        processors[i].l3_id = CPU_TOPOLOGY_UNKNOWN;
+    }
+
+    core = 0;
+    package = 0;
+
+    for(ptr = buffer; ptr < buffer + length; ptr += info->Size)
+    {
+        KAFFINITY mask = 0;
+        uint32_t smt = 0;
+
+        info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)ptr;
+
+        switch(info->Relationship)
+        {
+            case RelationProcessorCore:
+                if(info->Processor.GroupMask[0].Group == 0)
+                    mask = info->Processor.GroupMask[0].Mask;
+                break;
+            case RelationProcessorPackage:
+                if(info->Processor.GroupMask[0].Group == 0)
+                    mask = info->Processor.GroupMask[0].Mask;
+                break;
+            case RelationNumaNode:
+                if(info->NumaNode.GroupMask.Group == 0)
+                    mask = info->NumaNode.GroupMask.Mask;
+                break;
+            case RelationCache:
+                if(info->Cache.GroupMask.Group == 0)
+                    mask = info->Cache.GroupMask.Mask;
+                break;
+            default:
+                break;
+        }
+
+        for(i = 0; i < 64; i++)
+        {
+            uint32_t first_in_mask;
+
+            if((mask & ((KAFFINITY)1 << i)) == 0)
+                continue;
+
+            first_in_mask = (uint32_t)ctz_u64((uint64_t)mask);
+
+            switch(info->Relationship)
+            {
+                case RelationProcessorCore:
+                    present[i] = true;
+                    raw_core_ids[i] = core;
+                    processors[i].smt_index = smt++;
+                    break;
+                case RelationProcessorPackage:
+                    processors[i].package_id = package;
+                    break;
+                case RelationNumaNode:
+                    processors[i].numa_node = (uint32_t)info->NumaNode.NodeNumber;
+                    break;
+                case RelationCache:
+                    if(info->Cache.Level == 2)
+                        processors[i].l2_id = first_in_mask;
+                    else if(info->Cache.Level == 3)
+                        processors[i].l3_id = first_in_mask;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if(info->Relationship == RelationProcessorCore)
+            core++;
+        else if(info->Relationship == RelationProcessorPackage)
+            package++;
+    }
+
+    free(buffer);
+
+    count = 0;
+
+    for(i = 0; i < 64; i++)
+        count += (uint32_t)present[i];
+
+    if(count == 0 || !cpu_topology_alloc(topology, count))
+        return false;
+
+    count = 0;
+
+    for(i = 0; i < 64; i++)
+    {
+        if(!present[i])
+            continue;
+
+        compact_core_ids[count] = raw_core_ids[i];
+        topology->processors[count++] = processors[i];
+    }
+
+    cpu_topology_finalize(topology, compact_core_ids);
+
+    return true;
+}
+
+uint32_t cpu_topology_get_processors_count(void)
+{
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    return (uint32_t)sys_info.dwNumberOfProcessors;
+}
+
+#elif defined(ROMANO_APPLE)
+
+/* macOS does not expose which processors are SMT siblings, they are assumed to be contiguous */
+bool cpu_topology_query(CPUTopology* topology)
+{
+    int logical = 0;
+    int physical = 0;
+    size_t value_sz;
+    uint32_t threads_per_core;
+    uint32_t* raw_core_ids;
+    uint32_t i;
+
+    value_sz = sizeof(logical);
+
+    if(sysctlbyname("hw.logicalcpu", &logical, &value_sz, NULL, 0) != 0 || logical <= 0)
+        return false;
+
+    value_sz = sizeof(physical);
+
+    if(sysctlbyname("hw.physicalcpu", &physical, &value_sz, NULL, 0) != 0 || physical <= 0)
+        physical = logical;
+
+    if(!cpu_topology_alloc(topology, (uint32_t)logical))
+        return false;
+
+    raw_core_ids = (uint32_t*)calloc((size_t)logical, sizeof(uint32_t));
+
+    if(raw_core_ids == NULL)
+    {
+        free(topology->processors);
+        topology->processors = NULL;
+        return false;
+    }
+
+    threads_per_core = (uint32_t)(logical / physical);
+    threads_per_core = threads_per_core == 0 ? 1 : threads_per_core;
+
+    for(i = 0; i < (uint32_t)logical; i++)
+    {
+        topology->processors[i].id = i;
+        topology->processors[i].package_id = 0;
+        topology->processors[i].numa_node = 0;
+        topology->processors[i].l2_id = CPU_TOPOLOGY_UNKNOWN;
+        topology->processors[i].l3_id = CPU_TOPOLOGY_UNKNOWN;
+        raw_core_ids[i] = i / threads_per_core;
+    }
+
+    cpu_topology_finalize(topology, raw_core_ids);
+
+    free(raw_core_ids);
+
+    return true;
+}
+
+uint32_t cpu_topology_get_processors_count(void)
+{
+    int n_cpu = 0;
+    size_t n_cpu_sz = sizeof(n_cpu);
+
+    if(sysctlbyname("hw.ncpu", &n_cpu, &n_cpu_sz, NULL, 0) != 0)
+        return 1;
+
+    return (uint32_t)n_cpu;
+}
+
+#else
+
+bool cpu_topology_query(CPUTopology* topology)
+{
+    ROMANO_UNUSED(topology);
+    return false;
+}
+
+uint32_t cpu_topology_get_processors_count(void)
+{
+    return 1;
+}
+
+#endif /* defined(ROMANO_LINUX) */
+
+bool cpu_topology_init(CPUTopology* topology)
+{
+    uint32_t count;
+
+    ROMANO_ASSERT(topology != NULL, "topology is NULL");
+
+    memset(topology, 0, sizeof(CPUTopology));
+
+    if(cpu_topology_query(topology))
+        return true;
+
+    count = cpu_topology_get_processors_count();
+    count = count == 0 ? 1 : count;
+
+    if(!cpu_topology_alloc(topology, count))
+        return false;
+
+    cpu_topology_flat(topology);
+
+    return true;
+}
+
+void cpu_topology_release(CPUTopology* topology)
+{
+    ROMANO_ASSERT(topology != NULL, "topology is NULL");
+
+    if(topology->processors != NULL)
+        free(topology->processors);
+
+    memset(topology, 0, sizeof(CPUTopology));
+}
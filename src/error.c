@@ -54,6 +54,16 @@ const char *error_str(ErrorCode code)
             return "Json: expected a key";
         case ErrorCode_JsonExpectedColon:
             return "Json: expected colon";
+        case ErrorCode_JsonUnterminatedString:
+            return "Json: unterminated string";
+        case ErrorCode_JsonMaxDepthExceeded:
+            return "Json: maximum nesting depth exceeded";
+        case ErrorCode_JsonInvalidPath:
+            return "Json: invalid path";
+        case ErrorCode_JsonSchemaMismatch:
+            return "Json: value does not match the schema";
+        case ErrorCode_JsonMissingField:
+            return "Json: missing required field";
         case ErrorCode_RegexUnexpectedCharacter:
             return "Regex: unexpected character";
         case ErrorCode_RegexInvalidCharacterRange:
@@ -90,6 +100,10 @@ const char *error_str(ErrorCode code)
             return "CLI: missing positional args";
         case ErrorCode_CLIMissingRequiredArg:
             return "CLI: missing required arg";
+        case ErrorCode_ParseInvalidNumber:
+            return "Parse: invalid number";
+        case ErrorCode_ParseNumberOutOfRange:
+            return "Parse: number out of range";
         default:
             return "Unknown error";
     }
@@ -0,0 +1,851 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/fiber.h"
+#include "libromano/atomic.h"
+#include "libromano/vector.h"
+#include "libromano/error.h"
+
+#include <string.h>
+
+#if defined(ROMANO_WIN)
+#define ROMANO_FIBER_WIN32
+#elif (defined(ROMANO_GCC) || defined(ROMANO_CLANG)) && (defined(ROMANO_X86_64) || defined(ROMANO_AARCH64))
+#define ROMANO_FIBER_ASM
+#include <sys/mman.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#else
+#error "Fibers are not supported on this platform"
+#endif /* defined(ROMANO_WIN) */
+
+extern ErrorCode g_current_error;
+
+typedef enum FiberState {
+    FiberState_Idle,
+    FiberState_Running,
+    FiberState_Yielded,
+    FiberState_WaitingIO,
+    FiberState_Finished,
+} FiberState;
+
+typedef struct Fiber
+{
+    /* Saved stack pointer, or the Win32 fiber handle */
+    void* context;
+
+    /* Mapping of the stack, including the guard page */
+    void* stack;
+    size_t stack_size;
+
+    FiberRuntime* runtime;
+
+    ThreadFunc func;
+    void* arg;
+    ThreadPoolWaiter* waiter;
+
+    FiberState state;
+
+    Socket io_socket;
+    uint32_t io_events;
+    uint32_t io_revents;
+
+    /* Next fiber in the runtime free list */
+    struct Fiber* next;
+} Fiber;
+
+struct FiberRuntime
+{
+    ThreadPool* pool;
+
+    size_t stack_size;
+    size_t page_size;
+
+    Fiber* free_fibers;
+    int32_t free_lock;
+
+    /* Fibers waiting for a socket, registered by the workers and polled by the io thread */
+    Mutex io_mutex;
+    Vector io_pending;
+
+    Thread* io_thread;
+    int32_t io_stop;
+
+#if defined(ROMANO_FIBER_ASM)
+    /* Wakes up the io thread when a fiber is registered */
+    int io_wake_pipe[2];
+#endif /* defined(ROMANO_FIBER_ASM) */
+};
+
+/* State of the thread executing fibers (a worker of the threadpool) */
+typedef struct FiberThreadContext
+{
+    /* Context to switch back to when the current fiber suspends */
+    void* context;
+
+    Fiber* current;
+} FiberThreadContext;
+
+static ROMANO_THREAD_LOCAL FiberThreadContext g_fiber_thread_context;
+
+/*
+ * A fiber can be resumed on another thread, so the address of the thread local context must
+ * not be cached across a context switch: it is always fetched through this function
+ */
+ROMANO_NO_INLINE FiberThreadContext* fiber_thread_context(void)
+{
+#if defined(ROMANO_GCC) || defined(ROMANO_CLANG)
+    __asm__ __volatile__("" ::: "memory");
+#endif /* defined(ROMANO_GCC) || defined(ROMANO_CLANG) */
+
+    return &g_fiber_thread_context;
+}
+
+void fiber_entry(Fiber* fiber);
+
+/* Context switch */
+
+#if defined(ROMANO_FIBER_ASM)
+
+/* Saves the callee-saved registers on the current stack, stores it in from_sp and jumps to to_sp */
+void fiber_context_switch(void** from_sp, void* to_sp);
+
+/* First return address of a new fiber, calls fiber_entry with the fiber kept in a callee-saved register */
+void fiber_context_trampoline(void);
+
+#if defined(ROMANO_APPLE)
+#define FIBER_ASM_FUNCTION_BEGIN(name) ".text\n"                             \
+                                       ".globl _" #name "\n"                 \
+                                       ".private_extern _" #name "\n"        \
+                                       ".p2align 4\n"                        \
+                                       "_" #name ":\n"
+#define FIBER_ASM_FUNCTION_END(name) ""
+#else
+#if defined(ROMANO_AARCH64)
+#define FIBER_ASM_FUNCTION_TYPE "%function"
+#else
+#define FIBER_ASM_FUNCTION_TYPE "@function"
+#endif /* defined(ROMANO_AARCH64) */
+#define FIBER_ASM_FUNCTION_BEGIN(name) ".text\n"                                   \
+                                       ".globl " #name "\n"                        \
+                                       ".hidden " #name "\n"                       \
+                                       ".type " #name ", " FIBER_ASM_FUNCTION_TYPE "\n" \
+                                       ".p2align 4\n"                              \
+                                       #name ":\n"
+#define FIBER_ASM_FUNCTION_END(name) ".size " #name ", .-" #name "\n"
+#endif /* defined(ROMANO_APPLE) */
+
+#if defined(ROMANO_X86_64)
+
+/* System V: rbx, rbp, r12-r15, the x87 control word and mxcsr are callee-saved */
+__asm__(
+    FIBER_ASM_FUNCTION_BEGIN(fiber_context_switch)
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    FIBER_ASM_FUNCTION_END(fiber_context_switch)
+    FIBER_ASM_FUNCTION_BEGIN(fiber_context_trampoline)
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    FIBER_ASM_FUNCTION_END(fiber_context_trampoline)
+);
+
+#define FIBER_CONTEXT_MXCSR_FPUCW (0x1F80ULL | (0x037FULL << 32))
+
+void fiber_context_init(Fiber* fiber)
+{
+    uintptr_t top = ((uintptr_t)fiber->stack + fiber->stack_size) & ~(uintptr_t)15;
+
+    /* Return address slot, rsp is 16 bytes aligned once the trampoline has been "returned" to */
+    uint64_t* frame = (uint64_t*)(top - 8);
+
+    frame[0] = (uint64_t)(uintptr_t)fiber_context_trampoline;
+    frame[-1] = 0;                                  /* rbp */
+    frame[-2] = 0;                                  /* rbx */
+    frame[-3] = (uint64_t)(uintptr_t)fiber_entry;   /* r12 */
+    frame[-4] = (uint64_t)(uintptr_t)fiber;         /* r13 */
+    frame[-5] = 0;                                  /* r14 */
+    frame[-6] = 0;                                  /* r15 */
+    frame[-7] = FIBER_CONTEXT_MXCSR_FPUCW;
+
+    fiber->context = (void*)&frame[-7];
+}
+
+#elif defined(ROMANO_AARCH64)
+
+/* AAPCS64: x19-x29, the link register and the low halves of v8-v15 are callee-saved */
+__asm__(
+    FIBER_ASM_FUNCTION_BEGIN(fiber_context_switch)
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n"
+    FIBER_ASM_FUNCTION_END(fiber_context_switch)
+    FIBER_ASM_FUNCTION_BEGIN(fiber_context_trampoline)
+    "    mov x0, x20\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    FIBER_ASM_FUNCTION_END(fiber_context_trampoline)
+);
+
+void fiber_context_init(Fiber* fiber)
+{
+    uintptr_t top = ((uintptr_t)fiber->stack + fiber->stack_size) & ~(uintptr_t)15;
+    uint64_t* frame = (uint64_t*)(top - 160);
+
+    memset(frame, 0, 160);
+
+    frame[0] = (uint64_t)(uintptr_t)fiber_entry;                /* x19 */
+    frame[1] = (uint64_t)(uintptr_t)fiber;                      /* x20 */
+    frame[11] = (uint64_t)(uintptr_t)fiber_context_trampoline;  /* x30 */
+
+    fiber->context = (void*)frame;
+}
+
+#endif /* defined(ROMANO_X86_64) */
+
+bool fiber_stack_alloc(FiberRuntime* runtime, Fiber* fiber)
+{
+    /* The lowest page is left inaccessible so a stack overflow faults instead of corrupting memory */
+    size_t size = runtime->stack_size + runtime->page_size;
+    void* stack = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(stack == MAP_FAILED)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    if(mprotect(stack, runtime->page_size, PROT_NONE) != 0)
+    {
+        g_current_error = error_get_last_from_system();
+        munmap(stack, size);
+        return false;
+    }
+
+    fiber->stack = stack;
+    fiber->stack_size = size;
+
+    fiber_context_init(fiber);
+
+    return true;
+}
+
+void fiber_stack_free(Fiber* fiber)
+{
+    munmap(fiber->stack, fiber->stack_size);
+}
+
+/* Switches from the worker to the fiber, returns when the fiber suspends */
+ROMANO_FORCE_INLINE void fiber_switch_in(FiberThreadContext* thread_context, Fiber* fiber)
+{
+    fiber_context_switch(&thread_context->context, fiber->context);
+}
+
+/* Switches from the fiber back to the worker that resumed it */
+ROMANO_FORCE_INLINE void fiber_switch_out(Fiber* fiber)
+{
+    fiber_context_switch(&fiber->context, fiber_thread_context()->context);
+}
+
+#elif defined(ROMANO_FIBER_WIN32)
+
+VOID CALLBACK fiber_win32_entry(LPVOID param)
+{
+    fiber_entry((Fiber*)param);
+}
+
+/* Windows manages the stack (and its guard page) of the fiber */
+bool fiber_stack_alloc(FiberRuntime* runtime, Fiber* fiber)
+{
+    fiber->context = CreateFiberEx(0,
+                                   runtime->stack_size,
+                                   FIBER_FLAG_FLOAT_SWITCH,
+                                   fiber_win32_entry,
+                                   fiber);
+
+    if(fiber->context == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    fiber->stack = NULL;
+    fiber->stack_size = runtime->stack_size;
+
+    return true;
+}
+
+void fiber_stack_free(Fiber* fiber)
+{
+    DeleteFiber(fiber->context);
+}
+
+ROMANO_FORCE_INLINE void fiber_switch_in(FiberThreadContext* thread_context, Fiber* fiber)
+{
+    /*
+     * Workers are converted to fibers the first time they resume one. The fiber switched back to
+     * is the one resuming, which is another fiber when resumes are nested
+     */
+    if(!IsThreadAFiber())
+        ConvertThreadToFiberEx(NULL, FIBER_FLAG_FLOAT_SWITCH);
+
+    thread_context->context = GetCurrentFiber();
+
+    SwitchToFiber(fiber->context);
+}
+
+ROMANO_FORCE_INLINE void fiber_switch_out(Fiber* fiber)
+{
+    ROMANO_UNUSED(fiber);
+
+    SwitchToFiber(fiber_thread_context()->context);
+}
+
+#endif /* defined(ROMANO_FIBER_ASM) */
+
+/* A fiber is reused for several spawns: it loops forever and suspends between two functions */
+void fiber_entry(Fiber* fiber)
+{
+    while(1)
+    {
+        fiber->func(fiber->arg);
+
+        fiber->state = FiberState_Finished;
+
+        fiber_switch_out(fiber);
+    }
+}
+
+/* Fibers pool */
+
+ROMANO_FORCE_INLINE void fiber_spin_lock(int32_t* lock)
+{
+    while(!atomic_compare_exchange_strong_32((Atomic32*)lock, 1, 0, MemoryOrder_Acquire))
+        thread_yield();
+}
+
+ROMANO_FORCE_INLINE void fiber_spin_unlock(int32_t* lock)
+{
+    atomic_store_32((Atomic32*)lock, 0, MemoryOrder_Release);
+}
+
+Fiber* fiber_acquire(FiberRuntime* runtime)
+{
+    Fiber* fiber;
+
+    fiber_spin_lock(&runtime->free_lock);
+
+    fiber = runtime->free_fibers;
+
+    if(fiber != NULL)
+        runtime->free_fibers = fiber->next;
+
+    fiber_spin_unlock(&runtime->free_lock);
+
+    if(fiber != NULL)
+        return fiber;
+
+    fiber = (Fiber*)calloc(1, sizeof(Fiber));
+
+    if(fiber == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    fiber->runtime = runtime;
+
+    if(!fiber_stack_alloc(runtime, fiber))
+    {
+        free(fiber);
+        return NULL;
+    }
+
+    return fiber;
+}
+
+void fiber_release(Fiber* fiber)
+{
+    FiberRuntime* runtime = fiber->runtime;
+
+    fiber->func = NULL;
+    fiber->arg = NULL;
+    fiber->state = FiberState_Idle;
+
+    fiber_spin_lock(&runtime->free_lock);
+
+    fiber->next = runtime->free_fibers;
+    runtime->free_fibers = fiber;
+
+    fiber_spin_unlock(&runtime->free_lock);
+}
+
+/* I/O */
+
+#if defined(ROMANO_WIN)
+typedef WSAPOLLFD FiberPollFd;
+#define fiber_poll(fds, count, timeout) WSAPoll((fds), (ULONG)(count), (timeout))
+#else
+typedef struct pollfd FiberPollFd;
+#define fiber_poll(fds, count, timeout) poll((fds), (nfds_t)(count), (timeout))
+#endif /* defined(ROMANO_WIN) */
+
+ROMANO_FORCE_INLINE short fiber_events_to_poll(uint32_t events)
+{
+    short poll_events = 0;
+
+    if(events & FiberIOEvent_Read)
+        poll_events |= POLLIN;
+
+    if(events & FiberIOEvent_Write)
+        poll_events |= POLLOUT;
+
+    return poll_events;
+}
+
+ROMANO_FORCE_INLINE uint32_t fiber_events_from_poll(short poll_events)
+{
+    uint32_t events = 0;
+
+    if(poll_events & POLLIN)
+        events |= FiberIOEvent_Read;
+
+    if(poll_events & POLLOUT)
+        events |= FiberIOEvent_Write;
+
+    return events;
+}
+
+void* fiber_resume_func(void* arg);
+
+void fiber_io_wake(FiberRuntime* runtime)
+{
+#if defined(ROMANO_FIBER_ASM)
+    char c = 0;
+    ssize_t res = write(runtime->io_wake_pipe[1], &c, 1);
+    ROMANO_UNUSED(res);
+#else
+    ROMANO_UNUSED(runtime);
+#endif /* defined(ROMANO_FIBER_ASM) */
+}
+
+void* fiber_io_func(void* arg)
+{
+    FiberRuntime* runtime = (FiberRuntime*)arg;
+    Vector waiting;
+    Vector fds;
+
+    vector_init(&waiting, 128, sizeof(Fiber*));
+    vector_init(&fds, 128, sizeof(FiberPollFd));
+
+    while(!atomic_load_32((Atomic32*)&runtime->io_stop, MemoryOrder_Acquire))
+    {
+        FiberPollFd* poll_fds;
+        size_t first_fiber_fd = 0;
+        size_t i;
+        int res;
+
+        mutex_lock(&runtime->io_mutex);
+
+        for(i = 0; i < vector_size(&runtime->io_pending); i++)
+            vector_push_back(&waiting, vector_at(&runtime->io_pending, i));
+
+        vector_clear(&runtime->io_pending);
+
+        mutex_unlock(&runtime->io_mutex);
+
+        vector_clear(&fds);
+
+#if defined(ROMANO_FIBER_ASM)
+        {
+            FiberPollFd wake_fd;
+            wake_fd.fd = runtime->io_wake_pipe[0];
+            wake_fd.events = POLLIN;
+            wake_fd.revents = 0;
+            vector_push_back(&fds, &wake_fd);
+            first_fiber_fd = 1;
+        }
+#endif /* defined(ROMANO_FIBER_ASM) */
+
+        for(i = 0; i < vector_size(&waiting); i++)
+        {
+            Fiber* fiber = *(Fiber**)vector_at(&waiting, i);
+            FiberPollFd fiber_fd;
+
+            fiber_fd.fd = fiber->io_socket;
+            fiber_fd.events = fiber_events_to_poll(fiber->io_events);
+            fiber_fd.revents = 0;
+
+            vector_push_back(&fds, &fiber_fd);
+        }
+
+#if defined(ROMANO_WIN)
+        /* WSAPoll fails without any socket, and there is no wake up pipe */
+        if(vector_size(&fds) == 0)
+        {
+            thread_sleep(1);
+            continue;
+        }
+
+        res = fiber_poll((FiberPollFd*)vector_at(&fds, 0), vector_size(&fds), 1);
+#else
+        res = fiber_poll((FiberPollFd*)vector_at(&fds, 0), vector_size(&fds), -1);
+#endif /* defined(ROMANO_WIN) */
+
+        if(res <= 0)
+            continue;
+
+        poll_fds = (FiberPollFd*)vector_at(&fds, 0);
+
+#if defined(ROMANO_FIBER_ASM)
+        if(poll_fds[0].revents & POLLIN)
+        {
+            char buffer[64];
+            ssize_t read_res = read(runtime->io_wake_pipe[0], buffer, sizeof(buffer));
+            ROMANO_UNUSED(read_res);
+        }
+#endif /* defined(ROMANO_FIBER_ASM) */
+
+        /* Iterates backward to remove the ready fibers while iterating */
+        for(i = vector_size(&waiting); i > 0; i--)
+        {
+            FiberPollFd* fiber_fd = &poll_fds[first_fiber_fd + i - 1];
+            Fiber* fiber;
+
+            if(fiber_fd->revents == 0)
+                continue;
+
+            fiber = *(Fiber**)vector_at(&waiting, i - 1);
+            fiber->io_revents = fiber_events_from_poll(fiber_fd->revents);
+
+            /* The last fiber has already been visited, it replaces the ready one */
+            *(Fiber**)vector_at(&waiting, i - 1) = *(Fiber**)vector_back(&waiting);
+            vector_pop(&waiting);
+
+            threadpool_work_add(runtime->pool, fiber_resume_func, fiber, NULL);
+        }
+    }
+
+    vector_release(&fds);
+    vector_release(&waiting);
+
+    return NULL;
+}
+
+void fiber_io_register(FiberRuntime* runtime, Fiber* fiber)
+{
+    mutex_lock(&runtime->io_mutex);
+    vector_push_back(&runtime->io_pending, &fiber);
+    mutex_unlock(&runtime->io_mutex);
+
+    fiber_io_wake(runtime);
+}
+
+/* Work executed by the threadpool to run a fiber until it suspends */
+void* fiber_resume_func(void* arg)
+{
+    Fiber* fiber = (Fiber*)arg;
+    FiberRuntime* runtime = fiber->runtime;
+    FiberThreadContext* thread_context = fiber_thread_context();
+
+    /*
+     * A fiber blocked in future_get helps the threadpool and can resume another fiber on the same
+     * worker: the outer fiber and its context are restored once the nested one suspends
+     */
+    Fiber* previous = thread_context->current;
+    void* previous_context = thread_context->context;
+
+    thread_context->current = fiber;
+    fiber->state = FiberState_Running;
+
+    fiber_switch_in(thread_context, fiber);
+
+    thread_context->current = previous;
+    thread_context->context = previous_context;
+
+    /* The fiber is not executing anymore, it can be handed to another thread */
+    switch(fiber->state)
+    {
+        case FiberState_Yielded:
+            while(!threadpool_work_add(runtime->pool, fiber_resume_func, fiber, NULL))
+                thread_yield();
+            break;
+        case FiberState_WaitingIO:
+            fiber_io_register(runtime, fiber);
+            break;
+        case FiberState_Finished:
+        {
+            ThreadPoolWaiter* waiter = fiber->waiter;
+
+            fiber_release(fiber);
+
+            if(waiter != NULL)
+                atomic_sub_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Release);
+
+            break;
+        }
+        default:
+            ROMANO_ASSERT(0, "Invalid fiber state after switch");
+            break;
+    }
+
+    return NULL;
+}
+
+/* Runtime */
+
+FiberRuntime* fiber_runtime_new(ThreadPool* threadpool, size_t stack_size)
+{
+    FiberRuntime* runtime;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    runtime = (FiberRuntime*)calloc(1, sizeof(FiberRuntime));
+
+    if(runtime == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    runtime->pool = threadpool;
+
+#if defined(ROMANO_WIN)
+    {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+        runtime->page_size = (size_t)sys_info.dwPageSize;
+    }
+#else
+    runtime->page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    if(pipe(runtime->io_wake_pipe) != 0)
+    {
+        g_current_error = error_get_last_from_system();
+        free(runtime);
+        return NULL;
+    }
+
+    fcntl(runtime->io_wake_pipe[0], F_SETFL, fcntl(runtime->io_wake_pipe[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(runtime->io_wake_pipe[1], F_SETFL, fcntl(runtime->io_wake_pipe[1], F_GETFL, 0) | O_NONBLOCK);
+#endif /* defined(ROMANO_WIN) */
+
+    stack_size = stack_size == 0 ? FIBER_DEFAULT_STACK_SIZE : stack_size;
+    runtime->stack_size = (stack_size + runtime->page_size - 1) & ~(runtime->page_size - 1);
+
+    mutex_init(&runtime->io_mutex);
+    vector_init(&runtime->io_pending, 128, sizeof(Fiber*));
+
+    runtime->io_thread = thread_create(fiber_io_func, runtime);
+
+    if(runtime->io_thread == NULL)
+    {
+        vector_release(&runtime->io_pending);
+        mutex_release(&runtime->io_mutex);
+#if defined(ROMANO_FIBER_ASM)
+        close(runtime->io_wake_pipe[0]);
+        close(runtime->io_wake_pipe[1]);
+#endif /* defined(ROMANO_FIBER_ASM) */
+        free(runtime);
+        return NULL;
+    }
+
+    thread_start(runtime->io_thread);
+
+    return runtime;
+}
+
+bool fiber_spawn(FiberRuntime* runtime, ThreadFunc func, void* arg, ThreadPoolWaiter* waiter)
+{
+    Fiber* fiber;
+
+    ROMANO_ASSERT(runtime != NULL, "");
+    ROMANO_ASSERT(func != NULL, "");
+
+    fiber = fiber_acquire(runtime);
+
+    if(fiber == NULL)
+        return false;
+
+    fiber->func = func;
+    fiber->arg = arg;
+    fiber->waiter = waiter;
+    fiber->state = FiberState_Idle;
+
+    if(waiter != NULL)
+        atomic_add_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Relax);
+
+    if(!threadpool_work_add(runtime->pool, fiber_resume_func, fiber, NULL))
+    {
+        if(waiter != NULL)
+            atomic_sub_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Relax);
+
+        fiber_release(fiber);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool fiber_is_in_fiber(void)
+{
+    return fiber_thread_context()->current != NULL;
+}
+
+void fiber_yield(void)
+{
+    Fiber* fiber = fiber_thread_context()->current;
+
+    if(fiber == NULL)
+    {
+        thread_yield();
+        return;
+    }
+
+    fiber->state = FiberState_Yielded;
+
+    fiber_switch_out(fiber);
+}
+
+uint32_t fiber_wait_socket(Socket s, uint32_t events)
+{
+    Fiber* fiber = fiber_thread_context()->current;
+
+    if(fiber == NULL)
+    {
+        FiberPollFd fd;
+
+        fd.fd = s;
+        fd.events = fiber_events_to_poll(events);
+        fd.revents = 0;
+
+        if(fiber_poll(&fd, 1, -1) <= 0)
+            return 0;
+
+        return fiber_events_from_poll(fd.revents);
+    }
+
+    fiber->io_socket = s;
+    fiber->io_events = events;
+    fiber->io_revents = 0;
+    fiber->state = FiberState_WaitingIO;
+
+    /* The worker registers the fiber to the io thread once the fiber has been switched out */
+    fiber_switch_out(fiber);
+
+    return fiber->io_revents;
+}
+
+ROMANO_FORCE_INLINE bool fiber_socket_would_block(void)
+{
+#if defined(ROMANO_WIN)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif /* defined(ROMANO_WIN) */
+}
+
+ssize_t fiber_socket_recv(Socket s, void* buffer, size_t buffer_sz, int flags)
+{
+    while(1)
+    {
+        ssize_t res = socket_recv(s, buffer, buffer_sz, flags);
+
+        if(res >= 0 || !fiber_socket_would_block())
+            return res;
+
+        fiber_wait_socket(s, FiberIOEvent_Read);
+    }
+}
+
+ssize_t fiber_socket_send(Socket s, const void* buffer, size_t buffer_sz, int flags)
+{
+    while(1)
+    {
+        ssize_t res = socket_send(s, buffer, buffer_sz, flags);
+
+        if(res >= 0 || !fiber_socket_would_block())
+            return res;
+
+        fiber_wait_socket(s, FiberIOEvent_Write);
+    }
+}
+
+void fiber_runtime_free(FiberRuntime* runtime)
+{
+    Fiber* fiber;
+
+    ROMANO_ASSERT(runtime != NULL, "");
+
+    atomic_store_32((Atomic32*)&runtime->io_stop, 1, MemoryOrder_Release);
+    fiber_io_wake(runtime);
+
+    thread_join(runtime->io_thread);
+
+    fiber = runtime->free_fibers;
+
+    while(fiber != NULL)
+    {
+        Fiber* next = fiber->next;
+
+        fiber_stack_free(fiber);
+        free(fiber);
+
+        fiber = next;
+    }
+
+    vector_release(&runtime->io_pending);
+    mutex_release(&runtime->io_mutex);
+
+#if defined(ROMANO_FIBER_ASM)
+    close(runtime->io_wake_pipe[0]);
+    close(runtime->io_wake_pipe[1]);
+#endif /* defined(ROMANO_FIBER_ASM) */
+
+    free(runtime);
+}
@@ -17,6 +17,8 @@
 #include <PathCch.h>
 #elif defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #if !defined(ROMANO_APPLE)
 #include <linux/limits.h>
 #endif /* !defined(ROMANO_APPLE) */
@@ -118,6 +120,144 @@ void fs_file_content_free(FileContent* content)
     free(content);
 }
 
+bool fs_file_map(FileMapping* mapping, const char* path, bool writable)
+{
+    ROMANO_ASSERT(mapping != NULL, "NULL file mapping");
+
+    mapping->data = NULL;
+    mapping->size = 0;
+
+#if defined(ROMANO_WIN)
+    LARGE_INTEGER file_size;
+
+    mapping->mapping_handle = NULL;
+    mapping->file_handle = CreateFileA(path,
+                                       GENERIC_READ,
+                                       FILE_SHARE_READ,
+                                       NULL,
+                                       OPEN_EXISTING,
+                                       FILE_ATTRIBUTE_NORMAL,
+                                       NULL);
+
+    if(mapping->file_handle == INVALID_HANDLE_VALUE)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    if(!GetFileSizeEx(mapping->file_handle, &file_size))
+    {
+        g_current_error = error_get_last_from_system();
+        CloseHandle(mapping->file_handle);
+        return false;
+    }
+
+    if(file_size.QuadPart == 0)
+        return true;
+
+    mapping->mapping_handle = CreateFileMappingA(mapping->file_handle,
+                                                 NULL,
+                                                 writable ? PAGE_WRITECOPY : PAGE_READONLY,
+                                                 0,
+                                                 0,
+                                                 NULL);
+
+    if(mapping->mapping_handle == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        CloseHandle(mapping->file_handle);
+        return false;
+    }
+
+    mapping->data = (char*)MapViewOfFile(mapping->mapping_handle,
+                                         writable ? FILE_MAP_COPY : FILE_MAP_READ,
+                                         0,
+                                         0,
+                                         0);
+
+    if(mapping->data == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        CloseHandle(mapping->mapping_handle);
+        CloseHandle(mapping->file_handle);
+        return false;
+    }
+
+    mapping->size = (size_t)file_size.QuadPart;
+#elif defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
+    struct stat file_stat;
+    void* data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+
+    if(fd == -1)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    if(fstat(fd, &file_stat) == -1)
+    {
+        g_current_error = error_get_last_from_system();
+        close(fd);
+        return false;
+    }
+
+    if(file_stat.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    data = mmap(NULL,
+                (size_t)file_stat.st_size,
+                writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                MAP_PRIVATE,
+                fd,
+                0);
+
+    /* The mapping stays valid once the file descriptor is closed */
+    close(fd);
+
+    if(data == MAP_FAILED)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    mapping->data = (char*)data;
+    mapping->size = (size_t)file_stat.st_size;
+#endif /* defined(ROMANO_WIN) */
+
+    return true;
+}
+
+void fs_file_unmap(FileMapping* mapping)
+{
+    ROMANO_ASSERT(mapping != NULL, "NULL file mapping");
+
+#if defined(ROMANO_WIN)
+    if(mapping->data != NULL)
+        UnmapViewOfFile(mapping->data);
+
+    if(mapping->mapping_handle != NULL)
+        CloseHandle(mapping->mapping_handle);
+
+    if(mapping->file_handle != INVALID_HANDLE_VALUE && mapping->file_handle != NULL)
+        CloseHandle(mapping->file_handle);
+
+    mapping->mapping_handle = NULL;
+    mapping->file_handle = NULL;
+#elif defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
+    if(mapping->data != NULL)
+        munmap(mapping->data, mapping->size);
+#endif /* defined(ROMANO_WIN) */
+
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
 bool fs_path_exists(const char *path)
 {
     ROMANO_ASSERT(path != NULL, "path is NULL");
@@ -3,15 +3,20 @@
 /* All rights reserved. */
 
 #include "libromano/json.h"
+#include "libromano/json_stream.h"
 #include "libromano/arena.h"
 #include "libromano/common.h"
 #include "libromano/logger.h"
 #include "libromano/error.h"
 #include "libromano/fmt.h"
+#include "libromano/parse.h"
 #include "libromano/bit.h"
+#include "libromano/simd.h"
+#include "libromano/hash.h"
+#include "libromano/filesystem.h"
+
+#include "json_internal.h"
 
-#include <ctype.h>
-#include <math.h>
 #include <string.h>
 
 extern ErrorCode g_current_error;
@@ -231,15 +236,18 @@ bool json_is_str(JsonValue* value)
 }
 
 JsonValue* json_str_new(Json* json, const char* str)
+{
+    return json_str_new_sized(json, str, strlen(str));
+}
+
+JsonValue* json_str_new_sized(Json* json, const char* str, size_t str_sz)
 {
     JsonValue* value;
-    size_t str_sz;
     char* str_ptr;
 
     value = arena_push(&json->value_arena, NULL, sizeof(JsonValue));
     memset(value, 0, sizeof(JsonValue));
 
-    str_sz = strlen(str);
     str_ptr = arena_push(&json->string_arena, NULL, (str_sz + 1) * sizeof(char));
     memcpy(str_ptr, str, str_sz * sizeof(char));
     str_ptr[str_sz] = '\0';
@@ -285,9 +293,16 @@ void json_str_set(Json* json, JsonValue* value, const char* str)
 
 /* Array */
 
+/*
+ * Arrays store their elements contiguously in the value arena. Growing an array pushes a new
+ * buffer twice as large, arrays built by the parser are allocated at their exact size
+ */
+
+#define JSON_ARRAY_MIN_CAPACITY 8
+
 typedef struct JsonArrayInfo {
-    JsonArrayElement* head;
-    JsonArrayElement* tail;
+    JsonValue** values;
+    size_t capacity;
 } JsonArrayInfo;
 
 bool json_is_array(JsonValue* value)
@@ -314,24 +329,30 @@ JsonValue* json_array_new(Json* json)
 
 void json_array_append(Json* json, JsonValue* array, JsonValue* value, bool reference)
 {
-    JsonArrayElement* new_element;
     JsonArrayInfo* info;
+    JsonValue** new_values;
     JsonValue* new_value;
+    size_t array_sz;
+    size_t new_capacity;
 
     info = (JsonArrayInfo*)array->value.ptr;
+    array_sz = (size_t)json_get_sz(array->tags);
 
-    new_element = arena_push(&json->value_arena, NULL, sizeof(JsonArrayElement));
-    new_element->next = NULL;
-
-    if(info->head == NULL)
-    {
-        info->head = new_element;
-        info->tail = new_element;
-    }
-    else
+    if(array_sz == info->capacity)
     {
-        info->tail->next = new_element;
-        info->tail = new_element;
+        new_capacity = info->capacity < JSON_ARRAY_MIN_CAPACITY ? JSON_ARRAY_MIN_CAPACITY :
+                                                                  info->capacity * 2;
+
+        new_values = arena_push(&json->value_arena, NULL, new_capacity * sizeof(JsonValue*));
+
+        if(new_values == NULL)
+            return;
+
+        if(array_sz > 0)
+            memcpy(new_values, info->values, array_sz * sizeof(JsonValue*));
+
+        info->values = new_values;
+        info->capacity = new_capacity;
     }
 
     if(!reference)
@@ -340,66 +361,68 @@ void json_array_append(Json* json, JsonValue* array, JsonValue* value, bool refe
         memcpy(new_value, value, sizeof(JsonValue));
     }
 
-    new_element->value = reference ? value : new_value;
+    info->values[array_sz] = reference ? value : new_value;
 
     json_incr_sz(array->tags);
 }
 
 void json_array_pop(Json* json, JsonValue* array, size_t index)
 {
+    JsonArrayInfo* info;
+    size_t array_sz;
+
     ROMANO_UNUSED(json);
 
-    JsonArrayIterator iterator;
-    JsonArrayInfo* info;
-    JsonArrayElement* previous;
-    size_t i;
+    array_sz = json_array_get_size(array);
 
-    if(index >= json_array_get_size(array))
+    if(index >= array_sz)
         return;
 
     info = (JsonArrayInfo*)array->value.ptr;
 
-    if(index == 0)
-    {
-        info->head = info->head->next;
-        json_decr_sz(array->tags);
-        return;
-    }
+    memmove(info->values + index,
+            info->values + index + 1,
+            (array_sz - index - 1) * sizeof(JsonValue*));
 
-    iterator.current = info->head;
-    previous = NULL;
-    i = 0;
+    json_decr_sz(array->tags);
+}
 
-    while(iterator.current->next != NULL && i < index)
-    {
-        previous = iterator.current;
-        iterator.current = iterator.current->next;
-        i++;
-    }
+/*
+ * Sets the elements of an empty array, allocating them at their exact size
+ */
+bool json_array_set_values(Json* json, JsonValue* array, JsonValue** values, size_t count)
+{
+    JsonArrayInfo* info;
 
-    if(previous == NULL)
-    {
-        info->head = iterator.current;
-    }
-    else
-    {
-        previous->next = iterator.current->next;
+    info = (JsonArrayInfo*)array->value.ptr;
 
-        if(iterator.current == info->tail)
-            info->tail = iterator.current->next;
-    }
+    info->values = arena_push(&json->value_arena, values, count * sizeof(JsonValue*));
 
-    json_decr_sz(array->tags);
+    if(info->values == NULL)
+        return false;
+
+    info->capacity = count;
+    json_set_sz(array->tags, count);
+
+    return true;
+}
+
+JsonValue* json_array_get(JsonValue* array, size_t index)
+{
+    if(index >= json_array_get_size(array))
+        return NULL;
+
+    return ((JsonArrayInfo*)array->value.ptr)->values[index];
 }
 
 JsonValue* json_array_get_next(Json* json, JsonValue* array, JsonArrayIterator* iterator)
 {
-    if(iterator->current == NULL)
-        iterator->current = ((JsonArrayInfo*)array->value.ptr)->head;
-    else
-        iterator->current = iterator->current->next;
+    ROMANO_UNUSED(json);
+
+    if(iterator->index >= json_array_get_size(array))
+        return NULL;
 
-    return iterator->current == NULL ? NULL : iterator->current->value;
+    return ((JsonArrayInfo*)array->value.ptr)->values[iterator->index++];
 }
 
 size_t json_array_get_size(JsonValue* value)
@@ -410,13 +433,223 @@ size_t json_array_get_size(JsonValue* value)
     return (size_t)json_get_sz(value->tags);
 }
 
+bool json_array_to_f64(JsonValue* array, double* out)
+{
+    JsonValue** values;
+    size_t array_sz;
+    size_t i;
+
+    if((array->tags & JsonTag_Array) == 0)
+        return false;
+
+    values = ((JsonArrayInfo*)array->value.ptr)->values;
+    array_sz = (size_t)json_get_sz(array->tags);
+
+    for(i = 0; i < array_sz; i++)
+    {
+        switch(values[i]->tags & JSON_TAGS_MASK)
+        {
+            case JsonTag_F64:
+                out[i] = values[i]->value.f64;
+                break;
+            case JsonTag_U64:
+                out[i] = (double)values[i]->value.u64;
+                break;
+            case JsonTag_I64:
+                out[i] = (double)values[i]->value.i64;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
 /* Dict */
 
+/*
+ * Open-addressing (linear probing) index mapping key hashes to dict elements. It is stored in the
+ * value arena and only built for dicts holding at least JSON_DICT_INDEX_THRESHOLD keys, the
+ * elements list still holds the insertion order. With duplicated keys, only the first one is
+ * indexed
+ */
+
+#define JSON_DICT_INDEX_SEED 0x9747B28C
+
+typedef struct JsonDictIndexEntry {
+    JsonDictElement* element;
+    uint32_t hash;
+} JsonDictIndexEntry;
+
+typedef struct JsonDictIndex {
+    JsonDictIndexEntry* entries;
+    uint32_t capacity;
+    uint32_t count;
+    bool has_duplicates;
+} JsonDictIndex;
+
 typedef struct JsonDictInfo {
     JsonDictElement* head;
     JsonDictElement* tail;
+    JsonDictIndex index;
 } JsonDictInfo;
 
+ROMANO_FORCE_INLINE uint32_t json_dict_hash_key(const char* key)
+{
+    return hash_murmur3(key, strlen(key), JSON_DICT_INDEX_SEED);
+}
+
+void json_dict_index_insert(JsonDictIndex* index, JsonDictElement* element, uint32_t hash)
+{
+    const uint32_t mask = index->capacity - 1;
+    uint32_t i;
+
+    i = hash & mask;
+
+    while(index->entries[i].element != NULL)
+    {
+        if(index->entries[i].hash == hash &&
+           strcmp(index->entries[i].element->key_value->key, element->key_value->key) == 0)
+        {
+            index->has_duplicates = true;
+            return;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    index->entries[i].element = element;
+    index->entries[i].hash = hash;
+    index->count++;
+}
+
+/*
+ * (Re)builds the index with the given capacity (a power of 2). Returns false on allocation failure
+ */
+bool json_dict_index_build(Json* json, JsonDictInfo* info, uint32_t capacity)
+{
+    JsonDictIndexEntry* old_entries;
+    JsonDictElement* element;
+    uint32_t old_capacity;
+    uint32_t i;
+
+    old_entries = info->index.entries;
+    old_capacity = info->index.capacity;
+
+    info->index.entries = arena_push(&json->value_arena, NULL, capacity * sizeof(JsonDictIndexEntry));
+
+    if(info->index.entries == NULL)
+    {
+        info->index.entries = old_entries;
+        return false;
+    }
+
+    memset(info->index.entries, 0, capacity * sizeof(JsonDictIndexEntry));
+    info->index.capacity = capacity;
+    info->index.count = 0;
+
+    if(old_entries != NULL)
+    {
+        for(i = 0; i < old_capacity; i++)
+            if(old_entries[i].element != NULL)
+                json_dict_index_insert(&info->index, old_entries[i].element, old_entries[i].hash);
+    }
+    else
+    {
+        info->index.has_duplicates = false;
+
+        for(element = info->head; element != NULL; element = element->next)
+            json_dict_index_insert(&info->index, element, json_dict_hash_key(element->key_value->key));
+    }
+
+    return true;
+}
+
+JsonDictIndexEntry* json_dict_index_find(JsonDictIndex* index, const char* key, uint32_t hash)
+{
+    const uint32_t mask = index->capacity - 1;
+    uint32_t i;
+
+    i = hash & mask;
+
+    while(index->entries[i].element != NULL)
+    {
+        if(index->entries[i].hash == hash && strcmp(index->entries[i].element->key_value->key, key) == 0)
+            return &index->entries[i];
+
+        i = (i + 1) & mask;
+    }
+
+    return NULL;
+}
+
+/*
+ * Removes an entry using backward shift deletion, so the index never holds tombstones
+ */
+void json_dict_index_remove(JsonDictIndex* index, JsonDictIndexEntry* entry)
+{
+    const uint32_t mask = index->capacity - 1;
+    uint32_t hole;
+    uint32_t i;
+    uint32_t home;
+
+    hole = (uint32_t)(entry - index->entries);
+    i = (hole + 1) & mask;
+
+    while(index->entries[i].element != NULL)
+    {
+        home = index->entries[i].hash & mask;
+
+        /* The entry can fill the hole if its home slot is not between the hole and itself */
+        if(((i - home) & mask) >= ((i - hole) & mask))
+        {
+            index->entries[hole] = index->entries[i];
+            hole = i;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    index->entries[hole].element = NULL;
+    index->entries[hole].hash = 0;
+    index->count--;
+}
+
+/*
+ * Returns the element holding the given key, building the index first if the dict is large enough
+ */
+/*
+ * hash is the hash of the key when it is already known (precompiled paths), otherwise NULL and it is
+ * computed if the dict is indexed
+ */
+JsonDictElement* json_dict_find_element(Json* json,
+                                        JsonDictInfo* info,
+                                        size_t dict_size,
+                                        const char* key,
+                                        const uint32_t* hash)
+{
+    JsonDictIndexEntry* entry;
+    JsonDictElement* element;
+
+    /* round_u32_to_next_pow2 returns the next power of 2 minus one */
+    if(info->index.entries == NULL && dict_size >= JSON_DICT_INDEX_THRESHOLD)
+        json_dict_index_build(json, info, round_u32_to_next_pow2((uint32_t)dict_size * 2) + 1);
+
+    if(info->index.entries != NULL)
+    {
+        entry = json_dict_index_find(&info->index, key, hash != NULL ? *hash : json_dict_hash_key(key));
+
+        return entry == NULL ? NULL : entry->element;
+    }
+
+    for(element = info->head; element != NULL; element = element->next)
+        if(strcmp(element->key_value->key, key) == 0)
+            return element;
+
+    return NULL;
+}
+
 bool json_is_dict(JsonValue* value)
 {
     return value->tags & JsonTag_Dict;
@@ -441,18 +674,19 @@ JsonValue* json_dict_new(Json* json, JsonValue* value)
     return dict;
 }
 
-void json_dict_append(Json* json, JsonValue* dict, const char* key, JsonValue* value, bool reference)
+/*
+ * Appends a key/value pair without copying the key, which must live as long as the document
+ */
+void json_dict_append_no_copy(Json* json, JsonValue* dict, const char* key, JsonValue* value)
 {
     JsonDictInfo* info;
     JsonDictElement* element;
     JsonKeyValue* new_key_value;
-    JsonValue* new_value;
-    size_t key_sz;
-    char* new_key;
 
     info = (JsonDictInfo*)dict->value.ptr;
 
     element = (JsonDictElement*)arena_push(&json->value_arena, NULL, sizeof(JsonDictElement));
+    element->previous = info->tail;
     element->next = NULL;
 
     if(info->head == NULL)
@@ -466,90 +700,121 @@ void json_dict_append(Json* json, JsonValue* dict, const char* key, JsonValue* v
         info->tail = element;
     }
 
+    new_key_value = arena_push(&json->value_arena, NULL, sizeof(JsonKeyValue));
+    new_key_value->key = key;
+    new_key_value->value = value;
+
+    element->key_value = new_key_value;
+
+    json_incr_sz(dict->tags);
+
+    if(info->index.entries != NULL)
+    {
+        /* Keep the load factor under 0.5, drop the index if it cannot grow */
+        if((info->index.count + 1) * 2 > info->index.capacity &&
+           !json_dict_index_build(json, info, info->index.capacity * 2))
+        {
+            memset(&info->index, 0, sizeof(JsonDictIndex));
+            return;
+        }
+
+        /* Hashed as the lookups and json_dict_index_build do, keys are compared as C strings */
+        json_dict_index_insert(&info->index, element, json_dict_hash_key(key));
+    }
+}
+
+void json_dict_append(Json* json, JsonValue* dict, const char* key, JsonValue* value, bool reference)
+{
+    JsonValue* new_value;
+    size_t key_sz;
+    char* new_key;
+
     key_sz = strlen(key);
 
     new_key = arena_push(&json->string_arena, NULL, (key_sz + 1) * sizeof(char));
     memcpy(new_key, key, key_sz);
     new_key[key_sz] = '\0';
 
-    if(!reference)
+    if(reference)
+    {
+        new_value = value;
+    }
+    else
     {
         new_value = arena_push(&json->value_arena, NULL, sizeof(JsonValue));
         memcpy(new_value, value, sizeof(JsonValue));
     }
 
-    new_key_value = arena_push(&json->value_arena, NULL, sizeof(JsonKeyValue));
-    new_key_value->key = new_key;
-    new_key_value->value = reference ? value : new_value;
-
-    element->key_value = new_key_value;
-
-    json_incr_sz(dict->tags);
+    json_dict_append_no_copy(json, dict, new_key, new_value);
 }
 
 JsonValue* json_dict_find(Json* json, JsonValue* dict, const char* key)
 {
-    JsonDictInfo* info;
-    JsonDictIterator iterator;
+    JsonDictElement* element;
 
-    ROMANO_UNUSED(json);
+    element = json_dict_find_element(json,
+                                     (JsonDictInfo*)dict->value.ptr,
+                                     (size_t)json_get_sz(dict->tags),
+                                     key,
+                                     NULL);
 
-    info = (JsonDictInfo*)dict->value.ptr;
+    return element == NULL ? NULL : element->key_value->value;
+}
 
-    iterator.current = info->head;
+uint32_t json_dict_key_hash(const char* key)
+{
+    return json_dict_hash_key(key);
+}
 
-    while(iterator.current != NULL)
-    {
-        if(strcmp(iterator.current->key_value->key, key) == 0)
-            break;
+JsonValue* json_dict_find_hashed(Json* json, JsonValue* dict, const char* key, uint32_t hash)
+{
+    JsonDictElement* element;
 
-        iterator.current = iterator.current->next;
-    }
+    element = json_dict_find_element(json,
+                                     (JsonDictInfo*)dict->value.ptr,
+                                     (size_t)json_get_sz(dict->tags),
+                                     key,
+                                     &hash);
 
-    return iterator.current == NULL ? NULL : iterator.current->key_value->value;
+    return element == NULL ? NULL : element->key_value->value;
 }
 
 void json_dict_pop(Json* json, JsonValue* dict, const char* key)
 {
     JsonDictInfo* info;
-    JsonDictIterator iterator;
-    JsonDictElement* previous;
-    bool found;
-
-    ROMANO_UNUSED(json);
+    JsonDictElement* element;
+    JsonDictIndexEntry* entry;
 
-    found = false;
     info = (JsonDictInfo*)dict->value.ptr;
 
-    iterator.current = (JsonDictElement*)(info->head);
-    previous = NULL;
+    element = json_dict_find_element(json, info, (size_t)json_get_sz(dict->tags), key, NULL);
+
+    if(element == NULL)
+        return;
 
-    while(iterator.current != NULL)
+    if(info->index.entries != NULL)
     {
-        if(strcmp(iterator.current->key_value->key, key) == 0)
+        /* A duplicated key would become visible again, let the next lookup rebuild the index */
+        if(info->index.has_duplicates)
         {
-            found = true;
-            break;
+            memset(&info->index, 0, sizeof(JsonDictIndex));
+        }
+        else
+        {
+            entry = json_dict_index_find(&info->index, key, json_dict_hash_key(key));
+            json_dict_index_remove(&info->index, entry);
         }
-
-        previous = iterator.current;
-        iterator.current = iterator.current->next;
     }
 
-    if(!found)
-        return;
-
-    if(previous == NULL)
-    {
-        info->head = iterator.current;
-    }
+    if(element->previous == NULL)
+        info->head = element->next;
     else
-    {
-        previous->next = iterator.current->next;
+        element->previous->next = element->next;
 
-        if(iterator.current == info->tail)
-            info->tail = iterator.current->next;
-    }
+    if(element->next == NULL)
+        info->tail = element->previous;
+    else
+        element->next->previous = element->previous;
 
     json_decr_sz(dict->tags);
 }
@@ -582,260 +847,710 @@ size_t json_dict_get_size(JsonValue* value)
 }
 
 /***************/
-/* Json Parser */
+/* Json escape */
 /***************/
 
-typedef struct JsonParser {
-    const char* str;
-    size_t pos;
-    size_t len;
-    Json* json;
-} JsonParser;
+ROMANO_FORCE_INLINE bool json_parse_hex4(const char* str, size_t str_sz, uint32_t* code_point)
+{
+    uint32_t value;
+    size_t i;
+    char c;
 
-JsonValue* json_parse_value(JsonParser* p);
+    if(str_sz < 4)
+        return false;
 
-ROMANO_FORCE_INLINE void json_skip_whitespace(JsonParser* p)
-{
-    while(p->pos < p->len)
-    {
-        char c = p->str[p->pos];
+    value = 0;
 
-        if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
-            p->pos++;
+    for(i = 0; i < 4; i++)
+    {
+        c = str[i];
+
+        if(c >= '0' && c <= '9')
+            value = (value << 4) | (uint32_t)(c - '0');
+        else if(c >= 'a' && c <= 'f')
+            value = (value << 4) | (uint32_t)(c - 'a' + 10);
+        else if(c >= 'A' && c <= 'F')
+            value = (value << 4) | (uint32_t)(c - 'A' + 10);
         else
-            break;
+            return false;
+    }
+
+    *code_point = value;
+
+    return true;
+}
+
+ROMANO_FORCE_INLINE size_t json_encode_utf8(char* dst, uint32_t code_point)
+{
+    if(code_point < 0x80)
+    {
+        dst[0] = (char)code_point;
+        return 1;
+    }
+    else if(code_point < 0x800)
+    {
+        dst[0] = (char)(0xC0 | (code_point >> 6));
+        dst[1] = (char)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    else if(code_point < 0x10000)
+    {
+        dst[0] = (char)(0xE0 | (code_point >> 12));
+        dst[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (code_point & 0x3F));
+        return 3;
     }
+
+    dst[0] = (char)(0xF0 | (code_point >> 18));
+    dst[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (code_point & 0x3F));
+    return 4;
 }
 
-JsonValue* json_parse_string(JsonParser* p)
+bool json_unescape(char* dst, const char* src, size_t src_sz, size_t* dst_sz)
 {
-    JsonValue* value;
-    char* str;
+    const char* backslash;
+    uint32_t code_point;
+    uint32_t low_surrogate;
+    size_t run;
     size_t i;
     size_t j;
-    size_t start;
-    size_t len;
-    bool has_escape;
-    char escape;
 
-    if(p->pos >= p->len || p->str[p->pos] != '"')
-        return NULL;
-
-    p->pos++;
-
-    start = p->pos;
-    len = 0;
-    has_escape = false;
+    i = 0;
+    j = 0;
 
-    while(p->pos < p->len)
+    while(i < src_sz)
     {
-        char c = p->str[p->pos];
+        backslash = (const char*)memchr(src + i, '\\', src_sz - i);
+        run = backslash == NULL ? src_sz - i : (size_t)(backslash - (src + i));
 
-        if(c == '"')
-        {
+        /* dst can alias src, and never gets ahead of it */
+        memmove(dst + j, src + i, run);
+        i += run;
+        j += run;
+
+        if(i >= src_sz)
             break;
-        }
-        else if(c == '\\')
+
+        if(i + 1 >= src_sz)
+            return false;
+
+        switch(src[i + 1])
         {
-            has_escape = true;
-            p->pos++;
+            case '"': dst[j++] = '"'; break;
+            case '\\': dst[j++] = '\\'; break;
+            case '/': dst[j++] = '/'; break;
+            case 'b': dst[j++] = '\b'; break;
+            case 'f': dst[j++] = '\f'; break;
+            case 'n': dst[j++] = '\n'; break;
+            case 'r': dst[j++] = '\r'; break;
+            case 't': dst[j++] = '\t'; break;
+            case 'u':
+            {
+                if(!json_parse_hex4(src + i + 2, src_sz - i - 2, &code_point))
+                    return false;
 
-            if(p->pos >= p->len)
-                return NULL;
+                i += 6;
 
-            escape = p->str[p->pos];
+                if(code_point >= 0xD800 && code_point <= 0xDBFF &&
+                   i + 6 <= src_sz && src[i] == '\\' && src[i + 1] == 'u' &&
+                   json_parse_hex4(src + i + 2, 4, &low_surrogate) &&
+                   low_surrogate >= 0xDC00 && low_surrogate <= 0xDFFF)
+                {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                    i += 6;
+                }
+                else if(code_point >= 0xD800 && code_point <= 0xDFFF)
+                {
+                    /* Lone surrogates are replaced by U+FFFD */
+                    code_point = 0xFFFD;
+                }
 
-            if(escape == 'u')
-            {
-                p->pos += 4;
+                j += json_encode_utf8(dst + j, code_point);
 
-                if(p->pos >= p->len)
-                    return NULL;
+                continue;
             }
-        }
-        else if((unsigned char)c < 0x20)
-        {
-            return NULL;
+            default:
+                return false;
         }
 
-        p->pos++;
-        len++;
+        i += 2;
     }
 
-    if(p->pos >= p->len)
-        return NULL;
+    dst[j] = '\0';
+    *dst_sz = j;
 
-    value = arena_push(&p->json->value_arena, NULL, sizeof(JsonValue));
+    return true;
+}
 
-    if(!has_escape)
-    {
-        str = arena_push(&p->json->string_arena, NULL, len + 1);
-        memcpy(str, p->str + start, len);
-        str[len] = '\0';
-    }
-    else
+/***************/
+/* Json Parser */
+/***************/
+
+/*
+ * The parser works in two stages. The first stage classifies the input 64 bytes at a time (AVX2
+ * on x86_64, NEON on aarch64, a lookup table otherwise) and builds an index of the positions of
+ * every structural character ({}[]:,), every opening quote and the first byte of every scalar
+ * (number, true, false, null) lying outside of a string. The value builders then jump from one
+ * indexed position to the next instead of skipping whitespace byte per byte
+ */
+
+#define JSON_BLOCK_SIZE 64
+
+typedef struct JsonBlock {
+    uint64_t whitespace;
+    uint64_t op;
+    uint64_t quote;
+    uint64_t backslash;
+} JsonBlock;
+
+#if defined(__AVX2__)
+
+ROMANO_FORCE_INLINE uint64_t json_movemask_64(__m256i lo, __m256i hi)
+{
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(lo) |
+           ((uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32);
+}
+
+ROMANO_FORCE_INLINE void json_classify_block(const char* data, JsonBlock* block)
+{
+    /* Lookup tables indexed by the low nibble, a byte is a whitespace/op if it matches its entry */
+    const __m256i ws_table = _mm256_setr_epi8(' ', 100, 100, 100, 17, 100, 113, 2,
+                                              100, '\t', '\n', 112, 100, '\r', 100, 100,
+                                              ' ', 100, 100, 100, 17, 100, 113, 2,
+                                              100, '\t', '\n', 112, 100, '\r', 100, 100);
+    const __m256i op_table = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, ':', '{', ',', '}', 0, 0,
+                                              0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 0, ':', '{', ',', '}', 0, 0);
+    /* Or-ing 0x20 maps '[' and ']' to '{' and '}' */
+    const __m256i curly = _mm256_set1_epi8(0x20);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    const __m256i lo = _mm256_loadu_si256((const __m256i*)data);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*)(data + 32));
+
+    block->whitespace = json_movemask_64(_mm256_cmpeq_epi8(lo, _mm256_shuffle_epi8(ws_table, lo)),
+                                         _mm256_cmpeq_epi8(hi, _mm256_shuffle_epi8(ws_table, hi)));
+    block->op = json_movemask_64(_mm256_cmpeq_epi8(_mm256_or_si256(lo, curly),
+                                                   _mm256_shuffle_epi8(op_table, lo)),
+                                 _mm256_cmpeq_epi8(_mm256_or_si256(hi, curly),
+                                                   _mm256_shuffle_epi8(op_table, hi)));
+    block->quote = json_movemask_64(_mm256_cmpeq_epi8(lo, quote), _mm256_cmpeq_epi8(hi, quote));
+    block->backslash = json_movemask_64(_mm256_cmpeq_epi8(lo, backslash),
+                                        _mm256_cmpeq_epi8(hi, backslash));
+}
+
+/*
+ * Returns the position of the first quote, backslash or control character found from pos, or len
+ */
+ROMANO_FORCE_INLINE size_t json_scan_string(const char* str, size_t pos, size_t len)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    uint32_t mask;
+
+    while(pos + 32 <= len)
     {
-        str = arena_push(&p->json->string_arena, NULL, len + 1);
-        j = 0;
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(str + pos));
 
-        for(i = start; i < p->pos; i++)
-        {
-            if(p->str[i] == '\\')
-            {
-                i++;
+        mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                            _mm256_cmpeq_epi8(v, backslash)),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v)));
 
-                switch(p->str[i])
-                {
-                    case '"': str[j++] = '"'; break;
-                    case '\\': str[j++] = '\\'; break;
-                    case '/': str[j++] = '/'; break;
-                    case 'b': str[j++] = '\b'; break;
-                    case 'f': str[j++] = '\f'; break;
-                    case 'n': str[j++] = '\n'; break;
-                    case 'r': str[j++] = '\r'; break;
-                    case 't': str[j++] = '\t'; break;
-                    case 'u':
-                    {
-                        /* TODO: unicode handling */
-                        i += 4;
-                        str[j++] = '?';
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                str[j++] = p->str[i];
-            }
-        }
+        if(mask != 0)
+            return pos + (size_t)ctz_u64((uint64_t)mask);
 
-        str[j] = '\0';
-        len = j;
+        pos += 32;
     }
 
-    p->pos++;
-    json_set_tags(value->tags, JsonTag_Str);
-    value->value.str = str;
+    while(pos < len && str[pos] != '"' && str[pos] != '\\' && (unsigned char)str[pos] >= 0x20)
+        pos++;
 
-    return value;
+    return pos;
 }
 
-ROMANO_FORCE_INLINE bool is_digit(unsigned int c)
+#elif defined(ROMANO_AARCH64)
+
+ROMANO_FORCE_INLINE uint64_t json_movemask_64(uint8x16_t c0, uint8x16_t c1, uint8x16_t c2, uint8x16_t c3)
 {
-    return (c - 48) < 10;
+    const uint8x16_t bits = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                              0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+    uint8x16_t sum0;
+    uint8x16_t sum1;
+
+    sum0 = vpaddq_u8(vandq_u8(c0, bits), vandq_u8(c1, bits));
+    sum1 = vpaddq_u8(vandq_u8(c2, bits), vandq_u8(c3, bits));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
 }
 
-static const double pow10_table[] = {
-    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
-    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
-    1e20, 1e21, 1e22
-};
+ROMANO_FORCE_INLINE void json_classify_block(const char* data, JsonBlock* block)
+{
+    /* Lookup tables indexed by the low nibble, a byte is a whitespace/op if it matches its entry */
+    const uint8x16_t ws_table = { ' ', 100, 100, 100, 17, 100, 113, 2,
+                                  100, '\t', '\n', 112, 100, '\r', 100, 100 };
+    const uint8x16_t op_table = { 0, 0, 0, 0, 0, 0, 0, 0,
+                                  0, 0, ':', '{', ',', '}', 0, 0 };
+    const uint8x16_t low_nibble = vdupq_n_u8(0x0F);
+    /* Or-ing 0x20 maps '[' and ']' to '{' and '}' */
+    const uint8x16_t curly = vdupq_n_u8(0x20);
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
 
-static const uint64_t pow10_int_table[] = {
-    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
-    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
-    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
-    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
-    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
-};
+    uint8x16_t in[4];
+    uint8x16_t ws[4];
+    uint8x16_t op[4];
+    uint8x16_t qt[4];
+    uint8x16_t bs[4];
+    size_t i;
 
-#define POW10_TABLE_SIZE (sizeof(pow10_table) / sizeof(pow10_table[0]))
-#define POW10_INT_TABLE_SIZE (sizeof(pow10_int_table) / sizeof(pow10_int_table[0]))
+    for(i = 0; i < 4; i++)
+    {
+        uint8x16_t nibble;
 
-JsonValue* json_parse_number(JsonParser* p)
+        in[i] = vld1q_u8((const uint8_t*)data + i * 16);
+        nibble = vandq_u8(in[i], low_nibble);
+
+        ws[i] = vceqq_u8(vqtbl1q_u8(ws_table, nibble), in[i]);
+        op[i] = vceqq_u8(vqtbl1q_u8(op_table, nibble), vorrq_u8(in[i], curly));
+        qt[i] = vceqq_u8(in[i], quote);
+        bs[i] = vceqq_u8(in[i], backslash);
+    }
+
+    block->whitespace = json_movemask_64(ws[0], ws[1], ws[2], ws[3]);
+    block->op = json_movemask_64(op[0], op[1], op[2], op[3]);
+    block->quote = json_movemask_64(qt[0], qt[1], qt[2], qt[3]);
+    block->backslash = json_movemask_64(bs[0], bs[1], bs[2], bs[3]);
+}
+
+/*
+ * Returns the position of the first quote, backslash or control character found from pos, or len
+ */
+ROMANO_FORCE_INLINE size_t json_scan_string(const char* str, size_t pos, size_t len)
 {
-    bool is_negative = false;
-    bool is_float = false;
-    int64_t int_val = 0;
-    double float_val = 0.0;
-    double fraction = 0.0;
-    int exponent = 0;
-    bool exp_negative = false;
-    if(p->pos < p->len && p->str[p->pos] == '-')
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x1F);
+
+    while(pos + 16 <= len)
     {
-        is_negative = true;
-        p->pos++;
+        const uint8x16_t v = vld1q_u8((const uint8_t*)str + pos);
+        const uint8x16_t mask = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)),
+                                         vcleq_u8(v, control));
+
+        if(vmaxvq_u8(mask) != 0)
+            break;
+
+        pos += 16;
     }
-    if(p->pos >= p->len || !is_digit(p->str[p->pos]))
-        return NULL;
-    while(p->pos < p->len && is_digit(p->str[p->pos]))
+
+    while(pos < len && str[pos] != '"' && str[pos] != '\\' && (unsigned char)str[pos] >= 0x20)
+        pos++;
+
+    return pos;
+}
+
+#else
+
+#define JSON_CHAR_WHITESPACE 0x1
+#define JSON_CHAR_OP 0x2
+#define JSON_CHAR_QUOTE 0x4
+#define JSON_CHAR_BACKSLASH 0x8
+
+static const uint8_t json_char_class[256] = {
+    [' '] = JSON_CHAR_WHITESPACE,
+    ['\t'] = JSON_CHAR_WHITESPACE,
+    ['\n'] = JSON_CHAR_WHITESPACE,
+    ['\r'] = JSON_CHAR_WHITESPACE,
+    ['{'] = JSON_CHAR_OP,
+    ['}'] = JSON_CHAR_OP,
+    ['['] = JSON_CHAR_OP,
+    [']'] = JSON_CHAR_OP,
+    [':'] = JSON_CHAR_OP,
+    [','] = JSON_CHAR_OP,
+    ['"'] = JSON_CHAR_QUOTE,
+    ['\\'] = JSON_CHAR_BACKSLASH,
+};
+
+void json_classify_block(const char* data, JsonBlock* block)
+{
+    size_t i;
+
+    memset(block, 0, sizeof(JsonBlock));
+
+    for(i = 0; i < JSON_BLOCK_SIZE; i++)
     {
-        int_val = int_val * 10 + (p->str[p->pos] - '0');
-        float_val = float_val * 10 + (p->str[p->pos] - '0');
-        p->pos++;
+        const uint64_t c = (uint64_t)json_char_class[(unsigned char)data[i]];
+
+        block->whitespace |= (c & 0x1) << i;
+        block->op |= ((c >> 1) & 0x1) << i;
+        block->quote |= ((c >> 2) & 0x1) << i;
+        block->backslash |= ((c >> 3) & 0x1) << i;
     }
-    if(p->pos < p->len && p->str[p->pos] == '.')
+}
+
+/*
+ * Returns the position of the first quote, backslash or control character found from pos, or len
+ */
+ROMANO_FORCE_INLINE size_t json_scan_string(const char* str, size_t pos, size_t len)
+{
+    while(pos < len && str[pos] != '"' && str[pos] != '\\' && (unsigned char)str[pos] >= 0x20)
+        pos++;
+
+    return pos;
+}
+
+#endif /* defined(__AVX2__) */
+
+/*
+ * Returns a mask where each bit is set if at least one of the bits in the previous positions is
+ * set an odd number of times (i.e. the bits lying between an opening and a closing quote)
+ */
+ROMANO_FORCE_INLINE uint64_t json_prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+
+    return x;
+}
+
+/*
+ * Returns the mask of the characters escaped by an odd-length sequence of backslashes.
+ * prev_escaped carries over whether the first character of the next block is escaped
+ */
+ROMANO_FORCE_INLINE uint64_t json_find_escaped(uint64_t backslash, uint64_t* prev_escaped)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    uint64_t follows_escape;
+    uint64_t odd_sequence_starts;
+    uint64_t sequences_starting_on_even_bits;
+
+    backslash &= ~(*prev_escaped);
+    follows_escape = (backslash << 1) | *prev_escaped;
+    odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+
+    sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+    *prev_escaped = sequences_starting_on_even_bits < backslash ? 1 : 0;
+
+    return (even_bits ^ (sequences_starting_on_even_bits << 1)) & follows_escape;
+}
+
+/*
+ * Builds the structural index of the given string. indices must be able to hold str_sz entries.
+ * Returns false if the input ends within a string
+ */
+bool json_build_index(const char* str, size_t str_sz, uint32_t* indices, size_t* indices_count)
+{
+    char padded[JSON_BLOCK_SIZE];
+    JsonBlock block;
+    uint64_t prev_escaped;
+    uint64_t prev_in_string;
+    uint64_t prev_scalar;
+    uint64_t quote;
+    uint64_t in_string;
+    uint64_t scalar;
+    uint64_t nonquote_scalar;
+    uint64_t structurals;
+    size_t offset;
+    size_t count;
+
+    prev_escaped = 0;
+    prev_in_string = 0;
+    prev_scalar = 0;
+    count = 0;
+
+    for(offset = 0; offset < str_sz; offset += JSON_BLOCK_SIZE)
     {
-        is_float = true;
-        p->pos++;
-        if (p->pos >= p->len || !is_digit(p->str[p->pos]))
-            return NULL;
-        int frac_digits = 0;
-        uint64_t frac_int = 0;
-        while(p->pos < p->len && is_digit(p->str[p->pos]) && frac_digits < POW10_INT_TABLE_SIZE)
+        if((str_sz - offset) >= JSON_BLOCK_SIZE)
         {
-            frac_int = frac_int * 10 + (p->str[p->pos] - '0');
-            frac_digits++;
-            p->pos++;
+            json_classify_block(str + offset, &block);
         }
-        while(p->pos < p->len && is_digit(p->str[p->pos]))
-            p->pos++;
-        if(frac_digits > 0 && frac_digits < POW10_TABLE_SIZE)
-            fraction = (double)frac_int / pow10_table[frac_digits];
-        else if(frac_digits > 0)
-            fraction = (double)frac_int / pow(10.0, frac_digits);
-        float_val += fraction;
-    }
-    if(p->pos < p->len && (p->str[p->pos] == 'e' || p->str[p->pos] == 'E'))
-    {
-        is_float = true;
-        p->pos++;
-        if(p->pos < p->len && p->str[p->pos] == '-')
+        else
         {
-            exp_negative = true;
-            p->pos++;
+            memset(padded, ' ', JSON_BLOCK_SIZE);
+            memcpy(padded, str + offset, str_sz - offset);
+            json_classify_block(padded, &block);
         }
-        else if(p->pos < p->len && p->str[p->pos] == '+')
+
+        quote = block.quote & ~json_find_escaped(block.backslash, &prev_escaped);
+
+        /* Opening quotes are part of in_string, closing quotes are not */
+        in_string = json_prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        scalar = ~(block.op | block.whitespace);
+        nonquote_scalar = scalar & ~quote;
+
+        structurals = block.op | (scalar & ~((nonquote_scalar << 1) | prev_scalar));
+        structurals &= ~(in_string ^ quote);
+
+        prev_scalar = nonquote_scalar >> 63;
+
+        while(structurals != 0)
         {
-            p->pos++;
+            indices[count++] = (uint32_t)(offset + ctz_u64(structurals));
+            structurals &= structurals - 1;
         }
-        if(p->pos >= p->len || !is_digit(p->str[p->pos]))
-            return NULL;
-        while(p->pos < p->len && is_digit(p->str[p->pos]))
+    }
+
+    *indices_count = count;
+
+    return prev_in_string == 0;
+}
+
+typedef struct JsonParser {
+    const char* str;
+    size_t pos;
+    size_t len;
+    const uint32_t* indices;
+    size_t indices_count;
+    size_t current_index;
+    JsonValue** stack;
+    size_t stack_size;
+    size_t stack_capacity;
+    Json* json;
+    /* Strings are decoded in the input buffer and point into it */
+    bool insitu;
+} JsonParser;
+
+JsonValue* json_parse_value(JsonParser* p);
+
+/*
+ * Moves to the next indexed position and returns its character, or '\0' when the index is exhausted
+ */
+ROMANO_FORCE_INLINE char json_next_structural(JsonParser* p)
+{
+    if(p->current_index >= p->indices_count)
+    {
+        p->pos = p->len;
+        return '\0';
+    }
+
+    p->pos = p->indices[p->current_index++];
+
+    return p->str[p->pos];
+}
+
+/*
+ * Array elements are accumulated on the parser stack, and copied once the array is closed
+ */
+ROMANO_FORCE_INLINE bool json_parser_push(JsonParser* p, JsonValue* value)
+{
+    JsonValue** new_stack;
+
+    if(p->stack_size == p->stack_capacity)
+    {
+        new_stack = (JsonValue**)realloc(p->stack, p->stack_capacity * 2 * sizeof(JsonValue*));
+
+        if(new_stack == NULL)
         {
-            exponent = exponent * 10 + (p->str[p->pos] - '0');
-            p->pos++;
+            g_current_error = ErrorCode_MemAllocError;
+            return false;
         }
+
+        p->stack = new_stack;
+        p->stack_capacity *= 2;
     }
-    if(is_float)
+
+    p->stack[p->stack_size++] = value;
+
+    return true;
+}
+
+ROMANO_FORCE_INLINE char json_peek_structural(JsonParser* p)
+{
+    if(p->current_index >= p->indices_count)
+        return '\0';
+
+    return p->str[p->indices[p->current_index]];
+}
+
+/*
+ * Scalars are not delimited in the index, so a scalar must be followed by the end of the input, a
+ * whitespace or an op to be valid
+ */
+ROMANO_FORCE_INLINE bool json_is_scalar_end(JsonParser* p)
+{
+    if(p->pos >= p->len)
+        return true;
+
+    switch(p->str[p->pos])
     {
-        if(exp_negative)
-            exponent = -exponent;
-        if(exponent >= -(int)POW10_TABLE_SIZE && exponent < (int)POW10_TABLE_SIZE)
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case ',':
+        case ':':
+        case ']':
+        case '}':
+        case '[':
+        case '{':
+            return true;
+        default:
+            g_current_error = ErrorCode_JsonUnexpectedCharacter;
+            return false;
+    }
+}
+
+ROMANO_FORCE_INLINE bool json_is_hex_digit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/*
+ * Parses the string starting at the current position. The string is copied to the string arena,
+ * or decoded in the input buffer itself when parsing in-situ
+ */
+bool json_parse_string_raw(JsonParser* p, const char** out_str, size_t* out_sz)
+{
+    char* str;
+    size_t start;
+    size_t len;
+    bool has_escape;
+
+    if(p->pos >= p->len || p->str[p->pos] != '"')
+        return false;
+
+    p->pos++;
+
+    start = p->pos;
+    has_escape = false;
+
+    while(true)
+    {
+        p->pos = json_scan_string(p->str, p->pos, p->len);
+
+        if(p->pos >= p->len)
+            return false;
+
+        if(p->str[p->pos] == '"')
+            break;
+
+        if(p->str[p->pos] != '\\')
         {
-            if(exponent >= 0)
-                float_val *= pow10_table[exponent];
-            else
-                float_val /= pow10_table[-exponent];
+            g_current_error = ErrorCode_JsonUnexpectedCharacter;
+            return false;
         }
-        else
+
+        has_escape = true;
+
+        if(p->pos + 1 >= p->len)
+            return false;
+
+        switch(p->str[p->pos + 1])
         {
-            float_val *= pow(10.0, exponent);
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                p->pos += 2;
+                break;
+            case 'u':
+                if(p->pos + 6 > p->len ||
+                   !json_is_hex_digit(p->str[p->pos + 2]) ||
+                   !json_is_hex_digit(p->str[p->pos + 3]) ||
+                   !json_is_hex_digit(p->str[p->pos + 4]) ||
+                   !json_is_hex_digit(p->str[p->pos + 5]))
+                {
+                    g_current_error = ErrorCode_JsonUnexpectedCharacter;
+                    return false;
+                }
+
+                p->pos += 6;
+                break;
+            default:
+                g_current_error = ErrorCode_JsonUnexpectedCharacter;
+                return false;
         }
-        if(is_negative)
-            float_val = -float_val;
-        return json_f64_new(p->json, float_val);
     }
+
+    len = p->pos - start;
+
+    /* In-situ, the closing quote leaves room for the null terminator */
+    if(p->insitu)
+        str = (char*)p->str + start;
     else
+        str = arena_push(&p->json->string_arena, NULL, len + 1);
+
+    if(!has_escape)
     {
-        if(is_negative)
-        {
-            return json_i64_new(p->json, -int_val);
-        }
-        else
-        {
-            return json_u64_new(p->json, (uint64_t)int_val);
-        }
+        if(!p->insitu)
+            memcpy(str, p->str + start, len);
+
+        str[len] = '\0';
+    }
+    else if(!json_unescape(str, p->str + start, len, &len))
+    {
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        return false;
+    }
+
+    p->pos++;
+
+    *out_str = str;
+    *out_sz = len;
+
+    return true;
+}
+
+JsonValue* json_parse_string(JsonParser* p)
+{
+    JsonValue* value;
+    const char* str;
+    size_t len;
+
+    if(!json_parse_string_raw(p, &str, &len))
+        return NULL;
+
+    value = arena_push(&p->json->value_arena, NULL, sizeof(JsonValue));
+    value->tags = 0;
+    json_set_tags(value->tags, JsonTag_Str);
+    json_set_sz(value->tags, len);
+    value->value.str = str;
+
+    return value;
+}
+
+
+ROMANO_FORCE_INLINE bool is_digit(unsigned int c)
+{
+    return (c - 48) < 10;
+}
+
+JsonValue* json_parse_number(JsonParser* p)
+{
+    ParsedNumber number;
+    size_t number_sz;
+
+    if(!parse_number(p->str + p->pos, p->len - p->pos, ParseFlags_Json, &number, &number_sz))
+        return NULL;
+
+    p->pos += number_sz;
+
+    switch(number.type)
+    {
+        case ParsedNumberType_U64:
+            return json_u64_new(p->json, number.value.u64);
+        case ParsedNumberType_I64:
+            return json_i64_new(p->json, number.value.i64);
+        default:
+            return json_f64_new(p->json, number.value.f64);
     }
 }
 
@@ -844,47 +1559,43 @@ JsonValue* json_parse_array(JsonParser* p)
     if(p->pos >= p->len || p->str[p->pos] != '[')
         return NULL;
 
-    p->pos++;
-
     JsonValue* array = json_array_new(p->json);
-    json_skip_whitespace(p);
 
-    if(p->pos < p->len && p->str[p->pos] == ']')
+    if(json_peek_structural(p) == ']')
     {
-        p->pos++;
+        json_next_structural(p);
         return array;
     }
 
-    while(p->pos < p->len)
+    size_t stack_start = p->stack_size;
+
+    while(true)
     {
         JsonValue* element = json_parse_value(p);
 
-        if(element == NULL)
+        if(element == NULL || !json_parser_push(p, element))
             return NULL;
 
-        json_array_append(p->json, array, element, true);
-        json_skip_whitespace(p);
-
-        if(p->pos >= p->len)
-            return NULL;
+        char c = json_next_structural(p);
 
-        if(p->str[p->pos] == ',')
-        {
-            p->pos++;
-            json_skip_whitespace(p);
-        }
-        else if (p->str[p->pos] == ']')
-        {
-            p->pos++;
-            return array;
-        }
-        else
+        if(c == ']')
+            break;
+        else if(c != ',')
         {
+            g_current_error = ErrorCode_JsonUnexpectedCharacter;
             return NULL;
         }
     }
 
-    return NULL;
+    if(!json_array_set_values(p->json,
+                              array,
+                              p->stack + stack_start,
+                              p->stack_size - stack_start))
+        return NULL;
+
+    p->stack_size = stack_start;
+
+    return array;
 }
 
 JsonValue* parse_dict(JsonParser* p)
@@ -892,73 +1603,52 @@ JsonValue* parse_dict(JsonParser* p)
     if(p->pos >= p->len || p->str[p->pos] != '{')
         return NULL;
 
-    p->pos++;
-
     JsonValue* dict = json_dict_new(p->json, NULL);
-    json_skip_whitespace(p);
 
-    if(p->pos < p->len && p->str[p->pos] == '}')
+    if(json_peek_structural(p) == '}')
     {
-        p->pos++;
+        json_next_structural(p);
         return dict;
     }
 
-    while(p->pos < p->len)
+    while(true)
     {
-        json_skip_whitespace(p);
-
-        if(p->pos >= p->len || p->str[p->pos] != '"')
+        if(json_next_structural(p) != '"')
         {
             g_current_error = ErrorCode_JsonExpectedKey;
             return NULL;
         }
 
-        JsonValue* key_val = json_parse_string(p);
+        const char* key;
+        size_t key_sz;
 
-        if(key_val == NULL)
+        /* Keys are already copied to the string arena (or live in the input in-situ) */
+        if(!json_parse_string_raw(p, &key, &key_sz))
             return NULL;
 
-        const char* key = json_str_get(key_val);
-
-        json_skip_whitespace(p);
-
-        if(p->pos >= p->len || p->str[p->pos] != ':')
+        if(json_next_structural(p) != ':')
         {
             g_current_error = ErrorCode_JsonExpectedColon;
             return NULL;
         }
 
-        p->pos++;
-        json_skip_whitespace(p);
-
         JsonValue* value = json_parse_value(p);
 
         if(value == NULL)
             return NULL;
 
-        json_dict_append(p->json, dict, key, value, true);
-        json_skip_whitespace(p);
+        json_dict_append_no_copy(p->json, dict, key, value);
 
-        if(p->pos >= p->len)
-            return NULL;
+        char c = json_next_structural(p);
 
-        if(p->str[p->pos] == ',')
-        {
-            p->pos++;
-            json_skip_whitespace(p);
-        }
-        else if(p->str[p->pos] == '}')
-        {
-            p->pos++;
+        if(c == '}')
             return dict;
-        }
-        else
+        else if(c != ',')
         {
+            g_current_error = ErrorCode_JsonUnexpectedCharacter;
             return NULL;
         }
     }
-
-    return NULL;
 }
 
 JsonValue* json_parse_literal(JsonParser* p)
@@ -986,12 +1676,10 @@ JsonValue* json_parse_literal(JsonParser* p)
 
 JsonValue* json_parse_value(JsonParser* p)
 {
-    json_skip_whitespace(p);
-
-    if(p->pos >= p->len)
-        return NULL;
+    JsonValue* value;
+    char c;
 
-    char c = p->str[p->pos];
+    c = json_next_structural(p);
 
     if(c == '"')
         return json_parse_string(p);
@@ -999,459 +1687,634 @@ JsonValue* json_parse_value(JsonParser* p)
         return parse_dict(p);
     else if (c == '[')
         return json_parse_array(p);
-    else if (c == '-' || isdigit(c))
-        return json_parse_number(p);
+    else if (c == '-' || is_digit((unsigned char)c))
+        value = json_parse_number(p);
     else if (c == 't' || c == 'f' || c == 'n')
-        return json_parse_literal(p);
+        value = json_parse_literal(p);
+    else
+        return NULL;
 
-    return NULL;
+    if(value == NULL || !json_is_scalar_end(p))
+        return NULL;
+
+    return value;
 }
 
-Json* json_parse(const char* str, size_t str_sz)
+static bool json_parse_root(Json* json, const char* str, size_t str_sz, bool insitu)
 {
     if(str == NULL || str_sz == 0)
-        return NULL;
+        return false;
 
-    Json* json = json_new();
+    /* Positions are stored on 32 bits, which keeps the index half the size of 64 bits offsets */
+    if(str_sz > (size_t)UINT32_MAX)
+    {
+        g_current_error = ErrorCode_SizeOverflow;
+        return false;
+    }
 
-    if(json == NULL)
-        return NULL;
+    /* The scratch buffers are kept in the document and only grow */
+    if(json->indices_capacity < str_sz)
+    {
+        free(json->indices);
+
+        json->indices = (uint32_t*)malloc(str_sz * sizeof(uint32_t));
+        json->indices_capacity = json->indices != NULL ? str_sz : 0;
+
+        if(json->indices == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            return false;
+        }
+    }
+
+    if(json->stack == NULL)
+    {
+        json->stack = (JsonValue**)malloc(1024 * sizeof(JsonValue*));
+
+        if(json->stack == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            return false;
+        }
+
+        json->stack_capacity = 1024;
+    }
+
+    size_t indices_count;
+
+    if(!json_build_index(str, str_sz, json->indices, &indices_count))
+    {
+        g_current_error = ErrorCode_JsonUnterminatedString;
+        return false;
+    }
 
     JsonParser parser;
     parser.str = str;
     parser.pos = 0;
     parser.len = str_sz;
+    parser.indices = json->indices;
+    parser.indices_count = indices_count;
+    parser.current_index = 0;
+    parser.stack_size = 0;
+    parser.stack_capacity = json->stack_capacity;
+    parser.stack = json->stack;
     parser.json = json;
+    parser.insitu = insitu;
 
     JsonValue* root = json_parse_value(&parser);
 
+    /* The stack may have grown */
+    json->stack = parser.stack;
+    json->stack_capacity = parser.stack_capacity;
+
     if(!root)
+        return false;
+
+    if(parser.current_index != parser.indices_count)
     {
-        json_free(json);
-        return NULL;
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        return false;
     }
 
-    json_skip_whitespace(&parser);
+    json_set_root(json, root);
 
-    if(parser.pos != parser.len)
+    return true;
+}
+
+bool json_parse_into(Json* json, const char* str, size_t str_sz)
+{
+    return json_parse_root(json, str, str_sz, false);
+}
+
+bool json_parse_insitu_into(Json* json, char* str, size_t str_sz)
+{
+    return json_parse_root(json, str, str_sz, true);
+}
+
+/*
+ * Releases the parser scratch buffers of documents parsed once
+ */
+static void json_release_scratch(Json* json)
+{
+    free(json->indices);
+    free(json->stack);
+
+    json->indices = NULL;
+    json->indices_capacity = 0;
+    json->stack = NULL;
+    json->stack_capacity = 0;
+}
+
+Json* json_parse(const char* str, size_t str_sz)
+{
+    if(str == NULL || str_sz == 0)
+        return NULL;
+
+    Json* json = json_new();
+
+    if(json == NULL)
+        return NULL;
+
+    if(!json_parse_into(json, str, str_sz))
     {
         json_free(json);
         return NULL;
     }
 
-    json_set_root(json, root);
+    json_release_scratch(json);
 
     return json;
 }
 
-/***************/
-/* Json writer */
-/***************/
+/********************/
+/* On-demand parser */
+/********************/
+
+#define JSON_ONDEMAND_NO_JUMP UINT32_MAX
+
+struct JsonOnDemand {
+    /* Parser over the whole input, positioned on a cursor to materialize its value */
+    JsonParser parser;
+    uint32_t* indices;
+
+    /* For each opening bracket, the index of its closing bracket */
+    uint32_t* jumps;
 
-typedef struct JsonWriter {
+    /* Holds the materialized values and the decoded keys */
     Json* json;
-    char* str;
-    size_t str_capacity;
-    size_t str_sz;
-    size_t indent_size;
-    size_t indent;
-} JsonWriter;
 
-bool json_write_realloc(JsonWriter* writer, size_t needed_size)
+    /* Escaped keys are decoded here to be compared */
+    char* key_buffer;
+    size_t key_buffer_capacity;
+};
+
+ROMANO_FORCE_INLINE char json_ondemand_char(const JsonOnDemand* doc, size_t index)
 {
-    char* new_str;
-    size_t total_needed_size;
-    size_t new_capacity;
+    if(index >= doc->parser.indices_count)
+        return '\0';
+
+    return doc->parser.str[doc->indices[index]];
+}
 
-    total_needed_size = writer->str_sz + needed_size;
-    new_capacity = writer->str_capacity;
+/* Returns the index following the value at the given index, containers are skipped at once */
+ROMANO_FORCE_INLINE size_t json_ondemand_skip(const JsonOnDemand* doc, size_t index)
+{
+    const char c = json_ondemand_char(doc, index);
+
+    if(c == '{' || c == '[')
+        return (size_t)doc->jumps[index] + 1;
+
+    return index + 1;
+}
+
+/*
+ * Matches the brackets of the index. While a bracket is open, its jump entry links to the previously
+ * open bracket, so the jumps array doubles as the stack. Returns false on unbalanced brackets
+ */
+static bool json_ondemand_build_jumps(JsonOnDemand* doc)
+{
+    uint32_t top = JSON_ONDEMAND_NO_JUMP;
+    size_t i;
+
+    for(i = 0; i < doc->parser.indices_count; i++)
+    {
+        const char c = json_ondemand_char(doc, i);
+
+        if(c == '{' || c == '[')
+        {
+            doc->jumps[i] = top;
+            top = (uint32_t)i;
+        }
+        else if(c == '}' || c == ']')
+        {
+            if(top == JSON_ONDEMAND_NO_JUMP || json_ondemand_char(doc, top) != (c == '}' ? '{' : '['))
+                return false;
+
+            const uint32_t open = top;
+
+            top = doc->jumps[open];
+            doc->jumps[open] = (uint32_t)i;
+        }
+    }
+
+    return top == JSON_ONDEMAND_NO_JUMP;
+}
+
+JsonOnDemand* json_ondemand_new(const char* str, size_t str_sz)
+{
+    JsonOnDemand* doc;
+    size_t indices_count;
+
+    if(str == NULL || str_sz == 0)
+        return NULL;
+
+    if(str_sz > (size_t)UINT32_MAX)
+    {
+        g_current_error = ErrorCode_SizeOverflow;
+        return NULL;
+    }
+
+    doc = (JsonOnDemand*)calloc(1, sizeof(JsonOnDemand));
+
+    if(doc == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    doc->indices = (uint32_t*)malloc(str_sz * sizeof(uint32_t));
+    doc->parser.stack_capacity = 1024;
+    doc->parser.stack = (JsonValue**)malloc(doc->parser.stack_capacity * sizeof(JsonValue*));
+    doc->json = json_new();
+
+    if(doc->indices == NULL || doc->parser.stack == NULL || doc->json == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        json_ondemand_free(doc);
+        return NULL;
+    }
 
-    if(total_needed_size < new_capacity)
-        return true;
+    if(!json_build_index(str, str_sz, doc->indices, &indices_count))
+    {
+        g_current_error = ErrorCode_JsonUnterminatedString;
+        json_ondemand_free(doc);
+        return NULL;
+    }
 
-    while(total_needed_size >= new_capacity)
-        new_capacity <<= 1;
+    doc->parser.str = str;
+    doc->parser.len = str_sz;
+    doc->parser.indices = doc->indices;
+    doc->parser.indices_count = indices_count;
+    doc->parser.json = doc->json;
+    doc->parser.insitu = false;
 
-    new_str = realloc(writer->str, new_capacity * sizeof(char));
+    doc->jumps = (uint32_t*)malloc((indices_count + 1) * sizeof(uint32_t));
 
-    if(new_str == NULL)
+    if(doc->jumps == NULL)
     {
         g_current_error = ErrorCode_MemAllocError;
-        return false;
+        json_ondemand_free(doc);
+        return NULL;
     }
 
-    writer->str = new_str;
-    writer->str_capacity = new_capacity;
+    /* A single top-level value spanning the whole index */
+    if(indices_count == 0 ||
+       !json_ondemand_build_jumps(doc) ||
+       json_ondemand_skip(doc, 0) != indices_count)
+    {
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        json_ondemand_free(doc);
+        return NULL;
+    }
 
-    return true;
+    return doc;
 }
 
-ROMANO_FORCE_INLINE bool json_write_char(JsonWriter* writer, char c)
+bool json_ondemand_get_root(JsonOnDemand* doc, JsonCursor* root)
 {
-    if(!json_write_realloc(writer, 1))
+    if(doc->parser.indices_count == 0)
         return false;
 
-    writer->str[writer->str_sz++] = c;
+    root->doc = doc;
+    root->index = 0;
 
     return true;
 }
 
-ROMANO_FORCE_INLINE bool json_write_indent(JsonWriter* writer)
+void json_ondemand_free(JsonOnDemand* doc)
 {
-    if(!json_write_realloc(writer, writer->indent))
-        return false;
-
-    memset(writer->str + writer->str_sz, ' ', writer->indent * sizeof(char));
-    writer->str_sz += writer->indent;
+    if(doc->json != NULL)
+        json_free(doc->json);
 
-    return true;
+    free(doc->parser.stack);
+    free(doc->indices);
+    free(doc->jumps);
+    free(doc->key_buffer);
+    free(doc);
 }
 
-bool json_write_value(JsonWriter* writer, JsonValue* value);
-
-bool json_write_str(JsonWriter* writer, const char* str);
-
-bool json_write_array(JsonWriter* writer, JsonValue* array)
+JsonCursorType json_cursor_get_type(const JsonCursor* cursor)
 {
-    JsonArrayIterator iterator;
-    JsonValue* array_element;
-    size_t i;
-
-    memset(&iterator, 0, sizeof(JsonArrayIterator));
-
-    if(!json_write_char(writer, '['))
-        return false;
-
-    if(writer->indent_size > 0)
+    switch(json_ondemand_char(cursor->doc, cursor->index))
     {
-        writer->indent += writer->indent_size;
+        case '{':
+            return JsonCursorType_Dict;
+        case '[':
+            return JsonCursorType_Array;
+        case '"':
+            return JsonCursorType_Str;
+        case 't':
+        case 'f':
+            return JsonCursorType_Bool;
+        case 'n':
+            return JsonCursorType_Null;
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return JsonCursorType_Number;
+        default:
+            return JsonCursorType_Invalid;
     }
+}
 
-    i = 0;
+/*
+ * Returns the raw (still escaped) key at the given index, the key being followed by a colon.
+ * Only whitespaces can be found between the closing quote and the colon
+ */
+static const char* json_ondemand_raw_key(const JsonOnDemand* doc, size_t index, size_t* raw_sz)
+{
+    const char* str = doc->parser.str;
+    size_t start = (size_t)doc->indices[index] + 1;
+    size_t end = (size_t)doc->indices[index + 1];
 
-    while((array_element = json_array_get_next(writer->json, array, &iterator)) != NULL)
-    {
-        if(i > 0)
-        {
-            if(!json_write_char(writer, ','))
-                return false;
-        }
+    while(end > start && str[end - 1] != '"')
+        end--;
 
-        if(writer->indent_size > 0)
-        {
-            if(!json_write_char(writer, '\n'))
-                return false;
+    *raw_sz = end > start ? end - 1 - start : 0;
 
-            if(!json_write_indent(writer))
-                return false;
-        }
+    return str + start;
+}
 
-        if(!json_write_value(writer, array_element))
-            return false;
+static bool json_ondemand_key_equals(JsonOnDemand* doc, size_t index, const char* key, size_t key_sz)
+{
+    const char* raw;
+    size_t raw_sz;
+    size_t decoded_sz;
 
-        i++;
-    }
+    raw = json_ondemand_raw_key(doc, index, &raw_sz);
 
-    if(writer->indent_size > 0)
-    {
-        if(!json_write_char(writer, '\n'))
-            return false;
+    /* The raw key can only be compared as is when it has no escapes */
+    if(memchr(raw, '\\', raw_sz) == NULL)
+        return raw_sz == key_sz && memcmp(raw, key, key_sz) == 0;
+
+    /* An escaped key is never shorter than its decoded form */
+    if(raw_sz < key_sz)
+        return false;
 
-        writer->indent -= writer->indent_size;
+    if(doc->key_buffer_capacity < raw_sz + 1)
+    {
+        char* new_buffer = (char*)realloc(doc->key_buffer, raw_sz + 1);
 
-        if(!json_write_indent(writer))
+        if(new_buffer == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
             return false;
+        }
+
+        doc->key_buffer = new_buffer;
+        doc->key_buffer_capacity = raw_sz + 1;
     }
 
-    if(!json_write_char(writer, ']'))
+    if(!json_unescape(doc->key_buffer, raw, raw_sz, &decoded_sz))
         return false;
 
-    return true;
+    return decoded_sz == key_sz && memcmp(doc->key_buffer, key, key_sz) == 0;
 }
 
-bool json_write_dict(JsonWriter* writer, JsonValue* dict)
+ROMANO_FORCE_INLINE bool json_ondemand_is_field(const JsonOnDemand* doc, size_t index)
 {
-    JsonDictIterator iterator;
-    JsonKeyValue* dict_element;
-    size_t i;
+    return json_ondemand_char(doc, index) == '"' && json_ondemand_char(doc, index + 1) == ':';
+}
 
-    memset(&iterator, 0, sizeof(JsonDictIterator));
+bool json_cursor_find_field(const JsonCursor* dict, const char* key, JsonCursor* value)
+{
+    JsonOnDemand* doc = dict->doc;
+    size_t key_sz;
+    size_t index;
 
-    if(!json_write_char(writer, '{'))
+    if(json_ondemand_char(doc, dict->index) != '{')
         return false;
 
-    if(writer->indent_size > 0)
-    {
-        writer->indent += writer->indent_size;
-    }
-
-    i = 0;
+    key_sz = strlen(key);
+    index = dict->index + 1;
 
-    while((dict_element = json_dict_get_next(writer->json, dict, &iterator)) != NULL)
+    while(json_ondemand_is_field(doc, index))
     {
-        if(i > 0)
-        {
-            if(!json_write_char(writer, ','))
-                return false;
-        }
-
-        if(writer->indent_size > 0)
+        if(json_ondemand_key_equals(doc, index, key, key_sz))
         {
-            if(!json_write_char(writer, '\n'))
-                return false;
-
-            if(!json_write_indent(writer))
-                return false;
+            value->doc = doc;
+            value->index = index + 2;
+            return true;
         }
 
-        if(!json_write_str(writer, dict_element->key))
-            return false;
+        index = json_ondemand_skip(doc, index + 2);
 
-        if(!json_write_char(writer, ':'))
-            return false;
+        if(json_ondemand_char(doc, index) != ',')
+            break;
 
-        if(!json_write_char(writer, ' '))
-            return false;
+        index++;
+    }
 
-        if(!json_write_value(writer, dict_element->value))
-            return false;
+    return false;
+}
 
-        i++;
-    }
+bool json_cursor_first_element(const JsonCursor* container, JsonCursor* element)
+{
+    JsonOnDemand* doc = container->doc;
+    const size_t index = container->index + 1;
 
-    if(writer->indent_size > 0)
+    switch(json_ondemand_char(doc, container->index))
     {
-        if(!json_write_char(writer, '\n'))
-            return false;
+        case '[':
+            if(json_ondemand_char(doc, index) == ']')
+                return false;
 
-        writer->indent -= writer->indent_size;
+            element->index = index;
+            break;
+        case '{':
+            if(!json_ondemand_is_field(doc, index))
+                return false;
 
-        if(!json_write_indent(writer))
+            element->index = index + 2;
+            break;
+        default:
             return false;
     }
 
-    if(!json_write_char(writer, '}'))
-        return false;
+    element->doc = doc;
 
     return true;
 }
 
-bool json_write_literal(JsonWriter* writer, const char* lit, size_t lit_sz)
+bool json_cursor_next_element(JsonCursor* element)
 {
-    if(!json_write_realloc(writer, lit_sz))
+    JsonOnDemand* doc = element->doc;
+    size_t index;
+
+    if(element->index == 0)
         return false;
 
-    memcpy(writer->str + writer->str_sz, lit, lit_sz);
+    index = json_ondemand_skip(doc, element->index);
+
+    if(json_ondemand_char(doc, index) != ',')
+        return false;
+
+    index++;
+
+    /* Dict values follow a colon, array elements follow a bracket or a comma */
+    if(json_ondemand_char(doc, element->index - 1) == ':')
+    {
+        if(!json_ondemand_is_field(doc, index))
+            return false;
+
+        index += 2;
+    }
 
-    writer->str_sz += lit_sz;
+    element->index = index;
 
     return true;
 }
 
-bool json_write_u64(JsonWriter* writer, uint64_t u64)
+const char* json_cursor_get_key(const JsonCursor* value, size_t* key_sz)
 {
-    int buffer_sz;
+    JsonOnDemand* doc = value->doc;
+    const char* raw;
+    size_t raw_sz;
+    size_t decoded_sz;
+    char* key;
 
-    buffer_sz = fmt_size_u64(u64);
+    if(value->index < 2 || json_ondemand_char(doc, value->index - 1) != ':')
+        return NULL;
+
+    raw = json_ondemand_raw_key(doc, value->index - 2, &raw_sz);
+    key = (char*)arena_push(&doc->json->string_arena, NULL, raw_sz + 1);
 
-    if(buffer_sz < 0)
+    if(!json_unescape(key, raw, raw_sz, &decoded_sz))
     {
-        g_current_error = ErrorCode_FormattingError;
-        return false;
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        return NULL;
     }
 
-    if(!json_write_realloc(writer, (size_t)buffer_sz))
-        return false;
-
-    fmt_u64(writer->str + writer->str_sz, u64);
+    if(key_sz != NULL)
+        *key_sz = decoded_sz;
 
-    writer->str_sz += buffer_sz;
-
-    return true;
+    return key;
 }
 
-bool json_write_i64(JsonWriter* writer, int64_t i64)
+size_t json_cursor_get_size(const JsonCursor* container)
 {
-    int buffer_sz;
+    JsonCursor element;
+    size_t size;
 
-    buffer_sz = fmt_size_i64(i64);
+    if(!json_cursor_first_element(container, &element))
+        return 0;
 
-    if(buffer_sz < 0)
-    {
-        g_current_error = ErrorCode_FormattingError;
-        return false;
-    }
+    size = 1;
 
-    if(!json_write_realloc(writer, (size_t)buffer_sz))
-        return false;
+    while(json_cursor_next_element(&element))
+        size++;
 
-    fmt_i64(writer->str + writer->str_sz, i64);
+    return size;
+}
 
-    writer->str_sz += buffer_sz;
+JsonValue* json_cursor_get_value(const JsonCursor* cursor)
+{
+    JsonParser* p = &cursor->doc->parser;
 
-    return true;
+    if(cursor->index >= p->indices_count)
+        return NULL;
+
+    p->current_index = cursor->index;
+    p->pos = 0;
+    p->stack_size = 0;
+
+    return json_parse_value(p);
 }
 
-bool json_write_f64(JsonWriter* writer, double f64)
+bool json_cursor_get_bool(const JsonCursor* cursor, bool* b)
 {
-    int buffer_sz;
-
-    buffer_sz = fmt_size_f64(f64, 3);
+    JsonValue* value;
 
-    if(buffer_sz < 0)
-    {
-        g_current_error = ErrorCode_FormattingError;
+    if(json_cursor_get_type(cursor) != JsonCursorType_Bool)
         return false;
-    }
 
-    if(!json_write_realloc(writer, (size_t)buffer_sz))
-        return false;
+    value = json_cursor_get_value(cursor);
 
-    fmt_f64(writer->str + writer->str_sz, f64, 3);
+    if(value == NULL)
+        return false;
 
-    writer->str_sz += buffer_sz;
+    *b = json_bool_get(value);
 
     return true;
 }
 
-ROMANO_FORCE_INLINE bool json_char_is_escaped(char c)
-{
-    switch(c)
-    {
-        case '\'':
-        case '\"':
-        case '\\':
-        case '\n':
-        case '\r':
-        case '\t':
-        case '\b':
-        case '\f':
-        case '\v':
-            return true;
-        default:
-            return false;
-    }
-}
-
-ROMANO_FORCE_INLINE char json_escaped_to_char(char c)
+bool json_cursor_get_u64(const JsonCursor* cursor, uint64_t* u64)
 {
-    switch(c)
-    {
-        case '\'': return 0x27;
-        case '\"': return '"';
-        case '\\': return '\\';
-        case '\n': return 'n';
-        case '\r': return 'r';
-        case '\t': return 't';
-        case '\b': return 'b';
-        case '\f': return 'f';
-        case '\v': return 'v';
-        default: return c;
-    }
-}
-
-bool json_write_str(JsonWriter* writer, const char* str)
-{
-    size_t str_sz;
-    size_t i;
-
-    str_sz = 0;
-    i = 0;
+    JsonValue* value;
 
-    while(str[i] != '\0')
-    {
-        if(json_char_is_escaped(str[i]))
-            str_sz += 2;
+    if(json_cursor_get_type(cursor) != JsonCursorType_Number)
+        return false;
 
-        str_sz++;
-        i++;
-    }
+    value = json_cursor_get_value(cursor);
 
-    if(!json_write_realloc(writer, str_sz + 2))
+    if(value == NULL || !json_is_u64(value))
         return false;
 
-    i = 0;
+    *u64 = json_u64_get(value);
+
+    return true;
+}
 
-    writer->str[writer->str_sz++] = '"';
+bool json_cursor_get_i64(const JsonCursor* cursor, int64_t* i64)
+{
+    JsonValue* value;
 
-    while(str[i] != '\0')
-    {
-        if(json_char_is_escaped(str[i]))
-        {
-            if(str[i] != '\'')
-                writer->str[writer->str_sz++] = '\\';
+    if(json_cursor_get_type(cursor) != JsonCursorType_Number)
+        return false;
 
-            writer->str[writer->str_sz++] = json_escaped_to_char(str[i]);
-        }
-        else
-        {
-            writer->str[writer->str_sz++] = str[i];
-        }
+    value = json_cursor_get_value(cursor);
 
-        i++;
-    }
+    if(value == NULL)
+        return false;
 
-    writer->str[writer->str_sz++] = '"';
+    if(json_is_i64(value))
+        *i64 = json_i64_get(value);
+    else if(json_is_u64(value) && json_u64_get(value) <= (uint64_t)INT64_MAX)
+        *i64 = (int64_t)json_u64_get(value);
+    else
+        return false;
 
     return true;
 }
 
-bool json_write_value(JsonWriter* writer, JsonValue* value)
+bool json_cursor_get_f64(const JsonCursor* cursor, double* f64)
 {
-    size_t tag;
+    JsonValue* value;
+
+    if(json_cursor_get_type(cursor) != JsonCursorType_Number)
+        return false;
 
-    tag = value->tags & JSON_TAGS_MASK;
+    value = json_cursor_get_value(cursor);
 
-    switch(tag)
-    {
-        case JsonTag_Null:
-            return json_write_literal(writer, "null", 4);
-        case JsonTag_Bool:
-            if(value->value.b)
-                return json_write_literal(writer, "true", 4);
-            else
-                return json_write_literal(writer, "false", 5);
-        case JsonTag_U64:
-            return json_write_u64(writer, value->value.u64);
-        case JsonTag_I64:
-            return json_write_i64(writer, value->value.i64);
-        case JsonTag_F64:
-            return json_write_f64(writer, value->value.f64);
-        case JsonTag_Str:
-            return json_write_str(writer, value->value.str);
-        case JsonTag_Array:
-            return json_write_array(writer, value);
-        case JsonTag_Dict:
-            return json_write_dict(writer, value);
-    }
+    if(value == NULL)
+        return false;
 
-    return false;
+    if(json_is_f64(value))
+        *f64 = json_f64_get(value);
+    else if(json_is_u64(value))
+        *f64 = (double)json_u64_get(value);
+    else
+        *f64 = (double)json_i64_get(value);
+
+    return true;
 }
 
-char* json_write(Json* json, size_t indent_size, size_t* written_size)
+const char* json_cursor_get_str(const JsonCursor* cursor, size_t* str_sz)
 {
-    JsonWriter writer;
-
-    writer.json = json;
-    writer.indent = 0;
-    writer.indent_size = indent_size;
-    writer.str_capacity = 4096;
-    writer.str_sz = 0;
-
-    writer.str = (char*)calloc(writer.str_capacity, sizeof(char));
+    JsonValue* value;
 
-    if(writer.str == NULL)
-    {
-        g_current_error = ErrorCode_MemAllocError;
+    if(json_cursor_get_type(cursor) != JsonCursorType_Str)
         return NULL;
-    }
 
-    if(!json_write_value(&writer, json->root))
+    value = json_cursor_get_value(cursor);
+
+    if(value == NULL)
         return NULL;
 
-    *written_size = writer.str_sz;
+    if(str_sz != NULL)
+        *str_sz = json_str_get_size(value);
 
-    return writer.str;
+    return json_str_get(value);
 }
 
 /**************/
@@ -1469,6 +2332,11 @@ Json* json_new(void)
     }
 
     json->root = NULL;
+    json->mapping = NULL;
+    json->indices = NULL;
+    json->indices_capacity = 0;
+    json->stack = NULL;
+    json->stack_capacity = 0;
     arena_init(&json->string_arena, 128 * 1024);
     arena_init(&json->value_arena, 1024 * sizeof(JsonValue));
 
@@ -1486,78 +2354,106 @@ Json* json_loads(const char* str, size_t len)
     return json_parse(str, len);
 }
 
-Json* json_loadf(const char* file_path)
+Json* json_loads_insitu(char* str, size_t len)
 {
-    FILE* file = fopen(file_path, "rb");
+    if(str == NULL || len == 0)
+        return NULL;
 
-    if(file == NULL)
-    {
-        g_current_error = error_get_last_from_system();
+    Json* json = json_new();
 
-        logger_log_error("Error while trying to read json file: %s (%d)",
-                         file_path,
-                         (int)g_current_error);
+    if(json == NULL)
+        return NULL;
 
+    if(!json_parse_insitu_into(json, str, len))
+    {
+        json_free(json);
         return NULL;
     }
 
-    fseek(file, 0, SEEK_END);
-    size_t file_size = ftell(file);
-    rewind(file);
+    json_release_scratch(json);
+
+    return json;
+}
 
-    char* file_buffer = calloc(file_size, sizeof(char));
+Json* json_loadf(const char* file_path)
+{
+    FileMapping* mapping = (FileMapping*)malloc(sizeof(FileMapping));
 
-    if(file_buffer == NULL)
+    if(mapping == NULL)
     {
-        logger_log_error("Error while trying to allocate memory to read json file: %s", file_path);
         g_current_error = ErrorCode_MemAllocError;
         return NULL;
     }
 
-    size_t file_read_size = fread(file_buffer, sizeof(char), file_size, file);
-
-    if(file_read_size != file_size)
+    /* Private writable mapping, strings are decoded in place without touching the file */
+    if(!fs_file_map(mapping, file_path, true))
     {
-        g_current_error = error_get_last_from_system();
-        logger_log_error("Error while trying to read json file: %s (%d)", file_path, g_current_error);
+        logger_log_error("Error while trying to read json file: %s (%d)", file_path, (int)g_current_error);
+        free(mapping);
+        return NULL;
+    }
 
-        free(file_buffer);
+    Json* json = json_loads_insitu(mapping->data, mapping->size);
 
+    if(json == NULL)
+    {
+        fs_file_unmap(mapping);
+        free(mapping);
         return NULL;
     }
 
-    Json* json = json_loads(file_buffer, file_size);
-
-    free(file_buffer);
+    json->mapping = mapping;
 
     return json;
 }
 
 char* json_dumps(Json* json, size_t indent_size, size_t* dumps_size)
 {
-    return json_write(json, indent_size, dumps_size);
-}
+    JsonStreamWriter* writer;
+    Buffer buffer;
+    char* dumped;
+    bool success;
 
-bool json_dumpf(Json* json, size_t indent_size, const char* file_path)
-{
-    char* written;
-    size_t written_sz;
-    size_t fwritten_sz;
-    FILE* file;
+    if(!buffer_init(&buffer, 4096))
+        return NULL;
 
-    written = json_write(json, indent_size, &written_sz);
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, indent_size);
 
-    if(written == NULL)
-        return false;
+    if(writer == NULL)
+    {
+        buffer_release(&buffer);
+        return NULL;
+    }
 
-    file = fopen(file_path, "wb");
+    success = json_stream_writer_value(writer, json, json->root);
 
-    if(file == NULL)
+    if(!json_stream_writer_free(writer))
+        success = false;
+
+    /* Null-terminated for convenience, the terminator not being part of the dumped size */
+    if(!success || !buffer_append(&buffer, "", 1))
     {
-        free(written);
+        buffer_release(&buffer);
+        return NULL;
+    }
+
+    dumped = (char*)buffer_front(&buffer);
 
-        g_current_error = error_get_last_from_system();
+    if(dumps_size != NULL)
+        *dumps_size = buffer_size(&buffer) - 1;
 
+    return dumped;
+}
+
+bool json_dumpf(Json* json, size_t indent_size, const char* file_path)
+{
+    JsonStreamWriter* writer;
+    bool success;
+
+    writer = json_stream_writer_new_to_file(file_path, 0, indent_size);
+
+    if(writer == NULL)
+    {
         logger_log_error("Error while trying to write json file: %s (%d)",
                          file_path,
                          (int)g_current_error);
@@ -1565,14 +2461,14 @@ bool json_dumpf(Json* json, size_t indent_size, const char* file_path)
         return false;
     }
 
-    fwritten_sz = fwrite(written, sizeof(char), written_sz, file);
+    success = json_stream_writer_value(writer, json, json->root);
 
-    free(written);
+    /* Always freed to close the file, keeping the first error */
+    if(!json_stream_writer_free(writer))
+        success = false;
 
-    if(fwritten_sz < written_sz)
+    if(!success)
     {
-        g_current_error = error_get_last_from_system();
-
         logger_log_error("Error while trying to write json file: %s (%d)",
                          file_path,
                          (int)g_current_error);
@@ -1583,10 +2479,80 @@ bool json_dumpf(Json* json, size_t indent_size, const char* file_path)
     return true;
 }
 
+void json_reset(Json* json)
+{
+    arena_clear(&json->string_arena);
+    arena_clear(&json->value_arena);
+
+    json->root = NULL;
+
+    if(json->mapping != NULL)
+    {
+        fs_file_unmap(json->mapping);
+        free(json->mapping);
+        json->mapping = NULL;
+    }
+}
+
+bool json_loads_into(Json* json, const char* str, size_t len)
+{
+    json_reset(json);
+
+    return json_parse_into(json, str, len);
+}
+
+bool json_loads_insitu_into(Json* json, char* str, size_t len)
+{
+    json_reset(json);
+
+    return json_parse_insitu_into(json, str, len);
+}
+
+static ROMANO_THREAD_LOCAL Json* g_json_pool[JSON_POOL_SIZE];
+static ROMANO_THREAD_LOCAL size_t g_json_pool_size = 0;
+
+Json* json_pool_acquire(void)
+{
+    if(g_json_pool_size > 0)
+        return g_json_pool[--g_json_pool_size];
+
+    return json_new();
+}
+
+void json_pool_release(Json* json)
+{
+    if(json == NULL)
+        return;
+
+    if(g_json_pool_size == JSON_POOL_SIZE)
+    {
+        json_free(json);
+        return;
+    }
+
+    json_reset(json);
+
+    g_json_pool[g_json_pool_size++] = json;
+}
+
+void json_pool_clear(void)
+{
+    while(g_json_pool_size > 0)
+        json_free(g_json_pool[--g_json_pool_size]);
+}
+
 void json_free(Json* json)
 {
     arena_release(&json->string_arena);
     arena_release(&json->value_arena);
 
+    if(json->mapping != NULL)
+    {
+        fs_file_unmap(json->mapping);
+        free(json->mapping);
+    }
+
+    json_release_scratch(json);
+
     free(json);
 }
@@ -0,0 +1,1017 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_binary.h"
+#include "libromano/buffer.h"
+#include "libromano/endian.h"
+#include "libromano/error.h"
+#include "libromano/filesystem.h"
+#include "libromano/hashmap.h"
+#include "libromano/logger.h"
+#include "libromano/vector.h"
+
+#include "json_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+#define JSON_BINARY_MAGIC "RJSB"
+#define JSON_BINARY_HEADER_SIZE 20
+#define JSON_BINARY_MAX_VARINT_SIZE 10
+
+typedef enum JsonBinaryTag {
+    JsonBinaryTag_Null,
+    JsonBinaryTag_False,
+    JsonBinaryTag_True,
+    JsonBinaryTag_U64,
+    JsonBinaryTag_I64,
+    JsonBinaryTag_F64,
+    JsonBinaryTag_Str,
+    JsonBinaryTag_Array,
+    JsonBinaryTag_Dict,
+} JsonBinaryTag;
+
+struct JsonBinary {
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t root;
+    uint32_t strings_count;
+    uint32_t strings_offsets;
+
+    FileMapping mapping;
+    bool mapped;
+};
+
+/************/
+/* Encoding */
+/************/
+
+typedef struct JsonBinaryString {
+    const char* str;
+    size_t str_sz;
+} JsonBinaryString;
+
+typedef struct JsonBinarySortEntry {
+    const char* key;
+    size_t key_sz;
+    uint32_t index;
+} JsonBinarySortEntry;
+
+typedef struct JsonBinaryEncoder {
+    Json* json;
+    Buffer buffer;
+
+    /* String -> id, and the strings by id */
+    HashMap* strings_ids;
+    Vector strings;
+
+    /* The hashmap does not accept empty keys */
+    uint32_t empty_string_id;
+
+    /* Offsets (and key ids) of the children of the containers being encoded */
+    Vector stack;
+
+    bool overflow;
+} JsonBinaryEncoder;
+
+ROMANO_FORCE_INLINE bool json_binary_write(JsonBinaryEncoder* encoder, const void* data, size_t data_sz)
+{
+    return buffer_append(&encoder->buffer, data, data_sz);
+}
+
+static bool json_binary_write_u32(JsonBinaryEncoder* encoder, uint32_t u32)
+{
+    u32 = htole32(u32);
+
+    return json_binary_write(encoder, &u32, sizeof(uint32_t));
+}
+
+static bool json_binary_write_varint(JsonBinaryEncoder* encoder, uint64_t u64)
+{
+    uint8_t bytes[JSON_BINARY_MAX_VARINT_SIZE];
+    size_t size = 0;
+
+    while(u64 >= 0x80)
+    {
+        bytes[size++] = (uint8_t)(u64 | 0x80);
+        u64 >>= 7;
+    }
+
+    bytes[size++] = (uint8_t)u64;
+
+    return json_binary_write(encoder, bytes, size);
+}
+
+ROMANO_FORCE_INLINE bool json_binary_write_tag(JsonBinaryEncoder* encoder, JsonBinaryTag tag)
+{
+    const uint8_t byte = (uint8_t)tag;
+
+    return json_binary_write(encoder, &byte, 1);
+}
+
+/* Returns the current offset, and flags documents whose offsets do not fit in 32 bits */
+ROMANO_FORCE_INLINE uint32_t json_binary_offset(JsonBinaryEncoder* encoder)
+{
+    const size_t offset = buffer_size(&encoder->buffer);
+
+    if(offset > (size_t)UINT32_MAX)
+        encoder->overflow = true;
+
+    return (uint32_t)offset;
+}
+
+static uint32_t json_binary_string_id(JsonBinaryEncoder* encoder, const char* str, size_t str_sz)
+{
+    JsonBinaryString string;
+    uint32_t* id;
+    uint32_t new_id;
+
+    if(str_sz == 0 && encoder->empty_string_id != UINT32_MAX)
+        return encoder->empty_string_id;
+
+    id = str_sz == 0 ? NULL : (uint32_t*)hashmap_get(encoder->strings_ids, str, (uint32_t)str_sz, NULL);
+
+    if(id != NULL)
+        return *id;
+
+    new_id = (uint32_t)vector_size(&encoder->strings);
+
+    string.str = str;
+    string.str_sz = str_sz;
+
+    vector_push_back(&encoder->strings, &string);
+
+    if(str_sz == 0)
+        encoder->empty_string_id = new_id;
+    else
+        hashmap_insert(encoder->strings_ids, str, (uint32_t)str_sz, &new_id, sizeof(uint32_t));
+
+    return new_id;
+}
+
+static int json_binary_sort_entry_cmp(const void* a, const void* b)
+{
+    const JsonBinarySortEntry* entry_a = (const JsonBinarySortEntry*)a;
+    const JsonBinarySortEntry* entry_b = (const JsonBinarySortEntry*)b;
+    const size_t min_sz = entry_a->key_sz < entry_b->key_sz ? entry_a->key_sz : entry_b->key_sz;
+    int cmp;
+
+    cmp = memcmp(entry_a->key, entry_b->key, min_sz);
+
+    if(cmp != 0)
+        return cmp;
+
+    if(entry_a->key_sz != entry_b->key_sz)
+        return entry_a->key_sz < entry_b->key_sz ? -1 : 1;
+
+    return entry_a->index < entry_b->index ? -1 : (entry_a->index > entry_b->index);
+}
+
+static bool json_binary_encode_value(JsonBinaryEncoder* encoder, JsonValue* value, uint32_t* offset);
+
+static bool json_binary_encode_array(JsonBinaryEncoder* encoder, JsonValue* array, uint32_t* offset)
+{
+    const size_t stack_start = vector_size(&encoder->stack);
+    const size_t size = json_array_get_size(array);
+    uint32_t child_offset;
+    size_t i;
+
+    /* Children are written first, the offsets table follows the array tag */
+    for(i = 0; i < size; i++)
+    {
+        if(!json_binary_encode_value(encoder, json_array_get(array, i), &child_offset))
+            return false;
+
+        vector_push_back(&encoder->stack, &child_offset);
+    }
+
+    *offset = json_binary_offset(encoder);
+
+    if(!json_binary_write_tag(encoder, JsonBinaryTag_Array) || !json_binary_write_varint(encoder, size))
+        return false;
+
+    for(i = 0; i < size; i++)
+        if(!json_binary_write_u32(encoder, *(uint32_t*)vector_at(&encoder->stack, stack_start + i)))
+            return false;
+
+    while(vector_size(&encoder->stack) > stack_start)
+        vector_pop(&encoder->stack);
+
+    return true;
+}
+
+static bool json_binary_encode_dict(JsonBinaryEncoder* encoder, JsonValue* dict, uint32_t* offset)
+{
+    const size_t stack_start = vector_size(&encoder->stack);
+    const size_t size = json_dict_get_size(dict);
+    JsonBinarySortEntry* entries;
+    JsonDictIterator iterator;
+    JsonKeyValue* key_value;
+    uint32_t key_id;
+    uint32_t child_offset;
+    size_t i;
+    bool success = true;
+
+    memset(&iterator, 0, sizeof(JsonDictIterator));
+
+    while((key_value = json_dict_get_next(encoder->json, dict, &iterator)) != NULL)
+    {
+        if(!json_binary_encode_value(encoder, key_value->value, &child_offset))
+            return false;
+
+        /* Dict keys are null-terminated in json documents, strlen is their size */
+        key_id = json_binary_string_id(encoder, key_value->key, strlen(key_value->key));
+
+        vector_push_back(&encoder->stack, &key_id);
+        vector_push_back(&encoder->stack, &child_offset);
+    }
+
+    *offset = json_binary_offset(encoder);
+
+    if(!json_binary_write_tag(encoder, JsonBinaryTag_Dict) || !json_binary_write_varint(encoder, size))
+        return false;
+
+    for(i = 0; i < size * 2; i++)
+        if(!json_binary_write_u32(encoder, *(uint32_t*)vector_at(&encoder->stack, stack_start + i)))
+            return false;
+
+    if(size >= JSON_DICT_INDEX_THRESHOLD)
+    {
+        entries = (JsonBinarySortEntry*)malloc(size * sizeof(JsonBinarySortEntry));
+
+        if(entries == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            return false;
+        }
+
+        for(i = 0; i < size; i++)
+        {
+            const JsonBinaryString* key;
+
+            key_id = *(uint32_t*)vector_at(&encoder->stack, stack_start + i * 2);
+            key = (const JsonBinaryString*)vector_at(&encoder->strings, key_id);
+
+            entries[i].key = key->str;
+            entries[i].key_sz = key->str_sz;
+            entries[i].index = (uint32_t)i;
+        }
+
+        qsort(entries, size, sizeof(JsonBinarySortEntry), json_binary_sort_entry_cmp);
+
+        for(i = 0; i < size && success; i++)
+            success = json_binary_write_u32(encoder, entries[i].index);
+
+        free(entries);
+    }
+
+    while(vector_size(&encoder->stack) > stack_start)
+        vector_pop(&encoder->stack);
+
+    return success;
+}
+
+static bool json_binary_encode_value(JsonBinaryEncoder* encoder, JsonValue* value, uint32_t* offset)
+{
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+
+    if(json_is_array(value))
+        return json_binary_encode_array(encoder, value, offset);
+
+    if(json_is_dict(value))
+        return json_binary_encode_dict(encoder, value, offset);
+
+    *offset = json_binary_offset(encoder);
+
+    if(json_is_null(value))
+        return json_binary_write_tag(encoder, JsonBinaryTag_Null);
+
+    if(json_is_bool(value))
+        return json_binary_write_tag(encoder, json_bool_get(value) ? JsonBinaryTag_True : JsonBinaryTag_False);
+
+    if(json_is_u64(value))
+        return json_binary_write_tag(encoder, JsonBinaryTag_U64) &&
+               json_binary_write_varint(encoder, json_u64_get(value));
+
+    if(json_is_i64(value))
+    {
+        /* Zigzag encoding, small negative values take few bytes */
+        i64 = json_i64_get(value);
+        u64 = ((uint64_t)i64 << 1) ^ (uint64_t)(i64 >> 63);
+
+        return json_binary_write_tag(encoder, JsonBinaryTag_I64) && json_binary_write_varint(encoder, u64);
+    }
+
+    if(json_is_f64(value))
+    {
+        f64 = json_f64_get(value);
+        memcpy(&u64, &f64, sizeof(double));
+        u64 = htole64(u64);
+
+        return json_binary_write_tag(encoder, JsonBinaryTag_F64) && json_binary_write(encoder, &u64, sizeof(uint64_t));
+    }
+
+    if(json_is_str(value))
+        return json_binary_write_tag(encoder, JsonBinaryTag_Str) &&
+               json_binary_write_varint(encoder,
+                                        json_binary_string_id(encoder, json_str_get(value), json_str_get_size(value)));
+
+    g_current_error = ErrorCode_JsonUnexpectedCharacter;
+
+    return false;
+}
+
+static bool json_binary_encode_strings(JsonBinaryEncoder* encoder, uint32_t* strings_offset)
+{
+    const size_t count = vector_size(&encoder->strings);
+    const uint8_t terminator = 0;
+    const JsonBinaryString* string;
+    size_t table_offset;
+    uint32_t offset;
+    size_t i;
+
+    *strings_offset = json_binary_offset(encoder);
+
+    if(!json_binary_write_varint(encoder, count))
+        return false;
+
+    /* Reserve the offsets table, filled as the strings are written */
+    table_offset = buffer_size(&encoder->buffer);
+
+    for(i = 0; i < count; i++)
+        if(!json_binary_write_u32(encoder, 0))
+            return false;
+
+    for(i = 0; i < count; i++)
+    {
+        string = (const JsonBinaryString*)vector_at(&encoder->strings, i);
+        offset = htole32(json_binary_offset(encoder));
+
+        memcpy((char*)buffer_front(&encoder->buffer) + table_offset + i * sizeof(uint32_t), &offset, sizeof(uint32_t));
+
+        if(!json_binary_write_varint(encoder, string->str_sz) ||
+           !json_binary_write(encoder, string->str, string->str_sz) ||
+           !json_binary_write(encoder, &terminator, 1))
+            return false;
+    }
+
+    return true;
+}
+
+char* json_binary_encode(Json* json, size_t* binary_size)
+{
+    JsonBinaryEncoder encoder;
+    uint32_t root_offset;
+    uint32_t strings_offset;
+    uint32_t header[4];
+    bool success;
+
+    if(json == NULL || json->root == NULL)
+        return NULL;
+
+    memset(&encoder, 0, sizeof(JsonBinaryEncoder));
+    encoder.json = json;
+    encoder.empty_string_id = UINT32_MAX;
+
+    if(!buffer_init(&encoder.buffer, 4096))
+        return NULL;
+
+    encoder.strings_ids = hashmap_new(1024);
+
+    if(encoder.strings_ids == NULL)
+    {
+        buffer_release(&encoder.buffer);
+        return NULL;
+    }
+
+    vector_init(&encoder.strings, 1024, sizeof(JsonBinaryString));
+    vector_init(&encoder.stack, 1024, sizeof(uint32_t));
+
+    /* The header is written once the offsets are known */
+    memset(header, 0, sizeof(header));
+
+    success = json_binary_write(&encoder, JSON_BINARY_MAGIC, 4) &&
+              json_binary_write(&encoder, header, sizeof(header)) &&
+              json_binary_encode_value(&encoder, json->root, &root_offset) &&
+              json_binary_encode_strings(&encoder, &strings_offset);
+
+    if(success && (encoder.overflow || buffer_size(&encoder.buffer) > (size_t)UINT32_MAX))
+    {
+        g_current_error = ErrorCode_SizeOverflow;
+        success = false;
+    }
+
+    hashmap_free(encoder.strings_ids);
+    vector_release(&encoder.strings);
+    vector_release(&encoder.stack);
+
+    if(!success)
+    {
+        buffer_release(&encoder.buffer);
+        return NULL;
+    }
+
+    header[0] = htole32(JSON_BINARY_VERSION);
+    header[1] = htole32((uint32_t)buffer_size(&encoder.buffer));
+    header[2] = htole32(root_offset);
+    header[3] = htole32(strings_offset);
+
+    memcpy((char*)buffer_front(&encoder.buffer) + 4, header, sizeof(header));
+
+    *binary_size = buffer_size(&encoder.buffer);
+
+    return (char*)buffer_front(&encoder.buffer);
+}
+
+char* json_binary_encode_text(const char* str, size_t str_sz, size_t* binary_size)
+{
+    Json* json;
+    char* binary;
+
+    json = json_loads(str, str_sz);
+
+    if(json == NULL)
+        return NULL;
+
+    binary = json_binary_encode(json, binary_size);
+
+    json_free(json);
+
+    return binary;
+}
+
+bool json_binary_dumpf(Json* json, const char* file_path)
+{
+    size_t binary_size;
+    size_t written_size;
+    char* binary;
+    FILE* file;
+
+    binary = json_binary_encode(json, &binary_size);
+
+    if(binary == NULL)
+        return false;
+
+    file = fopen(file_path, "wb");
+
+    if(file == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        logger_log_error("Error while trying to write binary json file: %s (%d)", file_path, (int)g_current_error);
+        free(binary);
+        return false;
+    }
+
+    written_size = fwrite(binary, sizeof(char), binary_size, file);
+
+    free(binary);
+
+    if(fclose(file) != 0 || written_size != binary_size)
+    {
+        g_current_error = error_get_last_from_system();
+        logger_log_error("Error while trying to write binary json file: %s (%d)", file_path, (int)g_current_error);
+        return false;
+    }
+
+    return true;
+}
+
+/************/
+/* Decoding */
+/************/
+
+ROMANO_FORCE_INLINE bool json_binary_read_u32(const JsonBinary* binary, uint32_t offset, uint32_t* u32)
+{
+    if(offset > binary->size || binary->size - offset < sizeof(uint32_t))
+        return false;
+
+    memcpy(u32, binary->data + offset, sizeof(uint32_t));
+    *u32 = le32toh(*u32);
+
+    return true;
+}
+
+/* Reads a varint at offset, and moves offset after it */
+ROMANO_FORCE_INLINE bool json_binary_read_varint(const JsonBinary* binary, uint32_t* offset, uint64_t* u64)
+{
+    uint32_t shift = 0;
+    uint8_t byte;
+
+    *u64 = 0;
+
+    do
+    {
+        if(*offset >= binary->size || shift >= 64)
+            return false;
+
+        byte = binary->data[(*offset)++];
+        *u64 |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    }
+    while(byte & 0x80);
+
+    return true;
+}
+
+/*
+ * Reads the elements count of a container, and sets table to the offset of its table, checking
+ * that the table (of entry_size bytes per element) fits in the document
+ */
+static bool json_binary_read_container(JsonBinaryValue value,
+                                       JsonBinaryTag tag,
+                                       size_t entry_size,
+                                       uint64_t* count,
+                                       uint32_t* table)
+{
+    const JsonBinary* binary = value.binary;
+
+    if(value.offset >= binary->size || binary->data[value.offset] != (uint8_t)tag)
+        return false;
+
+    *table = value.offset + 1;
+
+    if(!json_binary_read_varint(binary, table, count))
+        return false;
+
+    return *count <= (binary->size - *table) / entry_size;
+}
+
+static const char* json_binary_read_string(const JsonBinary* binary, uint64_t id, size_t* str_sz)
+{
+    uint32_t offset;
+    uint64_t size;
+
+    if(id >= binary->strings_count ||
+       !json_binary_read_u32(binary, binary->strings_offsets + (uint32_t)id * sizeof(uint32_t), &offset) ||
+       !json_binary_read_varint(binary, &offset, &size) ||
+       size >= binary->size - offset)
+    {
+        return NULL;
+    }
+
+    /* Strings are null-terminated, a corrupted document must not make them run past the data */
+    if(binary->data[offset + size] != 0)
+        return NULL;
+
+    if(str_sz != NULL)
+        *str_sz = (size_t)size;
+
+    return (const char*)binary->data + offset;
+}
+
+JsonBinary* json_binary_open(const char* data, size_t size)
+{
+    JsonBinary* binary;
+    uint32_t header[4];
+    uint32_t strings_offset;
+    uint64_t strings_count;
+
+    if(data == NULL || size < JSON_BINARY_HEADER_SIZE || size > (size_t)UINT32_MAX ||
+       memcmp(data, JSON_BINARY_MAGIC, 4) != 0)
+    {
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        return NULL;
+    }
+
+    memcpy(header, data + 4, sizeof(header));
+
+    if(le32toh(header[0]) != JSON_BINARY_VERSION || le32toh(header[1]) != (uint32_t)size)
+    {
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        return NULL;
+    }
+
+    binary = (JsonBinary*)calloc(1, sizeof(JsonBinary));
+
+    if(binary == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    binary->data = (const uint8_t*)data;
+    binary->size = (uint32_t)size;
+    binary->root = le32toh(header[2]);
+
+    strings_offset = le32toh(header[3]);
+
+    if(!json_binary_read_varint(binary, &strings_offset, &strings_count) ||
+       strings_count > (binary->size - strings_offset) / sizeof(uint32_t))
+    {
+        g_current_error = ErrorCode_JsonUnexpectedCharacter;
+        free(binary);
+        return NULL;
+    }
+
+    binary->strings_count = (uint32_t)strings_count;
+    binary->strings_offsets = strings_offset;
+
+    return binary;
+}
+
+JsonBinary* json_binary_loadf(const char* file_path)
+{
+    FileMapping mapping;
+    JsonBinary* binary;
+
+    if(!fs_file_map(&mapping, file_path, false))
+    {
+        logger_log_error("Error while trying to map binary json file: %s (%d)", file_path, (int)g_current_error);
+        return NULL;
+    }
+
+    binary = json_binary_open(mapping.data, mapping.size);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Invalid binary json file: %s", file_path);
+        fs_file_unmap(&mapping);
+        return NULL;
+    }
+
+    binary->mapping = mapping;
+    binary->mapped = true;
+
+    return binary;
+}
+
+void json_binary_free(JsonBinary* binary)
+{
+    if(binary->mapped)
+        fs_file_unmap(&binary->mapping);
+
+    free(binary);
+}
+
+JsonBinaryValue json_binary_get_root(const JsonBinary* binary)
+{
+    JsonBinaryValue root;
+
+    root.binary = binary;
+    root.offset = binary->root;
+
+    return root;
+}
+
+JsonBinaryType json_binary_get_type(JsonBinaryValue value)
+{
+    if(value.offset >= value.binary->size)
+        return JsonBinaryType_Invalid;
+
+    switch(value.binary->data[value.offset])
+    {
+        case JsonBinaryTag_Null:
+            return JsonBinaryType_Null;
+        case JsonBinaryTag_False:
+        case JsonBinaryTag_True:
+            return JsonBinaryType_Bool;
+        case JsonBinaryTag_U64:
+            return JsonBinaryType_U64;
+        case JsonBinaryTag_I64:
+            return JsonBinaryType_I64;
+        case JsonBinaryTag_F64:
+            return JsonBinaryType_F64;
+        case JsonBinaryTag_Str:
+            return JsonBinaryType_Str;
+        case JsonBinaryTag_Array:
+            return JsonBinaryType_Array;
+        case JsonBinaryTag_Dict:
+            return JsonBinaryType_Dict;
+        default:
+            return JsonBinaryType_Invalid;
+    }
+}
+
+bool json_binary_get_bool(JsonBinaryValue value, bool* b)
+{
+    if(json_binary_get_type(value) != JsonBinaryType_Bool)
+        return false;
+
+    *b = value.binary->data[value.offset] == JsonBinaryTag_True;
+
+    return true;
+}
+
+bool json_binary_get_u64(JsonBinaryValue value, uint64_t* u64)
+{
+    uint32_t offset = value.offset + 1;
+
+    if(json_binary_get_type(value) != JsonBinaryType_U64)
+        return false;
+
+    return json_binary_read_varint(value.binary, &offset, u64);
+}
+
+bool json_binary_get_i64(JsonBinaryValue value, int64_t* i64)
+{
+    uint32_t offset = value.offset + 1;
+    uint64_t u64;
+
+    switch(json_binary_get_type(value))
+    {
+        case JsonBinaryType_I64:
+            if(!json_binary_read_varint(value.binary, &offset, &u64))
+                return false;
+
+            *i64 = (int64_t)(u64 >> 1) ^ -(int64_t)(u64 & 1);
+
+            return true;
+        case JsonBinaryType_U64:
+            if(!json_binary_read_varint(value.binary, &offset, &u64) || u64 > (uint64_t)INT64_MAX)
+                return false;
+
+            *i64 = (int64_t)u64;
+
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool json_binary_get_f64(JsonBinaryValue value, double* f64)
+{
+    uint64_t u64;
+    int64_t i64;
+
+    switch(json_binary_get_type(value))
+    {
+        case JsonBinaryType_F64:
+            if(value.binary->size - value.offset - 1 < sizeof(uint64_t))
+                return false;
+
+            memcpy(&u64, value.binary->data + value.offset + 1, sizeof(uint64_t));
+            u64 = le64toh(u64);
+            memcpy(f64, &u64, sizeof(double));
+
+            return true;
+        case JsonBinaryType_U64:
+            if(!json_binary_get_u64(value, &u64))
+                return false;
+
+            *f64 = (double)u64;
+
+            return true;
+        case JsonBinaryType_I64:
+            if(!json_binary_get_i64(value, &i64))
+                return false;
+
+            *f64 = (double)i64;
+
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* json_binary_get_str(JsonBinaryValue value, size_t* str_sz)
+{
+    uint32_t offset = value.offset + 1;
+    uint64_t id;
+
+    if(json_binary_get_type(value) != JsonBinaryType_Str ||
+       !json_binary_read_varint(value.binary, &offset, &id))
+        return NULL;
+
+    return json_binary_read_string(value.binary, id, str_sz);
+}
+
+size_t json_binary_get_size(JsonBinaryValue value)
+{
+    uint64_t count;
+    uint32_t table;
+
+    if(json_binary_read_container(value, JsonBinaryTag_Array, sizeof(uint32_t), &count, &table) ||
+       json_binary_read_container(value, JsonBinaryTag_Dict, sizeof(uint32_t) * 2, &count, &table))
+        return (size_t)count;
+
+    return 0;
+}
+
+bool json_binary_array_get(JsonBinaryValue array, size_t index, JsonBinaryValue* element)
+{
+    uint64_t count;
+    uint32_t table;
+
+    if(!json_binary_read_container(array, JsonBinaryTag_Array, sizeof(uint32_t), &count, &table) ||
+       index >= count)
+        return false;
+
+    element->binary = array.binary;
+
+    /* Children precede their container, which also rejects cycles in corrupted documents */
+    return json_binary_read_u32(array.binary, table + (uint32_t)index * sizeof(uint32_t), &element->offset) &&
+           element->offset < array.offset;
+}
+
+bool json_binary_dict_get(JsonBinaryValue dict, size_t index, const char** key, JsonBinaryValue* value)
+{
+    uint64_t count;
+    uint32_t table;
+    uint32_t key_id;
+
+    if(!json_binary_read_container(dict, JsonBinaryTag_Dict, sizeof(uint32_t) * 2, &count, &table) ||
+       index >= count)
+        return false;
+
+    table += (uint32_t)index * sizeof(uint32_t) * 2;
+
+    if(!json_binary_read_u32(dict.binary, table, &key_id) ||
+       !json_binary_read_u32(dict.binary, table + sizeof(uint32_t), &value->offset) ||
+       value->offset >= dict.offset)
+        return false;
+
+    value->binary = dict.binary;
+
+    if(key != NULL)
+    {
+        size_t key_sz;
+
+        /* Keys are C strings, as in json documents, they cannot hold nulls */
+        *key = json_binary_read_string(dict.binary, key_id, &key_sz);
+
+        if(*key == NULL || memchr(*key, 0, key_sz) != NULL)
+            return false;
+    }
+
+    return true;
+}
+
+bool json_binary_dict_find(JsonBinaryValue dict, const char* key, JsonBinaryValue* value)
+{
+    const char* entry_key;
+    size_t entry_key_sz;
+    size_t key_sz;
+    uint64_t count;
+    uint32_t table;
+    uint32_t key_id;
+    uint32_t entry;
+    size_t low;
+    size_t high;
+    size_t i;
+    int cmp;
+
+    if(!json_binary_read_container(dict, JsonBinaryTag_Dict, sizeof(uint32_t) * 2, &count, &table))
+        return false;
+
+    key_sz = strlen(key);
+
+    if(count < JSON_DICT_INDEX_THRESHOLD)
+    {
+        for(i = 0; i < count; i++)
+        {
+            if(!json_binary_read_u32(dict.binary, table + (uint32_t)i * sizeof(uint32_t) * 2, &key_id))
+                return false;
+
+            entry_key = json_binary_read_string(dict.binary, key_id, &entry_key_sz);
+
+            if(entry_key != NULL && entry_key_sz == key_sz && memcmp(entry_key, key, key_sz) == 0)
+                return json_binary_dict_get(dict, i, NULL, value);
+        }
+
+        return false;
+    }
+
+    /* Binary search in the entries sorted by key, following the pairs table */
+    low = 0;
+    high = (size_t)count;
+
+    while(low < high)
+    {
+        i = low + (high - low) / 2;
+
+        if(!json_binary_read_u32(dict.binary, table + (uint32_t)(count * 2 + i) * sizeof(uint32_t), &entry) ||
+           entry >= count ||
+           !json_binary_read_u32(dict.binary, table + entry * sizeof(uint32_t) * 2, &key_id))
+            return false;
+
+        entry_key = json_binary_read_string(dict.binary, key_id, &entry_key_sz);
+
+        if(entry_key == NULL)
+            return false;
+
+        cmp = memcmp(entry_key, key, entry_key_sz < key_sz ? entry_key_sz : key_sz);
+
+        if(cmp == 0 && entry_key_sz != key_sz)
+            cmp = entry_key_sz < key_sz ? -1 : 1;
+
+        if(cmp == 0)
+            return json_binary_dict_get(dict, entry, NULL, value);
+
+        if(cmp < 0)
+            low = i + 1;
+        else
+            high = i;
+    }
+
+    return false;
+}
+
+static JsonValue* json_binary_decode_value(Json* json, JsonBinaryValue value)
+{
+    JsonBinaryValue child;
+    JsonValue* container;
+    JsonValue* decoded;
+    const char* key;
+    const char* str;
+    size_t size;
+    size_t i;
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+    bool b;
+
+    switch(json_binary_get_type(value))
+    {
+        case JsonBinaryType_Null:
+            return json_null_new(json);
+        case JsonBinaryType_Bool:
+            json_binary_get_bool(value, &b);
+            return json_bool_new(json, b);
+        case JsonBinaryType_U64:
+            return json_binary_get_u64(value, &u64) ? json_u64_new(json, u64) : NULL;
+        case JsonBinaryType_I64:
+            return json_binary_get_i64(value, &i64) ? json_i64_new(json, i64) : NULL;
+        case JsonBinaryType_F64:
+            return json_binary_get_f64(value, &f64) ? json_f64_new(json, f64) : NULL;
+        case JsonBinaryType_Str:
+            str = json_binary_get_str(value, &size);
+            return str != NULL ? json_str_new_sized(json, str, size) : NULL;
+        case JsonBinaryType_Array:
+            container = json_array_new(json);
+            size = json_binary_get_size(value);
+
+            for(i = 0; i < size; i++)
+            {
+                if(!json_binary_array_get(value, i, &child) ||
+                   (decoded = json_binary_decode_value(json, child)) == NULL)
+                    return NULL;
+
+                json_array_append(json, container, decoded, true);
+            }
+
+            return container;
+        case JsonBinaryType_Dict:
+            container = json_dict_new(json, NULL);
+            size = json_binary_get_size(value);
+
+            for(i = 0; i < size; i++)
+            {
+                if(!json_binary_dict_get(value, i, &key, &child) ||
+                   (decoded = json_binary_decode_value(json, child)) == NULL)
+                    return NULL;
+
+                json_dict_append(json, container, key, decoded, true);
+            }
+
+            return container;
+        default:
+            g_current_error = ErrorCode_JsonUnexpectedCharacter;
+            return NULL;
+    }
+}
+
+Json* json_binary_to_json(const JsonBinary* binary)
+{
+    JsonValue* root;
+    Json* json;
+
+    json = json_new();
+
+    if(json == NULL)
+        return NULL;
+
+    root = json_binary_decode_value(json, json_binary_get_root(binary));
+
+    if(root == NULL)
+    {
+        json_free(json);
+        return NULL;
+    }
+
+    json_set_root(json, root);
+
+    return json;
+}
+
+char* json_binary_to_text(const JsonBinary* binary, size_t indent_size, size_t* text_size)
+{
+    Json* json;
+    char* text;
+
+    json = json_binary_to_json(binary);
+
+    if(json == NULL)
+        return NULL;
+
+    text = json_dumps(json, indent_size, text_size);
+
+    json_free(json);
+
+    return text;
+}
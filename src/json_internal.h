@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#pragma once
+
+#if !defined(__LIBROMANO_JSON_INTERNAL)
+#define __LIBROMANO_JSON_INTERNAL
+
+#include "libromano/json.h"
+
+/* Json internals shared between the json sources, not part of the public api */
+
+ROMANO_CPP_ENTER
+
+/* Same as json_str_new, the string being copied with its size so it can hold nulls */
+JsonValue* json_str_new_sized(Json* json, const char* str, size_t str_sz);
+
+/* Hash of a dict key, as used by the dict index */
+uint32_t json_dict_key_hash(const char* key);
+
+/* Same as json_dict_find, with the key hash computed beforehand by json_dict_key_hash */
+JsonValue* json_dict_find_hashed(Json* json, JsonValue* dict, const char* key, uint32_t hash);
+
+/*
+ * Parses str into the given document, setting its root. Values are pushed to the document arenas,
+ * so a document can hold several parsed roots. Returns false on error
+ */
+bool json_parse_into(Json* json, const char* str, size_t str_sz);
+
+/* Same as json_parse_into, but strings are decoded in str and point into it */
+bool json_parse_insitu_into(Json* json, char* str, size_t str_sz);
+
+ROMANO_CPP_END
+
+#endif /* !defined(__LIBROMANO_JSON_INTERNAL) */
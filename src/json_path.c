@@ -0,0 +1,597 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_path.h"
+#include "libromano/error.h"
+
+#include "json_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+typedef struct JsonPathStep {
+    /* Dict key, decoded and null-terminated */
+    const char* key;
+    uint32_t hash;
+
+    size_t index;
+
+    bool has_key;
+    bool has_index;
+    bool wildcard;
+} JsonPathStep;
+
+struct JsonPath {
+    JsonPathStep* steps;
+    size_t steps_count;
+
+    /* Holds the keys of all the steps */
+    char* keys;
+
+    bool has_wildcard;
+};
+
+/***************/
+/* Compilation */
+/***************/
+
+typedef struct JsonPathCompiler {
+    JsonPath* path;
+    char* keys_end;
+} JsonPathCompiler;
+
+ROMANO_FORCE_INLINE JsonPathStep* json_path_push_step(JsonPathCompiler* compiler)
+{
+    JsonPathStep* step = &compiler->path->steps[compiler->path->steps_count++];
+
+    memset(step, 0, sizeof(JsonPathStep));
+
+    return step;
+}
+
+ROMANO_FORCE_INLINE void json_path_end_key(JsonPathCompiler* compiler, JsonPathStep* step, char* key)
+{
+    step->key = key;
+    step->has_key = true;
+
+    *compiler->keys_end++ = '\0';
+
+    step->hash = json_dict_key_hash(key);
+}
+
+/* Parses a non-empty decimal index without leading zeros. Returns false if it is not one */
+static bool json_path_parse_index(const char* str, size_t str_sz, size_t* index)
+{
+    size_t i;
+
+    if(str_sz == 0 || (str_sz > 1 && str[0] == '0'))
+        return false;
+
+    *index = 0;
+
+    for(i = 0; i < str_sz; i++)
+    {
+        if(str[i] < '0' || str[i] > '9')
+            return false;
+
+        if(*index > (SIZE_MAX - 9) / 10)
+            return false;
+
+        *index = *index * 10 + (size_t)(str[i] - '0');
+    }
+
+    return true;
+}
+
+static bool json_path_compile_pointer(JsonPathCompiler* compiler, const char* path)
+{
+    JsonPathStep* step;
+    const char* segment;
+    size_t segment_sz;
+    char* key;
+
+    while(*path == '/')
+    {
+        segment = ++path;
+
+        while(*path != '\0' && *path != '/')
+            path++;
+
+        segment_sz = (size_t)(path - segment);
+        step = json_path_push_step(compiler);
+
+        if(segment_sz == 1 && segment[0] == '*')
+        {
+            step->wildcard = true;
+            compiler->path->has_wildcard = true;
+            continue;
+        }
+
+        step->has_index = json_path_parse_index(segment, segment_sz, &step->index);
+
+        key = compiler->keys_end;
+
+        for(; segment < path; segment++)
+        {
+            if(*segment != '~')
+            {
+                *compiler->keys_end++ = *segment;
+                continue;
+            }
+
+            segment++;
+
+            if(segment == path || (*segment != '0' && *segment != '1'))
+                return false;
+
+            *compiler->keys_end++ = *segment == '0' ? '~' : '/';
+        }
+
+        json_path_end_key(compiler, step, key);
+    }
+
+    return *path == '\0';
+}
+
+static bool json_path_compile_jsonpath(JsonPathCompiler* compiler, const char* path)
+{
+    JsonPathStep* step;
+    const char* start;
+    char quote;
+    char* key;
+
+    /* Skip the $ */
+    path++;
+
+    while(*path != '\0')
+    {
+        step = json_path_push_step(compiler);
+
+        if(*path == '.')
+        {
+            path++;
+
+            if(*path == '*')
+            {
+                step->wildcard = true;
+                compiler->path->has_wildcard = true;
+                path++;
+                continue;
+            }
+
+            key = compiler->keys_end;
+
+            while(*path != '\0' && *path != '.' && *path != '[')
+                *compiler->keys_end++ = *path++;
+
+            if(compiler->keys_end == key)
+                return false;
+
+            json_path_end_key(compiler, step, key);
+        }
+        else if(*path == '[')
+        {
+            path++;
+
+            if(*path == '*')
+            {
+                step->wildcard = true;
+                compiler->path->has_wildcard = true;
+                path++;
+            }
+            else if(*path == '\'' || *path == '"')
+            {
+                quote = *path++;
+                key = compiler->keys_end;
+
+                while(*path != quote)
+                {
+                    if(*path == '\\' && (path[1] == quote || path[1] == '\\'))
+                        path++;
+
+                    if(*path == '\0')
+                        return false;
+
+                    *compiler->keys_end++ = *path++;
+                }
+
+                path++;
+
+                json_path_end_key(compiler, step, key);
+            }
+            else
+            {
+                start = path;
+
+                while(*path >= '0' && *path <= '9')
+                    path++;
+
+                if(!json_path_parse_index(start, (size_t)(path - start), &step->index))
+                    return false;
+
+                step->has_index = true;
+            }
+
+            if(*path != ']')
+                return false;
+
+            path++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+JsonPath* json_path_compile(const char* path)
+{
+    JsonPathCompiler compiler;
+    size_t path_sz;
+    bool success;
+
+    path_sz = strlen(path);
+
+    compiler.path = (JsonPath*)calloc(1, sizeof(JsonPath));
+
+    if(compiler.path == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    /* A path has at most one step per character, and keys are never longer than their source */
+    compiler.path->steps = (JsonPathStep*)malloc((path_sz + 1) * sizeof(JsonPathStep));
+    compiler.path->keys = (char*)malloc(path_sz * 2 + 1);
+    compiler.keys_end = compiler.path->keys;
+
+    if(compiler.path->steps == NULL || compiler.path->keys == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        json_path_free(compiler.path);
+        return NULL;
+    }
+
+    if(path[0] == '$')
+        success = json_path_compile_jsonpath(&compiler, path);
+    else
+        success = json_path_compile_pointer(&compiler, path);
+
+    if(!success)
+    {
+        g_current_error = ErrorCode_JsonInvalidPath;
+        json_path_free(compiler.path);
+        return NULL;
+    }
+
+    return compiler.path;
+}
+
+bool json_path_has_wildcard(const JsonPath* path)
+{
+    return path->has_wildcard;
+}
+
+void json_path_free(JsonPath* path)
+{
+    free(path->steps);
+    free(path->keys);
+    free(path);
+}
+
+/*************/
+/* Execution */
+/*************/
+
+/* Called on each matched value, returns false to stop the execution */
+typedef bool (*JsonPathVisitFunc)(void* match, void* user_data);
+
+static bool json_path_eval(const JsonPath* path,
+                           size_t step_index,
+                           Json* json,
+                           JsonValue* value,
+                           JsonPathVisitFunc visit,
+                           void* user_data)
+{
+    const JsonPathStep* step;
+    JsonDictIterator iterator;
+    JsonKeyValue* key_value;
+    JsonValue* child;
+    size_t size;
+    size_t i;
+
+    if(step_index == path->steps_count)
+        return visit(value, user_data);
+
+    step = &path->steps[step_index];
+
+    if(json_is_array(value))
+    {
+        if(step->wildcard)
+        {
+            size = json_array_get_size(value);
+
+            for(i = 0; i < size; i++)
+                if(!json_path_eval(path, step_index + 1, json, json_array_get(value, i), visit, user_data))
+                    return false;
+        }
+        else if(step->has_index && step->index < json_array_get_size(value))
+        {
+            return json_path_eval(path, step_index + 1, json, json_array_get(value, step->index), visit, user_data);
+        }
+    }
+    else if(json_is_dict(value))
+    {
+        if(step->wildcard)
+        {
+            memset(&iterator, 0, sizeof(JsonDictIterator));
+
+            while((key_value = json_dict_get_next(json, value, &iterator)) != NULL)
+                if(!json_path_eval(path, step_index + 1, json, key_value->value, visit, user_data))
+                    return false;
+        }
+        else if(step->has_key)
+        {
+            child = json_dict_find_hashed(json, value, step->key, step->hash);
+
+            if(child != NULL)
+                return json_path_eval(path, step_index + 1, json, child, visit, user_data);
+        }
+    }
+
+    return true;
+}
+
+static bool json_path_eval_cursor(const JsonPath* path,
+                                  size_t step_index,
+                                  const JsonCursor* cursor,
+                                  JsonPathVisitFunc visit,
+                                  void* user_data)
+{
+    const JsonPathStep* step;
+    JsonCursorType type;
+    JsonCursor child;
+    size_t i;
+
+    if(step_index == path->steps_count)
+        return visit((void*)cursor, user_data);
+
+    step = &path->steps[step_index];
+    type = json_cursor_get_type(cursor);
+
+    if(type != JsonCursorType_Array && type != JsonCursorType_Dict)
+        return true;
+
+    if(step->wildcard)
+    {
+        if(!json_cursor_first_element(cursor, &child))
+            return true;
+
+        do
+        {
+            if(!json_path_eval_cursor(path, step_index + 1, &child, visit, user_data))
+                return false;
+        }
+        while(json_cursor_next_element(&child));
+    }
+    else if(type == JsonCursorType_Array && step->has_index)
+    {
+        /* Preceding elements are skipped without being parsed */
+        if(!json_cursor_first_element(cursor, &child))
+            return true;
+
+        for(i = 0; i < step->index; i++)
+            if(!json_cursor_next_element(&child))
+                return true;
+
+        return json_path_eval_cursor(path, step_index + 1, &child, visit, user_data);
+    }
+    else if(type == JsonCursorType_Dict && step->has_key)
+    {
+        if(json_cursor_find_field(cursor, step->key, &child))
+            return json_path_eval_cursor(path, step_index + 1, &child, visit, user_data);
+    }
+
+    return true;
+}
+
+typedef struct JsonPathResults {
+    void* results;
+    size_t capacity;
+    size_t count;
+    JsonPathOutput output;
+} JsonPathResults;
+
+static bool json_path_visit_value(void* match, void* user_data)
+{
+    JsonPathResults* results = (JsonPathResults*)user_data;
+
+    ((JsonValue**)results->results)[results->count++] = (JsonValue*)match;
+
+    return results->count < results->capacity;
+}
+
+static bool json_path_visit_cursor(void* match, void* user_data)
+{
+    JsonPathResults* results = (JsonPathResults*)user_data;
+
+    ((JsonCursor*)results->results)[results->count++] = *(const JsonCursor*)match;
+
+    return results->count < results->capacity;
+}
+
+static bool json_path_visit_extract(void* match, void* user_data)
+{
+    JsonPathResults* results = (JsonPathResults*)user_data;
+    JsonValue* value = (JsonValue*)match;
+    const size_t i = results->count;
+
+    switch(results->output)
+    {
+        case JsonPathOutput_U64:
+            if(!json_is_u64(value))
+                return true;
+
+            ((uint64_t*)results->results)[i] = json_u64_get(value);
+            break;
+        case JsonPathOutput_I64:
+            if(json_is_i64(value))
+                ((int64_t*)results->results)[i] = json_i64_get(value);
+            else if(json_is_u64(value) && json_u64_get(value) <= (uint64_t)INT64_MAX)
+                ((int64_t*)results->results)[i] = (int64_t)json_u64_get(value);
+            else
+                return true;
+
+            break;
+        case JsonPathOutput_F64:
+            if(json_is_f64(value))
+                ((double*)results->results)[i] = json_f64_get(value);
+            else if(json_is_u64(value))
+                ((double*)results->results)[i] = (double)json_u64_get(value);
+            else if(json_is_i64(value))
+                ((double*)results->results)[i] = (double)json_i64_get(value);
+            else
+                return true;
+
+            break;
+        case JsonPathOutput_Bool:
+            if(!json_is_bool(value))
+                return true;
+
+            ((bool*)results->results)[i] = json_bool_get(value);
+            break;
+        case JsonPathOutput_Str:
+            if(!json_is_str(value))
+                return true;
+
+            ((const char**)results->results)[i] = json_str_get(value);
+            break;
+    }
+
+    results->count++;
+
+    return results->count < results->capacity;
+}
+
+static bool json_path_visit_extract_cursor(void* match, void* user_data)
+{
+    JsonPathResults* results = (JsonPathResults*)user_data;
+    const JsonCursor* cursor = (const JsonCursor*)match;
+    const size_t i = results->count;
+    bool converted = false;
+
+    switch(results->output)
+    {
+        case JsonPathOutput_U64:
+            converted = json_cursor_get_u64(cursor, &((uint64_t*)results->results)[i]);
+            break;
+        case JsonPathOutput_I64:
+            converted = json_cursor_get_i64(cursor, &((int64_t*)results->results)[i]);
+            break;
+        case JsonPathOutput_F64:
+            converted = json_cursor_get_f64(cursor, &((double*)results->results)[i]);
+            break;
+        case JsonPathOutput_Bool:
+            converted = json_cursor_get_bool(cursor, &((bool*)results->results)[i]);
+            break;
+        case JsonPathOutput_Str:
+            ((const char**)results->results)[i] = json_cursor_get_str(cursor, NULL);
+            converted = ((const char**)results->results)[i] != NULL;
+            break;
+    }
+
+    if(converted)
+        results->count++;
+
+    return results->count < results->capacity;
+}
+
+JsonValue* json_path_find(const JsonPath* path, Json* json, JsonValue* root)
+{
+    JsonValue* result = NULL;
+
+    json_path_find_all(path, json, root, &result, 1);
+
+    return result;
+}
+
+size_t json_path_find_all(const JsonPath* path,
+                          Json* json,
+                          JsonValue* root,
+                          JsonValue** results,
+                          size_t results_capacity)
+{
+    JsonPathResults visitor;
+
+    if(root == NULL || results_capacity == 0)
+        return 0;
+
+    visitor.results = results;
+    visitor.capacity = results_capacity;
+    visitor.count = 0;
+
+    json_path_eval(path, 0, json, root, json_path_visit_value, &visitor);
+
+    return visitor.count;
+}
+
+bool json_path_find_cursor(const JsonPath* path, const JsonCursor* root, JsonCursor* result)
+{
+    JsonPathResults visitor;
+
+    visitor.results = result;
+    visitor.capacity = 1;
+    visitor.count = 0;
+
+    json_path_eval_cursor(path, 0, root, json_path_visit_cursor, &visitor);
+
+    return visitor.count == 1;
+}
+
+size_t json_path_extract(const JsonPath* path,
+                         Json* json,
+                         JsonValue* root,
+                         JsonPathOutput output,
+                         void* out,
+                         size_t out_capacity)
+{
+    JsonPathResults visitor;
+
+    if(root == NULL || out_capacity == 0)
+        return 0;
+
+    visitor.results = out;
+    visitor.capacity = out_capacity;
+    visitor.count = 0;
+    visitor.output = output;
+
+    json_path_eval(path, 0, json, root, json_path_visit_extract, &visitor);
+
+    return visitor.count;
+}
+
+size_t json_path_extract_cursor(const JsonPath* path,
+                                const JsonCursor* root,
+                                JsonPathOutput output,
+                                void* out,
+                                size_t out_capacity)
+{
+    JsonPathResults visitor;
+
+    if(out_capacity == 0)
+        return 0;
+
+    visitor.results = out;
+    visitor.capacity = out_capacity;
+    visitor.count = 0;
+    visitor.output = output;
+
+    json_path_eval_cursor(path, 0, root, json_path_visit_extract_cursor, &visitor);
+
+    return visitor.count;
+}
@@ -0,0 +1,1340 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_stream.h"
+#include "libromano/bit.h"
+#include "libromano/error.h"
+#include "libromano/fmt.h"
+#include "libromano/parse.h"
+#include "libromano/simd.h"
+
+#include <math.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+typedef enum JsonStreamExpect {
+    JsonStreamExpect_Value,
+    JsonStreamExpect_ArrayValue,
+    JsonStreamExpect_ArrayValueOrEnd,
+    JsonStreamExpect_Key,
+    JsonStreamExpect_KeyOrEnd,
+    JsonStreamExpect_Colon,
+    JsonStreamExpect_CommaOrEnd,
+} JsonStreamExpect;
+
+typedef enum JsonStreamFill {
+    JsonStreamFill_Ok,
+    JsonStreamFill_End,
+    JsonStreamFill_NeedMoreData,
+    JsonStreamFill_Error,
+} JsonStreamFill;
+
+struct JsonStream {
+    JsonStreamReadFunc read_func;
+    void* user_data;
+    FILE* file;
+    Socket socket;
+
+    /* The buffer holds one more byte than its capacity, to null-terminate the data */
+    char* buffer;
+    size_t capacity;
+    size_t chunk_size;
+    size_t pos;
+    size_t end;
+
+    /* Progress of the string being scanned, relative to pos, to resume after a refill */
+    size_t token_scan;
+    bool token_has_escape;
+
+    bool eof;
+    bool error;
+
+    JsonStreamExpect expect;
+    size_t depth;
+    uint64_t dicts[JSON_STREAM_MAX_DEPTH / 64];
+};
+
+/* Sources */
+
+ssize_t json_stream_read_file(void* user_data, char* buffer, size_t buffer_size)
+{
+    FILE* file = (FILE*)user_data;
+    size_t read_size;
+
+    read_size = fread(buffer, sizeof(char), buffer_size, file);
+
+    if(read_size == 0 && ferror(file))
+        return -1;
+
+    return (ssize_t)read_size;
+}
+
+ssize_t json_stream_read_socket(void* user_data, char* buffer, size_t buffer_size)
+{
+    return socket_recv(*(Socket*)user_data, buffer, buffer_size, 0);
+}
+
+JsonStream* json_stream_new(JsonStreamReadFunc read_func, void* user_data, size_t chunk_size)
+{
+    JsonStream* stream;
+
+    if(chunk_size == 0)
+        chunk_size = JSON_STREAM_DEFAULT_CHUNK_SIZE;
+
+    stream = (JsonStream*)calloc(1, sizeof(JsonStream));
+
+    if(stream == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    stream->buffer = (char*)malloc(chunk_size + 1);
+
+    if(stream->buffer == NULL)
+    {
+        free(stream);
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    stream->buffer[0] = '\0';
+    stream->read_func = read_func;
+    stream->user_data = user_data;
+    stream->capacity = chunk_size;
+    stream->chunk_size = chunk_size;
+    stream->expect = JsonStreamExpect_Value;
+
+    return stream;
+}
+
+JsonStream* json_stream_new_from_file(const char* file_path, size_t chunk_size)
+{
+    JsonStream* stream;
+    FILE* file;
+
+    file = fopen(file_path, "rb");
+
+    if(file == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        return NULL;
+    }
+
+    stream = json_stream_new(json_stream_read_file, file, chunk_size);
+
+    if(stream == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    stream->file = file;
+
+    return stream;
+}
+
+JsonStream* json_stream_new_from_socket(Socket socket, size_t chunk_size)
+{
+    JsonStream* stream;
+
+    stream = json_stream_new(json_stream_read_socket, NULL, chunk_size);
+
+    if(stream == NULL)
+        return NULL;
+
+    stream->socket = socket;
+    stream->user_data = &stream->socket;
+
+    return stream;
+}
+
+/* Buffer management */
+
+/*
+ * Moves the unconsumed data to the front of the buffer
+ */
+ROMANO_FORCE_INLINE void json_stream_compact(JsonStream* stream)
+{
+    if(stream->pos == 0)
+        return;
+
+    memmove(stream->buffer, stream->buffer + stream->pos, stream->end - stream->pos);
+    stream->end -= stream->pos;
+    stream->pos = 0;
+}
+
+bool json_stream_grow(JsonStream* stream, size_t min_capacity)
+{
+    size_t new_capacity;
+    char* new_buffer;
+
+    new_capacity = stream->capacity;
+
+    while(new_capacity < min_capacity)
+        new_capacity *= 2;
+
+    new_buffer = (char*)realloc(stream->buffer, new_capacity + 1);
+
+    if(new_buffer == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    stream->buffer = new_buffer;
+    stream->capacity = new_capacity;
+
+    return true;
+}
+
+/*
+ * Makes more input available, keeping the data from pos (the token being read)
+ */
+JsonStreamFill json_stream_fill(JsonStream* stream)
+{
+    ssize_t read_size;
+    size_t max_read_size;
+
+    if(stream->eof)
+        return JsonStreamFill_End;
+
+    if(stream->read_func == NULL)
+        return JsonStreamFill_NeedMoreData;
+
+    json_stream_compact(stream);
+
+    if(stream->end == stream->capacity)
+    {
+        /* A single token fills the whole buffer */
+        if(stream->capacity >= stream->chunk_size + JSON_STREAM_MAX_TOKEN_SIZE)
+        {
+            g_current_error = ErrorCode_SizeOverflow;
+            return JsonStreamFill_Error;
+        }
+
+        if(!json_stream_grow(stream, stream->capacity + 1))
+            return JsonStreamFill_Error;
+    }
+
+    max_read_size = stream->capacity - stream->end;
+
+    if(max_read_size > stream->chunk_size)
+        max_read_size = stream->chunk_size;
+
+    read_size = stream->read_func(stream->user_data, stream->buffer + stream->end, max_read_size);
+
+    if(read_size < 0)
+    {
+        g_current_error = error_get_last_from_system();
+        return JsonStreamFill_Error;
+    }
+
+    if(read_size == 0)
+    {
+        stream->eof = true;
+        return JsonStreamFill_End;
+    }
+
+    stream->end += (size_t)read_size;
+    stream->buffer[stream->end] = '\0';
+
+    return JsonStreamFill_Ok;
+}
+
+bool json_stream_feed(JsonStream* stream, const char* data, size_t data_size)
+{
+    json_stream_compact(stream);
+
+    if(stream->end + data_size > stream->capacity &&
+       !json_stream_grow(stream, stream->end + data_size))
+        return false;
+
+    memcpy(stream->buffer + stream->end, data, data_size);
+    stream->end += data_size;
+    stream->buffer[stream->end] = '\0';
+
+    return true;
+}
+
+void json_stream_finish(JsonStream* stream)
+{
+    stream->eof = true;
+}
+
+/* Tokenizer */
+
+ROMANO_FORCE_INLINE bool json_stream_is_whitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+ROMANO_FORCE_INLINE bool json_stream_is_delimiter(char c)
+{
+    switch(c)
+    {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case ',':
+        case ':':
+        case '[':
+        case ']':
+        case '{':
+        case '}':
+        case '"':
+            return true;
+        default:
+            return false;
+    }
+}
+
+ROMANO_FORCE_INLINE bool json_stream_expects_value(JsonStream* stream)
+{
+    return stream->expect == JsonStreamExpect_Value ||
+           stream->expect == JsonStreamExpect_ArrayValue ||
+           stream->expect == JsonStreamExpect_ArrayValueOrEnd;
+}
+
+ROMANO_FORCE_INLINE bool json_stream_in_dict(JsonStream* stream)
+{
+    const size_t level = stream->depth - 1;
+
+    return stream->depth > 0 && (stream->dicts[level / 64] & (1ULL << (level % 64))) != 0;
+}
+
+ROMANO_FORCE_INLINE void json_stream_value_done(JsonStream* stream)
+{
+    stream->expect = stream->depth == 0 ? JsonStreamExpect_Value : JsonStreamExpect_CommaOrEnd;
+}
+
+ROMANO_FORCE_INLINE JsonTokenType json_stream_error(JsonStream* stream, JsonToken* token, ErrorCode error)
+{
+    g_current_error = error;
+    stream->error = true;
+    token->type = JsonTokenType_Error;
+
+    return JsonTokenType_Error;
+}
+
+bool json_stream_parse_number(const char* str, size_t str_sz, JsonToken* token)
+{
+    ParsedNumber number;
+    size_t number_sz;
+
+    /* The scalar must be a single number */
+    if(!parse_number(str, str_sz, ParseFlags_Json, &number, &number_sz) || number_sz != str_sz)
+        return false;
+
+    switch(number.type)
+    {
+        case ParsedNumberType_U64:
+            token->type = JsonTokenType_U64;
+            token->value.u64 = number.value.u64;
+            break;
+        case ParsedNumberType_I64:
+            token->type = JsonTokenType_I64;
+            token->value.i64 = number.value.i64;
+            break;
+        default:
+            token->type = JsonTokenType_F64;
+            token->value.f64 = number.value.f64;
+            break;
+    }
+
+    return true;
+}
+
+JsonTokenType json_stream_read_string(JsonStream* stream, JsonToken* token, JsonTokenType type)
+{
+    JsonStreamFill fill;
+    char* str;
+    size_t str_sz;
+    size_t i;
+    char c;
+
+    i = stream->pos + 1 + stream->token_scan;
+
+    while(true)
+    {
+        while(i < stream->end)
+        {
+            c = stream->buffer[i];
+
+            if(c == '"')
+                goto found;
+
+            if(c == '\\')
+            {
+                if(i + 1 >= stream->end)
+                    break;
+
+                stream->token_has_escape = true;
+                i += 2;
+                continue;
+            }
+
+            if((unsigned char)c < 0x20)
+                return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+            i++;
+        }
+
+        stream->token_scan = i - stream->pos - 1;
+
+        fill = json_stream_fill(stream);
+
+        if(fill == JsonStreamFill_NeedMoreData)
+            return token->type = JsonTokenType_NeedMoreData;
+        else if(fill == JsonStreamFill_End)
+            return json_stream_error(stream, token, ErrorCode_JsonUnterminatedString);
+        else if(fill == JsonStreamFill_Error)
+            return json_stream_error(stream, token, g_current_error);
+
+        i = stream->pos + 1 + stream->token_scan;
+    }
+
+found:
+    str = stream->buffer + stream->pos + 1;
+    str_sz = i - stream->pos - 1;
+    stream->buffer[i] = '\0';
+
+    if(stream->token_has_escape && !json_unescape(str, str, str_sz, &str_sz))
+        return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+    stream->pos = i + 1;
+    stream->token_scan = 0;
+    stream->token_has_escape = false;
+
+    token->type = type;
+    token->value.str = str;
+    token->str_size = str_sz;
+
+    return type;
+}
+
+JsonTokenType json_stream_read_scalar(JsonStream* stream, JsonToken* token)
+{
+    JsonStreamFill fill;
+    const char* str;
+    size_t str_sz;
+    size_t i;
+
+    i = stream->pos;
+
+    while(true)
+    {
+        while(i < stream->end && !json_stream_is_delimiter(stream->buffer[i]))
+            i++;
+
+        if(i < stream->end || stream->eof)
+            break;
+
+        str_sz = i - stream->pos;
+
+        fill = json_stream_fill(stream);
+
+        if(fill == JsonStreamFill_NeedMoreData)
+            return token->type = JsonTokenType_NeedMoreData;
+        else if(fill == JsonStreamFill_Error)
+            return json_stream_error(stream, token, g_current_error);
+
+        i = stream->pos + str_sz;
+    }
+
+    str = stream->buffer + stream->pos;
+    str_sz = i - stream->pos;
+
+    if(str_sz == 4 && memcmp(str, "null", 4) == 0)
+    {
+        token->type = JsonTokenType_Null;
+    }
+    else if(str_sz == 4 && memcmp(str, "true", 4) == 0)
+    {
+        token->type = JsonTokenType_Bool;
+        token->value.b = true;
+    }
+    else if(str_sz == 5 && memcmp(str, "false", 5) == 0)
+    {
+        token->type = JsonTokenType_Bool;
+        token->value.b = false;
+    }
+    else if(!json_stream_parse_number(str, str_sz, token))
+    {
+        return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+    }
+
+    stream->pos = i;
+
+    return token->type;
+}
+
+JsonTokenType json_stream_next(JsonStream* stream, JsonToken* token)
+{
+    JsonStreamFill fill;
+    JsonTokenType type;
+    size_t level;
+    char c;
+
+    if(stream->error)
+        return token->type = JsonTokenType_Error;
+
+    while(true)
+    {
+        while(stream->pos < stream->end && json_stream_is_whitespace(stream->buffer[stream->pos]))
+            stream->pos++;
+
+        if(stream->pos == stream->end)
+        {
+            fill = json_stream_fill(stream);
+
+            if(fill == JsonStreamFill_Ok)
+                continue;
+            else if(fill == JsonStreamFill_NeedMoreData)
+                return token->type = JsonTokenType_NeedMoreData;
+            else if(fill == JsonStreamFill_Error)
+                return json_stream_error(stream, token, g_current_error);
+
+            if(stream->depth != 0 || stream->expect != JsonStreamExpect_Value)
+                return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+            return token->type = JsonTokenType_End;
+        }
+
+        c = stream->buffer[stream->pos];
+
+        switch(c)
+        {
+            case '{':
+            case '[':
+                if(!json_stream_expects_value(stream))
+                    return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+                if(stream->depth == JSON_STREAM_MAX_DEPTH)
+                    return json_stream_error(stream, token, ErrorCode_JsonMaxDepthExceeded);
+
+                level = stream->depth++;
+
+                if(c == '{')
+                    stream->dicts[level / 64] |= 1ULL << (level % 64);
+                else
+                    stream->dicts[level / 64] &= ~(1ULL << (level % 64));
+
+                stream->pos++;
+                stream->expect = c == '{' ? JsonStreamExpect_KeyOrEnd : JsonStreamExpect_ArrayValueOrEnd;
+
+                return token->type = c == '{' ? JsonTokenType_BeginDict : JsonTokenType_BeginArray;
+
+            case '}':
+            case ']':
+                if(stream->depth == 0 || json_stream_in_dict(stream) != (c == '}'))
+                    return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+                if(stream->expect != JsonStreamExpect_CommaOrEnd &&
+                   stream->expect != (c == '}' ? JsonStreamExpect_KeyOrEnd : JsonStreamExpect_ArrayValueOrEnd))
+                    return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+                stream->depth--;
+                stream->pos++;
+                json_stream_value_done(stream);
+
+                return token->type = c == '}' ? JsonTokenType_EndDict : JsonTokenType_EndArray;
+
+            case ',':
+                if(stream->expect != JsonStreamExpect_CommaOrEnd)
+                    return json_stream_error(stream, token, ErrorCode_JsonUnexpectedCharacter);
+
+                stream->pos++;
+                stream->expect = json_stream_in_dict(stream) ? JsonStreamExpect_Key : JsonStreamExpect_ArrayValue;
+                continue;
+
+            case ':':
+                if(stream->expect != JsonStreamExpect_Colon)
+                {
+                    return json_stream_error(stream,
+                                             token,
+                                             stream->expect == JsonStreamExpect_Key ? ErrorCode_JsonExpectedKey :
+                                                                                      ErrorCode_JsonUnexpectedCharacter);
+                }
+
+                stream->pos++;
+                stream->expect = JsonStreamExpect_Value;
+                continue;
+
+            case '"':
+                if(stream->expect == JsonStreamExpect_Key || stream->expect == JsonStreamExpect_KeyOrEnd)
+                {
+                    type = json_stream_read_string(stream, token, JsonTokenType_Key);
+
+                    if(type == JsonTokenType_Key)
+                        stream->expect = JsonStreamExpect_Colon;
+
+                    return type;
+                }
+
+                if(!json_stream_expects_value(stream))
+                {
+                    return json_stream_error(stream,
+                                             token,
+                                             stream->expect == JsonStreamExpect_Colon ? ErrorCode_JsonExpectedColon :
+                                                                                        ErrorCode_JsonUnexpectedCharacter);
+                }
+
+                type = json_stream_read_string(stream, token, JsonTokenType_Str);
+
+                if(type == JsonTokenType_Str)
+                    json_stream_value_done(stream);
+
+                return type;
+
+            default:
+                if(!json_stream_expects_value(stream))
+                {
+                    return json_stream_error(stream,
+                                             token,
+                                             stream->expect == JsonStreamExpect_Key ||
+                                             stream->expect == JsonStreamExpect_KeyOrEnd ? ErrorCode_JsonExpectedKey :
+                                                                                           ErrorCode_JsonUnexpectedCharacter);
+                }
+
+                type = json_stream_read_scalar(stream, token);
+
+                if(type != JsonTokenType_NeedMoreData && type != JsonTokenType_Error)
+                    json_stream_value_done(stream);
+
+                return type;
+        }
+    }
+}
+
+size_t json_stream_get_depth(JsonStream* stream)
+{
+    return stream->depth;
+}
+
+bool json_stream_parse(JsonStream* stream, const JsonSaxCallbacks* callbacks, void* user_data)
+{
+    JsonToken token;
+    bool keep_going;
+
+    while(true)
+    {
+        switch(json_stream_next(stream, &token))
+        {
+            case JsonTokenType_BeginDict:
+                keep_going = callbacks->begin_dict == NULL || callbacks->begin_dict(user_data);
+                break;
+            case JsonTokenType_EndDict:
+                keep_going = callbacks->end_dict == NULL || callbacks->end_dict(user_data);
+                break;
+            case JsonTokenType_BeginArray:
+                keep_going = callbacks->begin_array == NULL || callbacks->begin_array(user_data);
+                break;
+            case JsonTokenType_EndArray:
+                keep_going = callbacks->end_array == NULL || callbacks->end_array(user_data);
+                break;
+            case JsonTokenType_Key:
+                keep_going = callbacks->key == NULL || callbacks->key(user_data, token.value.str, token.str_size);
+                break;
+            case JsonTokenType_Str:
+            case JsonTokenType_U64:
+            case JsonTokenType_I64:
+            case JsonTokenType_F64:
+            case JsonTokenType_Bool:
+            case JsonTokenType_Null:
+                keep_going = callbacks->scalar == NULL || callbacks->scalar(user_data, &token);
+                break;
+            case JsonTokenType_NeedMoreData:
+            case JsonTokenType_End:
+                return true;
+            case JsonTokenType_Error:
+            default:
+                return false;
+        }
+
+        if(!keep_going)
+            return false;
+    }
+}
+
+void json_stream_free(JsonStream* stream)
+{
+    if(stream->file != NULL)
+        fclose(stream->file);
+
+    free(stream->buffer);
+    free(stream);
+}
+
+/********************/
+/* Streaming writer */
+/********************/
+
+#define JSON_STREAM_WRITER_MIN_BUFFER_SIZE 64
+
+struct JsonStreamWriter {
+    JsonStreamWriteFunc write_func;
+    void* user_data;
+    FILE* file;
+    Socket socket;
+
+    char* buffer;
+    size_t capacity;
+    size_t size;
+
+    size_t indent_size;
+    size_t depth;
+    uint64_t dicts[JSON_STREAM_MAX_DEPTH / 64];
+
+    /* The current container holds elements, a separator precedes the next one */
+    bool has_elements;
+    /* A key has been written, its value is expected */
+    bool has_key;
+    /* A top-level value has been written, the next one goes on a new line */
+    bool has_root;
+
+    bool error;
+};
+
+/* Sinks */
+
+bool json_stream_write_file(void* user_data, const char* data, size_t data_size)
+{
+    if(fwrite(data, sizeof(char), data_size, (FILE*)user_data) != data_size)
+    {
+        g_current_error = error_get_last_from_system();
+        return false;
+    }
+
+    return true;
+}
+
+bool json_stream_write_socket(void* user_data, const char* data, size_t data_size)
+{
+    ssize_t sent;
+
+    while(data_size > 0)
+    {
+        sent = socket_send(*(Socket*)user_data, data, data_size, 0);
+
+        if(sent <= 0)
+        {
+            g_current_error = error_get_last_from_system();
+            return false;
+        }
+
+        data += sent;
+        data_size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+bool json_stream_write_buffer(void* user_data, const char* data, size_t data_size)
+{
+    return buffer_append((Buffer*)user_data, data, data_size);
+}
+
+JsonStreamWriter* json_stream_writer_new(JsonStreamWriteFunc write_func,
+                                         void* user_data,
+                                         size_t buffer_size,
+                                         size_t indent_size)
+{
+    JsonStreamWriter* writer;
+
+    if(buffer_size == 0)
+        buffer_size = JSON_STREAM_WRITER_DEFAULT_BUFFER_SIZE;
+
+    /* Numbers and escape sequences are formatted in the buffer at once */
+    if(buffer_size < JSON_STREAM_WRITER_MIN_BUFFER_SIZE)
+        buffer_size = JSON_STREAM_WRITER_MIN_BUFFER_SIZE;
+
+    writer = (JsonStreamWriter*)calloc(1, sizeof(JsonStreamWriter));
+
+    if(writer == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    writer->buffer = (char*)malloc(buffer_size);
+
+    if(writer->buffer == NULL)
+    {
+        free(writer);
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    writer->write_func = write_func;
+    writer->user_data = user_data;
+    writer->capacity = buffer_size;
+    writer->indent_size = indent_size;
+
+    return writer;
+}
+
+JsonStreamWriter* json_stream_writer_new_to_file(const char* file_path, size_t buffer_size, size_t indent_size)
+{
+    JsonStreamWriter* writer;
+    FILE* file;
+
+    file = fopen(file_path, "wb");
+
+    if(file == NULL)
+    {
+        g_current_error = error_get_last_from_system();
+        return NULL;
+    }
+
+    writer = json_stream_writer_new(json_stream_write_file, file, buffer_size, indent_size);
+
+    if(writer == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    writer->file = file;
+
+    return writer;
+}
+
+JsonStreamWriter* json_stream_writer_new_to_socket(Socket socket, size_t buffer_size, size_t indent_size)
+{
+    JsonStreamWriter* writer;
+
+    writer = json_stream_writer_new(json_stream_write_socket, NULL, buffer_size, indent_size);
+
+    if(writer == NULL)
+        return NULL;
+
+    writer->socket = socket;
+    writer->user_data = &writer->socket;
+
+    return writer;
+}
+
+JsonStreamWriter* json_stream_writer_new_to_buffer(Buffer* buffer, size_t buffer_size, size_t indent_size)
+{
+    return json_stream_writer_new(json_stream_write_buffer, buffer, buffer_size, indent_size);
+}
+
+/* Output */
+
+ROMANO_FORCE_INLINE bool json_stream_writer_fail(JsonStreamWriter* writer, ErrorCode error)
+{
+    writer->error = true;
+    g_current_error = error;
+
+    return false;
+}
+
+bool json_stream_writer_flush_buffer(JsonStreamWriter* writer)
+{
+    if(writer->size == 0)
+        return true;
+
+    /* The write function sets the error */
+    if(!writer->write_func(writer->user_data, writer->buffer, writer->size))
+    {
+        writer->error = true;
+        return false;
+    }
+
+    writer->size = 0;
+
+    return true;
+}
+
+/* Makes room for size bytes in the buffer, size being at most JSON_STREAM_WRITER_MIN_BUFFER_SIZE */
+ROMANO_FORCE_INLINE bool json_stream_writer_reserve(JsonStreamWriter* writer, size_t size)
+{
+    if(writer->capacity - writer->size >= size)
+        return true;
+
+    return json_stream_writer_flush_buffer(writer);
+}
+
+ROMANO_FORCE_INLINE bool json_stream_writer_char(JsonStreamWriter* writer, char c)
+{
+    if(!json_stream_writer_reserve(writer, 1))
+        return false;
+
+    writer->buffer[writer->size++] = c;
+
+    return true;
+}
+
+bool json_stream_writer_bytes(JsonStreamWriter* writer, const char* data, size_t data_size)
+{
+    if(writer->capacity - writer->size < data_size)
+    {
+        if(!json_stream_writer_flush_buffer(writer))
+            return false;
+
+        /* Large data skips the buffer */
+        if(data_size >= writer->capacity)
+        {
+            if(!writer->write_func(writer->user_data, data, data_size))
+            {
+                writer->error = true;
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    memcpy(writer->buffer + writer->size, data, data_size);
+    writer->size += data_size;
+
+    return true;
+}
+
+bool json_stream_writer_newline(JsonStreamWriter* writer, size_t depth)
+{
+    size_t indent = depth * writer->indent_size;
+    size_t size;
+
+    if(!json_stream_writer_char(writer, '\n'))
+        return false;
+
+    while(indent > 0)
+    {
+        if(writer->size == writer->capacity && !json_stream_writer_flush_buffer(writer))
+            return false;
+
+        size = writer->capacity - writer->size < indent ? writer->capacity - writer->size : indent;
+
+        memset(writer->buffer + writer->size, ' ', size);
+        writer->size += size;
+        indent -= size;
+    }
+
+    return true;
+}
+
+/*
+ * Returns the position of the first character of str[0, str_size) to escape (quote, backslash and
+ * control characters), or str_size if there is none
+ */
+#if defined(__AVX2__)
+ROMANO_FORCE_INLINE size_t json_stream_find_escape(const char* str, size_t str_size)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    size_t pos = 0;
+    uint32_t mask;
+
+    while(pos + 32 <= str_size)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(str + pos));
+
+        /* Unsigned v <= 0x1F */
+        const __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v);
+
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                                              _mm256_cmpeq_epi8(v, backslash)),
+                                                              is_control));
+
+        if(mask != 0)
+            return pos + (size_t)ctz_u64((uint64_t)mask);
+
+        pos += 32;
+    }
+
+    while(pos < str_size && (unsigned char)str[pos] >= 0x20 && str[pos] != '"' && str[pos] != '\\')
+        pos++;
+
+    return pos;
+}
+#elif defined(ROMANO_AARCH64)
+ROMANO_FORCE_INLINE size_t json_stream_find_escape(const char* str, size_t str_size)
+{
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    size_t pos = 0;
+
+    while(pos + 16 <= str_size)
+    {
+        const uint8x16_t v = vld1q_u8((const uint8_t*)str + pos);
+        const uint8x16_t matches = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, control));
+
+        if(vmaxvq_u8(matches) != 0)
+            break;
+
+        pos += 16;
+    }
+
+    while(pos < str_size && (unsigned char)str[pos] >= 0x20 && str[pos] != '"' && str[pos] != '\\')
+        pos++;
+
+    return pos;
+}
+#else
+ROMANO_FORCE_INLINE size_t json_stream_find_escape(const char* str, size_t str_size)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t word;
+    uint64_t quotes;
+    uint64_t backslashes;
+    size_t pos = 0;
+
+    /* SWAR: 8 bytes at a time, flags bytes equal to '"' or '\\', or lower than 0x20 */
+    while(pos + 8 <= str_size)
+    {
+        memcpy(&word, str + pos, sizeof(uint64_t));
+
+        quotes = word ^ (ones * '"');
+        backslashes = word ^ (ones * '\\');
+
+        if((((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes) | ((word - ones * 0x20) & ~word)) & highs)
+            break;
+
+        pos += 8;
+    }
+
+    while(pos < str_size && (unsigned char)str[pos] >= 0x20 && str[pos] != '"' && str[pos] != '\\')
+        pos++;
+
+    return pos;
+}
+#endif /* defined(__AVX2__) */
+
+bool json_stream_writer_escaped_str(JsonStreamWriter* writer, const char* str, size_t str_size)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t run;
+    unsigned char c;
+    char* escape;
+
+    if(!json_stream_writer_char(writer, '"'))
+        return false;
+
+    while(str_size > 0)
+    {
+        run = json_stream_find_escape(str, str_size);
+
+        if(run > 0 && !json_stream_writer_bytes(writer, str, run))
+            return false;
+
+        str += run;
+        str_size -= run;
+
+        if(str_size == 0)
+            break;
+
+        if(!json_stream_writer_reserve(writer, 6))
+            return false;
+
+        c = (unsigned char)*str;
+        escape = writer->buffer + writer->size;
+        escape[0] = '\\';
+
+        switch(c)
+        {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex_digits[c >> 4];
+                escape[5] = hex_digits[c & 0xF];
+                writer->size += 4;
+                break;
+        }
+
+        writer->size += 2;
+        str++;
+        str_size--;
+    }
+
+    return json_stream_writer_char(writer, '"');
+}
+
+/* Structure */
+
+ROMANO_FORCE_INLINE bool json_stream_writer_in_dict(JsonStreamWriter* writer)
+{
+    return writer->depth > 0 && (writer->dicts[(writer->depth - 1) / 64] & ((uint64_t)1 << ((writer->depth - 1) % 64)));
+}
+
+/* Writes what precedes a value: the separator and the indentation of array elements */
+bool json_stream_writer_begin_value(JsonStreamWriter* writer)
+{
+    if(writer->error)
+        return false;
+
+    if(writer->depth == 0)
+    {
+        if(writer->has_root && !json_stream_writer_char(writer, '\n'))
+            return false;
+
+        writer->has_root = true;
+
+        return true;
+    }
+
+    if(json_stream_writer_in_dict(writer))
+    {
+        if(!writer->has_key)
+            return json_stream_writer_fail(writer, ErrorCode_JsonExpectedKey);
+
+        writer->has_key = false;
+
+        return true;
+    }
+
+    if(writer->has_elements && !json_stream_writer_char(writer, ','))
+        return false;
+
+    writer->has_elements = true;
+
+    return writer->indent_size == 0 || json_stream_writer_newline(writer, writer->depth);
+}
+
+bool json_stream_writer_begin(JsonStreamWriter* writer, char c, bool dict)
+{
+    if(!json_stream_writer_begin_value(writer))
+        return false;
+
+    if(writer->depth == JSON_STREAM_MAX_DEPTH)
+        return json_stream_writer_fail(writer, ErrorCode_JsonMaxDepthExceeded);
+
+    if(!json_stream_writer_char(writer, c))
+        return false;
+
+    if(dict)
+        writer->dicts[writer->depth / 64] |= (uint64_t)1 << (writer->depth % 64);
+    else
+        writer->dicts[writer->depth / 64] &= ~((uint64_t)1 << (writer->depth % 64));
+
+    writer->depth++;
+    writer->has_elements = false;
+
+    return true;
+}
+
+bool json_stream_writer_end(JsonStreamWriter* writer, char c, bool dict)
+{
+    if(writer->error)
+        return false;
+
+    if(writer->depth == 0 || json_stream_writer_in_dict(writer) != dict || writer->has_key)
+        return json_stream_writer_fail(writer, ErrorCode_JsonUnexpectedCharacter);
+
+    if(writer->indent_size > 0 && !json_stream_writer_newline(writer, writer->depth - 1))
+        return false;
+
+    writer->depth--;
+
+    /* The parent holds the closed container */
+    writer->has_elements = true;
+
+    return json_stream_writer_char(writer, c);
+}
+
+bool json_stream_writer_begin_dict(JsonStreamWriter* writer)
+{
+    return json_stream_writer_begin(writer, '{', true);
+}
+
+bool json_stream_writer_end_dict(JsonStreamWriter* writer)
+{
+    return json_stream_writer_end(writer, '}', true);
+}
+
+bool json_stream_writer_begin_array(JsonStreamWriter* writer)
+{
+    return json_stream_writer_begin(writer, '[', false);
+}
+
+bool json_stream_writer_end_array(JsonStreamWriter* writer)
+{
+    return json_stream_writer_end(writer, ']', false);
+}
+
+bool json_stream_writer_key(JsonStreamWriter* writer, const char* key, size_t key_size)
+{
+    if(writer->error)
+        return false;
+
+    if(!json_stream_writer_in_dict(writer) || writer->has_key)
+        return json_stream_writer_fail(writer, ErrorCode_JsonUnexpectedCharacter);
+
+    if(writer->has_elements && !json_stream_writer_char(writer, ','))
+        return false;
+
+    if(writer->indent_size > 0 && !json_stream_writer_newline(writer, writer->depth))
+        return false;
+
+    if(!json_stream_writer_escaped_str(writer, key, key_size) || !json_stream_writer_bytes(writer, ": ", 2))
+        return false;
+
+    writer->has_elements = true;
+    writer->has_key = true;
+
+    return true;
+}
+
+/* Values */
+
+bool json_stream_writer_str(JsonStreamWriter* writer, const char* str, size_t str_size)
+{
+    return json_stream_writer_begin_value(writer) && json_stream_writer_escaped_str(writer, str, str_size);
+}
+
+bool json_stream_writer_u64(JsonStreamWriter* writer, uint64_t u64)
+{
+    if(!json_stream_writer_begin_value(writer) || !json_stream_writer_reserve(writer, 20))
+        return false;
+
+    writer->size += (size_t)fmt_u64(writer->buffer + writer->size, u64);
+
+    return true;
+}
+
+bool json_stream_writer_i64(JsonStreamWriter* writer, int64_t i64)
+{
+    if(!json_stream_writer_begin_value(writer) || !json_stream_writer_reserve(writer, 21))
+        return false;
+
+    writer->size += (size_t)fmt_i64(writer->buffer + writer->size, i64);
+
+    return true;
+}
+
+bool json_stream_writer_f64(JsonStreamWriter* writer, double f64)
+{
+    char buffer[FMT_F64_SHORTEST_MAX_SIZE];
+    int buffer_size;
+
+    if(!json_stream_writer_begin_value(writer))
+        return false;
+
+    if(isnan(f64) || isinf(f64))
+        return json_stream_writer_bytes(writer, "null", 4);
+
+    buffer_size = fmt_f64_shortest(buffer, f64);
+
+    return json_stream_writer_bytes(writer, buffer, (size_t)buffer_size);
+}
+
+bool json_stream_writer_bool(JsonStreamWriter* writer, bool b)
+{
+    return json_stream_writer_begin_value(writer) && json_stream_writer_bytes(writer, b ? "true" : "false", b ? 4 : 5);
+}
+
+bool json_stream_writer_null(JsonStreamWriter* writer)
+{
+    return json_stream_writer_begin_value(writer) && json_stream_writer_bytes(writer, "null", 4);
+}
+
+bool json_stream_writer_value(JsonStreamWriter* writer, Json* json, JsonValue* value)
+{
+    JsonArrayIterator array_iterator;
+    JsonDictIterator dict_iterator;
+    JsonKeyValue* key_value;
+    JsonValue* element;
+
+    if(value == NULL)
+        return json_stream_writer_fail(writer, ErrorCode_JsonUnexpectedCharacter);
+
+    if(json_is_dict(value))
+    {
+        if(!json_stream_writer_begin_dict(writer))
+            return false;
+
+        memset(&dict_iterator, 0, sizeof(JsonDictIterator));
+
+        while((key_value = json_dict_get_next(json, value, &dict_iterator)) != NULL)
+            if(!json_stream_writer_key(writer, key_value->key, strlen(key_value->key)) ||
+               !json_stream_writer_value(writer, json, key_value->value))
+                return false;
+
+        return json_stream_writer_end_dict(writer);
+    }
+
+    if(json_is_array(value))
+    {
+        if(!json_stream_writer_begin_array(writer))
+            return false;
+
+        memset(&array_iterator, 0, sizeof(JsonArrayIterator));
+
+        while((element = json_array_get_next(json, value, &array_iterator)) != NULL)
+            if(!json_stream_writer_value(writer, json, element))
+                return false;
+
+        return json_stream_writer_end_array(writer);
+    }
+
+    if(json_is_str(value))
+        return json_stream_writer_str(writer, json_str_get(value), json_str_get_size(value));
+
+    if(json_is_u64(value))
+        return json_stream_writer_u64(writer, json_u64_get(value));
+
+    if(json_is_i64(value))
+        return json_stream_writer_i64(writer, json_i64_get(value));
+
+    if(json_is_f64(value))
+        return json_stream_writer_f64(writer, json_f64_get(value));
+
+    if(json_is_bool(value))
+        return json_stream_writer_bool(writer, json_bool_get(value));
+
+    if(json_is_null(value))
+        return json_stream_writer_null(writer);
+
+    return json_stream_writer_fail(writer, ErrorCode_JsonUnexpectedCharacter);
+}
+
+bool json_stream_writer_flush(JsonStreamWriter* writer)
+{
+    if(writer->error)
+        return false;
+
+    if(!json_stream_writer_flush_buffer(writer))
+        return false;
+
+    if(writer->file != NULL && fflush(writer->file) != 0)
+        return json_stream_writer_fail(writer, error_get_last_from_system());
+
+    return true;
+}
+
+bool json_stream_writer_free(JsonStreamWriter* writer)
+{
+    bool success;
+
+    success = json_stream_writer_flush(writer);
+
+    /* The buffered data is still written, but the document is truncated */
+    if(success && writer->depth != 0)
+        success = json_stream_writer_fail(writer, ErrorCode_JsonUnexpectedCharacter);
+
+    if(writer->file != NULL && fclose(writer->file) != 0 && success)
+    {
+        g_current_error = error_get_last_from_system();
+        success = false;
+    }
+
+    free(writer->buffer);
+    free(writer);
+
+    return success;
+}
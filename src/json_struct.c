@@ -0,0 +1,1060 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_struct.h"
+#include "libromano/json.h"
+#include "libromano/error.h"
+#include "libromano/fmt.h"
+#include "libromano/parse.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+#define JSON_STRUCT_ALIGNMENT 16
+#define JSON_STRUCT_MAX_KEY_SIZE 256
+
+typedef struct JsonStructDecoder {
+    const char* str;
+    size_t pos;
+    size_t len;
+    size_t depth;
+    Arena* arena;
+} JsonStructDecoder;
+
+ROMANO_FORCE_INLINE bool json_struct_fail(ErrorCode error)
+{
+    g_current_error = error;
+    return false;
+}
+
+ROMANO_FORCE_INLINE bool json_struct_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static size_t json_struct_type_size(JsonFieldType type, const JsonStruct* descriptor)
+{
+    switch(type)
+    {
+        case JsonFieldType_Bool:
+            return sizeof(bool);
+        case JsonFieldType_I32:
+        case JsonFieldType_U32:
+            return sizeof(uint32_t);
+        case JsonFieldType_I64:
+        case JsonFieldType_U64:
+            return sizeof(uint64_t);
+        case JsonFieldType_F32:
+            return sizeof(float);
+        case JsonFieldType_F64:
+            return sizeof(double);
+        case JsonFieldType_Str:
+            return sizeof(const char*);
+        case JsonFieldType_Struct:
+            return descriptor != NULL ? descriptor->size : 0;
+        default:
+            return 0;
+    }
+}
+
+/************/
+/* Decoding */
+/************/
+
+ROMANO_FORCE_INLINE char json_struct_peek(JsonStructDecoder* d)
+{
+    while(d->pos < d->len)
+    {
+        switch(d->str[d->pos])
+        {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                d->pos++;
+                break;
+            default:
+                return d->str[d->pos];
+        }
+    }
+
+    return '\0';
+}
+
+ROMANO_FORCE_INLINE bool json_struct_expect(JsonStructDecoder* d, char c)
+{
+    if(json_struct_peek(d) != c)
+        return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+    d->pos++;
+
+    return true;
+}
+
+/* Arena memory aligned for any field type */
+static void* json_struct_alloc(JsonStructDecoder* d, size_t size)
+{
+    char* data;
+
+    /* Strings and arrays cannot be decoded without an arena */
+    if(d->arena == NULL)
+    {
+        g_current_error = ErrorCode_JsonSchemaMismatch;
+        return NULL;
+    }
+
+    data = (char*)arena_push(d->arena, NULL, size + JSON_STRUCT_ALIGNMENT - 1);
+
+    if(data == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    return (void*)(((uintptr_t)data + JSON_STRUCT_ALIGNMENT - 1) & ~(uintptr_t)(JSON_STRUCT_ALIGNMENT - 1));
+}
+
+/*
+ * Scans the string starting at the current quote, sets start and size to its raw content and moves
+ * after the closing quote
+ */
+static bool json_struct_scan_string(JsonStructDecoder* d, size_t* start, size_t* size, bool* escaped)
+{
+    size_t pos = d->pos + 1;
+    unsigned char c;
+
+    *escaped = false;
+    *start = pos;
+
+    while(pos < d->len)
+    {
+        c = (unsigned char)d->str[pos];
+
+        if(c == '"')
+        {
+            *size = pos - *start;
+            d->pos = pos + 1;
+            return true;
+        }
+
+        if(c == '\\')
+        {
+            *escaped = true;
+            pos += 2;
+            continue;
+        }
+
+        if(c < 0x20)
+            return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+        pos++;
+    }
+
+    return json_struct_fail(ErrorCode_JsonUnterminatedString);
+}
+
+/*
+ * Scans a number, following the json grammar, and sets is_integer if it has no fraction nor
+ * exponent
+ */
+static bool json_struct_scan_number(JsonStructDecoder* d, size_t* start, bool* is_integer)
+{
+    size_t pos = d->pos;
+
+    *start = pos;
+    *is_integer = true;
+
+    if(pos < d->len && d->str[pos] == '-')
+        pos++;
+
+    if(pos >= d->len || !json_struct_is_digit(d->str[pos]))
+        return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+    if(d->str[pos] == '0')
+        pos++;
+    else
+        while(pos < d->len && json_struct_is_digit(d->str[pos]))
+            pos++;
+
+    if(pos < d->len && d->str[pos] == '.')
+    {
+        *is_integer = false;
+        pos++;
+
+        if(pos >= d->len || !json_struct_is_digit(d->str[pos]))
+            return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+        while(pos < d->len && json_struct_is_digit(d->str[pos]))
+            pos++;
+    }
+
+    if(pos < d->len && (d->str[pos] == 'e' || d->str[pos] == 'E'))
+    {
+        *is_integer = false;
+        pos++;
+
+        if(pos < d->len && (d->str[pos] == '-' || d->str[pos] == '+'))
+            pos++;
+
+        if(pos >= d->len || !json_struct_is_digit(d->str[pos]))
+            return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+        while(pos < d->len && json_struct_is_digit(d->str[pos]))
+            pos++;
+    }
+
+    d->pos = pos;
+
+    return true;
+}
+
+static bool json_struct_scan_literal(JsonStructDecoder* d, const char* literal, size_t literal_sz)
+{
+    if(d->len - d->pos < literal_sz || memcmp(d->str + d->pos, literal, literal_sz) != 0)
+        return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+    d->pos += literal_sz;
+
+    return true;
+}
+
+static bool json_struct_skip_value(JsonStructDecoder* d)
+{
+    size_t start;
+    size_t size;
+    bool flag;
+    char c;
+
+    c = json_struct_peek(d);
+
+    switch(c)
+    {
+        case '"':
+            return json_struct_scan_string(d, &start, &size, &flag);
+        case 't':
+            return json_struct_scan_literal(d, "true", 4);
+        case 'f':
+            return json_struct_scan_literal(d, "false", 5);
+        case 'n':
+            return json_struct_scan_literal(d, "null", 4);
+        case '{':
+        case '[':
+            break;
+        default:
+            return json_struct_scan_number(d, &start, &flag);
+    }
+
+    if(++d->depth > JSON_STRUCT_MAX_DEPTH)
+        return json_struct_fail(ErrorCode_JsonMaxDepthExceeded);
+
+    d->pos++;
+
+    if(json_struct_peek(d) == (c == '{' ? '}' : ']'))
+    {
+        d->pos++;
+        d->depth--;
+        return true;
+    }
+
+    while(true)
+    {
+        if(c == '{')
+        {
+            if(json_struct_peek(d) != '"')
+                return json_struct_fail(ErrorCode_JsonExpectedKey);
+
+            if(!json_struct_scan_string(d, &start, &size, &flag))
+                return false;
+
+            if(json_struct_peek(d) != ':')
+                return json_struct_fail(ErrorCode_JsonExpectedColon);
+
+            d->pos++;
+        }
+
+        if(!json_struct_skip_value(d))
+            return false;
+
+        switch(json_struct_peek(d))
+        {
+            case ',':
+                d->pos++;
+                continue;
+            case '}':
+            case ']':
+                if(d->str[d->pos] != (c == '{' ? '}' : ']'))
+                    return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+                d->pos++;
+                d->depth--;
+                return true;
+            default:
+                return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+        }
+    }
+}
+
+static bool json_struct_decode_integer(JsonStructDecoder* d, JsonFieldType type, void* out)
+{
+    size_t start;
+    size_t pos;
+    uint64_t u64;
+    uint64_t digit;
+    bool is_integer;
+    bool negative;
+
+    if(!json_struct_scan_number(d, &start, &is_integer))
+        return false;
+
+    if(!is_integer)
+        return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+    pos = start;
+    negative = d->str[pos] == '-';
+    pos += (size_t)negative;
+    u64 = 0;
+
+    for(; pos < d->pos; pos++)
+    {
+        digit = (uint64_t)(d->str[pos] - '0');
+
+        if(u64 > (UINT64_MAX - digit) / 10)
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+        u64 = u64 * 10 + digit;
+    }
+
+    switch(type)
+    {
+        case JsonFieldType_U64:
+            if(negative && u64 != 0)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            *(uint64_t*)out = u64;
+            return true;
+        case JsonFieldType_U32:
+            if((negative && u64 != 0) || u64 > UINT32_MAX)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            *(uint32_t*)out = (uint32_t)u64;
+            return true;
+        case JsonFieldType_I64:
+            if(u64 > (uint64_t)INT64_MAX + (uint64_t)negative)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            *(int64_t*)out = negative ? (int64_t)(0 - u64) : (int64_t)u64;
+            return true;
+        case JsonFieldType_I32:
+            if(u64 > (uint64_t)INT32_MAX + (uint64_t)negative)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            *(int32_t*)out = negative ? (int32_t)(0 - (uint32_t)u64) : (int32_t)u64;
+            return true;
+        default:
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+    }
+}
+
+static bool json_struct_decode_float(JsonStructDecoder* d, JsonFieldType type, void* out)
+{
+    size_t start;
+    double f64;
+    bool is_integer;
+
+    if(!json_struct_scan_number(d, &start, &is_integer))
+        return false;
+
+    /* The number has already been validated by the scan */
+    if(!parse_f64(d->str + start, d->pos - start, &f64, NULL))
+        return false;
+
+    /* Json has no infinity, an infinite result means the value overflows the field */
+    if(type == JsonFieldType_F32)
+    {
+        float f32 = (float)f64;
+
+        if(isinf(f32))
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+        *(float*)out = f32;
+    }
+    else
+    {
+        if(isinf(f64))
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+        *(double*)out = f64;
+    }
+
+    return true;
+}
+
+static bool json_struct_decode_str(JsonStructDecoder* d, const JsonField* field, JsonFieldType type, void* out)
+{
+    size_t start;
+    size_t size;
+    size_t decoded_size;
+    char* decoded;
+    bool escaped;
+
+    if(!json_struct_scan_string(d, &start, &size, &escaped))
+        return false;
+
+    if(type == JsonFieldType_Str)
+    {
+        decoded = (char*)json_struct_alloc(d, size + 1);
+
+        if(decoded == NULL)
+            return false;
+
+        *(const char**)out = decoded;
+    }
+    else
+    {
+        /* Decoded strings are never larger than their raw content */
+        if(!escaped && size >= field->size)
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+        decoded = size < field->size ? (char*)out : (char*)malloc(size + 1);
+
+        if(decoded == NULL)
+            return json_struct_fail(ErrorCode_MemAllocError);
+    }
+
+    if(!escaped)
+    {
+        memcpy(decoded, d->str + start, size);
+        decoded_size = size;
+    }
+    else if(!json_unescape(decoded, d->str + start, size, &decoded_size))
+    {
+        if(decoded != (char*)out && type == JsonFieldType_StrBuffer)
+            free(decoded);
+
+        return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+    }
+
+    if(type == JsonFieldType_Str)
+    {
+        decoded[decoded_size] = '\0';
+        return true;
+    }
+
+    if(decoded != (char*)out)
+    {
+        if(decoded_size < field->size)
+            memcpy(out, decoded, decoded_size);
+
+        free(decoded);
+
+        if(decoded_size >= field->size)
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+    }
+
+    ((char*)out)[decoded_size] = '\0';
+
+    return true;
+}
+
+static bool json_struct_decode_object(JsonStructDecoder* d, const JsonStruct* descriptor, void* out);
+
+static bool json_struct_decode_array_elements(JsonStructDecoder* d,
+                                              JsonFieldType element_type,
+                                              const JsonStruct* descriptor,
+                                              void** elements,
+                                              size_t* count);
+
+/*
+ * Decodes the value at the current position into out. Null values leave out untouched and set
+ * present to false
+ */
+static bool json_struct_decode_value(JsonStructDecoder* d,
+                                     const JsonField* field,
+                                     JsonFieldType type,
+                                     void* out,
+                                     bool* present)
+{
+    char c;
+
+    c = json_struct_peek(d);
+
+    *present = c != 'n';
+
+    if(c == 'n')
+    {
+        if(type == JsonFieldType_Str)
+            *(const char**)out = NULL;
+
+        return json_struct_scan_literal(d, "null", 4);
+    }
+
+    switch(type)
+    {
+        case JsonFieldType_Bool:
+            if(c == 't' && json_struct_scan_literal(d, "true", 4))
+                *(bool*)out = true;
+            else if(c == 'f' && json_struct_scan_literal(d, "false", 5))
+                *(bool*)out = false;
+            else
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return true;
+        case JsonFieldType_I32:
+        case JsonFieldType_I64:
+        case JsonFieldType_U32:
+        case JsonFieldType_U64:
+            if(c != '-' && !json_struct_is_digit(c))
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_decode_integer(d, type, out);
+        case JsonFieldType_F32:
+        case JsonFieldType_F64:
+            if(c != '-' && !json_struct_is_digit(c))
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_decode_float(d, type, out);
+        case JsonFieldType_Str:
+        case JsonFieldType_StrBuffer:
+            if(c != '"')
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_decode_str(d, field, type, out);
+        case JsonFieldType_Struct:
+            if(c != '{' || field->descriptor == NULL)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_decode_object(d, field->descriptor, out);
+        case JsonFieldType_Array:
+            if(c != '[')
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_decode_array_elements(d,
+                                                     field->element_type,
+                                                     field->descriptor,
+                                                     (void**)out,
+                                                     (size_t*)((char*)out - field->offset + field->count_offset));
+        default:
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+    }
+}
+
+/*
+ * Counts the elements of the array starting at the current position, without decoding them, to
+ * allocate the decoded array at once
+ */
+static size_t json_struct_count_elements(JsonStructDecoder* d)
+{
+    size_t pos = d->pos + 1;
+    size_t depth = 0;
+    size_t count = 0;
+    bool empty = true;
+    char c;
+
+    for(; pos < d->len; pos++)
+    {
+        c = d->str[pos];
+
+        switch(c)
+        {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                continue;
+            case '"':
+                for(pos++; pos < d->len && d->str[pos] != '"'; pos++)
+                    if(d->str[pos] == '\\')
+                        pos++;
+                break;
+            case '[':
+            case '{':
+                depth++;
+                break;
+            case ']':
+            case '}':
+                if(depth == 0)
+                    return empty ? 0 : count + 1;
+
+                depth--;
+                break;
+            case ',':
+                if(depth == 0)
+                    count++;
+                break;
+            default:
+                break;
+        }
+
+        empty = false;
+    }
+
+    return count + 1;
+}
+
+static bool json_struct_decode_array_elements(JsonStructDecoder* d,
+                                              JsonFieldType element_type,
+                                              const JsonStruct* descriptor,
+                                              void** elements,
+                                              size_t* count)
+{
+    JsonField element_field;
+    const size_t element_size = json_struct_type_size(element_type, descriptor);
+    const size_t capacity = json_struct_count_elements(d);
+    char* data = NULL;
+    size_t i = 0;
+    bool present;
+
+    if(element_size == 0)
+        return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+    if(++d->depth > JSON_STRUCT_MAX_DEPTH)
+        return json_struct_fail(ErrorCode_JsonMaxDepthExceeded);
+
+    if(capacity > 0)
+    {
+        if(capacity > SIZE_MAX / element_size)
+            return json_struct_fail(ErrorCode_SizeOverflow);
+
+        data = (char*)json_struct_alloc(d, capacity * element_size);
+
+        if(data == NULL)
+            return false;
+
+        memset(data, 0, capacity * element_size);
+    }
+
+    memset(&element_field, 0, sizeof(JsonField));
+    element_field.type = element_type;
+    element_field.descriptor = descriptor;
+
+    d->pos++;
+
+    if(json_struct_peek(d) == ']')
+    {
+        d->pos++;
+    }
+    else
+    {
+        while(true)
+        {
+            if(i == capacity)
+                return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+            if(!json_struct_decode_value(d, &element_field, element_type, data + i * element_size, &present))
+                return false;
+
+            i++;
+
+            if(json_struct_peek(d) == ',')
+            {
+                d->pos++;
+                continue;
+            }
+
+            if(!json_struct_expect(d, ']'))
+                return false;
+
+            break;
+        }
+    }
+
+    d->depth--;
+
+    *elements = data;
+    *count = i;
+
+    return true;
+}
+
+ROMANO_FORCE_INLINE bool json_struct_key_equals(const char* name, const char* key, size_t key_sz)
+{
+    size_t i;
+
+    for(i = 0; i < key_sz; i++)
+        if(name[i] != key[i] || name[i] == '\0')
+            return false;
+
+    return name[key_sz] == '\0';
+}
+
+/*
+ * Fields mostly appear in the order of the descriptor, the search starts after the last found one
+ */
+static const JsonField* json_struct_find_field(const JsonStruct* descriptor,
+                                               const char* key,
+                                               size_t key_sz,
+                                               size_t* hint)
+{
+    const JsonField* field;
+    size_t index;
+    size_t i;
+
+    for(i = 0; i < descriptor->fields_count; i++)
+    {
+        index = *hint + i;
+
+        if(index >= descriptor->fields_count)
+            index -= descriptor->fields_count;
+
+        field = &descriptor->fields[index];
+
+        if(json_struct_key_equals(field->name, key, key_sz))
+        {
+            *hint = index + 1 < descriptor->fields_count ? index + 1 : 0;
+            return field;
+        }
+    }
+
+    return NULL;
+}
+
+static bool json_struct_decode_object(JsonStructDecoder* d, const JsonStruct* descriptor, void* out)
+{
+    uint64_t found[JSON_STRUCT_MAX_FIELDS / 64];
+    char key_buffer[JSON_STRUCT_MAX_KEY_SIZE];
+    const JsonField* field;
+    const char* key;
+    size_t key_start;
+    size_t key_sz;
+    size_t hint = 0;
+    size_t index;
+    size_t i;
+    bool escaped;
+    bool present;
+
+    if(descriptor->fields_count > JSON_STRUCT_MAX_FIELDS)
+        return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+    if(++d->depth > JSON_STRUCT_MAX_DEPTH)
+        return json_struct_fail(ErrorCode_JsonMaxDepthExceeded);
+
+    memset(found, 0, sizeof(found));
+
+    d->pos++;
+
+    if(json_struct_peek(d) == '}')
+    {
+        d->pos++;
+    }
+    else
+    {
+        while(true)
+        {
+            if(json_struct_peek(d) != '"')
+                return json_struct_fail(ErrorCode_JsonExpectedKey);
+
+            if(!json_struct_scan_string(d, &key_start, &key_sz, &escaped))
+                return false;
+
+            key = d->str + key_start;
+
+            /* Escaped keys longer than the buffer cannot match a field and are skipped */
+            if(escaped)
+            {
+                if(key_sz <= JSON_STRUCT_MAX_KEY_SIZE && json_unescape(key_buffer, key, key_sz, &key_sz))
+                    key = key_buffer;
+                else
+                    key = NULL;
+            }
+
+            if(json_struct_peek(d) != ':')
+                return json_struct_fail(ErrorCode_JsonExpectedColon);
+
+            d->pos++;
+
+            field = key != NULL ? json_struct_find_field(descriptor, key, key_sz, &hint) : NULL;
+
+            if(field == NULL)
+            {
+                if(!json_struct_skip_value(d))
+                    return false;
+            }
+            else
+            {
+                if(!json_struct_decode_value(d, field, field->type, (char*)out + field->offset, &present))
+                    return false;
+
+                if(present)
+                {
+                    index = (size_t)(field - descriptor->fields);
+                    found[index / 64] |= (uint64_t)1 << (index % 64);
+                }
+            }
+
+            if(json_struct_peek(d) == ',')
+            {
+                d->pos++;
+                continue;
+            }
+
+            if(!json_struct_expect(d, '}'))
+                return false;
+
+            break;
+        }
+    }
+
+    d->depth--;
+
+    for(i = 0; i < descriptor->fields_count; i++)
+        if((descriptor->fields[i].flags & JsonFieldFlag_Required) && !(found[i / 64] & ((uint64_t)1 << (i % 64))))
+            return json_struct_fail(ErrorCode_JsonMissingField);
+
+    return true;
+}
+
+static void json_struct_decoder_init(JsonStructDecoder* d, const char* str, size_t str_sz, Arena* arena)
+{
+    d->str = str;
+    d->pos = 0;
+    d->len = str_sz;
+    d->depth = 0;
+    d->arena = arena;
+}
+
+ROMANO_FORCE_INLINE bool json_struct_decoder_end(JsonStructDecoder* d)
+{
+    if(json_struct_peek(d) != '\0' || d->pos != d->len)
+        return json_struct_fail(ErrorCode_JsonUnexpectedCharacter);
+
+    return true;
+}
+
+bool json_struct_decode(const JsonStruct* descriptor, const char* str, size_t str_sz, void* out, Arena* arena)
+{
+    JsonStructDecoder d;
+
+    if(str == NULL)
+        return false;
+
+    json_struct_decoder_init(&d, str, str_sz, arena);
+
+    if(json_struct_peek(&d) != '{')
+        return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+    return json_struct_decode_object(&d, descriptor, out) && json_struct_decoder_end(&d);
+}
+
+bool json_struct_decode_array(const JsonStruct* descriptor,
+                              const char* str,
+                              size_t str_sz,
+                              Arena* arena,
+                              void** out,
+                              size_t* count)
+{
+    JsonStructDecoder d;
+
+    if(str == NULL)
+        return false;
+
+    json_struct_decoder_init(&d, str, str_sz, arena);
+
+    if(json_struct_peek(&d) != '[')
+        return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+    return json_struct_decode_array_elements(&d, JsonFieldType_Struct, descriptor, out, count) &&
+           json_struct_decoder_end(&d);
+}
+
+/************/
+/* Encoding */
+/************/
+
+ROMANO_FORCE_INLINE bool json_struct_write(Buffer* buffer, const char* data, size_t data_sz)
+{
+    return buffer_append(buffer, data, data_sz);
+}
+
+static bool json_struct_write_str(Buffer* buffer, const char* str, size_t str_sz)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    char escape[6];
+    size_t run_start;
+    size_t escape_sz;
+    size_t i;
+    unsigned char c;
+
+    if(!json_struct_write(buffer, "\"", 1))
+        return false;
+
+    run_start = 0;
+
+    for(i = 0; i < str_sz; i++)
+    {
+        c = (unsigned char)str[i];
+
+        if(c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        escape[0] = '\\';
+        escape_sz = 2;
+
+        switch(c)
+        {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex_digits[c >> 4];
+                escape[5] = hex_digits[c & 0xF];
+                escape_sz = 6;
+                break;
+        }
+
+        if(!json_struct_write(buffer, str + run_start, i - run_start) ||
+           !json_struct_write(buffer, escape, escape_sz))
+            return false;
+
+        run_start = i + 1;
+    }
+
+    return json_struct_write(buffer, str + run_start, str_sz - run_start) && json_struct_write(buffer, "\"", 1);
+}
+
+static bool json_struct_write_float(Buffer* buffer, double f64, bool is_f32)
+{
+    char number[32];
+    int number_sz;
+
+    if(isnan(f64) || isinf(f64))
+        return json_struct_write(buffer, "null", 4);
+
+    /* Enough digits for the value to be decoded back exactly, doubles using the fewest */
+    if(is_f32)
+        number_sz = snprintf(number, sizeof(number), "%.9g", f64);
+    else
+        number_sz = fmt_f64_shortest(number, f64);
+
+    if(number_sz < 0 || (size_t)number_sz >= sizeof(number))
+        return json_struct_fail(ErrorCode_FormattingError);
+
+    return json_struct_write(buffer, number, (size_t)number_sz);
+}
+
+static bool json_struct_encode_object(const JsonStruct* descriptor, const char* data, Buffer* buffer);
+
+static bool json_struct_encode_value(const JsonField* field, JsonFieldType type, const char* data, Buffer* buffer)
+{
+    char number[32];
+    const char* str;
+    const char* elements;
+    size_t element_size;
+    size_t count;
+    size_t i;
+
+    switch(type)
+    {
+        case JsonFieldType_Bool:
+            return *(const bool*)data ? json_struct_write(buffer, "true", 4) : json_struct_write(buffer, "false", 5);
+        case JsonFieldType_I32:
+            return json_struct_write(buffer, number, (size_t)fmt_i64(number, *(const int32_t*)data));
+        case JsonFieldType_I64:
+            return json_struct_write(buffer, number, (size_t)fmt_i64(number, *(const int64_t*)data));
+        case JsonFieldType_U32:
+            return json_struct_write(buffer, number, (size_t)fmt_u64(number, *(const uint32_t*)data));
+        case JsonFieldType_U64:
+            return json_struct_write(buffer, number, (size_t)fmt_u64(number, *(const uint64_t*)data));
+        case JsonFieldType_F32:
+            return json_struct_write_float(buffer, (double)*(const float*)data, true);
+        case JsonFieldType_F64:
+            return json_struct_write_float(buffer, *(const double*)data, false);
+        case JsonFieldType_Str:
+            str = *(const char* const*)data;
+
+            if(str == NULL)
+                return json_struct_write(buffer, "null", 4);
+
+            return json_struct_write_str(buffer, str, strlen(str));
+        case JsonFieldType_StrBuffer:
+            str = (const char*)memchr(data, '\0', field->size);
+
+            return json_struct_write_str(buffer, data, str != NULL ? (size_t)(str - data) : field->size);
+        case JsonFieldType_Struct:
+            if(field->descriptor == NULL)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            return json_struct_encode_object(field->descriptor, data, buffer);
+        case JsonFieldType_Array:
+            element_size = json_struct_type_size(field->element_type, field->descriptor);
+
+            if(element_size == 0)
+                return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+
+            elements = *(const char* const*)data;
+            count = *(const size_t*)(data - field->offset + field->count_offset);
+
+            if(!json_struct_write(buffer, "[", 1))
+                return false;
+
+            for(i = 0; i < count; i++)
+            {
+                if(i > 0 && !json_struct_write(buffer, ",", 1))
+                    return false;
+
+                if(!json_struct_encode_value(field, field->element_type, elements + i * element_size, buffer))
+                    return false;
+            }
+
+            return json_struct_write(buffer, "]", 1);
+        default:
+            return json_struct_fail(ErrorCode_JsonSchemaMismatch);
+    }
+}
+
+static bool json_struct_encode_object(const JsonStruct* descriptor, const char* data, Buffer* buffer)
+{
+    const JsonField* field;
+    size_t i;
+
+    if(!json_struct_write(buffer, "{", 1))
+        return false;
+
+    for(i = 0; i < descriptor->fields_count; i++)
+    {
+        field = &descriptor->fields[i];
+
+        if((i > 0 && !json_struct_write(buffer, ",", 1)) ||
+           !json_struct_write_str(buffer, field->name, strlen(field->name)) ||
+           !json_struct_write(buffer, ":", 1) ||
+           !json_struct_encode_value(field, field->type, data + field->offset, buffer))
+            return false;
+    }
+
+    return json_struct_write(buffer, "}", 1);
+}
+
+bool json_struct_encode(const JsonStruct* descriptor, const void* data, Buffer* buffer)
+{
+    return json_struct_encode_object(descriptor, (const char*)data, buffer);
+}
+
+bool json_struct_encode_array(const JsonStruct* descriptor, const void* data, size_t count, Buffer* buffer)
+{
+    size_t i;
+
+    if(!json_struct_write(buffer, "[", 1))
+        return false;
+
+    for(i = 0; i < count; i++)
+    {
+        if(i > 0 && !json_struct_write(buffer, ",", 1))
+            return false;
+
+        if(!json_struct_encode_object(descriptor, (const char*)data + i * descriptor->size, buffer))
+            return false;
+    }
+
+    return json_struct_write(buffer, "]", 1);
+}
@@ -0,0 +1,390 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/lockfree_stack.h"
+#include "libromano/memory.h"
+#include "libromano/thread.h"
+#include "libromano/error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+/* LockFreeStack */
+
+#if defined(ROMANO_HAS_ATOMIC_128)
+typedef Atomic128 LockFreeStackHead;
+
+ROMANO_FORCE_INLINE LockFreeStackHead lockfreestack_load_head(LockFreeStack* stack)
+{
+    LockFreeStackHead head;
+
+    /* The two halves can be torn, the CAS validates them anyway */
+    head.hi = (uint64_t)atomic_load_64((Atomic64*)&stack->head.hi, MemoryOrder_Acquire);
+    head.lo = (uint64_t)atomic_load_64((Atomic64*)&stack->head.lo, MemoryOrder_Acquire);
+
+    return head;
+}
+
+ROMANO_FORCE_INLINE LockFreeStackHead lockfreestack_make_head(LockFreeStackNode* node, LockFreeStackHead previous)
+{
+    LockFreeStackHead head;
+
+    head.lo = (uint64_t)(uintptr_t)node;
+    head.hi = previous.hi + 1;
+
+    return head;
+}
+
+ROMANO_FORCE_INLINE LockFreeStackNode* lockfreestack_head_node(LockFreeStackHead head)
+{
+    return (LockFreeStackNode*)(uintptr_t)head.lo;
+}
+
+ROMANO_FORCE_INLINE bool lockfreestack_cas_head(LockFreeStack* stack,
+                                                LockFreeStackHead exchange,
+                                                LockFreeStackHead* compare)
+{
+    /* The sanitizer does not see the synchronization done in assembly */
+    ROMANO_TP_RELEASE(stack);
+
+    if(atomic_compare_exchange_128(&stack->head, exchange, compare))
+    {
+        ROMANO_TP_ACQUIRE(stack);
+        return true;
+    }
+
+    return false;
+}
+#else
+typedef uint64_t LockFreeStackHead;
+
+/* User space addresses fit in 48 bits on 64 bits platforms */
+#if UINTPTR_MAX > 0xFFFFFFFF
+#define LOCKFREESTACK_POINTER_BITS 48
+#else
+#define LOCKFREESTACK_POINTER_BITS 32
+#endif /* UINTPTR_MAX > 0xFFFFFFFF */
+
+#define LOCKFREESTACK_POINTER_MASK (((uint64_t)1 << LOCKFREESTACK_POINTER_BITS) - 1)
+
+ROMANO_FORCE_INLINE LockFreeStackHead lockfreestack_load_head(LockFreeStack* stack)
+{
+    return (uint64_t)atomic_load_64(&stack->head, MemoryOrder_Acquire);
+}
+
+ROMANO_FORCE_INLINE LockFreeStackHead lockfreestack_make_head(LockFreeStackNode* node, LockFreeStackHead previous)
+{
+    uint64_t counter = (previous >> LOCKFREESTACK_POINTER_BITS) + 1;
+
+    return ((uint64_t)(uintptr_t)node & LOCKFREESTACK_POINTER_MASK) | (counter << LOCKFREESTACK_POINTER_BITS);
+}
+
+ROMANO_FORCE_INLINE LockFreeStackNode* lockfreestack_head_node(LockFreeStackHead head)
+{
+    return (LockFreeStackNode*)(uintptr_t)(head & LOCKFREESTACK_POINTER_MASK);
+}
+
+ROMANO_FORCE_INLINE bool lockfreestack_cas_head(LockFreeStack* stack,
+                                                LockFreeStackHead exchange,
+                                                LockFreeStackHead* compare)
+{
+    if(atomic_compare_exchange_strong_64(&stack->head, (Atomic64)exchange, (Atomic64)*compare, MemoryOrder_SeqCst))
+        return true;
+
+    *compare = lockfreestack_load_head(stack);
+
+    return false;
+}
+#endif /* defined(ROMANO_HAS_ATOMIC_128) */
+
+void lockfreestack_init(LockFreeStack* stack)
+{
+    ROMANO_ASSERT(stack != NULL, "");
+
+    memset(stack, 0, sizeof(LockFreeStack));
+}
+
+bool lockfreestack_is_empty(LockFreeStack* stack)
+{
+    ROMANO_ASSERT(stack != NULL, "");
+
+    return lockfreestack_head_node(lockfreestack_load_head(stack)) == NULL;
+}
+
+void lockfreestack_push_batch(LockFreeStack* stack, LockFreeStackNode* first, LockFreeStackNode* last)
+{
+    LockFreeStackHead head;
+
+    ROMANO_ASSERT(stack != NULL && first != NULL && last != NULL, "");
+
+    head = lockfreestack_load_head(stack);
+
+    do
+    {
+        atomic_store_ptr((void**)&last->next, lockfreestack_head_node(head), MemoryOrder_Relax);
+    } while(!lockfreestack_cas_head(stack, lockfreestack_make_head(first, head), &head));
+}
+
+void lockfreestack_push(LockFreeStack* stack, LockFreeStackNode* node)
+{
+    lockfreestack_push_batch(stack, node, node);
+}
+
+LockFreeStackNode* lockfreestack_pop(LockFreeStack* stack)
+{
+    LockFreeStackHead head;
+    LockFreeStackNode* node;
+
+    ROMANO_ASSERT(stack != NULL, "");
+
+    head = lockfreestack_load_head(stack);
+
+    do
+    {
+        LockFreeStackNode* next;
+
+        node = lockfreestack_head_node(head);
+
+        if(node == NULL)
+            return NULL;
+
+        /* The node may have been popped concurrently, the counter makes the CAS fail then */
+        next = (LockFreeStackNode*)atomic_load_ptr((void**)&node->next, MemoryOrder_Relax);
+
+        if(lockfreestack_cas_head(stack, lockfreestack_make_head(next, head), &head))
+            break;
+    } while(1);
+
+    return node;
+}
+
+LockFreeStackNode* lockfreestack_pop_all(LockFreeStack* stack)
+{
+    LockFreeStackHead head;
+
+    ROMANO_ASSERT(stack != NULL, "");
+
+    head = lockfreestack_load_head(stack);
+
+    while(lockfreestack_head_node(head) != NULL)
+    {
+        LockFreeStackNode* node = lockfreestack_head_node(head);
+
+        if(lockfreestack_cas_head(stack, lockfreestack_make_head(NULL, head), &head))
+            return node;
+    }
+
+    return NULL;
+}
+
+/* WorkStack */
+
+typedef struct WorkStackChunk {
+    LockFreeStackNode node;
+
+    /* Links all the allocated chunks, to free them with the work stack */
+    struct WorkStackChunk* next_allocated;
+
+    uint32_t count;
+    void* values[WORKSTACK_CHUNK_SIZE];
+} WorkStackChunk;
+
+struct WorkStack
+{
+    /* Full (or flushed) chunks */
+    LockFreeStack chunks;
+
+    /* Empty chunks, never freed while the work stack is alive so popping them is safe */
+    LockFreeStack free_chunks;
+
+    WorkStackChunk* allocated;
+};
+
+struct WorkStackCache
+{
+    WorkStack* stack;
+
+    /* Values are pushed and popped in current, spare is the previous (full) chunk */
+    WorkStackChunk* current;
+    WorkStackChunk* spare;
+};
+
+WorkStack* workstack_new(void)
+{
+    WorkStack* stack = (WorkStack*)mem_aligned_alloc(sizeof(WorkStack), ROMANO_CACHE_LINE_SIZE);
+
+    if(stack == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    lockfreestack_init(&stack->chunks);
+    lockfreestack_init(&stack->free_chunks);
+    stack->allocated = NULL;
+
+    return stack;
+}
+
+static WorkStackChunk* workstack_get_empty_chunk(WorkStack* stack)
+{
+    WorkStackChunk* chunk = (WorkStackChunk*)lockfreestack_pop(&stack->free_chunks);
+
+    if(chunk == NULL)
+    {
+        chunk = (WorkStackChunk*)malloc(sizeof(WorkStackChunk));
+
+        if(chunk == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            return NULL;
+        }
+
+        do
+        {
+            chunk->next_allocated = (WorkStackChunk*)atomic_load_ptr((void**)&stack->allocated, MemoryOrder_Relax);
+        } while(!atomic_compare_exchange_ptr((void**)&stack->allocated,
+                                             chunk,
+                                             chunk->next_allocated,
+                                             MemoryOrder_SeqCst));
+    }
+
+    chunk->count = 0;
+
+    return chunk;
+}
+
+WorkStackCache* workstack_cache_new(WorkStack* stack)
+{
+    WorkStackCache* cache;
+
+    ROMANO_ASSERT(stack != NULL, "");
+
+    cache = (WorkStackCache*)malloc(sizeof(WorkStackCache));
+
+    if(cache == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    cache->stack = stack;
+    cache->current = NULL;
+    cache->spare = NULL;
+
+    return cache;
+}
+
+bool workstack_push(WorkStackCache* cache, void* value)
+{
+    ROMANO_ASSERT(cache != NULL, "");
+
+    if(cache->current == NULL || cache->current->count == WORKSTACK_CHUNK_SIZE)
+    {
+        WorkStackChunk* chunk = workstack_get_empty_chunk(cache->stack);
+
+        if(chunk == NULL)
+            return false;
+
+        /* Keeps the most recent full chunk local, and shares the older one */
+        if(cache->spare != NULL)
+        {
+            if(cache->spare->count > 0)
+                lockfreestack_push(&cache->stack->chunks, &cache->spare->node);
+            else
+                lockfreestack_push(&cache->stack->free_chunks, &cache->spare->node);
+        }
+
+        cache->spare = cache->current;
+        cache->current = chunk;
+    }
+
+    cache->current->values[cache->current->count++] = value;
+
+    return true;
+}
+
+bool workstack_pop(WorkStackCache* cache, void** value)
+{
+    ROMANO_ASSERT(cache != NULL && value != NULL, "");
+
+    if(cache->current == NULL || cache->current->count == 0)
+    {
+        WorkStackChunk* chunk;
+
+        if(cache->spare != NULL && cache->spare->count > 0)
+        {
+            chunk = cache->spare;
+            cache->spare = cache->current;
+        }
+        else
+        {
+            chunk = (WorkStackChunk*)lockfreestack_pop(&cache->stack->chunks);
+
+            if(chunk == NULL)
+                return false;
+
+            if(cache->current != NULL)
+                lockfreestack_push(&cache->stack->free_chunks, &cache->current->node);
+        }
+
+        cache->current = chunk;
+    }
+
+    *value = cache->current->values[--cache->current->count];
+
+    return true;
+}
+
+void workstack_flush(WorkStackCache* cache)
+{
+    uint32_t i;
+    WorkStackChunk** chunks;
+
+    ROMANO_ASSERT(cache != NULL, "");
+
+    chunks = &cache->current;
+
+    for(i = 0; i < 2; i++, chunks = &cache->spare)
+    {
+        if(*chunks == NULL)
+            continue;
+
+        if((*chunks)->count > 0)
+            lockfreestack_push(&cache->stack->chunks, &(*chunks)->node);
+        else
+            lockfreestack_push(&cache->stack->free_chunks, &(*chunks)->node);
+
+        *chunks = NULL;
+    }
+}
+
+void workstack_cache_free(WorkStackCache* cache)
+{
+    ROMANO_ASSERT(cache != NULL, "");
+
+    workstack_flush(cache);
+
+    free(cache);
+}
+
+void workstack_free(WorkStack* stack)
+{
+    WorkStackChunk* chunk;
+
+    ROMANO_ASSERT(stack != NULL, "");
+
+    chunk = stack->allocated;
+
+    while(chunk != NULL)
+    {
+        WorkStackChunk* next = chunk->next_allocated;
+        free(chunk);
+        chunk = next;
+    }
+
+    mem_aligned_free(stack);
+}
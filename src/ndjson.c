@@ -0,0 +1,491 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/ndjson.h"
+#include "libromano/arena.h"
+#include "libromano/atomic.h"
+#include "libromano/bit.h"
+#include "libromano/error.h"
+#include "libromano/filesystem.h"
+#include "libromano/lockfree_stack.h"
+#include "libromano/logger.h"
+#include "libromano/simd.h"
+#include "libromano/vector.h"
+
+#include "json_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+/* Returns the position of the next newline in data[pos, size), or size if there is none */
+#if defined(__AVX2__)
+ROMANO_FORCE_INLINE size_t ndjson_find_newline(const char* data, size_t pos, size_t size)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    uint32_t mask;
+
+    while(pos + 32 <= size)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(data + pos));
+
+        mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+
+        if(mask != 0)
+            return pos + (size_t)ctz_u64((uint64_t)mask);
+
+        pos += 32;
+    }
+
+    while(pos < size && data[pos] != '\n')
+        pos++;
+
+    return pos;
+}
+#elif defined(ROMANO_AARCH64)
+ROMANO_FORCE_INLINE size_t ndjson_find_newline(const char* data, size_t pos, size_t size)
+{
+    const uint8x16_t newline = vdupq_n_u8('\n');
+
+    while(pos + 16 <= size)
+    {
+        const uint8x16_t v = vld1q_u8((const uint8_t*)data + pos);
+
+        if(vmaxvq_u8(vceqq_u8(v, newline)) != 0)
+            break;
+
+        pos += 16;
+    }
+
+    while(pos < size && data[pos] != '\n')
+        pos++;
+
+    return pos;
+}
+#else
+ROMANO_FORCE_INLINE size_t ndjson_find_newline(const char* data, size_t pos, size_t size)
+{
+    const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+
+    return newline != NULL ? (size_t)(newline - data) : size;
+}
+#endif /* defined(__AVX2__) */
+
+ROMANO_FORCE_INLINE bool ndjson_is_blank(const char* line, size_t line_size)
+{
+    size_t i;
+
+    for(i = 0; i < line_size; i++)
+        if(line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+            return false;
+
+    return true;
+}
+
+typedef struct NDJsonDocument {
+    LockFreeStackNode node;
+    Json* json;
+} NDJsonDocument;
+
+typedef struct NDJsonLoader {
+    const char* data;
+    size_t data_size;
+    NDJsonRecordFunc func;
+    void* user_data;
+    ThreadPool* threadpool;
+
+    /* The data is mutable (a private file mapping) and records are parsed in-situ */
+    bool insitu;
+
+    /* Set once a record is invalid or the callback returned false, pending batches stop early */
+    Atomic32 stopped;
+    Atomic32 failed;
+
+    /* Unordered mode, one document per worker */
+    LockFreeStack documents;
+} NDJsonLoader;
+
+typedef struct NDJsonBatch {
+    NDJsonLoader* loader;
+    size_t begin;
+    size_t end;
+} NDJsonBatch;
+
+/* Ordered mode, a batch parsed into its own document and delivered by the calling thread */
+typedef struct NDJsonSlot {
+    NDJsonBatch batch;
+    Json* json;
+    Vector roots;
+    size_t error_offset;
+    bool failed;
+    ThreadPoolWaiter waiter;
+} NDJsonSlot;
+
+ROMANO_FORCE_INLINE bool ndjson_is_stopped(NDJsonLoader* loader)
+{
+    return atomic_load_32(&loader->stopped, MemoryOrder_Acquire) != 0;
+}
+
+ROMANO_FORCE_INLINE void ndjson_stop(NDJsonLoader* loader, bool failed)
+{
+    if(failed)
+        atomic_store_32(&loader->failed, 1, MemoryOrder_Release);
+
+    atomic_store_32(&loader->stopped, 1, MemoryOrder_Release);
+}
+
+ROMANO_FORCE_INLINE bool ndjson_parse_record(NDJsonLoader* loader, Json* json, size_t begin, size_t end)
+{
+    if(loader->insitu)
+        return json_parse_insitu_into(json, (char*)loader->data + begin, end - begin);
+
+    return json_parse_into(json, loader->data + begin, end - begin);
+}
+
+static void ndjson_log_invalid_record(size_t offset)
+{
+    logger_log_error("Invalid ndjson record at byte offset %zu (%d)", offset, g_current_error);
+}
+
+/* Splits the input in batches of about NDJSON_BATCH_SIZE bytes ending on a newline */
+static size_t ndjson_split_batches(NDJsonLoader* loader, NDJsonBatch* batches)
+{
+    size_t batches_count = 0;
+    size_t begin = 0;
+
+    while(begin < loader->data_size)
+    {
+        size_t end = begin + NDJSON_BATCH_SIZE;
+
+        if(end >= loader->data_size)
+        {
+            end = loader->data_size;
+        }
+        else
+        {
+            end = ndjson_find_newline(loader->data, end, loader->data_size);
+            end += end < loader->data_size;
+        }
+
+        batches[batches_count].loader = loader;
+        batches[batches_count].begin = begin;
+        batches[batches_count].end = end;
+        batches_count++;
+
+        begin = end;
+    }
+
+    return batches_count;
+}
+
+static void ndjson_submit(NDJsonLoader* loader, ThreadFunc func, void* arg, ThreadPoolWaiter* waiter)
+{
+    if(loader->threadpool == NULL || !threadpool_work_add(loader->threadpool, func, arg, waiter))
+        func(arg);
+}
+
+void* ndjson_unordered_task(void* arg)
+{
+    NDJsonBatch* batch = (NDJsonBatch*)arg;
+    NDJsonLoader* loader = batch->loader;
+    NDJsonDocument* document;
+    Json* json;
+    size_t pos;
+
+    document = (NDJsonDocument*)lockfreestack_pop(&loader->documents);
+    json = document != NULL ? document->json : json_new();
+
+    if(json == NULL)
+    {
+        ndjson_stop(loader, true);
+        return NULL;
+    }
+
+    pos = batch->begin;
+
+    while(pos < batch->end && !ndjson_is_stopped(loader))
+    {
+        size_t line_end = ndjson_find_newline(loader->data, pos, batch->end);
+
+        if(!ndjson_is_blank(loader->data + pos, line_end - pos))
+        {
+            json_reset(json);
+
+            if(!ndjson_parse_record(loader, json, pos, line_end))
+            {
+                ndjson_log_invalid_record(pos);
+                ndjson_stop(loader, true);
+                break;
+            }
+
+            if(!loader->func(json, loader->user_data))
+            {
+                ndjson_stop(loader, false);
+                break;
+            }
+        }
+
+        pos = line_end + 1;
+    }
+
+    if(document != NULL)
+        lockfreestack_push(&loader->documents, &document->node);
+    else
+        json_free(json);
+
+    return NULL;
+}
+
+void* ndjson_ordered_task(void* arg)
+{
+    NDJsonSlot* slot = (NDJsonSlot*)arg;
+    NDJsonLoader* loader = slot->batch.loader;
+    size_t pos;
+
+    pos = slot->batch.begin;
+
+    while(pos < slot->batch.end && !ndjson_is_stopped(loader))
+    {
+        size_t line_end = ndjson_find_newline(loader->data, pos, slot->batch.end);
+
+        if(!ndjson_is_blank(loader->data + pos, line_end - pos))
+        {
+            /* All the records of the batch live in the slot document until they are delivered */
+            if(!ndjson_parse_record(loader, slot->json, pos, line_end))
+            {
+                slot->error_offset = pos;
+                slot->failed = true;
+                break;
+            }
+
+            vector_push_back(&slot->roots, &slot->json->root);
+        }
+
+        pos = line_end + 1;
+    }
+
+    return NULL;
+}
+
+static bool ndjson_load_unordered(NDJsonLoader* loader, NDJsonBatch* batches, size_t batches_count)
+{
+    NDJsonDocument* documents;
+    ThreadPoolWaiter waiter;
+    size_t documents_count;
+    size_t i;
+
+    documents_count = loader->threadpool != NULL ? threadpool_get_workers_count(loader->threadpool) : 1;
+    documents = (NDJsonDocument*)calloc(documents_count, sizeof(NDJsonDocument));
+
+    if(documents == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    lockfreestack_init(&loader->documents);
+
+    for(i = 0; i < documents_count; i++)
+    {
+        documents[i].json = json_new();
+
+        if(documents[i].json != NULL)
+            lockfreestack_push(&loader->documents, &documents[i].node);
+    }
+
+    waiter = threadpool_waiter_new();
+
+    for(i = 0; i < batches_count; i++)
+        ndjson_submit(loader, ndjson_unordered_task, &batches[i], &waiter);
+
+    if(loader->threadpool != NULL)
+        threadpool_waiter_wait(&waiter);
+
+    for(i = 0; i < documents_count; i++)
+        if(documents[i].json != NULL)
+            json_free(documents[i].json);
+
+    free(documents);
+
+    return atomic_load_32(&loader->stopped, MemoryOrder_Acquire) == 0;
+}
+
+static bool ndjson_load_ordered(NDJsonLoader* loader, NDJsonBatch* batches, size_t batches_count)
+{
+    NDJsonSlot* slots;
+    size_t slots_count;
+    size_t next_batch;
+    size_t delivered;
+    size_t i;
+    bool success = true;
+
+    /* Twice as many batches in flight as workers, so workers stay busy while the callback runs */
+    slots_count = loader->threadpool != NULL ? 2 * threadpool_get_workers_count(loader->threadpool) : 1;
+    slots_count = slots_count < batches_count ? slots_count : batches_count;
+
+    slots = (NDJsonSlot*)calloc(slots_count, sizeof(NDJsonSlot));
+
+    if(slots == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    for(i = 0; i < slots_count; i++)
+    {
+        slots[i].json = json_new();
+        slots[i].waiter = threadpool_waiter_new();
+        vector_init(&slots[i].roots, 128, sizeof(JsonValue*));
+
+        if(slots[i].json == NULL)
+            success = false;
+    }
+
+    next_batch = 0;
+
+    if(success)
+    {
+        for(i = 0; i < slots_count; i++)
+        {
+            slots[i].batch = batches[next_batch++];
+            ndjson_submit(loader, ndjson_ordered_task, &slots[i], &slots[i].waiter);
+        }
+    }
+
+    for(delivered = 0; success && delivered < batches_count; delivered++)
+    {
+        NDJsonSlot* slot = &slots[delivered % slots_count];
+
+        if(loader->threadpool != NULL)
+            threadpool_waiter_wait(&slot->waiter);
+
+        for(i = 0; i < vector_size(&slot->roots); i++)
+        {
+            slot->json->root = *(JsonValue**)vector_at(&slot->roots, i);
+
+            if(!loader->func(slot->json, loader->user_data))
+            {
+                success = false;
+                break;
+            }
+        }
+
+        if(success && slot->failed)
+        {
+            ndjson_log_invalid_record(slot->error_offset);
+            success = false;
+        }
+
+        if(!success)
+        {
+            ndjson_stop(loader, slot->failed);
+            break;
+        }
+
+        if(next_batch < batches_count)
+        {
+            json_reset(slot->json);
+            vector_clear(&slot->roots);
+            slot->batch = batches[next_batch++];
+            ndjson_submit(loader, ndjson_ordered_task, slot, &slot->waiter);
+        }
+    }
+
+    /* Batches still in flight reference the slots, wait for them before releasing */
+    for(i = 0; i < slots_count; i++)
+    {
+        if(loader->threadpool != NULL)
+            threadpool_waiter_wait(&slots[i].waiter);
+
+        if(slots[i].json != NULL)
+            json_free(slots[i].json);
+
+        vector_release(&slots[i].roots);
+    }
+
+    free(slots);
+
+    return success;
+}
+
+static bool ndjson_load(ThreadPool* threadpool,
+                        const char* data,
+                        size_t data_size,
+                        bool insitu,
+                        NDJsonOrder order,
+                        NDJsonRecordFunc func,
+                        void* user_data)
+{
+    NDJsonLoader loader;
+    NDJsonBatch* batches;
+    size_t batches_count;
+    bool success;
+
+    ROMANO_ASSERT(func != NULL, "NULL ndjson record function");
+
+    if(data == NULL || data_size == 0)
+        return true;
+
+    loader.data = data;
+    loader.data_size = data_size;
+    loader.func = func;
+    loader.user_data = user_data;
+    loader.threadpool = threadpool;
+    loader.insitu = insitu;
+    loader.stopped = 0;
+    loader.failed = 0;
+
+    batches = (NDJsonBatch*)malloc((data_size / NDJSON_BATCH_SIZE + 1) * sizeof(NDJsonBatch));
+
+    if(batches == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    batches_count = ndjson_split_batches(&loader, batches);
+
+    if(order == NDJsonOrder_Ordered)
+        success = ndjson_load_ordered(&loader, batches, batches_count);
+    else
+        success = ndjson_load_unordered(&loader, batches, batches_count);
+
+    free(batches);
+
+    return success;
+}
+
+bool ndjson_loads(ThreadPool* threadpool,
+                  const char* data,
+                  size_t data_size,
+                  NDJsonOrder order,
+                  NDJsonRecordFunc func,
+                  void* user_data)
+{
+    return ndjson_load(threadpool, data, data_size, false, order, func, user_data);
+}
+
+bool ndjson_loadf(ThreadPool* threadpool,
+                  const char* file_path,
+                  NDJsonOrder order,
+                  NDJsonRecordFunc func,
+                  void* user_data)
+{
+    FileMapping mapping;
+    bool success;
+
+    /* Private writable mapping, records are parsed in-situ without touching the file */
+    if(!fs_file_map(&mapping, file_path, true))
+    {
+        logger_log_error("Error while trying to map ndjson file: %s (%d)", file_path, g_current_error);
+        return false;
+    }
+
+    success = ndjson_load(threadpool, mapping.data, mapping.size, true, order, func, user_data);
+
+    fs_file_unmap(&mapping);
+
+    return success;
+}
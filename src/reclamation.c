@@ -0,0 +1,635 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/reclamation.h"
+#include "libromano/atomic.h"
+#include "libromano/memory.h"
+#include "libromano/sync.h"
+#include "libromano/error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+/* Number of retired pointers accumulated by a thread before it tries to reclaim them */
+#define RECLAIM_BATCH 64
+
+typedef struct RetiredPointer {
+    void* ptr;
+    ReclaimFunc func;
+
+    /* Global epoch when the pointer was retired, unused by hazard pointers */
+    uint64_t epoch;
+} RetiredPointer;
+
+typedef struct RetiredList {
+    RetiredPointer* pointers;
+    size_t count;
+    size_t capacity;
+} RetiredList;
+
+/* Makes room for count more pointers. Returns false if the memory cannot be allocated */
+static bool retiredlist_reserve(RetiredList* list, size_t count)
+{
+    size_t new_capacity;
+    RetiredPointer* new_pointers;
+
+    if(list->count + count <= list->capacity)
+        return true;
+
+    new_capacity = list->capacity == 0 ? RECLAIM_BATCH * 2 : list->capacity * 2;
+
+    while(new_capacity < list->count + count)
+        new_capacity *= 2;
+
+    new_pointers = (RetiredPointer*)realloc(list->pointers, new_capacity * sizeof(RetiredPointer));
+
+    if(new_pointers == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    list->pointers = new_pointers;
+    list->capacity = new_capacity;
+
+    return true;
+}
+
+static bool retiredlist_push(RetiredList* list, void* ptr, ReclaimFunc func, uint64_t epoch)
+{
+    if(!retiredlist_reserve(list, 1))
+        return false;
+
+    list->pointers[list->count].ptr = ptr;
+    list->pointers[list->count].func = func;
+    list->pointers[list->count].epoch = epoch;
+    list->count++;
+
+    return true;
+}
+
+/* Moves all the pointers of other to list, or none of them if the memory cannot be allocated */
+static bool retiredlist_append(RetiredList* list, RetiredList* other)
+{
+    if(!retiredlist_reserve(list, other->count))
+        return false;
+
+    memcpy(list->pointers + list->count, other->pointers, other->count * sizeof(RetiredPointer));
+    list->count += other->count;
+    other->count = 0;
+
+    return true;
+}
+
+static void retiredlist_free_all(RetiredList* list)
+{
+    size_t i;
+
+    for(i = 0; i < list->count; i++)
+        list->pointers[i].func(list->pointers[i].ptr);
+
+    free(list->pointers);
+
+    list->pointers = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/* Epochs */
+
+#define EPOCH_ACTIVE 1
+
+struct ROMANO_ALIGN(ROMANO_CACHE_LINE_SIZE) EpochThread
+{
+    /* (local epoch << 1) | EPOCH_ACTIVE while in a critical section, read by the other threads */
+    Atomic64 state;
+    Atomic32 in_use;
+    uint32_t nesting;
+
+    RetiredList retired;
+
+    EpochDomain* domain;
+
+    /* Records are never unlinked, only reused, so next is immutable once published */
+    struct EpochThread* next;
+};
+
+struct ROMANO_ALIGN(ROMANO_CACHE_LINE_SIZE) EpochDomain
+{
+    Atomic64 epoch;
+
+    char _pad[ROMANO_CACHE_LINE_SIZE - sizeof(Atomic64)];
+
+    EpochThread* threads;
+
+    /* Retired pointers left by the unregistered threads */
+    SpinLock orphans_lock;
+    RetiredList orphans;
+};
+
+EpochDomain* epoch_domain_new(void)
+{
+    EpochDomain* domain = (EpochDomain*)mem_aligned_alloc(sizeof(EpochDomain), ROMANO_CACHE_LINE_SIZE);
+
+    if(domain == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(domain, 0, sizeof(EpochDomain));
+
+    spinlock_init(&domain->orphans_lock);
+
+    return domain;
+}
+
+EpochThread* epoch_thread_register(EpochDomain* domain)
+{
+    EpochThread* thread;
+
+    ROMANO_ASSERT(domain != NULL, "");
+
+    /* Reuses the record of an unregistered thread if possible */
+    for(thread = (EpochThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Acquire);
+        thread != NULL;
+        thread = thread->next)
+    {
+        if(atomic_load_32(&thread->in_use, MemoryOrder_Relax) == 0 &&
+           atomic_compare_exchange_strong_32(&thread->in_use, 1, 0, MemoryOrder_Acquire))
+            return thread;
+    }
+
+    thread = (EpochThread*)mem_aligned_alloc(sizeof(EpochThread), ROMANO_CACHE_LINE_SIZE);
+
+    if(thread == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(thread, 0, sizeof(EpochThread));
+
+    thread->in_use = 1;
+    thread->domain = domain;
+
+    do
+    {
+        thread->next = (EpochThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Relax);
+    } while(!atomic_compare_exchange_ptr((void**)&domain->threads, thread, thread->next, MemoryOrder_SeqCst));
+
+    return thread;
+}
+
+void epoch_enter(EpochThread* thread)
+{
+    ROMANO_ASSERT(thread != NULL, "");
+
+    if(thread->nesting++ == 0)
+    {
+        Atomic64 epoch = atomic_load_64(&thread->domain->epoch, MemoryOrder_Acquire);
+
+        atomic_store_64(&thread->state, (epoch << 1) | EPOCH_ACTIVE, MemoryOrder_Relax);
+
+        /* The published state must be visible before any load of the protected structure */
+        atomic_thread_fence(MemoryOrder_SeqCst);
+    }
+}
+
+void epoch_exit(EpochThread* thread)
+{
+    ROMANO_ASSERT(thread != NULL && thread->nesting > 0, "");
+
+    if(--thread->nesting == 0)
+        atomic_store_64(&thread->state, 0, MemoryOrder_Release);
+}
+
+/* The epoch can advance once every active thread has observed the current one */
+static uint64_t epoch_try_advance(EpochDomain* domain)
+{
+    Atomic64 epoch = atomic_load_64(&domain->epoch, MemoryOrder_SeqCst);
+    EpochThread* thread;
+
+    atomic_thread_fence(MemoryOrder_SeqCst);
+
+    for(thread = (EpochThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Acquire);
+        thread != NULL;
+        thread = thread->next)
+    {
+        Atomic64 state = atomic_load_64(&thread->state, MemoryOrder_Acquire);
+
+        if((state & EPOCH_ACTIVE) != 0 && (state >> 1) != epoch)
+            return (uint64_t)epoch;
+    }
+
+    if(atomic_compare_exchange_strong_64(&domain->epoch, epoch + 1, epoch, MemoryOrder_SeqCst))
+        return (uint64_t)epoch + 1;
+
+    return (uint64_t)atomic_load_64(&domain->epoch, MemoryOrder_Acquire);
+}
+
+/* Frees the pointers retired at least two epochs ago, they are stored in retire order */
+static void epoch_free_safe(RetiredList* list, uint64_t epoch)
+{
+    size_t i = 0;
+
+    while(i < list->count && list->pointers[i].epoch + 2 <= epoch)
+    {
+        list->pointers[i].func(list->pointers[i].ptr);
+        i++;
+    }
+
+    if(i > 0)
+    {
+        memmove(list->pointers, list->pointers + i, (list->count - i) * sizeof(RetiredPointer));
+        list->count -= i;
+    }
+}
+
+size_t epoch_reclaim(EpochThread* thread)
+{
+    EpochDomain* domain;
+    uint64_t epoch;
+
+    ROMANO_ASSERT(thread != NULL, "");
+
+    domain = thread->domain;
+    epoch = epoch_try_advance(domain);
+
+    epoch_free_safe(&thread->retired, epoch);
+
+    /* Orphans are reclaimed opportunistically, by whoever gets the lock */
+    if(spinlock_try_lock(&domain->orphans_lock))
+    {
+        epoch_free_safe(&domain->orphans, epoch);
+        spinlock_unlock(&domain->orphans_lock);
+    }
+
+    return thread->retired.count;
+}
+
+bool epoch_retire(EpochThread* thread, void* ptr, ReclaimFunc func)
+{
+    uint64_t epoch;
+
+    ROMANO_ASSERT(thread != NULL && func != NULL, "");
+
+    /* The pointer has been unlinked before: readers entering from now on cannot reach it */
+    epoch = (uint64_t)atomic_load_64(&thread->domain->epoch, MemoryOrder_SeqCst);
+
+    /* When memory is exhausted, reclaiming frees some room in the list */
+    if(!retiredlist_push(&thread->retired, ptr, func, epoch))
+    {
+        epoch_reclaim(thread);
+
+        if(!retiredlist_push(&thread->retired, ptr, func, epoch))
+            return false;
+    }
+
+    if(thread->retired.count >= RECLAIM_BATCH)
+        epoch_reclaim(thread);
+
+    return true;
+}
+
+void epoch_thread_unregister(EpochThread* thread)
+{
+    EpochDomain* domain;
+
+    ROMANO_ASSERT(thread != NULL && thread->nesting == 0, "Thread is still in a critical section");
+
+    domain = thread->domain;
+
+    /* If the handover fails, the pointers stay in the record until it is reused */
+    if(epoch_reclaim(thread) > 0)
+    {
+        spinlock_lock(&domain->orphans_lock);
+        retiredlist_append(&domain->orphans, &thread->retired);
+        spinlock_unlock(&domain->orphans_lock);
+    }
+
+    atomic_store_32(&thread->in_use, 0, MemoryOrder_Release);
+}
+
+void epoch_domain_free(EpochDomain* domain)
+{
+    EpochThread* thread;
+
+    ROMANO_ASSERT(domain != NULL, "");
+
+    thread = domain->threads;
+
+    while(thread != NULL)
+    {
+        EpochThread* next = thread->next;
+
+        retiredlist_free_all(&thread->retired);
+        mem_aligned_free(thread);
+
+        thread = next;
+    }
+
+    retiredlist_free_all(&domain->orphans);
+
+    mem_aligned_free(domain);
+}
+
+/* Hazard pointers */
+
+struct ROMANO_ALIGN(ROMANO_CACHE_LINE_SIZE) HazardThread
+{
+    void** slots;
+    Atomic32 in_use;
+
+    RetiredList retired;
+
+    HazardDomain* domain;
+    struct HazardThread* next;
+};
+
+struct HazardDomain
+{
+    uint32_t slots_count;
+    Atomic32 threads_count;
+
+    HazardThread* threads;
+
+    SpinLock orphans_lock;
+    RetiredList orphans;
+};
+
+HazardDomain* hazard_domain_new(uint32_t slots_count)
+{
+    HazardDomain* domain;
+
+    ROMANO_ASSERT(slots_count > 0, "");
+
+    domain = (HazardDomain*)calloc(1, sizeof(HazardDomain));
+
+    if(domain == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    domain->slots_count = slots_count;
+    spinlock_init(&domain->orphans_lock);
+
+    return domain;
+}
+
+HazardThread* hazard_thread_register(HazardDomain* domain)
+{
+    HazardThread* thread;
+
+    ROMANO_ASSERT(domain != NULL, "");
+
+    for(thread = (HazardThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Acquire);
+        thread != NULL;
+        thread = thread->next)
+    {
+        if(atomic_load_32(&thread->in_use, MemoryOrder_Relax) == 0 &&
+           atomic_compare_exchange_strong_32(&thread->in_use, 1, 0, MemoryOrder_Acquire))
+            return thread;
+    }
+
+    thread = (HazardThread*)mem_aligned_alloc(sizeof(HazardThread), ROMANO_CACHE_LINE_SIZE);
+
+    if(thread == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(thread, 0, sizeof(HazardThread));
+
+    /* Slots of different threads live on different cache lines */
+    thread->slots = (void**)mem_aligned_alloc(domain->slots_count * sizeof(void*), ROMANO_CACHE_LINE_SIZE);
+
+    if(thread->slots == NULL)
+    {
+        mem_aligned_free(thread);
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(thread->slots, 0, domain->slots_count * sizeof(void*));
+
+    thread->in_use = 1;
+    thread->domain = domain;
+
+    /* Counted before being linked, a scan that reaches the thread has room for its slots */
+    atomic_add_32(&domain->threads_count, 1, MemoryOrder_SeqCst);
+
+    do
+    {
+        thread->next = (HazardThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Relax);
+    } while(!atomic_compare_exchange_ptr((void**)&domain->threads, thread, thread->next, MemoryOrder_SeqCst));
+
+    return thread;
+}
+
+void* hazard_protect(HazardThread* thread, uint32_t slot, void* volatile* src)
+{
+    void* ptr;
+
+    ROMANO_ASSERT(thread != NULL && slot < thread->domain->slots_count, "");
+
+    ptr = atomic_load_ptr(src, MemoryOrder_Relax);
+
+    while(1)
+    {
+        void* current;
+
+        atomic_store_ptr(&thread->slots[slot], ptr, MemoryOrder_Relax);
+
+        /* The slot must be visible before src is validated, pairs with the fence in hazard_reclaim */
+        atomic_thread_fence(MemoryOrder_SeqCst);
+
+        current = atomic_load_ptr(src, MemoryOrder_Acquire);
+
+        if(current == ptr)
+            return ptr;
+
+        ptr = current;
+    }
+}
+
+void hazard_set(HazardThread* thread, uint32_t slot, void* ptr)
+{
+    ROMANO_ASSERT(thread != NULL && slot < thread->domain->slots_count, "");
+
+    atomic_store_ptr(&thread->slots[slot], ptr, MemoryOrder_SeqCst);
+}
+
+void hazard_clear(HazardThread* thread, uint32_t slot)
+{
+    ROMANO_ASSERT(thread != NULL && slot < thread->domain->slots_count, "");
+
+    atomic_store_ptr(&thread->slots[slot], NULL, MemoryOrder_Release);
+}
+
+static int hazard_compare(const void* a, const void* b)
+{
+    uintptr_t pa = *(const uintptr_t*)a;
+    uintptr_t pb = *(const uintptr_t*)b;
+
+    return (pa > pb) - (pa < pb);
+}
+
+/* Frees the pointers of the list that are not published in any slot */
+static void hazard_free_unprotected(HazardDomain* domain, RetiredList* list)
+{
+    HazardThread* thread;
+    uintptr_t* hazards;
+    size_t hazards_count = 0;
+    size_t hazards_capacity;
+    size_t kept = 0;
+    size_t i;
+
+    if(list->count == 0)
+        return;
+
+    atomic_thread_fence(MemoryOrder_SeqCst);
+
+    hazards_capacity = (size_t)atomic_load_32(&domain->threads_count, MemoryOrder_Acquire) * domain->slots_count;
+    hazards = (uintptr_t*)malloc((hazards_capacity + 1) * sizeof(uintptr_t));
+
+    if(hazards == NULL)
+        return;
+
+    for(thread = (HazardThread*)atomic_load_ptr((void**)&domain->threads, MemoryOrder_Acquire);
+        thread != NULL;
+        thread = thread->next)
+    {
+        uint32_t j;
+
+        for(j = 0; j < domain->slots_count; j++)
+        {
+            void* ptr = atomic_load_ptr(&thread->slots[j], MemoryOrder_Acquire);
+
+            if(ptr == NULL)
+                continue;
+
+            /* Never skip a published hazard, keep everything for the next scan instead */
+            if(hazards_count == hazards_capacity)
+            {
+                free(hazards);
+                return;
+            }
+
+            hazards[hazards_count++] = (uintptr_t)ptr;
+        }
+    }
+
+    qsort(hazards, hazards_count, sizeof(uintptr_t), hazard_compare);
+
+    for(i = 0; i < list->count; i++)
+    {
+        uintptr_t ptr = (uintptr_t)list->pointers[i].ptr;
+
+        if(hazards_count > 0 && bsearch(&ptr, hazards, hazards_count, sizeof(uintptr_t), hazard_compare) != NULL)
+            list->pointers[kept++] = list->pointers[i];
+        else
+            list->pointers[i].func(list->pointers[i].ptr);
+    }
+
+    list->count = kept;
+
+    free(hazards);
+}
+
+size_t hazard_reclaim(HazardThread* thread)
+{
+    HazardDomain* domain;
+
+    ROMANO_ASSERT(thread != NULL, "");
+
+    domain = thread->domain;
+
+    hazard_free_unprotected(domain, &thread->retired);
+
+    /* Orphans are reclaimed opportunistically, by whoever gets the lock */
+    if(spinlock_try_lock(&domain->orphans_lock))
+    {
+        hazard_free_unprotected(domain, &domain->orphans);
+        spinlock_unlock(&domain->orphans_lock);
+    }
+
+    return thread->retired.count;
+}
+
+bool hazard_retire(HazardThread* thread, void* ptr, ReclaimFunc func)
+{
+    size_t threshold;
+
+    ROMANO_ASSERT(thread != NULL && func != NULL, "");
+
+    /* When memory is exhausted, reclaiming frees some room in the list */
+    if(!retiredlist_push(&thread->retired, ptr, func, 0))
+    {
+        hazard_reclaim(thread);
+
+        if(!retiredlist_push(&thread->retired, ptr, func, 0))
+            return false;
+    }
+
+    /* Scanning is amortized: at most half of the list can be protected when it runs */
+    threshold = 2 * (size_t)atomic_load_32(&thread->domain->threads_count, MemoryOrder_Relax) *
+                thread->domain->slots_count;
+
+    if(thread->retired.count >= (threshold > RECLAIM_BATCH ? threshold : RECLAIM_BATCH))
+        hazard_reclaim(thread);
+
+    return true;
+}
+
+void hazard_thread_unregister(HazardThread* thread)
+{
+    HazardDomain* domain;
+    uint32_t i;
+
+    ROMANO_ASSERT(thread != NULL, "");
+
+    domain = thread->domain;
+
+    for(i = 0; i < domain->slots_count; i++)
+        atomic_store_ptr(&thread->slots[i], NULL, MemoryOrder_Release);
+
+    /* If the handover fails, the pointers stay in the record until it is reused */
+    if(hazard_reclaim(thread) > 0)
+    {
+        spinlock_lock(&domain->orphans_lock);
+        retiredlist_append(&domain->orphans, &thread->retired);
+        spinlock_unlock(&domain->orphans_lock);
+    }
+
+    atomic_store_32(&thread->in_use, 0, MemoryOrder_Release);
+}
+
+void hazard_domain_free(HazardDomain* domain)
+{
+    HazardThread* thread;
+
+    ROMANO_ASSERT(domain != NULL, "");
+
+    thread = domain->threads;
+
+    while(thread != NULL)
+    {
+        HazardThread* next = thread->next;
+
+        retiredlist_free_all(&thread->retired);
+        mem_aligned_free(thread->slots);
+        mem_aligned_free(thread);
+
+        thread = next;
+    }
+
+    retiredlist_free_all(&domain->orphans);
+
+    free(domain);
+}
@@ -0,0 +1,446 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/ring_queue.h"
+#include "libromano/atomic.h"
+#include "libromano/memory.h"
+#include "libromano/bit.h"
+#include "libromano/cpu.h"
+#include "libromano/thread.h"
+#include "libromano/error.h"
+
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+#define RING_QUEUE_MAX_CAPACITY ((uint32_t)1 << 31)
+
+/* Busy waiting used by the blocking variants: a few pauses, then yields the thread */
+#define RING_QUEUE_SPINS 64
+
+ROMANO_FORCE_INLINE void ring_queue_backoff(uint32_t* spins)
+{
+    if(*spins < RING_QUEUE_SPINS)
+    {
+        (*spins)++;
+        cpu_pause();
+    }
+    else
+    {
+        thread_yield();
+    }
+}
+
+ROMANO_FORCE_INLINE uint32_t ring_queue_capacity(uint32_t capacity)
+{
+    if(capacity < 2)
+        return 2;
+
+    if(capacity > RING_QUEUE_MAX_CAPACITY)
+        return RING_QUEUE_MAX_CAPACITY;
+
+    /* round_u32_to_next_pow2 returns x - 1 */
+    return round_u32_to_next_pow2(capacity) + 1;
+}
+
+/* SPSC */
+
+struct SPSCQueue
+{
+    void** buffer;
+    uint64_t mask;
+
+    char _pad0[ROMANO_CACHE_LINE_SIZE - sizeof(void**) - sizeof(uint64_t)];
+
+    /* Consumer side */
+    Atomic64 head;
+    uint64_t cached_tail;
+
+    char _pad1[ROMANO_CACHE_LINE_SIZE - sizeof(Atomic64) - sizeof(uint64_t)];
+
+    /* Producer side */
+    Atomic64 tail;
+    uint64_t cached_head;
+
+    char _pad2[ROMANO_CACHE_LINE_SIZE - sizeof(Atomic64) - sizeof(uint64_t)];
+};
+
+SPSCQueue* spscqueue_new(uint32_t capacity)
+{
+    SPSCQueue* queue;
+
+    capacity = ring_queue_capacity(capacity);
+
+    queue = (SPSCQueue*)mem_aligned_alloc(sizeof(SPSCQueue), ROMANO_CACHE_LINE_SIZE);
+
+    if(queue == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(SPSCQueue));
+
+    queue->buffer = (void**)mem_aligned_alloc((size_t)capacity * sizeof(void*), ROMANO_CACHE_LINE_SIZE);
+
+    if(queue->buffer == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        mem_aligned_free(queue);
+        return NULL;
+    }
+
+    queue->mask = (uint64_t)capacity - 1;
+
+    return queue;
+}
+
+uint32_t spscqueue_capacity(SPSCQueue* queue)
+{
+    ROMANO_ASSERT(queue != NULL, "");
+
+    return (uint32_t)(queue->mask + 1);
+}
+
+uint32_t spscqueue_size_approx(SPSCQueue* queue)
+{
+    uint64_t head;
+    uint64_t tail;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    head = (uint64_t)atomic_load_64(&queue->head, MemoryOrder_Acquire);
+    tail = (uint64_t)atomic_load_64(&queue->tail, MemoryOrder_Acquire);
+
+    return tail > head ? (uint32_t)(tail - head) : 0;
+}
+
+uint32_t spscqueue_try_push_batch(SPSCQueue* queue, void** values, uint32_t count)
+{
+    uint64_t tail;
+    uint64_t capacity;
+    uint64_t free_slots;
+    uint32_t i;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    tail = (uint64_t)atomic_load_64(&queue->tail, MemoryOrder_Relax);
+    capacity = queue->mask + 1;
+    free_slots = capacity - (tail - queue->cached_head);
+
+    /* The consumer index is only read when the cached one says the queue looks full */
+    if(free_slots < count)
+    {
+        queue->cached_head = (uint64_t)atomic_load_64(&queue->head, MemoryOrder_Acquire);
+        free_slots = capacity - (tail - queue->cached_head);
+    }
+
+    if(free_slots < count)
+        count = (uint32_t)free_slots;
+
+    for(i = 0; i < count; i++)
+        queue->buffer[(tail + i) & queue->mask] = values[i];
+
+    atomic_store_64(&queue->tail, (Atomic64)(tail + count), MemoryOrder_Release);
+
+    return count;
+}
+
+bool spscqueue_try_push(SPSCQueue* queue, void* value)
+{
+    return spscqueue_try_push_batch(queue, &value, 1) == 1;
+}
+
+uint32_t spscqueue_try_pop_batch(SPSCQueue* queue, void** values, uint32_t max_count)
+{
+    uint64_t head;
+    uint64_t available;
+    uint32_t i;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    head = (uint64_t)atomic_load_64(&queue->head, MemoryOrder_Relax);
+    available = queue->cached_tail - head;
+
+    /* The producer index is only read when the cached one says the queue looks empty */
+    if(available < max_count)
+    {
+        queue->cached_tail = (uint64_t)atomic_load_64(&queue->tail, MemoryOrder_Acquire);
+        available = queue->cached_tail - head;
+    }
+
+    if(available < max_count)
+        max_count = (uint32_t)available;
+
+    for(i = 0; i < max_count; i++)
+        values[i] = queue->buffer[(head + i) & queue->mask];
+
+    atomic_store_64(&queue->head, (Atomic64)(head + max_count), MemoryOrder_Release);
+
+    return max_count;
+}
+
+bool spscqueue_try_pop(SPSCQueue* queue, void** value)
+{
+    return spscqueue_try_pop_batch(queue, value, 1) == 1;
+}
+
+void spscqueue_push(SPSCQueue* queue, void* value)
+{
+    uint32_t spins = 0;
+
+    while(!spscqueue_try_push(queue, value))
+        ring_queue_backoff(&spins);
+}
+
+void* spscqueue_pop(SPSCQueue* queue)
+{
+    uint32_t spins = 0;
+    void* value;
+
+    while(!spscqueue_try_pop(queue, &value))
+        ring_queue_backoff(&spins);
+
+    return value;
+}
+
+void spscqueue_free(SPSCQueue* queue)
+{
+    ROMANO_ASSERT(queue != NULL, "");
+
+    mem_aligned_free(queue->buffer);
+    mem_aligned_free(queue);
+}
+
+/* MPMC */
+
+typedef struct MPMCCell
+{
+    /* Equals the position when the cell is free, the position + 1 when it holds a value */
+    Atomic64 sequence;
+    void* value;
+} MPMCCell;
+
+struct MPMCQueue
+{
+    MPMCCell* cells;
+    uint64_t mask;
+
+    char _pad0[ROMANO_CACHE_LINE_SIZE - sizeof(MPMCCell*) - sizeof(uint64_t)];
+
+    Atomic64 enqueue_pos;
+
+    char _pad1[ROMANO_CACHE_LINE_SIZE - sizeof(Atomic64)];
+
+    Atomic64 dequeue_pos;
+
+    char _pad2[ROMANO_CACHE_LINE_SIZE - sizeof(Atomic64)];
+};
+
+MPMCQueue* mpmcqueue_new(uint32_t capacity)
+{
+    MPMCQueue* queue;
+    uint32_t i;
+
+    capacity = ring_queue_capacity(capacity);
+
+    queue = (MPMCQueue*)mem_aligned_alloc(sizeof(MPMCQueue), ROMANO_CACHE_LINE_SIZE);
+
+    if(queue == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(MPMCQueue));
+
+    queue->cells = (MPMCCell*)mem_aligned_alloc((size_t)capacity * sizeof(MPMCCell), ROMANO_CACHE_LINE_SIZE);
+
+    if(queue->cells == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        mem_aligned_free(queue);
+        return NULL;
+    }
+
+    for(i = 0; i < capacity; i++)
+    {
+        queue->cells[i].sequence = (Atomic64)i;
+        queue->cells[i].value = NULL;
+    }
+
+    queue->mask = (uint64_t)capacity - 1;
+
+    return queue;
+}
+
+uint32_t mpmcqueue_capacity(MPMCQueue* queue)
+{
+    ROMANO_ASSERT(queue != NULL, "");
+
+    return (uint32_t)(queue->mask + 1);
+}
+
+uint32_t mpmcqueue_size_approx(MPMCQueue* queue)
+{
+    uint64_t enqueue_pos;
+    uint64_t dequeue_pos;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    dequeue_pos = (uint64_t)atomic_load_64(&queue->dequeue_pos, MemoryOrder_Acquire);
+    enqueue_pos = (uint64_t)atomic_load_64(&queue->enqueue_pos, MemoryOrder_Acquire);
+
+    return enqueue_pos > dequeue_pos ? (uint32_t)(enqueue_pos - dequeue_pos) : 0;
+}
+
+/*
+ * A batch claims the contiguous cells, starting at the current position, that are ready
+ * (sequence == position + offset). Cells only become ready in one direction, so once they have
+ * been checked, claiming them with a single CAS on the position is safe
+ */
+uint32_t mpmcqueue_try_push_batch(MPMCQueue* queue, void** values, uint32_t count)
+{
+    uint64_t pos;
+    uint32_t ready;
+    uint32_t i;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    if(count == 0)
+        return 0;
+
+    pos = (uint64_t)atomic_load_64(&queue->enqueue_pos, MemoryOrder_Relax);
+
+    while(1)
+    {
+        for(ready = 0; ready < count; ready++)
+        {
+            MPMCCell* cell = &queue->cells[(pos + ready) & queue->mask];
+            int64_t diff = atomic_load_64(&cell->sequence, MemoryOrder_Acquire) - (int64_t)(pos + ready);
+
+            if(diff != 0)
+            {
+                /* Another producer already moved past this position */
+                if(ready == 0 && diff > 0)
+                    ready = UINT32_MAX;
+
+                break;
+            }
+        }
+
+        if(ready == 0)
+            return 0;
+
+        if(ready != UINT32_MAX &&
+           atomic_compare_exchange_weak_64(&queue->enqueue_pos,
+                                           (Atomic64)(pos + ready),
+                                           (Atomic64)pos,
+                                           MemoryOrder_Relax))
+            break;
+
+        pos = (uint64_t)atomic_load_64(&queue->enqueue_pos, MemoryOrder_Relax);
+    }
+
+    for(i = 0; i < ready; i++)
+    {
+        MPMCCell* cell = &queue->cells[(pos + i) & queue->mask];
+
+        cell->value = values[i];
+        atomic_store_64(&cell->sequence, (Atomic64)(pos + i + 1), MemoryOrder_Release);
+    }
+
+    return ready;
+}
+
+bool mpmcqueue_try_push(MPMCQueue* queue, void* value)
+{
+    return mpmcqueue_try_push_batch(queue, &value, 1) == 1;
+}
+
+uint32_t mpmcqueue_try_pop_batch(MPMCQueue* queue, void** values, uint32_t max_count)
+{
+    uint64_t pos;
+    uint32_t ready;
+    uint32_t i;
+
+    ROMANO_ASSERT(queue != NULL, "");
+
+    if(max_count == 0)
+        return 0;
+
+    pos = (uint64_t)atomic_load_64(&queue->dequeue_pos, MemoryOrder_Relax);
+
+    while(1)
+    {
+        for(ready = 0; ready < max_count; ready++)
+        {
+            MPMCCell* cell = &queue->cells[(pos + ready) & queue->mask];
+            int64_t diff = atomic_load_64(&cell->sequence, MemoryOrder_Acquire) - (int64_t)(pos + ready + 1);
+
+            if(diff != 0)
+            {
+                /* Another consumer already moved past this position */
+                if(ready == 0 && diff > 0)
+                    ready = UINT32_MAX;
+
+                break;
+            }
+        }
+
+        if(ready == 0)
+            return 0;
+
+        if(ready != UINT32_MAX &&
+           atomic_compare_exchange_weak_64(&queue->dequeue_pos,
+                                           (Atomic64)(pos + ready),
+                                           (Atomic64)pos,
+                                           MemoryOrder_Relax))
+            break;
+
+        pos = (uint64_t)atomic_load_64(&queue->dequeue_pos, MemoryOrder_Relax);
+    }
+
+    for(i = 0; i < ready; i++)
+    {
+        MPMCCell* cell = &queue->cells[(pos + i) & queue->mask];
+
+        values[i] = cell->value;
+        atomic_store_64(&cell->sequence, (Atomic64)(pos + i + queue->mask + 1), MemoryOrder_Release);
+    }
+
+    return ready;
+}
+
+bool mpmcqueue_try_pop(MPMCQueue* queue, void** value)
+{
+    return mpmcqueue_try_pop_batch(queue, value, 1) == 1;
+}
+
+void mpmcqueue_push(MPMCQueue* queue, void* value)
+{
+    uint32_t spins = 0;
+
+    while(!mpmcqueue_try_push(queue, value))
+        ring_queue_backoff(&spins);
+}
+
+void* mpmcqueue_pop(MPMCQueue* queue)
+{
+    uint32_t spins = 0;
+    void* value;
+
+    while(!mpmcqueue_try_pop(queue, &value))
+        ring_queue_backoff(&spins);
+
+    return value;
+}
+
+void mpmcqueue_free(MPMCQueue* queue)
+{
+    ROMANO_ASSERT(queue != NULL, "");
+
+    mem_aligned_free(queue->cells);
+    mem_aligned_free(queue);
+}
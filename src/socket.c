@@ -81,7 +81,7 @@ void socket_set_nonblocking(Socket s, bool enable)
     if(enable)
         fcntl(s, F_SETFL, flags | O_NONBLOCK);
     else
-        fcntl(s, F_SETFL, flags | ~O_NONBLOCK);
+        fcntl(s, F_SETFL, flags & ~O_NONBLOCK);
 #endif /* defined(ROMANO_WIN) */
 }
 
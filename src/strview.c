@@ -3,6 +3,7 @@
 /* All rights reserved. */
 
 #include "libromano/strview.h"
+#include "libromano/parse.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -178,9 +179,27 @@ StringView strview_trim(const char* data)
    return result;
 }
 
+ROMANO_FORCE_INLINE size_t strview_leading_whitespace(const StringView s)
+{
+    size_t i = 0;
+
+    while(i < s.size && isspace((unsigned char)s.data[i]))
+        i++;
+
+    return i;
+}
+
 int strview_parse_int(const StringView s)
 {
-    return strtol(s.data, NULL, 10);
+    size_t offset;
+    int64_t i64;
+
+    offset = strview_leading_whitespace(s);
+
+    if(!parse_i64(s.data + offset, s.size - offset, &i64, NULL) || i64 < INT_MIN || i64 > INT_MAX)
+        return 0;
+
+    return (int)i64;
 }
 
 bool strview_parse_bool(const StringView s)
@@ -205,5 +224,13 @@ bool strview_parse_bool(const StringView s)
 
 double strview_parse_double(const StringView s)
 {
-    return strtod(s.data, NULL);
+    size_t offset;
+    double f64;
+
+    offset = strview_leading_whitespace(s);
+
+    if(!parse_f64(s.data + offset, s.size - offset, &f64, NULL))
+        return 0.0;
+
+    return f64;
 }
\ No newline at end of file
@@ -0,0 +1,573 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/sync.h"
+#include "libromano/thread.h"
+#include "libromano/cpu.h"
+#include "libromano/time.h"
+
+#if defined(ROMANO_WIN)
+#include <Windows.h>
+#elif defined(ROMANO_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#elif defined(ROMANO_APPLE)
+#include <errno.h>
+
+/* Private but stable API of libsystem_kernel, also used by libc++ for std::atomic::wait */
+#define UL_COMPARE_AND_WAIT 1
+#define ULF_WAKE_ALL 0x00000100
+#define ULF_NO_ERRNO 0x01000000
+
+extern int __ulock_wait(uint32_t operation, void* addr, uint64_t value, uint32_t timeout_us);
+extern int __ulock_wake(uint32_t operation, void* addr, uint64_t wake_value);
+#endif /* defined(ROMANO_WIN) */
+
+bool address_wait(Atomic32* address, Atomic32 expected, uint64_t timeout_ns)
+{
+#if defined(ROMANO_WIN)
+    DWORD timeout_ms = INFINITE;
+
+    if(timeout_ns != SYNC_WAIT_INFINITE)
+    {
+        uint64_t ms = (timeout_ns + 999999) / 1000000;
+        timeout_ms = ms >= (uint64_t)INFINITE ? INFINITE - 1 : (DWORD)ms;
+    }
+
+    if(!WaitOnAddress((volatile VOID*)address, &expected, sizeof(Atomic32), timeout_ms))
+        return GetLastError() != ERROR_TIMEOUT;
+
+    return true;
+#elif defined(ROMANO_LINUX)
+    struct timespec timeout;
+    struct timespec* timeout_ptr = NULL;
+    long res;
+
+    if(timeout_ns != SYNC_WAIT_INFINITE)
+    {
+        timeout.tv_sec = (time_t)(timeout_ns / 1000000000);
+        timeout.tv_nsec = (long)(timeout_ns % 1000000000);
+        timeout_ptr = &timeout;
+    }
+
+    res = syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, timeout_ptr, NULL, 0);
+
+    return !(res == -1 && errno == ETIMEDOUT);
+#elif defined(ROMANO_APPLE)
+    /* A timeout of 0 means infinite for ulock */
+    uint32_t timeout_us = 0;
+    int res;
+
+    if(timeout_ns != SYNC_WAIT_INFINITE)
+    {
+        uint64_t us = timeout_ns / 1000;
+        timeout_us = us == 0 ? 1 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    }
+
+    res = __ulock_wait(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, address, (uint64_t)(uint32_t)expected, timeout_us);
+
+    return res != -ETIMEDOUT;
+#endif /* defined(ROMANO_WIN) */
+}
+
+void address_wake_one(Atomic32* address)
+{
+#if defined(ROMANO_WIN)
+    WakeByAddressSingle((PVOID)address);
+#elif defined(ROMANO_LINUX)
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#elif defined(ROMANO_APPLE)
+    __ulock_wake(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, address, 0);
+#endif /* defined(ROMANO_WIN) */
+}
+
+void address_wake_all(Atomic32* address)
+{
+#if defined(ROMANO_WIN)
+    WakeByAddressAll((PVOID)address);
+#elif defined(ROMANO_LINUX)
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#elif defined(ROMANO_APPLE)
+    __ulock_wake(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO | ULF_WAKE_ALL, address, 0);
+#endif /* defined(ROMANO_WIN) */
+}
+
+/*
+ * Exponential backoff for spinning loops: pauses 1, 2, 4... times, then yields the thread
+ * so that a preempted owner can run
+ */
+#define SYNC_MAX_BACKOFF 1024
+
+ROMANO_FORCE_INLINE void sync_backoff(uint32_t* backoff)
+{
+    uint32_t i;
+
+    if(*backoff > SYNC_MAX_BACKOFF)
+    {
+        thread_yield();
+        return;
+    }
+
+    for(i = 0; i < *backoff; i++)
+        cpu_pause();
+
+    *backoff <<= 1;
+}
+
+/* SpinLock */
+
+void spinlock_init(SpinLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    lock->locked = 0;
+}
+
+bool spinlock_try_lock(SpinLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    return atomic_load_32(&lock->locked, MemoryOrder_Relax) == 0 &&
+           atomic_exchange_32(&lock->locked, 1, MemoryOrder_Acquire) == 0;
+}
+
+void spinlock_lock(SpinLock* lock)
+{
+    uint32_t backoff = 1;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    while(atomic_exchange_32(&lock->locked, 1, MemoryOrder_Acquire) != 0)
+    {
+        /* Spin on a read so the cache line stays shared while the lock is owned */
+        while(atomic_load_32(&lock->locked, MemoryOrder_Relax) != 0)
+            sync_backoff(&backoff);
+    }
+}
+
+void spinlock_unlock(SpinLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    atomic_store_32(&lock->locked, 0, MemoryOrder_Release);
+}
+
+/* TicketLock */
+
+/* Pauses per ticket ahead of ours, and total pauses before yielding the thread */
+#define TICKETLOCK_PAUSES_PER_TICKET 32
+#define TICKETLOCK_MAX_PAUSES 128
+
+void ticketlock_init(TicketLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    lock->next = 0;
+    lock->serving = 0;
+}
+
+/* Tickets wrap around after 2^32 acquisitions, the arithmetic is done unsigned to keep it defined */
+
+bool ticketlock_try_lock(TicketLock* lock)
+{
+    Atomic32 serving;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    serving = atomic_load_32(&lock->serving, MemoryOrder_Relax);
+
+    return atomic_compare_exchange_strong_32(&lock->next,
+                                             (Atomic32)((uint32_t)serving + 1U),
+                                             serving,
+                                             MemoryOrder_Acquire);
+}
+
+void ticketlock_lock(TicketLock* lock)
+{
+    Atomic32 ticket;
+    Atomic32 serving;
+    uint32_t total_pauses = 0;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    /* atomic_fetch_add_32 returns the incremented value */
+    ticket = (Atomic32)((uint32_t)atomic_fetch_add_32(&lock->next, 1, MemoryOrder_Relax) - 1U);
+
+    while((serving = atomic_load_32(&lock->serving, MemoryOrder_Acquire)) != ticket)
+    {
+        /* Proportional backoff: the further we are in the queue, the longer we wait */
+        uint32_t pauses = ((uint32_t)ticket - (uint32_t)serving) * TICKETLOCK_PAUSES_PER_TICKET;
+        uint32_t i;
+
+        /* The owner or a thread before us may have been preempted */
+        if(total_pauses > TICKETLOCK_MAX_PAUSES)
+        {
+            thread_yield();
+            continue;
+        }
+
+        for(i = 0; i < pauses; i++)
+            cpu_pause();
+
+        total_pauses += pauses;
+    }
+}
+
+void ticketlock_unlock(TicketLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    /* Only the owner writes serving */
+    atomic_store_32(&lock->serving,
+                    (Atomic32)((uint32_t)atomic_load_32(&lock->serving, MemoryOrder_Relax) + 1U),
+                    MemoryOrder_Release);
+}
+
+/* FastMutex */
+
+#define FASTMUTEX_MAX_SPINS 100
+
+void fastmutex_init(FastMutex* mutex)
+{
+    ROMANO_ASSERT(mutex != NULL, "");
+
+    mutex->state = 0;
+    mutex->spins = 0;
+}
+
+bool fastmutex_try_lock(FastMutex* mutex)
+{
+    ROMANO_ASSERT(mutex != NULL, "");
+
+    return atomic_compare_exchange_strong_32(&mutex->state, 1, 0, MemoryOrder_Acquire);
+}
+
+void fastmutex_lock(FastMutex* mutex)
+{
+    Atomic32 spins;
+    Atomic32 max_spins;
+    Atomic32 count;
+
+    ROMANO_ASSERT(mutex != NULL, "");
+
+    if(atomic_compare_exchange_strong_32(&mutex->state, 1, 0, MemoryOrder_Acquire))
+        return;
+
+    /* Same heuristic as glibc adaptive mutexes: spin up to twice the average spin count */
+    spins = atomic_load_32(&mutex->spins, MemoryOrder_Relax);
+    max_spins = spins * 2 + 10;
+
+    if(max_spins > FASTMUTEX_MAX_SPINS)
+        max_spins = FASTMUTEX_MAX_SPINS;
+
+    for(count = 0; count < max_spins; count++)
+    {
+        if(atomic_load_32(&mutex->state, MemoryOrder_Relax) == 0 &&
+           atomic_compare_exchange_strong_32(&mutex->state, 1, 0, MemoryOrder_Acquire))
+        {
+            atomic_store_32(&mutex->spins, spins + (count - spins) / 8, MemoryOrder_Relax);
+            return;
+        }
+
+        cpu_pause();
+    }
+
+    atomic_store_32(&mutex->spins, spins + (count - spins) / 8, MemoryOrder_Relax);
+
+    /* Marks the mutex as contended so the owner wakes us on unlock */
+    while(atomic_exchange_32(&mutex->state, 2, MemoryOrder_Acquire) != 0)
+        address_wait(&mutex->state, 2, SYNC_WAIT_INFINITE);
+}
+
+void fastmutex_unlock(FastMutex* mutex)
+{
+    ROMANO_ASSERT(mutex != NULL, "");
+
+    if(atomic_exchange_32(&mutex->state, 0, MemoryOrder_Release) == 2)
+        address_wake_one(&mutex->state);
+}
+
+/* RWLock */
+
+#define RWLOCK_WRITER 0x40000000
+
+void rwlock_init(RWLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    lock->state = 0;
+    lock->writers_waiting = 0;
+    lock->sleepers = 0;
+    lock->wake_seq = 0;
+}
+
+ROMANO_FORCE_INLINE bool rwlock_readers_blocked(RWLock* lock, Atomic32 state)
+{
+    return (state & RWLOCK_WRITER) != 0 ||
+           atomic_load_32(&lock->writers_waiting, MemoryOrder_SeqCst) != 0;
+}
+
+/*
+ * Sleepers wait on wake_seq rather than on the state: a reader blocked by writers_waiting sees
+ * a free state, and a writer locking and unlocking before it sleeps would leave the state
+ * unchanged. Every transition that can unblock someone bumps wake_seq, so sleepers that read
+ * wake_seq before checking the state one last time cannot miss it
+ */
+ROMANO_FORCE_INLINE void rwlock_sleep(RWLock* lock, bool writer)
+{
+    Atomic32 wake_seq;
+    Atomic32 state;
+
+    atomic_add_32(&lock->sleepers, 1, MemoryOrder_SeqCst);
+
+    wake_seq = atomic_load_32(&lock->wake_seq, MemoryOrder_SeqCst);
+    state = atomic_load_32(&lock->state, MemoryOrder_SeqCst);
+
+    if(writer ? state != 0 : rwlock_readers_blocked(lock, state))
+        address_wait(&lock->wake_seq, wake_seq, SYNC_WAIT_INFINITE);
+
+    atomic_sub_32(&lock->sleepers, 1, MemoryOrder_SeqCst);
+}
+
+/* Called after the transition, wake_seq wraps around */
+ROMANO_FORCE_INLINE void rwlock_wake(RWLock* lock)
+{
+    atomic_add_32(&lock->wake_seq, 1, MemoryOrder_SeqCst);
+
+    if(atomic_load_32(&lock->sleepers, MemoryOrder_SeqCst) != 0)
+        address_wake_all(&lock->wake_seq);
+}
+
+bool rwlock_try_read_lock(RWLock* lock)
+{
+    Atomic32 state;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    state = atomic_load_32(&lock->state, MemoryOrder_SeqCst);
+
+    while(!rwlock_readers_blocked(lock, state))
+    {
+        if(atomic_compare_exchange_weak_32(&lock->state, state + 1, state, MemoryOrder_SeqCst))
+            return true;
+
+        state = atomic_load_32(&lock->state, MemoryOrder_SeqCst);
+    }
+
+    return false;
+}
+
+void rwlock_read_lock(RWLock* lock)
+{
+    uint32_t backoff = 1;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    while(!rwlock_try_read_lock(lock))
+    {
+        if(backoff <= SYNC_MAX_BACKOFF)
+            sync_backoff(&backoff);
+        else
+            rwlock_sleep(lock, false);
+    }
+}
+
+void rwlock_read_unlock(RWLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    /* Only the last reader can unblock a writer */
+    if(atomic_fetch_add_32(&lock->state, -1, MemoryOrder_SeqCst) == 0)
+        rwlock_wake(lock);
+}
+
+bool rwlock_try_write_lock(RWLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    return atomic_compare_exchange_strong_32(&lock->state, RWLOCK_WRITER, 0, MemoryOrder_SeqCst);
+}
+
+void rwlock_write_lock(RWLock* lock)
+{
+    uint32_t backoff = 1;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    if(rwlock_try_write_lock(lock))
+        return;
+
+    /* From now on, new readers block */
+    atomic_add_32(&lock->writers_waiting, 1, MemoryOrder_SeqCst);
+
+    while(!rwlock_try_write_lock(lock))
+    {
+        if(backoff <= SYNC_MAX_BACKOFF)
+            sync_backoff(&backoff);
+        else
+            rwlock_sleep(lock, true);
+    }
+
+    /* Readers may be waiting for the last waiting writer to leave */
+    if(atomic_fetch_add_32(&lock->writers_waiting, -1, MemoryOrder_SeqCst) == 0)
+        rwlock_wake(lock);
+}
+
+void rwlock_write_unlock(RWLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    atomic_store_32(&lock->state, 0, MemoryOrder_SeqCst);
+
+    rwlock_wake(lock);
+}
+
+/* SeqLock */
+
+void seqlock_init(SeqLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    lock->sequence = 0;
+}
+
+void seqlock_write_begin(SeqLock* lock)
+{
+    uint32_t backoff = 1;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    while(1)
+    {
+        Atomic32 sequence = atomic_load_32(&lock->sequence, MemoryOrder_Relax);
+
+        /* An odd sequence means a writer is active */
+        if((sequence & 1) == 0 &&
+           atomic_compare_exchange_weak_32(&lock->sequence,
+                                           (Atomic32)((uint32_t)sequence + 1U),
+                                           sequence,
+                                           MemoryOrder_SeqCst))
+            break;
+
+        sync_backoff(&backoff);
+    }
+
+    /* Orders the odd sequence before the data stores, pairs with the fence in seqlock_read_retry */
+    atomic_thread_fence(MemoryOrder_Release);
+}
+
+void seqlock_write_end(SeqLock* lock)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    atomic_store_32(&lock->sequence,
+                    (Atomic32)((uint32_t)atomic_load_32(&lock->sequence, MemoryOrder_Relax) + 1U),
+                    MemoryOrder_Release);
+}
+
+uint32_t seqlock_read_begin(SeqLock* lock)
+{
+    uint32_t backoff = 1;
+    Atomic32 sequence;
+
+    ROMANO_ASSERT(lock != NULL, "");
+
+    while(((sequence = atomic_load_32(&lock->sequence, MemoryOrder_Acquire)) & 1) != 0)
+        sync_backoff(&backoff);
+
+    return (uint32_t)sequence;
+}
+
+bool seqlock_read_retry(SeqLock* lock, uint32_t sequence)
+{
+    ROMANO_ASSERT(lock != NULL, "");
+
+    atomic_thread_fence(MemoryOrder_Acquire);
+
+    return (uint32_t)atomic_load_32(&lock->sequence, MemoryOrder_Relax) != sequence;
+}
+
+/* Event */
+
+void event_init(Event* event, EventMode mode)
+{
+    ROMANO_ASSERT(event != NULL, "");
+
+    event->signaled = 0;
+    event->sleepers = 0;
+    event->mode = mode;
+}
+
+void event_set(Event* event)
+{
+    ROMANO_ASSERT(event != NULL, "");
+
+    atomic_store_32(&event->signaled, 1, MemoryOrder_SeqCst);
+
+    if(atomic_load_32(&event->sleepers, MemoryOrder_SeqCst) != 0)
+    {
+        if(event->mode == EventMode_AutoReset)
+            address_wake_one(&event->signaled);
+        else
+            address_wake_all(&event->signaled);
+    }
+}
+
+void event_reset(Event* event)
+{
+    ROMANO_ASSERT(event != NULL, "");
+
+    atomic_store_32(&event->signaled, 0, MemoryOrder_Release);
+}
+
+bool event_try_wait(Event* event)
+{
+    ROMANO_ASSERT(event != NULL, "");
+
+    if(event->mode == EventMode_AutoReset)
+        return atomic_compare_exchange_strong_32(&event->signaled, 0, 1, MemoryOrder_Acquire);
+
+    return atomic_load_32(&event->signaled, MemoryOrder_Acquire) != 0;
+}
+
+bool event_wait_for(Event* event, uint64_t timeout_ns)
+{
+    uint64_t deadline = 0;
+    uint64_t remaining = SYNC_WAIT_INFINITE;
+
+    ROMANO_ASSERT(event != NULL, "");
+
+    if(timeout_ns != SYNC_WAIT_INFINITE)
+        deadline = time_get_monotonic_ns() + timeout_ns;
+
+    while(!event_try_wait(event))
+    {
+        if(timeout_ns != SYNC_WAIT_INFINITE)
+        {
+            uint64_t now = time_get_monotonic_ns();
+
+            if(now >= deadline)
+                return false;
+
+            remaining = deadline - now;
+        }
+
+        atomic_add_32(&event->sleepers, 1, MemoryOrder_SeqCst);
+
+        if(atomic_load_32(&event->signaled, MemoryOrder_SeqCst) == 0)
+            address_wait(&event->signaled, 0, remaining);
+
+        atomic_sub_32(&event->sleepers, 1, MemoryOrder_SeqCst);
+    }
+
+    return true;
+}
+
+void event_wait(Event* event)
+{
+    event_wait_for(event, SYNC_WAIT_INFINITE);
+}
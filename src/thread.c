@@ -6,6 +6,10 @@
 #include "libromano/atomic.h"
 #include "libromano/vector.h"
 #include "libromano/error.h"
+#include "libromano/cpu.h"
+#include "libromano/memory.h"
+#include "libromano/time.h"
+#include "libromano/logger.h"
 
 #include "concurrentqueue/concurrentqueue.h"
 
@@ -339,35 +343,151 @@ void thread_join(Thread* thread)
     free(thread);
 }
 
+bool thread_set_current_affinity(uint32_t processor)
+{
+#if defined(ROMANO_WIN)
+    if(processor >= 64)
+        return false;
+
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor) != 0;
+#elif defined(ROMANO_LINUX)
+    cpu_set_t set;
+
+    if(processor >= CPU_SETSIZE)
+        return false;
+
+    CPU_ZERO(&set);
+    CPU_SET(processor, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+    ROMANO_UNUSED(processor);
+    return false;
+#endif /* defined(ROMANO_WIN) */
+}
+
+ROMANO_FORCE_INLINE void threadpool_spin_lock(int32_t* lock)
+{
+    while(!atomic_compare_exchange_strong_32((Atomic32*)lock, 1, 0, MemoryOrder_Acquire))
+        thread_yield();
+}
+
+ROMANO_FORCE_INLINE void threadpool_spin_unlock(int32_t* lock)
+{
+    atomic_store_32((Atomic32*)lock, 0, MemoryOrder_Release);
+}
+
 struct Work
 {
     ThreadFunc func;
     void* arg;
     ThreadPoolWaiter* waiter;
+
+    /* Set when the work is a task of a TaskGraph */
+    struct TaskGraph* graph;
+    uint32_t graph_task;
+
+    /* Set when the work result is stored in a future, the work holds a reference on it */
+    struct Future* future;
+
+    ThreadPoolPriority priority;
+
+    /* Monotonic time in nanoseconds, THREADPOOL_NO_DEADLINE if the work has no deadline */
+    uint64_t deadline_ns;
 };
 
 typedef struct Work Work;
 
-typedef struct Worker
+typedef struct TaskGraphNode
+{
+    ThreadFunc func;
+    void* arg;
+
+    /* uint32_t ids of the tasks waiting for this one */
+    Vector successors;
+
+    uint32_t predecessors_count;
+
+    /* Number of predecessors left to execute during the current submission */
+    int32_t pending;
+} TaskGraphNode;
+
+struct TaskGraph
+{
+    Vector nodes;
+
+    ThreadPoolWaiter* waiter;
+
+    /* Number of tasks left to execute during the current submission */
+    int32_t running;
+
+    bool validated;
+};
+
+/*
+ * Every THREADPOOL_NORMAL_TURN (resp. THREADPOOL_BACKGROUND_TURN) dequeues, a worker looks into
+ * the normal (resp. background) lane first so lower priorities cannot starve
+ */
+#define THREADPOOL_NORMAL_TURN 8
+#define THREADPOOL_BACKGROUND_TURN 32
+
+typedef struct ROMANO_ALIGN(ROMANO_CACHE_LINE_SIZE) Worker
 {
-    MoodycamelCQHandle queue;
+    /* One queue per priority lane */
+    MoodycamelCQHandle queues[ThreadPoolPriority_Count];
     struct ThreadPool* pool;
     Thread* thread;
     size_t tid;
     uint32_t index;
-    char _pad[64];
+
+    /* Logical processor the worker is pinned to, CPU_TOPOLOGY_UNKNOWN if not pinned */
+    uint32_t processor;
+    uint32_t numa_node;
+
+    /* Indices of the workers to steal from, same numa node first */
+    uint32_t* steal_order;
+
+    /* Keeps the counters updated by the worker away from the fields read by the other workers */
+    char _pad[ROMANO_CACHE_LINE_SIZE];
+
+    /* Telemetry, only written by the worker itself except max_queue_depth */
+    Atomic64 tasks_executed;
+    Atomic64 tasks_stolen;
+    Atomic64 failed_steals;
+    Atomic64 busy_ns;
+    Atomic64 idle_ns;
+    Atomic64 max_queue_depth;
+
+    uint32_t dequeues_count;
 } Worker;
 
 struct ThreadPool
 {
     Worker* workers;
 
+    /* workers_count * workers_count block the workers steal orders point into */
+    uint32_t* steal_orders;
+
     uint32_t working_threads_count;
     uint32_t workers_count;
     uint32_t alive_count;
     uint32_t stop;
 
     uint32_t submit_rr;
+
+    Thread* stats_log_thread;
+    uint32_t stats_log_interval_ms;
+
+    /* Binary min-heap of the works carrying a deadline, shared by all the workers */
+    Work** deadlines;
+    uint32_t deadlines_count;
+    uint32_t deadlines_capacity;
+    int32_t deadlines_lock;
+
+    /* Futures are allocated by chunks and recycled through a free list */
+    struct FutureChunk* futures_chunks;
+    struct Future* futures_free;
+    int32_t futures_lock;
 };
 
 Work* work_new(ThreadFunc func, void* arg, ThreadPoolWaiter* waiter)
@@ -387,6 +507,11 @@ Work* work_new(ThreadFunc func, void* arg, ThreadPoolWaiter* waiter)
     new_work->func = func;
     new_work->arg = arg;
     new_work->waiter = waiter;
+    new_work->graph = NULL;
+    new_work->graph_task = TASKGRAPH_INVALID_TASK;
+    new_work->future = NULL;
+    new_work->priority = ThreadPoolPriority_Normal;
+    new_work->deadline_ns = THREADPOOL_NO_DEADLINE;
 
     if(waiter != NULL)
         atomic_add_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Relax);
@@ -394,6 +519,8 @@ Work* work_new(ThreadFunc func, void* arg, ThreadPoolWaiter* waiter)
     return new_work;
 }
 
+void future_unref(Future* future);
+
 void work_free(Work* work)
 {
     ROMANO_ASSERT(work != NULL, "");
@@ -402,7 +529,10 @@ void work_free(Work* work)
     work->arg = NULL;
 
     if(work->waiter != NULL)
-        atomic_sub_32((Atomic32*)&work->waiter->counter, 1, MemoryOrder_Relax);
+        atomic_sub_32((Atomic32*)&work->waiter->counter, 1, MemoryOrder_Release);
+
+    if(work->future != NULL)
+        future_unref(work->future);
 
     free(work);
 }
@@ -421,6 +551,14 @@ Worker* threadpool_current_worker(ThreadPool* pool)
     return NULL;
 }
 
+bool threadpool_work_submit(ThreadPool* threadpool, Work* work);
+
+void taskgraph_task_done(ThreadPool* pool, TaskGraph* graph, uint32_t task);
+
+bool future_start(Future* future);
+
+void future_finish(Future* future, void* result);
+
 void work_execute(ThreadPool* pool, Work* work)
 {
     ROMANO_ASSERT(work != NULL && work->func != NULL, "Invalid work item");
@@ -429,26 +567,255 @@ void work_execute(ThreadPool* pool, Work* work)
 
     atomic_add_32((Atomic32*)&pool->working_threads_count, 1, MemoryOrder_Relax);
 
-    work->func(work->arg);
+    if(work->future != NULL)
+    {
+        /* A cancelled future is skipped, its dependents have already been notified */
+        if(future_start(work->future))
+            future_finish(work->future, work->func(work->arg));
+    }
+    else
+    {
+        work->func(work->arg);
+    }
+
+    /* Successors are scheduled before the work is freed so the waiter never reaches zero early */
+    if(work->graph != NULL)
+        taskgraph_task_done(pool, work->graph, work->graph_task);
 
     atomic_sub_32((Atomic32*)&pool->working_threads_count, 1, MemoryOrder_Relax);
 
     work_free(work);
 }
 
+/* Counters have a single writer, readers only need to see non-torn values */
+ROMANO_FORCE_INLINE void worker_stat_add(Atomic64* stat, uint64_t value)
+{
+    atomic_store_64(stat, atomic_load_64(stat, MemoryOrder_Relax) + (Atomic64)value, MemoryOrder_Relax);
+}
+
+size_t worker_queues_size_approx(Worker* worker)
+{
+    size_t size = 0;
+    uint32_t i;
+
+    for(i = 0; i < ThreadPoolPriority_Count; i++)
+        size += moodycamel_cq_size_approx(worker->queues[i]);
+
+    return size;
+}
+
+void worker_sample_queue_depth(Worker* worker)
+{
+    Atomic64 depth = (Atomic64)worker_queues_size_approx(worker);
+    Atomic64 max_depth = atomic_load_64(&worker->max_queue_depth, MemoryOrder_Relax);
+
+    while(depth > max_depth)
+    {
+        if(atomic_compare_exchange_weak_64(&worker->max_queue_depth,
+                                           depth,
+                                           max_depth,
+                                           MemoryOrder_Relax))
+            break;
+
+        max_depth = atomic_load_64(&worker->max_queue_depth, MemoryOrder_Relax);
+    }
+}
+
+/* Executes the work and accounts the time since last_ns as idle, and the execution as busy */
+void worker_execute(Worker* self, Work* work, uint64_t* last_ns)
+{
+    uint64_t start = time_get_monotonic_ns();
+    uint64_t end;
+
+    worker_stat_add(&self->idle_ns, start - *last_ns);
+
+    work_execute(self->pool, work);
+
+    end = time_get_monotonic_ns();
+
+    worker_stat_add(&self->busy_ns, end - start);
+    worker_stat_add(&self->tasks_executed, 1);
+
+    *last_ns = end;
+}
+
 Work* threadpool_try_steal(ThreadPool* pool, Worker* self)
 {
     uint32_t count = pool->workers_count;
-    uint32_t start = self->index;
     uint32_t i;
     Work* work;
 
-    for(i = 1; i < count; i++)
+    for(i = 0; i < count - 1; i++)
+    {
+        uint32_t victim = self->steal_order[i];
+        uint32_t lane;
+
+        for(lane = 0; lane < ThreadPoolPriority_Count; lane++)
+        {
+            if(moodycamel_cq_try_dequeue(pool->workers[victim].queues[lane],
+                                         (MoodycamelValue*)&work))
+            {
+                ROMANO_TP_ACQUIRE(work);
+
+                worker_stat_add(&self->tasks_stolen, 1);
+
+                return work;
+            }
+        }
+    }
+
+    if(count > 1)
+        worker_stat_add(&self->failed_steals, 1);
+
+    return NULL;
+}
+
+/* Deadlines heap, must be called with the deadlines lock held */
+
+void threadpool_deadlines_sift_up(ThreadPool* pool, uint32_t index)
+{
+    Work** heap = pool->deadlines;
+
+    while(index > 0)
+    {
+        uint32_t parent = (index - 1) / 2;
+        Work* tmp;
+
+        if(heap[parent]->deadline_ns <= heap[index]->deadline_ns)
+            break;
+
+        tmp = heap[parent];
+        heap[parent] = heap[index];
+        heap[index] = tmp;
+
+        index = parent;
+    }
+}
+
+void threadpool_deadlines_sift_down(ThreadPool* pool, uint32_t index)
+{
+    Work** heap = pool->deadlines;
+    uint32_t count = pool->deadlines_count;
+
+    while(1)
+    {
+        uint32_t left = index * 2 + 1;
+        uint32_t right = left + 1;
+        uint32_t smallest = index;
+        Work* tmp;
+
+        if(left < count && heap[left]->deadline_ns < heap[smallest]->deadline_ns)
+            smallest = left;
+
+        if(right < count && heap[right]->deadline_ns < heap[smallest]->deadline_ns)
+            smallest = right;
+
+        if(smallest == index)
+            break;
+
+        tmp = heap[smallest];
+        heap[smallest] = heap[index];
+        heap[index] = tmp;
+
+        index = smallest;
+    }
+}
+
+bool threadpool_deadlines_push(ThreadPool* pool, Work* work)
+{
+    threadpool_spin_lock(&pool->deadlines_lock);
+
+    if(pool->deadlines_count == pool->deadlines_capacity)
+    {
+        uint32_t new_capacity = pool->deadlines_capacity == 0 ? 64 : pool->deadlines_capacity * 2;
+        Work** new_deadlines = (Work**)realloc(pool->deadlines, new_capacity * sizeof(Work*));
+
+        if(new_deadlines == NULL)
+        {
+            threadpool_spin_unlock(&pool->deadlines_lock);
+            g_current_error = ErrorCode_MemAllocError;
+            return false;
+        }
+
+        pool->deadlines = new_deadlines;
+        pool->deadlines_capacity = new_capacity;
+    }
+
+    pool->deadlines[pool->deadlines_count] = work;
+    threadpool_deadlines_sift_up(pool, pool->deadlines_count);
+
+    atomic_store_32((Atomic32*)&pool->deadlines_count,
+                    (Atomic32)(pool->deadlines_count + 1),
+                    MemoryOrder_Release);
+
+    threadpool_spin_unlock(&pool->deadlines_lock);
+
+    return true;
+}
+
+Work* threadpool_deadlines_pop(ThreadPool* pool)
+{
+    Work* work;
+
+    /* Avoids taking the lock when no work with a deadline has been submitted */
+    if(atomic_load_32((Atomic32*)&pool->deadlines_count, MemoryOrder_Acquire) == 0)
+        return NULL;
+
+    threadpool_spin_lock(&pool->deadlines_lock);
+
+    if(pool->deadlines_count == 0)
+    {
+        threadpool_spin_unlock(&pool->deadlines_lock);
+        return NULL;
+    }
+
+    work = pool->deadlines[0];
+
+    atomic_store_32((Atomic32*)&pool->deadlines_count,
+                    (Atomic32)(pool->deadlines_count - 1),
+                    MemoryOrder_Release);
+
+    if(pool->deadlines_count > 0)
+    {
+        pool->deadlines[0] = pool->deadlines[pool->deadlines_count];
+        threadpool_deadlines_sift_down(pool, 0);
+    }
+
+    threadpool_spin_unlock(&pool->deadlines_lock);
+
+    return work;
+}
+
+/*
+ * Takes the next work of the worker: works with a deadline first (earliest deadline first),
+ * then the high, normal and background lanes, with periodic turns given to the lower lanes
+ */
+Work* worker_dequeue(Worker* self)
+{
+    uint32_t first_lane = ThreadPoolPriority_High;
+    uint32_t i;
+    Work* work;
+
+    self->dequeues_count++;
+
+    if(self->dequeues_count % THREADPOOL_BACKGROUND_TURN == 0)
+        first_lane = ThreadPoolPriority_Background;
+    else if(self->dequeues_count % THREADPOOL_NORMAL_TURN == 0)
+        first_lane = ThreadPoolPriority_Normal;
+
+    if(first_lane == ThreadPoolPriority_High)
+    {
+        work = threadpool_deadlines_pop(self->pool);
+
+        if(work != NULL)
+            return work;
+    }
+
+    for(i = 0; i < ThreadPoolPriority_Count; i++)
     {
-        uint32_t victim = (start + i) % count;
+        uint32_t lane = (first_lane + i) % ThreadPoolPriority_Count;
 
-        if(moodycamel_cq_try_dequeue(pool->workers[victim].queue,
-                                     (MoodycamelValue*)&work))
+        if(moodycamel_cq_try_dequeue(self->queues[lane], (MoodycamelValue*)&work))
         {
             ROMANO_TP_ACQUIRE(work);
 
@@ -456,6 +823,10 @@ Work* threadpool_try_steal(ThreadPool* pool, Worker* self)
         }
     }
 
+    /* The lower lanes were empty during their turn */
+    if(first_lane != ThreadPoolPriority_High)
+        return threadpool_deadlines_pop(self->pool);
+
     return NULL;
 }
 
@@ -465,21 +836,28 @@ void* threadpool_worker_func(void* arg)
     ThreadPool* pool = self->pool;
     Work* work;
     uint32_t spins = 0;
+    uint64_t last_ns;
+    uint64_t now_ns;
 
     self->tid = thread_get_id();
 
+    if(self->processor != CPU_TOPOLOGY_UNKNOWN)
+        thread_set_current_affinity(self->processor);
+
     atomic_add_32((Atomic32*)&pool->alive_count, 1, MemoryOrder_AcqRel);
 
+    last_ns = time_get_monotonic_ns();
+
     while(1)
     {
         if(atomic_load_32((Atomic32*)&pool->stop, MemoryOrder_Relax))
             break;
 
-        if(moodycamel_cq_try_dequeue(self->queue, (MoodycamelValue*)&work))
-        {
-            ROMANO_TP_ACQUIRE(work);
+        work = worker_dequeue(self);
 
-            work_execute(pool, work);
+        if(work != NULL)
+        {
+            worker_execute(self, work, &last_ns);
             spins = 0;
 
             continue;
@@ -489,7 +867,7 @@ void* threadpool_worker_func(void* arg)
 
         if(work != NULL)
         {
-            work_execute(pool, work);
+            worker_execute(self, work, &last_ns);
             spins = 0;
             continue;
         }
@@ -503,6 +881,10 @@ void* threadpool_worker_func(void* arg)
             thread_yield();
             spins = 1024;
         }
+
+        now_ns = time_get_monotonic_ns();
+        worker_stat_add(&self->idle_ns, now_ns - last_ns);
+        last_ns = now_ns;
     }
 
     atomic_sub_32((Atomic32*)&pool->alive_count, 1, MemoryOrder_AcqRel);
@@ -518,11 +900,121 @@ ThreadPoolWaiter threadpool_waiter_new(void)
     return waiter;
 }
 
+/* Sort key of the processors used for placement: physical cores first, grouped by numa node */
+ROMANO_FORCE_INLINE bool threadpool_placement_less(const CPULogicalProcessor* a,
+                                                   const CPULogicalProcessor* b)
+{
+    if(a->smt_index != b->smt_index)
+        return a->smt_index < b->smt_index;
+
+    if(a->numa_node != b->numa_node)
+        return a->numa_node < b->numa_node;
+
+    return a->core_id < b->core_id;
+}
+
+/*
+ * Fills the processors the workers will be pinned to. Returns the number of processors used,
+ * 0 if no pinning should be done
+ */
+uint32_t threadpool_placement_processors(CPUTopology* topology,
+                                         ThreadPoolPlacement placement,
+                                         CPULogicalProcessor* processors)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for(i = 0; i < topology->processors_count; i++)
+    {
+        CPULogicalProcessor processor = topology->processors[i];
+        uint32_t j;
+
+        if(placement == ThreadPoolPlacement_PerPhysicalCore && processor.smt_index != 0)
+            continue;
+
+        j = count++;
+
+        while(j > 0 && threadpool_placement_less(&processor, &processors[j - 1]))
+        {
+            processors[j] = processors[j - 1];
+            j--;
+        }
+
+        processors[j] = processor;
+    }
+
+    return count;
+}
+
+void threadpool_build_steal_orders(ThreadPool* threadpool)
+{
+    uint32_t count = threadpool->workers_count;
+    uint32_t i;
+
+    for(i = 0; i < count; i++)
+    {
+        Worker* self = &threadpool->workers[i];
+        uint32_t n = 0;
+        uint32_t j;
+
+        self->steal_order = threadpool->steal_orders + (size_t)i * count;
+
+        for(j = 1; j < count; j++)
+        {
+            uint32_t victim = (i + j) % count;
+
+            if(threadpool->workers[victim].numa_node == self->numa_node)
+                self->steal_order[n++] = victim;
+        }
+
+        for(j = 1; j < count; j++)
+        {
+            uint32_t victim = (i + j) % count;
+
+            if(threadpool->workers[victim].numa_node != self->numa_node)
+                self->steal_order[n++] = victim;
+        }
+    }
+}
+
 ThreadPool* threadpool_init(uint32_t workers_count)
+{
+    return threadpool_init_with_placement(workers_count, ThreadPoolPlacement_None);
+}
+
+ThreadPool* threadpool_init_with_placement(uint32_t workers_count,
+                                           ThreadPoolPlacement placement)
 {
     ThreadPool* threadpool;
+    CPUTopology topology;
+    CPULogicalProcessor* processors = NULL;
+    uint32_t processors_count = 0;
     uint32_t i;
 
+    if(placement != ThreadPoolPlacement_None)
+    {
+        if(!cpu_topology_init(&topology))
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            return NULL;
+        }
+
+        processors = (CPULogicalProcessor*)malloc(topology.processors_count * sizeof(CPULogicalProcessor));
+
+        if(processors == NULL)
+        {
+            g_current_error = ErrorCode_MemAllocError;
+            cpu_topology_release(&topology);
+            return NULL;
+        }
+
+        processors_count = threadpool_placement_processors(&topology, placement, processors);
+
+        cpu_topology_release(&topology);
+
+        workers_count = workers_count == 0 ? processors_count : workers_count;
+    }
+
     workers_count = workers_count == 0 ? (uint32_t)get_num_procs() : workers_count;
 
     threadpool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
@@ -530,35 +1022,68 @@ ThreadPool* threadpool_init(uint32_t workers_count)
     if(threadpool == NULL)
     {
         g_current_error = ErrorCode_MemAllocError;
+        free(processors);
         return NULL;
     }
 
-    threadpool->workers = (Worker*)calloc(workers_count, sizeof(Worker));
+    threadpool->workers = (Worker*)mem_aligned_alloc(workers_count * sizeof(Worker),
+                                                     ROMANO_CACHE_LINE_SIZE);
+    threadpool->steal_orders = (uint32_t*)calloc((size_t)workers_count * workers_count, sizeof(uint32_t));
 
-    if(threadpool->workers == NULL)
+    if(threadpool->workers == NULL || threadpool->steal_orders == NULL)
     {
         g_current_error = ErrorCode_MemAllocError;
+        free(threadpool->steal_orders);
+
+        if(threadpool->workers != NULL)
+            mem_aligned_free(threadpool->workers);
+
         free(threadpool);
+        free(processors);
         return NULL;
     }
 
+    memset(threadpool->workers, 0, workers_count * sizeof(Worker));
+
     threadpool->workers_count = workers_count;
 
+    /* More workers than processors wrap around, the workers then share processors */
     for(i = 0; i < workers_count; i++)
     {
-        threadpool->workers[i].pool  = threadpool;
-        threadpool->workers[i].index = i;
+        if(processors_count > 0)
+        {
+            threadpool->workers[i].processor = processors[i % processors_count].id;
+            threadpool->workers[i].numa_node = processors[i % processors_count].numa_node;
+        }
+        else
+        {
+            threadpool->workers[i].processor = CPU_TOPOLOGY_UNKNOWN;
+            threadpool->workers[i].numa_node = 0;
+        }
+    }
+
+    free(processors);
+
+    threadpool_build_steal_orders(threadpool);
+
+    for(i = 0; i < workers_count * ThreadPoolPriority_Count; i++)
+    {
+        Worker* worker = &threadpool->workers[i / ThreadPoolPriority_Count];
+
+        worker->pool  = threadpool;
+        worker->index = i / ThreadPoolPriority_Count;
 
-        if(!moodycamel_cq_create(&threadpool->workers[i].queue))
+        if(!moodycamel_cq_create(&worker->queues[i % ThreadPoolPriority_Count]))
         {
             uint32_t j;
 
             g_current_error = ErrorCode_MemAllocError;
 
             for(j = 0; j < i; j++)
-                moodycamel_cq_destroy(threadpool->workers[j].queue);
+                moodycamel_cq_destroy(threadpool->workers[j / ThreadPoolPriority_Count].queues[j % ThreadPoolPriority_Count]);
 
-            free(threadpool->workers);
+            free(threadpool->steal_orders);
+            mem_aligned_free(threadpool->workers);
             free(threadpool);
 
             return NULL;
@@ -578,28 +1103,14 @@ ThreadPool* threadpool_init(uint32_t workers_count)
     return threadpool;
 }
 
-bool threadpool_work_add(ThreadPool* threadpool,
-                         ThreadFunc func,
-                         void* arg,
-                         ThreadPoolWaiter* waiter)
+bool threadpool_work_submit(ThreadPool* threadpool, Work* work)
 {
-    Work* work;
-    Worker* self;
+    Worker* worker;
     uint32_t idx;
 
-    ROMANO_ASSERT(threadpool != NULL, "");
-
-    work = work_new(func, arg, waiter);
-
-    if(work == NULL)
-        return false;
-
-    self = threadpool_current_worker(threadpool);
-
-    if(self != NULL)
+    if(work->deadline_ns != THREADPOOL_NO_DEADLINE)
     {
-        ROMANO_TP_RELEASE(work);
-        if(!moodycamel_cq_enqueue(self->queue, (MoodycamelValue)work))
+        if(!threadpool_deadlines_push(threadpool, work))
         {
             work_free(work);
             return false;
@@ -608,20 +1119,87 @@ bool threadpool_work_add(ThreadPool* threadpool,
         return true;
     }
 
-    idx = atomic_fetch_add_32((Atomic32*)&threadpool->submit_rr, 1, MemoryOrder_Relax) % threadpool->workers_count;
+    worker = threadpool_current_worker(threadpool);
+
+    if(worker == NULL)
+    {
+        idx = atomic_fetch_add_32((Atomic32*)&threadpool->submit_rr, 1, MemoryOrder_Relax) % threadpool->workers_count;
+        worker = &threadpool->workers[idx];
+    }
 
     ROMANO_TP_RELEASE(work);
-    if(!moodycamel_cq_enqueue(threadpool->workers[idx].queue, (MoodycamelValue)work))
+    if(!moodycamel_cq_enqueue(worker->queues[work->priority], (MoodycamelValue)work))
     {
         work_free(work);
         return false;
     }
 
+    worker_sample_queue_depth(worker);
+
     atomic_thread_fence(MemoryOrder_Release);
 
     return true;
 }
 
+bool threadpool_work_add(ThreadPool* threadpool,
+                         ThreadFunc func,
+                         void* arg,
+                         ThreadPoolWaiter* waiter)
+{
+    Work* work;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    work = work_new(func, arg, waiter);
+
+    if(work == NULL)
+        return false;
+
+    return threadpool_work_submit(threadpool, work);
+}
+
+bool threadpool_work_add_with_priority(ThreadPool* threadpool,
+                                       ThreadFunc func,
+                                       void* arg,
+                                       ThreadPoolWaiter* waiter,
+                                       ThreadPoolPriority priority)
+{
+    Work* work;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+    ROMANO_ASSERT(priority < ThreadPoolPriority_Count, "Invalid priority");
+
+    work = work_new(func, arg, waiter);
+
+    if(work == NULL)
+        return false;
+
+    work->priority = priority;
+
+    return threadpool_work_submit(threadpool, work);
+}
+
+bool threadpool_work_add_with_deadline(ThreadPool* threadpool,
+                                       ThreadFunc func,
+                                       void* arg,
+                                       ThreadPoolWaiter* waiter,
+                                       uint64_t deadline_ns)
+{
+    Work* work;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    work = work_new(func, arg, waiter);
+
+    if(work == NULL)
+        return false;
+
+    work->priority = ThreadPoolPriority_High;
+    work->deadline_ns = deadline_ns;
+
+    return threadpool_work_submit(threadpool, work);
+}
+
 void threadpool_wait(ThreadPool* threadpool)
 {
     uint32_t i;
@@ -634,11 +1212,11 @@ void threadpool_wait(ThreadPool* threadpool)
         if(atomic_load_32((Atomic32*)&threadpool->working_threads_count,
                           MemoryOrder_Relax) == 0)
         {
-            all_empty = true;
+            all_empty = atomic_load_32((Atomic32*)&threadpool->deadlines_count, MemoryOrder_Acquire) == 0;
 
-            for(i = 0; i < threadpool->workers_count; i++)
+            for(i = 0; i < threadpool->workers_count && all_empty; i++)
             {
-                if(moodycamel_cq_size_approx(threadpool->workers[i].queue) != 0)
+                if(worker_queues_size_approx(&threadpool->workers[i]) != 0)
                 {
                     all_empty = false;
                     break;
@@ -655,10 +1233,140 @@ void threadpool_wait(ThreadPool* threadpool)
 
 void threadpool_waiter_wait(ThreadPoolWaiter* waiter)
 {
-    while(atomic_load_32((Atomic32*)&waiter->counter, MemoryOrder_Relax) != 0)
+    while(atomic_load_32((Atomic32*)&waiter->counter, MemoryOrder_Acquire) != 0)
         thread_yield();
 }
 
+uint32_t threadpool_get_workers_count(ThreadPool* threadpool)
+{
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    return threadpool->workers_count;
+}
+
+void worker_get_stats(Worker* worker, ThreadPoolWorkerStats* stats)
+{
+    stats->tasks_executed = (uint64_t)atomic_load_64(&worker->tasks_executed, MemoryOrder_Relax);
+    stats->tasks_stolen = (uint64_t)atomic_load_64(&worker->tasks_stolen, MemoryOrder_Relax);
+    stats->failed_steals = (uint64_t)atomic_load_64(&worker->failed_steals, MemoryOrder_Relax);
+    stats->busy_ns = (uint64_t)atomic_load_64(&worker->busy_ns, MemoryOrder_Relax);
+    stats->idle_ns = (uint64_t)atomic_load_64(&worker->idle_ns, MemoryOrder_Relax);
+    stats->queue_depth = (uint64_t)worker_queues_size_approx(worker);
+    stats->max_queue_depth = (uint64_t)atomic_load_64(&worker->max_queue_depth, MemoryOrder_Relax);
+}
+
+uint32_t threadpool_get_stats(ThreadPool* threadpool,
+                              ThreadPoolWorkerStats* stats,
+                              uint32_t stats_count)
+{
+    uint32_t count;
+    uint32_t i;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+    ROMANO_ASSERT(stats != NULL || stats_count == 0, "");
+
+    count = stats_count < threadpool->workers_count ? stats_count : threadpool->workers_count;
+
+    for(i = 0; i < count; i++)
+        worker_get_stats(&threadpool->workers[i], &stats[i]);
+
+    return count;
+}
+
+void threadpool_log_stats(ThreadPool* threadpool)
+{
+    ThreadPoolWorkerStats stats;
+    uint32_t i;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    for(i = 0; i < threadpool->workers_count; i++)
+    {
+        uint64_t total_ns;
+
+        worker_get_stats(&threadpool->workers[i], &stats);
+
+        total_ns = stats.busy_ns + stats.idle_ns;
+
+        logger_log(LogLevel_Info,
+                   "ThreadPool worker %u: %llu executed, %llu stolen, %llu failed steals, "
+                   "%.1f%% busy, queue depth %llu (max %llu)",
+                   i,
+                   (unsigned long long)stats.tasks_executed,
+                   (unsigned long long)stats.tasks_stolen,
+                   (unsigned long long)stats.failed_steals,
+                   total_ns == 0 ? 0.0 : (double)stats.busy_ns * 100.0 / (double)total_ns,
+                   (unsigned long long)stats.queue_depth,
+                   (unsigned long long)stats.max_queue_depth);
+    }
+}
+
+void* threadpool_stats_log_func(void* arg)
+{
+    ThreadPool* threadpool = (ThreadPool*)arg;
+    uint64_t last_ns = time_get_monotonic_ns();
+
+    while(1)
+    {
+        uint32_t interval_ms = (uint32_t)atomic_load_32((Atomic32*)&threadpool->stats_log_interval_ms,
+                                                        MemoryOrder_Relax);
+        uint64_t now_ns;
+
+        if(interval_ms == 0)
+            break;
+
+        /* Sleeps by small steps to notice quickly when the logging is stopped */
+        thread_sleep(10);
+
+        now_ns = time_get_monotonic_ns();
+
+        if((now_ns - last_ns) >= (uint64_t)interval_ms * 1000000ULL)
+        {
+            threadpool_log_stats(threadpool);
+            last_ns = now_ns;
+        }
+    }
+
+    return NULL;
+}
+
+bool threadpool_set_stats_log_interval(ThreadPool* threadpool, uint32_t interval_ms)
+{
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    atomic_store_32((Atomic32*)&threadpool->stats_log_interval_ms,
+                    (Atomic32)interval_ms,
+                    MemoryOrder_Relax);
+
+    if(interval_ms == 0)
+    {
+        if(threadpool->stats_log_thread != NULL)
+        {
+            thread_join(threadpool->stats_log_thread);
+            threadpool->stats_log_thread = NULL;
+        }
+
+        return true;
+    }
+
+    if(threadpool->stats_log_thread == NULL)
+    {
+        threadpool->stats_log_thread = thread_create(threadpool_stats_log_func, threadpool);
+
+        if(threadpool->stats_log_thread == NULL)
+        {
+            atomic_store_32((Atomic32*)&threadpool->stats_log_interval_ms, 0, MemoryOrder_Relax);
+            return false;
+        }
+
+        thread_start(threadpool->stats_log_thread);
+    }
+
+    return true;
+}
+
+void threadpool_futures_release(ThreadPool* threadpool);
+
 void threadpool_release(ThreadPool* threadpool)
 {
     uint32_t workers_count;
@@ -669,16 +1377,20 @@ void threadpool_release(ThreadPool* threadpool)
 
     workers_count = threadpool->workers_count;
 
+    threadpool_set_stats_log_interval(threadpool, 0);
+
     atomic_store_32((Atomic32*)&threadpool->stop, 1, MemoryOrder_SeqCst);
 
     for(i = 0; i < workers_count; i++)
         thread_join(threadpool->workers[i].thread);
 
-    for(i = 0; i < workers_count; i++)
+    for(i = 0; i < workers_count * ThreadPoolPriority_Count; i++)
     {
-        while(moodycamel_cq_size_approx(threadpool->workers[i].queue) > 0)
+        MoodycamelCQHandle queue = threadpool->workers[i / ThreadPoolPriority_Count].queues[i % ThreadPoolPriority_Count];
+
+        while(moodycamel_cq_size_approx(queue) > 0)
         {
-            if(moodycamel_cq_try_dequeue(threadpool->workers[i].queue, (MoodycamelValue*)&work))
+            if(moodycamel_cq_try_dequeue(queue, (MoodycamelValue*)&work))
             {
                 ROMANO_TP_ACQUIRE(work);
 
@@ -686,9 +1398,766 @@ void threadpool_release(ThreadPool* threadpool)
             }
         }
 
-        moodycamel_cq_destroy(threadpool->workers[i].queue);
+        moodycamel_cq_destroy(queue);
     }
 
-    free(threadpool->workers);
+    for(i = 0; i < threadpool->deadlines_count; i++)
+        work_free(threadpool->deadlines[i]);
+
+    free(threadpool->deadlines);
+
+    threadpool_futures_release(threadpool);
+
+    free(threadpool->steal_orders);
+    mem_aligned_free(threadpool->workers);
     free(threadpool);
 }
+
+/* Task graph */
+
+TaskGraph* taskgraph_new(void)
+{
+    TaskGraph* graph = (TaskGraph*)calloc(1, sizeof(TaskGraph));
+
+    if(graph == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    vector_init(&graph->nodes, 16, sizeof(TaskGraphNode));
+
+    if(graph->nodes.data == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        free(graph);
+        return NULL;
+    }
+
+    graph->validated = true;
+
+    return graph;
+}
+
+ROMANO_FORCE_INLINE TaskGraphNode* taskgraph_get_node(TaskGraph* graph, uint32_t task)
+{
+    return (TaskGraphNode*)vector_at(&graph->nodes, (size_t)task);
+}
+
+uint32_t taskgraph_add_task(TaskGraph* graph, ThreadFunc func, void* arg)
+{
+    TaskGraphNode* node;
+
+    ROMANO_ASSERT(graph != NULL, "");
+    ROMANO_ASSERT(func != NULL, "");
+
+    if(taskgraph_is_running(graph) || vector_size(&graph->nodes) >= (size_t)TASKGRAPH_INVALID_TASK)
+        return TASKGRAPH_INVALID_TASK;
+
+    node = &vector_emplace_back(&graph->nodes, TaskGraphNode);
+    node->func = func;
+    node->arg = arg;
+    node->predecessors_count = 0;
+    node->pending = 0;
+
+    vector_init(&node->successors, 4, sizeof(uint32_t));
+
+    if(node->successors.data == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        vector_pop(&graph->nodes);
+        return TASKGRAPH_INVALID_TASK;
+    }
+
+    return (uint32_t)(vector_size(&graph->nodes) - 1);
+}
+
+bool taskgraph_add_dependency(TaskGraph* graph, uint32_t task, uint32_t predecessor)
+{
+    uint32_t count;
+
+    ROMANO_ASSERT(graph != NULL, "");
+
+    count = taskgraph_get_tasks_count(graph);
+
+    if(task >= count || predecessor >= count || task == predecessor)
+        return false;
+
+    if(taskgraph_is_running(graph))
+        return false;
+
+    vector_push_back(&taskgraph_get_node(graph, predecessor)->successors, &task);
+    taskgraph_get_node(graph, task)->predecessors_count++;
+
+    graph->validated = false;
+
+    return true;
+}
+
+uint32_t taskgraph_get_tasks_count(TaskGraph* graph)
+{
+    ROMANO_ASSERT(graph != NULL, "");
+
+    return (uint32_t)vector_size(&graph->nodes);
+}
+
+bool taskgraph_is_running(TaskGraph* graph)
+{
+    ROMANO_ASSERT(graph != NULL, "");
+
+    return atomic_load_32((Atomic32*)&graph->running, MemoryOrder_Acquire) != 0;
+}
+
+/* Kahn's algorithm, checks that all the tasks can be reached (no cycle) */
+bool taskgraph_validate(TaskGraph* graph)
+{
+    uint32_t* ready;
+    uint32_t ready_count;
+    uint32_t visited;
+    uint32_t count;
+    uint32_t i;
+
+    if(graph->validated)
+        return true;
+
+    count = taskgraph_get_tasks_count(graph);
+
+    ready = (uint32_t*)malloc(count * sizeof(uint32_t));
+
+    if(ready == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return false;
+    }
+
+    ready_count = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        TaskGraphNode* node = taskgraph_get_node(graph, i);
+        node->pending = (int32_t)node->predecessors_count;
+
+        if(node->pending == 0)
+            ready[ready_count++] = i;
+    }
+
+    visited = 0;
+
+    while(ready_count > 0)
+    {
+        TaskGraphNode* node = taskgraph_get_node(graph, ready[--ready_count]);
+        size_t j;
+
+        visited++;
+
+        for(j = 0; j < vector_size(&node->successors); j++)
+        {
+            uint32_t successor = *(uint32_t*)vector_at(&node->successors, j);
+
+            if(--taskgraph_get_node(graph, successor)->pending == 0)
+                ready[ready_count++] = successor;
+        }
+    }
+
+    free(ready);
+
+    graph->validated = visited == count;
+
+    return graph->validated;
+}
+
+bool taskgraph_schedule_task(ThreadPool* pool, TaskGraph* graph, uint32_t task)
+{
+    TaskGraphNode* node;
+    Work* work;
+
+    node = taskgraph_get_node(graph, task);
+
+    work = work_new(node->func, node->arg, graph->waiter);
+
+    if(work == NULL)
+        return false;
+
+    work->graph = graph;
+    work->graph_task = task;
+
+    return threadpool_work_submit(pool, work);
+}
+
+void taskgraph_task_done(ThreadPool* pool, TaskGraph* graph, uint32_t task)
+{
+    TaskGraphNode* node;
+    size_t i;
+
+    node = taskgraph_get_node(graph, task);
+
+    for(i = 0; i < vector_size(&node->successors); i++)
+    {
+        uint32_t successor = *(uint32_t*)vector_at(&node->successors, i);
+
+        if(atomic_fetch_add_32((Atomic32*)&taskgraph_get_node(graph, successor)->pending,
+                               -1,
+                               MemoryOrder_AcqRel) == 0)
+        {
+            if(!taskgraph_schedule_task(pool, graph, successor))
+            {
+                /* Nothing else to do than executing it inline */
+                TaskGraphNode* successor_node = taskgraph_get_node(graph, successor);
+                successor_node->func(successor_node->arg);
+                taskgraph_task_done(pool, graph, successor);
+            }
+        }
+    }
+
+    atomic_sub_32((Atomic32*)&graph->running, 1, MemoryOrder_AcqRel);
+}
+
+bool threadpool_graph_submit(ThreadPool* threadpool,
+                             TaskGraph* graph,
+                             ThreadPoolWaiter* waiter)
+{
+    uint32_t count;
+    uint32_t i;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+    ROMANO_ASSERT(graph != NULL, "");
+
+    if(taskgraph_is_running(graph))
+        return false;
+
+    if(!taskgraph_validate(graph))
+        return false;
+
+    count = taskgraph_get_tasks_count(graph);
+
+    if(count == 0)
+        return true;
+
+    graph->waiter = waiter;
+
+    for(i = 0; i < count; i++)
+    {
+        TaskGraphNode* node = taskgraph_get_node(graph, i);
+        node->pending = (int32_t)node->predecessors_count;
+    }
+
+    atomic_store_32((Atomic32*)&graph->running, (Atomic32)count, MemoryOrder_Release);
+
+    /* Holds the waiter while roots are scheduled, a root might complete before the next one is added */
+    if(waiter != NULL)
+        atomic_add_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Relax);
+
+    for(i = 0; i < count; i++)
+    {
+        if(taskgraph_get_node(graph, i)->predecessors_count != 0)
+            continue;
+
+        if(!taskgraph_schedule_task(threadpool, graph, i))
+        {
+            TaskGraphNode* node = taskgraph_get_node(graph, i);
+            node->func(node->arg);
+            taskgraph_task_done(threadpool, graph, i);
+        }
+    }
+
+    if(waiter != NULL)
+        atomic_sub_32((Atomic32*)&waiter->counter, 1, MemoryOrder_Relax);
+
+    return true;
+}
+
+void taskgraph_free(TaskGraph* graph)
+{
+    uint32_t i;
+
+    if(graph == NULL)
+        return;
+
+    ROMANO_ASSERT(!taskgraph_is_running(graph), "Task graph is still executing");
+
+    for(i = 0; i < taskgraph_get_tasks_count(graph); i++)
+        vector_release(&taskgraph_get_node(graph, i)->successors);
+
+    vector_release(&graph->nodes);
+
+    free(graph);
+}
+
+/* Futures */
+
+typedef enum FutureKind {
+    /* Result of a work submitted with threadpool_work_add_future */
+    FutureKind_Work,
+
+    /* Continuation created by future_then, its work is submitted when its antecedent is done */
+    FutureKind_Then,
+
+    /* Created by future_when_all */
+    FutureKind_WhenAll,
+
+    /* Internal link between one future passed to future_when_all and the resulting future */
+    FutureKind_Relay,
+} FutureKind;
+
+struct Future
+{
+    struct ThreadPool* pool;
+
+    /* Continuation function for FutureKind_Then */
+    ThreadFunc func;
+
+    void* result;
+
+    /* WhenAll future notified by a relay */
+    struct Future* target;
+
+    /* Futures to notify once this one is done or cancelled, protected by lock */
+    struct Future* dependents;
+
+    /* Next future in the dependents list of the antecedent, or in the pool free list */
+    struct Future* next;
+
+    int32_t state;
+    int32_t refcount;
+    int32_t lock;
+
+    /* Number of futures left to complete for FutureKind_WhenAll */
+    int32_t pending;
+
+    /* Set by the relays of a FutureKind_WhenAll future when one of the futures has been cancelled */
+    int32_t cancelled;
+
+    FutureKind kind;
+};
+
+#define FUTURE_CHUNK_SIZE 64
+
+typedef struct FutureChunk
+{
+    struct FutureChunk* next;
+    Future futures[FUTURE_CHUNK_SIZE];
+} FutureChunk;
+
+ROMANO_FORCE_INLINE bool future_state_is_final(int32_t state)
+{
+    return state == FutureState_Done || state == FutureState_Cancelled;
+}
+
+Future* future_alloc(ThreadPool* pool, FutureKind kind, int32_t refcount)
+{
+    Future* future;
+
+    threadpool_spin_lock(&pool->futures_lock);
+
+    if(pool->futures_free == NULL)
+    {
+        FutureChunk* chunk = (FutureChunk*)calloc(1, sizeof(FutureChunk));
+        uint32_t i;
+
+        if(chunk == NULL)
+        {
+            threadpool_spin_unlock(&pool->futures_lock);
+            g_current_error = ErrorCode_MemAllocError;
+            return NULL;
+        }
+
+        for(i = 0; i < FUTURE_CHUNK_SIZE; i++)
+        {
+            chunk->futures[i].next = pool->futures_free;
+            pool->futures_free = &chunk->futures[i];
+        }
+
+        chunk->next = pool->futures_chunks;
+        pool->futures_chunks = chunk;
+    }
+
+    future = pool->futures_free;
+    pool->futures_free = future->next;
+
+    threadpool_spin_unlock(&pool->futures_lock);
+
+    future->pool = pool;
+    future->func = NULL;
+    future->result = NULL;
+    future->target = NULL;
+    future->dependents = NULL;
+    future->next = NULL;
+    future->state = FutureState_Pending;
+    future->refcount = refcount;
+    future->lock = 0;
+    future->pending = 0;
+    future->cancelled = 0;
+    future->kind = kind;
+
+    return future;
+}
+
+void future_ref(Future* future)
+{
+    atomic_add_32((Atomic32*)&future->refcount, 1, MemoryOrder_Relax);
+}
+
+void future_unref(Future* future)
+{
+    ThreadPool* pool = future->pool;
+
+    /* atomic_fetch_add_32 returns the updated value */
+    if(atomic_fetch_add_32((Atomic32*)&future->refcount, -1, MemoryOrder_AcqRel) != 0)
+        return;
+
+    threadpool_spin_lock(&pool->futures_lock);
+
+    future->next = pool->futures_free;
+    pool->futures_free = future;
+
+    threadpool_spin_unlock(&pool->futures_lock);
+}
+
+void future_dependency_done(Future* dependent, Future* antecedent);
+
+/* Notifies the dependents once the future has reached a final state */
+void future_notify_dependents(Future* future)
+{
+    Future* dependent;
+
+    threadpool_spin_lock(&future->lock);
+
+    dependent = future->dependents;
+    future->dependents = NULL;
+
+    threadpool_spin_unlock(&future->lock);
+
+    while(dependent != NULL)
+    {
+        Future* next = dependent->next;
+
+        dependent->next = NULL;
+
+        future_dependency_done(dependent, future);
+
+        dependent = next;
+    }
+}
+
+/* Registers dependent to be notified when future is done, takes ownership of one dependent reference */
+void future_add_dependent(Future* future, Future* dependent)
+{
+    threadpool_spin_lock(&future->lock);
+
+    if(!future_state_is_final(atomic_load_32((Atomic32*)&future->state, MemoryOrder_Acquire)))
+    {
+        dependent->next = future->dependents;
+        future->dependents = dependent;
+
+        threadpool_spin_unlock(&future->lock);
+
+        return;
+    }
+
+    threadpool_spin_unlock(&future->lock);
+
+    future_dependency_done(dependent, future);
+}
+
+bool future_start(Future* future)
+{
+    return atomic_compare_exchange_strong_32((Atomic32*)&future->state,
+                                             FutureState_Running,
+                                             FutureState_Pending,
+                                             MemoryOrder_SeqCst);
+}
+
+/* Stores the result of a running or pending future and notifies its dependents */
+void future_complete(Future* future, void* result, int32_t from_state)
+{
+    future->result = result;
+
+    if(!atomic_compare_exchange_strong_32((Atomic32*)&future->state,
+                                          FutureState_Done,
+                                          from_state,
+                                          MemoryOrder_SeqCst))
+        return;
+
+    future_notify_dependents(future);
+}
+
+void future_finish(Future* future, void* result)
+{
+    future_complete(future, result, FutureState_Running);
+}
+
+/* Called once all the futures of a FutureKind_WhenAll future are done or cancelled */
+void future_when_all_complete(Future* all)
+{
+    if(atomic_load_32((Atomic32*)&all->cancelled, MemoryOrder_Acquire) != 0)
+        future_cancel(all);
+    else
+        future_complete(all, NULL, FutureState_Pending);
+}
+
+void future_dependency_done(Future* dependent, Future* antecedent)
+{
+    int32_t antecedent_state = atomic_load_32((Atomic32*)&antecedent->state, MemoryOrder_Acquire);
+
+    switch(dependent->kind)
+    {
+        case FutureKind_Then:
+        {
+            Work* work;
+
+            if(antecedent_state == FutureState_Cancelled)
+            {
+                future_cancel(dependent);
+                break;
+            }
+
+            if(atomic_load_32((Atomic32*)&dependent->state, MemoryOrder_Acquire) != FutureState_Pending)
+                break;
+
+            work = work_new(dependent->func, antecedent->result, NULL);
+
+            if(work == NULL)
+            {
+                future_cancel(dependent);
+                break;
+            }
+
+            future_ref(dependent);
+            work->future = dependent;
+
+            if(!threadpool_work_submit(dependent->pool, work))
+                future_cancel(dependent);
+
+            break;
+        }
+        case FutureKind_Relay:
+        {
+            Future* target = dependent->target;
+
+            if(antecedent_state == FutureState_Cancelled)
+                atomic_store_32((Atomic32*)&target->cancelled, 1, MemoryOrder_Relax);
+
+            /* The release of the decrement publishes cancelled to the last relay */
+            if(atomic_fetch_add_32((Atomic32*)&target->pending, -1, MemoryOrder_AcqRel) == 0)
+                future_when_all_complete(target);
+
+            future_unref(target);
+
+            break;
+        }
+        default:
+            ROMANO_ASSERT(0, "Invalid dependent future kind");
+            break;
+    }
+
+    future_unref(dependent);
+}
+
+Future* threadpool_work_add_future(ThreadPool* threadpool, ThreadFunc func, void* arg)
+{
+    Future* future;
+    Work* work;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+
+    /* One reference for the caller, one for the work */
+    future = future_alloc(threadpool, FutureKind_Work, 2);
+
+    if(future == NULL)
+        return NULL;
+
+    work = work_new(func, arg, NULL);
+
+    if(work == NULL)
+    {
+        future_unref(future);
+        future_unref(future);
+        return NULL;
+    }
+
+    work->future = future;
+
+    if(!threadpool_work_submit(threadpool, work))
+    {
+        future_unref(future);
+        return NULL;
+    }
+
+    return future;
+}
+
+FutureState future_get_state(Future* future)
+{
+    ROMANO_ASSERT(future != NULL, "");
+
+    return (FutureState)atomic_load_32((Atomic32*)&future->state, MemoryOrder_Acquire);
+}
+
+/* Executes one pending work of the pool, returns false if none was found */
+bool threadpool_help(ThreadPool* pool)
+{
+    Worker* self = threadpool_current_worker(pool);
+    Work* work;
+    uint32_t i;
+
+    if(self != NULL)
+    {
+        work = worker_dequeue(self);
+
+        if(work != NULL)
+        {
+            work_execute(pool, work);
+            return true;
+        }
+
+        work = threadpool_try_steal(pool, self);
+
+        if(work != NULL)
+        {
+            work_execute(pool, work);
+            return true;
+        }
+
+        return false;
+    }
+
+    work = threadpool_deadlines_pop(pool);
+
+    if(work != NULL)
+    {
+        work_execute(pool, work);
+        return true;
+    }
+
+    for(i = 0; i < pool->workers_count * ThreadPoolPriority_Count; i++)
+    {
+        MoodycamelCQHandle queue = pool->workers[i % pool->workers_count].queues[i / pool->workers_count];
+
+        if(moodycamel_cq_try_dequeue(queue, (MoodycamelValue*)&work))
+        {
+            ROMANO_TP_ACQUIRE(work);
+            work_execute(pool, work);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void* future_get(Future* future)
+{
+    int32_t state;
+
+    ROMANO_ASSERT(future != NULL, "");
+
+    while(1)
+    {
+        state = atomic_load_32((Atomic32*)&future->state, MemoryOrder_Acquire);
+
+        if(future_state_is_final(state))
+            break;
+
+        /* Helps the pool instead of blocking, the awaited work may be queued behind others */
+        if(!threadpool_help(future->pool))
+            thread_yield();
+    }
+
+    return state == FutureState_Done ? future->result : NULL;
+}
+
+bool future_cancel(Future* future)
+{
+    ROMANO_ASSERT(future != NULL, "");
+
+    if(!atomic_compare_exchange_strong_32((Atomic32*)&future->state,
+                                          FutureState_Cancelled,
+                                          FutureState_Pending,
+                                          MemoryOrder_SeqCst))
+        return false;
+
+    future_notify_dependents(future);
+
+    return true;
+}
+
+Future* future_then(Future* future, ThreadFunc func)
+{
+    Future* continuation;
+
+    ROMANO_ASSERT(future != NULL, "");
+    ROMANO_ASSERT(func != NULL, "");
+
+    /* One reference for the caller, one for the dependents list of the antecedent */
+    continuation = future_alloc(future->pool, FutureKind_Then, 2);
+
+    if(continuation == NULL)
+        return NULL;
+
+    continuation->func = func;
+
+    future_add_dependent(future, continuation);
+
+    return continuation;
+}
+
+Future* future_when_all(ThreadPool* threadpool, Future** futures, uint32_t futures_count)
+{
+    Future* all;
+    uint32_t i;
+
+    ROMANO_ASSERT(threadpool != NULL, "");
+    ROMANO_ASSERT(futures != NULL || futures_count == 0, "");
+
+    all = future_alloc(threadpool, FutureKind_WhenAll, 1);
+
+    if(all == NULL)
+        return NULL;
+
+    /* Holds one extra count while the relays are registered so all cannot complete early */
+    all->pending = (int32_t)futures_count + 1;
+
+    for(i = 0; i < futures_count; i++)
+    {
+        Future* relay = future_alloc(threadpool, FutureKind_Relay, 1);
+
+        if(relay == NULL)
+        {
+            /* The remaining futures will never be awaited, all is marked as cancelled */
+            future_cancel(all);
+            atomic_sub_32((Atomic32*)&all->pending, (Atomic32)(futures_count - i), MemoryOrder_AcqRel);
+            break;
+        }
+
+        future_ref(all);
+        relay->target = all;
+
+        future_add_dependent(futures[i], relay);
+    }
+
+    if(atomic_fetch_add_32((Atomic32*)&all->pending, -1, MemoryOrder_AcqRel) == 0)
+        future_when_all_complete(all);
+
+    return all;
+}
+
+void future_release(Future* future)
+{
+    ROMANO_ASSERT(future != NULL, "");
+
+    future_unref(future);
+}
+
+void threadpool_futures_release(ThreadPool* threadpool)
+{
+    FutureChunk* chunk = threadpool->futures_chunks;
+
+    while(chunk != NULL)
+    {
+        FutureChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    threadpool->futures_chunks = NULL;
+    threadpool->futures_free = NULL;
+}
@@ -40,3 +40,29 @@ void gettimeofday(timeval_t* tv, timezone_t* tz)
 
 #endif /* defined(ROMANO_WIN) */
 
+
+#if defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
+#include <time.h>
+#endif /* defined(ROMANO_LINUX) || defined(ROMANO_APPLE) */
+
+uint64_t time_get_monotonic_ns(void)
+{
+#if defined(ROMANO_WIN)
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+
+    if(frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)((counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+                      ((counter.QuadPart % frequency.QuadPart) * 1000000000ULL) / frequency.QuadPart);
+#elif defined(ROMANO_LINUX) || defined(ROMANO_APPLE)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif /* defined(ROMANO_WIN) */
+}
@@ -0,0 +1,610 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/timer_wheel.h"
+#include "libromano/sync.h"
+#include "libromano/time.h"
+#include "libromano/bit.h"
+#include "libromano/error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern ErrorCode g_current_error;
+
+#define TIMERWHEEL_LEVELS 4
+#define TIMERWHEEL_SLOT_BITS 8
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_SLOT_BITS)
+#define TIMERWHEEL_SLOT_MASK (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_MAX_DELTA (((uint64_t)1 << (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOT_BITS)) - 1)
+
+#define TIMER_NONE UINT32_MAX
+
+typedef struct Timer {
+    /* Expiry and period in ticks, the period is 0 for one-shot timers */
+    uint64_t expiry;
+    uint64_t period;
+    ThreadFunc func;
+    void* arg;
+
+    /* Slot list links, next also links the free timers */
+    uint32_t next;
+    uint32_t prev;
+
+    /* level * TIMERWHEEL_SLOTS + slot index, TIMER_NONE when the timer is free */
+    uint32_t slot;
+
+    /* Incremented each time the timer is freed, so stale ids can be detected */
+    uint32_t generation;
+} Timer;
+
+typedef struct FiredTimer {
+    ThreadFunc func;
+    void* arg;
+} FiredTimer;
+
+struct TimerWheel
+{
+    uint32_t slots[TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS];
+
+    /* One bit per non-empty slot, to skip idle ticks */
+    uint64_t occupied[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS / 64];
+
+    Timer* timers;
+    uint32_t timers_capacity;
+    uint32_t free_timers;
+    size_t timers_count;
+
+    uint64_t start_ns;
+    uint64_t tick_ns;
+    uint64_t current_tick;
+
+    FastMutex lock;
+
+    /* Only used by the thread advancing the wheel */
+    FiredTimer* fired;
+    size_t fired_capacity;
+
+    Thread* thread;
+    ThreadPool* threadpool;
+    Event wake;
+    Atomic32 running;
+
+    /* Time the wheel thread sleeps until, protected by lock */
+    uint64_t sleep_until_ns;
+};
+
+ROMANO_FORCE_INLINE TimerId timer_make_id(uint32_t index, uint32_t generation)
+{
+    return ((uint64_t)generation << 32) | (uint64_t)(index + 1);
+}
+
+TimerWheel* timerwheel_new(uint64_t tick_ns)
+{
+    TimerWheel* wheel;
+
+    ROMANO_ASSERT(tick_ns > 0, "The tick duration must not be 0");
+
+    wheel = (TimerWheel*)calloc(1, sizeof(TimerWheel));
+
+    if(wheel == NULL)
+    {
+        g_current_error = ErrorCode_MemAllocError;
+        return NULL;
+    }
+
+    memset(wheel->slots, 0xFF, sizeof(wheel->slots));
+
+    wheel->free_timers = TIMER_NONE;
+    wheel->tick_ns = tick_ns;
+    wheel->start_ns = time_get_monotonic_ns();
+    wheel->sleep_until_ns = TIMERWHEEL_NO_EXPIRY;
+
+    fastmutex_init(&wheel->lock);
+    event_init(&wheel->wake, EventMode_AutoReset);
+
+    return wheel;
+}
+
+static bool timerwheel_grow(TimerWheel* wheel)
+{
+    uint32_t new_capacity;
+    Timer* new_timers;
+    uint32_t i;
+
+    if(wheel->timers_capacity >= TIMER_NONE / 2)
+        return false;
+
+    new_capacity = wheel->timers_capacity == 0 ? 1024 : wheel->timers_capacity * 2;
+    new_timers = (Timer*)realloc(wheel->timers, (size_t)new_capacity * sizeof(Timer));
+
+    if(new_timers == NULL)
+        return false;
+
+    for(i = new_capacity; i > wheel->timers_capacity; i--)
+    {
+        new_timers[i - 1].slot = TIMER_NONE;
+        new_timers[i - 1].generation = 0;
+        new_timers[i - 1].next = wheel->free_timers;
+        wheel->free_timers = i - 1;
+    }
+
+    wheel->timers = new_timers;
+    wheel->timers_capacity = new_capacity;
+
+    return true;
+}
+
+static void timerwheel_link(TimerWheel* wheel, uint32_t index)
+{
+    Timer* timer = &wheel->timers[index];
+    uint64_t expiry = timer->expiry;
+    uint64_t delta;
+    uint32_t level;
+    uint32_t slot;
+
+    if(expiry < wheel->current_tick)
+        expiry = wheel->current_tick;
+
+    delta = expiry - wheel->current_tick;
+
+    /* Too far away timers wait in the last slot reachable, and are placed again from there */
+    if(delta > TIMERWHEEL_MAX_DELTA)
+    {
+        delta = TIMERWHEEL_MAX_DELTA;
+        expiry = wheel->current_tick + TIMERWHEEL_MAX_DELTA;
+    }
+
+    for(level = 0; level < TIMERWHEEL_LEVELS - 1; level++)
+        if(delta < ((uint64_t)1 << ((level + 1) * TIMERWHEEL_SLOT_BITS)))
+            break;
+
+    slot = (uint32_t)(expiry >> (level * TIMERWHEEL_SLOT_BITS)) & TIMERWHEEL_SLOT_MASK;
+
+    timer->slot = level * TIMERWHEEL_SLOTS + slot;
+    timer->prev = TIMER_NONE;
+    timer->next = wheel->slots[timer->slot];
+
+    if(timer->next != TIMER_NONE)
+        wheel->timers[timer->next].prev = index;
+
+    wheel->slots[timer->slot] = index;
+
+    SET_BIT64(wheel->occupied[level][slot / 64], slot % 64);
+}
+
+static void timerwheel_unlink(TimerWheel* wheel, uint32_t index)
+{
+    Timer* timer = &wheel->timers[index];
+
+    if(timer->prev != TIMER_NONE)
+        wheel->timers[timer->prev].next = timer->next;
+    else
+        wheel->slots[timer->slot] = timer->next;
+
+    if(timer->next != TIMER_NONE)
+        wheel->timers[timer->next].prev = timer->prev;
+
+    if(wheel->slots[timer->slot] == TIMER_NONE)
+    {
+        uint32_t level = timer->slot / TIMERWHEEL_SLOTS;
+        uint32_t slot = timer->slot % TIMERWHEEL_SLOTS;
+
+        UNSET_BIT64(wheel->occupied[level][slot / 64], slot % 64);
+    }
+}
+
+static void timerwheel_release_timer(TimerWheel* wheel, uint32_t index)
+{
+    Timer* timer = &wheel->timers[index];
+
+    timer->slot = TIMER_NONE;
+    timer->generation++;
+    timer->next = wheel->free_timers;
+    wheel->free_timers = index;
+    wheel->timers_count--;
+}
+
+/* Detaches the whole list of a slot, and returns its head */
+static uint32_t timerwheel_take_slot(TimerWheel* wheel, uint32_t level, uint32_t slot)
+{
+    uint32_t head = wheel->slots[level * TIMERWHEEL_SLOTS + slot];
+
+    wheel->slots[level * TIMERWHEEL_SLOTS + slot] = TIMER_NONE;
+    UNSET_BIT64(wheel->occupied[level][slot / 64], slot % 64);
+
+    return head;
+}
+
+ROMANO_FORCE_INLINE uint64_t timerwheel_now_tick(TimerWheel* wheel, uint64_t now_ns)
+{
+    return now_ns > wheel->start_ns ? (now_ns - wheel->start_ns) / wheel->tick_ns : 0;
+}
+
+TimerId timerwheel_add(TimerWheel* wheel,
+                       uint64_t delay_ns,
+                       uint64_t period_ns,
+                       ThreadFunc func,
+                       void* arg)
+{
+    uint64_t now_tick;
+    uint64_t delay_ticks;
+    uint64_t expiry_ns;
+    uint32_t index;
+    Timer* timer;
+    TimerId id;
+
+    ROMANO_ASSERT(wheel != NULL, "");
+    ROMANO_ASSERT(func != NULL, "");
+
+    now_tick = timerwheel_now_tick(wheel, time_get_monotonic_ns());
+    delay_ticks = delay_ns / wheel->tick_ns + (delay_ns % wheel->tick_ns != 0);
+
+    fastmutex_lock(&wheel->lock);
+
+    if(wheel->free_timers == TIMER_NONE && !timerwheel_grow(wheel))
+    {
+        fastmutex_unlock(&wheel->lock);
+        g_current_error = ErrorCode_MemAllocError;
+        return TIMER_INVALID_ID;
+    }
+
+    index = wheel->free_timers;
+    timer = &wheel->timers[index];
+    wheel->free_timers = timer->next;
+    wheel->timers_count++;
+
+    /* The wheel may lag behind the clock if it has not been advanced recently */
+    if(now_tick < wheel->current_tick)
+        now_tick = wheel->current_tick;
+
+    timer->expiry = now_tick + (delay_ticks == 0 ? 1 : delay_ticks);
+    timer->period = period_ns == 0 ? 0 : period_ns / wheel->tick_ns + (period_ns % wheel->tick_ns != 0);
+    timer->func = func;
+    timer->arg = arg;
+
+    timerwheel_link(wheel, index);
+
+    id = timer_make_id(index, timer->generation);
+
+    expiry_ns = wheel->start_ns + timer->expiry * wheel->tick_ns;
+
+    /* Wakes the wheel thread if it sleeps past this new timer */
+    if(expiry_ns < wheel->sleep_until_ns)
+    {
+        wheel->sleep_until_ns = expiry_ns;
+        event_set(&wheel->wake);
+    }
+
+    fastmutex_unlock(&wheel->lock);
+
+    return id;
+}
+
+bool timerwheel_cancel(TimerWheel* wheel, TimerId timer_id)
+{
+    uint32_t index = (uint32_t)(timer_id & 0xFFFFFFFF);
+    uint32_t generation = (uint32_t)(timer_id >> 32);
+    bool cancelled = false;
+
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    if(index == 0)
+        return false;
+
+    index--;
+
+    fastmutex_lock(&wheel->lock);
+
+    if(index < wheel->timers_capacity &&
+       wheel->timers[index].generation == generation &&
+       wheel->timers[index].slot != TIMER_NONE)
+    {
+        timerwheel_unlink(wheel, index);
+        timerwheel_release_timer(wheel, index);
+        cancelled = true;
+    }
+
+    fastmutex_unlock(&wheel->lock);
+
+    return cancelled;
+}
+
+size_t timerwheel_get_timers_count(TimerWheel* wheel)
+{
+    size_t count;
+
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    fastmutex_lock(&wheel->lock);
+    count = wheel->timers_count;
+    fastmutex_unlock(&wheel->lock);
+
+    return count;
+}
+
+/* Returns the first occupied slot at or after start, wrapping around, or TIMERWHEEL_SLOTS */
+static uint32_t timerwheel_find_occupied(uint64_t* occupied, uint32_t start)
+{
+    uint32_t i;
+
+    for(i = 0; i <= TIMERWHEEL_SLOTS / 64; i++)
+    {
+        uint32_t word = ((start / 64) + i) % (TIMERWHEEL_SLOTS / 64);
+        uint64_t bits = occupied[word];
+
+        /* The first word is looked at twice, from start and then before start */
+        if(i == 0)
+            bits &= ~(uint64_t)0 << (start % 64);
+        else if(i == TIMERWHEEL_SLOTS / 64)
+            bits &= start % 64 == 0 ? 0 : ~(~(uint64_t)0 << (start % 64));
+
+        if(bits != 0)
+            return word * 64 + ctz_u64(bits);
+    }
+
+    return TIMERWHEEL_SLOTS;
+}
+
+/* Returns the next tick at which a slot has to be fired or cascaded, or UINT64_MAX */
+static uint64_t timerwheel_next_tick(TimerWheel* wheel)
+{
+    uint64_t next_tick = UINT64_MAX;
+    uint32_t level;
+
+    if(wheel->timers_count == 0)
+        return UINT64_MAX;
+
+    for(level = 0; level < TIMERWHEEL_LEVELS; level++)
+    {
+        uint32_t shift = level * TIMERWHEEL_SLOT_BITS;
+        uint64_t block = wheel->current_tick >> shift;
+        uint32_t current_slot = (uint32_t)block & TIMERWHEEL_SLOT_MASK;
+        uint32_t slot = timerwheel_find_occupied(wheel->occupied[level],
+                                                 (current_slot + 1) & TIMERWHEEL_SLOT_MASK);
+        uint64_t distance;
+        uint64_t tick;
+
+        if(slot == TIMERWHEEL_SLOTS)
+            continue;
+
+        /* The current block slot is visited again after a full turn */
+        distance = (slot - current_slot) & TIMERWHEEL_SLOT_MASK;
+        distance = distance == 0 ? TIMERWHEEL_SLOTS : distance;
+
+        tick = (block + distance) << shift;
+
+        if(tick < next_tick)
+            next_tick = tick;
+    }
+
+    return next_tick;
+}
+
+static bool timerwheel_push_fired(TimerWheel* wheel, size_t* fired_count, Timer* timer)
+{
+    if(*fired_count == wheel->fired_capacity)
+    {
+        size_t new_capacity = wheel->fired_capacity == 0 ? 64 : wheel->fired_capacity * 2;
+        FiredTimer* new_fired = (FiredTimer*)realloc(wheel->fired, new_capacity * sizeof(FiredTimer));
+
+        if(new_fired == NULL)
+            return false;
+
+        wheel->fired = new_fired;
+        wheel->fired_capacity = new_capacity;
+    }
+
+    wheel->fired[*fired_count].func = timer->func;
+    wheel->fired[*fired_count].arg = timer->arg;
+    (*fired_count)++;
+
+    return true;
+}
+
+/*
+ * Moves the wheel to the given tick, cascading the upper levels and collecting expired timers.
+ * Returns false if the fired timers cannot be collected, the timers not collected yet are put
+ * back and the wheel stays before the tick, so they are fired by the next advance
+ */
+static bool timerwheel_process_tick(TimerWheel* wheel, uint64_t tick, size_t* fired_count)
+{
+    uint32_t level;
+    uint32_t index;
+
+    wheel->current_tick = tick;
+
+    for(level = 1; level < TIMERWHEEL_LEVELS; level++)
+    {
+        uint32_t shift = level * TIMERWHEEL_SLOT_BITS;
+
+        if((tick & (((uint64_t)1 << shift) - 1)) != 0)
+            break;
+
+        index = timerwheel_take_slot(wheel, level, (uint32_t)(tick >> shift) & TIMERWHEEL_SLOT_MASK);
+
+        while(index != TIMER_NONE)
+        {
+            uint32_t next = wheel->timers[index].next;
+            timerwheel_link(wheel, index);
+            index = next;
+        }
+    }
+
+    index = timerwheel_take_slot(wheel, 0, (uint32_t)tick & TIMERWHEEL_SLOT_MASK);
+
+    while(index != TIMER_NONE)
+    {
+        Timer* timer = &wheel->timers[index];
+        uint32_t next = timer->next;
+
+        if(!timerwheel_push_fired(wheel, fired_count, timer))
+        {
+            /* Cascading this tick again is harmless, the upper slots are placed by expiry */
+            wheel->current_tick = tick - 1;
+
+            while(index != TIMER_NONE)
+            {
+                next = wheel->timers[index].next;
+                timerwheel_link(wheel, index);
+                index = next;
+            }
+
+            return false;
+        }
+
+        if(timer->period != 0)
+        {
+            timer->expiry = tick + timer->period;
+            timerwheel_link(wheel, index);
+        }
+        else
+        {
+            timerwheel_release_timer(wheel, index);
+        }
+
+        index = next;
+    }
+
+    return true;
+}
+
+static size_t timerwheel_advance_internal(TimerWheel* wheel, uint64_t now_ns, ThreadPool* threadpool)
+{
+    uint64_t target_tick = timerwheel_now_tick(wheel, now_ns);
+    size_t fired_count = 0;
+    size_t i;
+
+    fastmutex_lock(&wheel->lock);
+
+    while(wheel->current_tick < target_tick)
+    {
+        uint64_t next_tick = timerwheel_next_tick(wheel);
+
+        /* Nothing happens until the target, no need to go through the idle ticks */
+        if(next_tick > target_tick)
+        {
+            wheel->current_tick = target_tick;
+            break;
+        }
+
+        /* Out of memory, the timers collected so far are fired and the others wait */
+        if(!timerwheel_process_tick(wheel, next_tick, &fired_count))
+            break;
+    }
+
+    fastmutex_unlock(&wheel->lock);
+
+    /* Callbacks are called without the lock, so they can add or cancel timers */
+    for(i = 0; i < fired_count; i++)
+    {
+        if(threadpool != NULL)
+            threadpool_work_add(threadpool, wheel->fired[i].func, wheel->fired[i].arg, NULL);
+        else
+            wheel->fired[i].func(wheel->fired[i].arg);
+    }
+
+    return fired_count;
+}
+
+size_t timerwheel_advance(TimerWheel* wheel, uint64_t now_ns)
+{
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    return timerwheel_advance_internal(wheel, now_ns, NULL);
+}
+
+uint64_t timerwheel_next_expiry(TimerWheel* wheel)
+{
+    uint64_t next_tick;
+
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    fastmutex_lock(&wheel->lock);
+    next_tick = timerwheel_next_tick(wheel);
+    fastmutex_unlock(&wheel->lock);
+
+    return next_tick == UINT64_MAX ? TIMERWHEEL_NO_EXPIRY : wheel->start_ns + next_tick * wheel->tick_ns;
+}
+
+void* timerwheel_thread_func(void* arg)
+{
+    TimerWheel* wheel = (TimerWheel*)arg;
+
+    while(atomic_load_32(&wheel->running, MemoryOrder_Acquire) != 0)
+    {
+        uint64_t sleep_until_ns;
+        uint64_t next_tick;
+        uint64_t now_ns;
+
+        timerwheel_advance_internal(wheel, time_get_monotonic_ns(), wheel->threadpool);
+
+        /* Published under the lock so timerwheel_add knows whether it has to wake us */
+        fastmutex_lock(&wheel->lock);
+        next_tick = timerwheel_next_tick(wheel);
+        sleep_until_ns = next_tick == UINT64_MAX ? TIMERWHEEL_NO_EXPIRY :
+                                                   wheel->start_ns + next_tick * wheel->tick_ns;
+        wheel->sleep_until_ns = sleep_until_ns;
+        fastmutex_unlock(&wheel->lock);
+
+        now_ns = time_get_monotonic_ns();
+
+        if(sleep_until_ns == TIMERWHEEL_NO_EXPIRY)
+            event_wait(&wheel->wake);
+        else if(sleep_until_ns > now_ns)
+            event_wait_for(&wheel->wake, sleep_until_ns - now_ns);
+    }
+
+    return NULL;
+}
+
+bool timerwheel_start(TimerWheel* wheel, ThreadPool* threadpool)
+{
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    if(wheel->thread != NULL)
+        return false;
+
+    wheel->threadpool = threadpool;
+    atomic_store_32(&wheel->running, 1, MemoryOrder_Release);
+
+    wheel->thread = thread_create(timerwheel_thread_func, wheel);
+
+    if(wheel->thread == NULL)
+    {
+        atomic_store_32(&wheel->running, 0, MemoryOrder_Release);
+        return false;
+    }
+
+    thread_start(wheel->thread);
+
+    return true;
+}
+
+void timerwheel_stop(TimerWheel* wheel)
+{
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    if(wheel->thread == NULL)
+        return;
+
+    atomic_store_32(&wheel->running, 0, MemoryOrder_Release);
+    event_set(&wheel->wake);
+
+    thread_join(wheel->thread);
+
+    wheel->thread = NULL;
+    wheel->sleep_until_ns = TIMERWHEEL_NO_EXPIRY;
+}
+
+void timerwheel_free(TimerWheel* wheel)
+{
+    ROMANO_ASSERT(wheel != NULL, "");
+
+    timerwheel_stop(wheel);
+
+    free(wheel->timers);
+    free(wheel->fired);
+    free(wheel);
+}
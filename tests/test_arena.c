@@ -5,6 +5,8 @@
 #include "libromano/arena.h"
 #include "libromano/logger.h"
 
+#include <string.h>
+
 #if ROMANO_DEBUG
 #define NUM_LOOPS 100000
 #else
@@ -24,6 +26,39 @@ int main(void)
         arena_push(&arena, &f, sizeof(float));
     }
 
+    arena_clear(&arena);
+
+    /* Cleared blocks are reused, and pushes larger than the block size get their own block */
+    for(size_t i = 0; i < NUM_LOOPS; i++)
+    {
+        float f = (float)i;
+        arena_push(&arena, &f, sizeof(float));
+    }
+
+    char* large = (char*)arena_push(&arena, NULL, ARENA_BLOCK_SIZE * 4);
+
+    if(large == NULL)
+    {
+        logger_log_error("Cannot push a large object in the arena");
+        return 1;
+    }
+
+    memset(large, 0, ARENA_BLOCK_SIZE * 4);
+
+    float* after_large = (float*)arena_push(&arena, NULL, sizeof(float));
+
+    if(after_large == NULL)
+    {
+        logger_log_error("Cannot push in the arena after a large object");
+        return 1;
+    }
+
+    if((char*)after_large >= large && (char*)after_large < large + ARENA_BLOCK_SIZE * 4)
+    {
+        logger_log_error("Arena push overlaps a large object");
+        return 1;
+    }
+
     arena_release(&arena);
 
     logger_release();
@@ -15,6 +15,57 @@ int main(void)
 
     logger_log(LogLevel_Info, "CPU Name: %s", cpu_name);
 
+    CPUTopology topology;
+    uint32_t i;
+
+    if(!cpu_topology_init(&topology))
+    {
+        logger_log_error("Failed to query the cpu topology");
+        return 1;
+    }
+
+    if(topology.processors_count == 0)
+    {
+        logger_log_error("No logical processor found");
+        return 1;
+    }
+
+    if(topology.cores_count == 0 || topology.cores_count > topology.processors_count)
+    {
+        logger_log_error("Invalid physical cores count");
+        return 1;
+    }
+
+    logger_log(LogLevel_Info,
+               "CPU Topology: %u logical processors, %u cores, %u packages, %u numa nodes",
+               topology.processors_count,
+               topology.cores_count,
+               topology.packages_count,
+               topology.numa_nodes_count);
+
+    for(i = 0; i < topology.processors_count; i++)
+    {
+        CPULogicalProcessor* processor = &topology.processors[i];
+
+        if(processor->core_id >= topology.cores_count)
+        {
+            logger_log_error("Invalid core id");
+            return 1;
+        }
+
+        logger_log(LogLevel_Debug,
+                   "Processor %u: core %u, smt %u, package %u, node %u, l2 %d, l3 %d",
+                   processor->id,
+                   processor->core_id,
+                   processor->smt_index,
+                   processor->package_id,
+                   processor->numa_node,
+                   (int)processor->l2_id,
+                   (int)processor->l3_id);
+    }
+
+    cpu_topology_release(&topology);
+
     logger_release();
 
     return 0;
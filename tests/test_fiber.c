@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/fiber.h"
+#include "libromano/atomic.h"
+#include "libromano/logger.h"
+
+#define FIBERS_COUNT 1000
+#define FIBERS_YIELDS 10
+#define SOCKET_FIBERS_COUNT 128
+#define NESTED_FIBERS_COUNT 64
+
+void* yield_fiber_func(void* data)
+{
+    int32_t* counter = (int32_t*)data;
+    uint32_t i;
+
+    /* The counter will not reach its expected value */
+    if(!fiber_is_in_fiber())
+        return NULL;
+
+    for(i = 0; i < FIBERS_YIELDS; i++)
+    {
+        atomic_add_32((Atomic32*)counter, 1, MemoryOrder_Relax);
+        fiber_yield();
+    }
+
+    return NULL;
+}
+
+/* Fibers blocked in future_get resume the other fibers queued on the single worker */
+
+typedef struct NestedFiberData {
+    ThreadPool* pool;
+    int32_t finished;
+    int32_t failures;
+} NestedFiberData;
+
+void* nested_work_func(void* data)
+{
+    return data;
+}
+
+void* nested_fiber_func(void* data)
+{
+    NestedFiberData* nested = (NestedFiberData*)data;
+    Future* future = threadpool_work_add_future(nested->pool, nested_work_func, data);
+
+    if(future == NULL || future_get(future) != data)
+        atomic_add_32((Atomic32*)&nested->failures, 1, MemoryOrder_Relax);
+
+    if(future != NULL)
+        future_release(future);
+
+    /* Suspends and finishes through the context of the worker, not the one of a nested resume */
+    fiber_yield();
+
+    if(!fiber_is_in_fiber())
+        atomic_add_32((Atomic32*)&nested->failures, 1, MemoryOrder_Relax);
+
+    atomic_add_32((Atomic32*)&nested->finished, 1, MemoryOrder_Relax);
+
+    return NULL;
+}
+
+int test_fiber_nested_resumes(void)
+{
+    ThreadPool* tp = threadpool_init(1);
+    FiberRuntime* runtime;
+    ThreadPoolWaiter waiter = threadpool_waiter_new();
+    NestedFiberData nested;
+    uint32_t i;
+
+    if(tp == NULL)
+    {
+        logger_log_error("Cannot create threadpool");
+        return 1;
+    }
+
+    runtime = fiber_runtime_new(tp, 0);
+
+    if(runtime == NULL)
+    {
+        logger_log_error("Cannot create fiber runtime");
+        return 1;
+    }
+
+    nested.pool = tp;
+    nested.finished = 0;
+    nested.failures = 0;
+
+    for(i = 0; i < NESTED_FIBERS_COUNT; i++)
+    {
+        if(!fiber_spawn(runtime, nested_fiber_func, &nested, &waiter))
+        {
+            logger_log_error("Cannot spawn fiber");
+            return 1;
+        }
+    }
+
+    threadpool_waiter_wait(&waiter);
+
+    if(nested.finished != NESTED_FIBERS_COUNT || nested.failures != 0)
+    {
+        logger_log_error("Nested fibers did not complete: %d finished, %d failures",
+                         nested.finished,
+                         nested.failures);
+        return 1;
+    }
+
+    fiber_runtime_free(runtime);
+    threadpool_release(tp);
+
+    logger_log(LogLevel_Info, "%u fibers resumed from future_get", NESTED_FIBERS_COUNT);
+
+    return 0;
+}
+
+#if !defined(ROMANO_WIN)
+typedef struct SocketFiberData {
+    Socket sockets[2];
+    int32_t* received;
+} SocketFiberData;
+
+void* recv_fiber_func(void* data)
+{
+    SocketFiberData* fiber_data = (SocketFiberData*)data;
+    char buffer[16];
+    ssize_t res;
+
+    /* Blocks the fiber, not the worker, until the main thread writes */
+    res = fiber_socket_recv(fiber_data->sockets[0], buffer, sizeof(buffer), 0);
+
+    if(res != 5 || buffer[0] != 'h')
+        return NULL;
+
+    res = fiber_socket_send(fiber_data->sockets[0], "world", 5, 0);
+
+    /* Only counted once the reply has been sent, the main thread waits for it */
+    if(res == 5)
+        atomic_add_32((Atomic32*)fiber_data->received, 1, MemoryOrder_Relax);
+
+    return NULL;
+}
+
+int test_fiber_sockets(FiberRuntime* runtime)
+{
+    SocketFiberData* data = (SocketFiberData*)calloc(SOCKET_FIBERS_COUNT, sizeof(SocketFiberData));
+    ThreadPoolWaiter waiter = threadpool_waiter_new();
+    int32_t received = 0;
+    uint32_t i;
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot allocate the fibers data");
+        return 1;
+    }
+
+    for(i = 0; i < SOCKET_FIBERS_COUNT; i++)
+    {
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, data[i].sockets) != 0)
+        {
+            logger_log_error("Cannot create socket pair");
+            return 1;
+        }
+
+        socket_set_nonblocking(data[i].sockets[0], true);
+        data[i].received = &received;
+
+        if(!fiber_spawn(runtime, recv_fiber_func, &data[i], &waiter))
+        {
+            logger_log_error("Cannot spawn fiber");
+            return 1;
+        }
+    }
+
+    /* All the fibers are now waiting on their socket while the workers stay available */
+    thread_sleep(50);
+
+    for(i = 0; i < SOCKET_FIBERS_COUNT; i++)
+        socket_send(data[i].sockets[1], "hello", 5, 0);
+
+    threadpool_waiter_wait(&waiter);
+
+    /* The replies are read only if all of them have been sent, reading a missing one would block */
+    if(atomic_load_32((Atomic32*)&received, MemoryOrder_Relax) != SOCKET_FIBERS_COUNT)
+    {
+        logger_log_error("Fibers did not receive the data");
+        return 1;
+    }
+
+    for(i = 0; i < SOCKET_FIBERS_COUNT; i++)
+    {
+        char buffer[16];
+
+        if(fiber_socket_recv(data[i].sockets[1], buffer, sizeof(buffer), 0) != 5)
+        {
+            logger_log_error("Invalid reply from fiber");
+            return 1;
+        }
+
+        closesocket(data[i].sockets[0]);
+        closesocket(data[i].sockets[1]);
+    }
+
+    free(data);
+
+    logger_log(LogLevel_Info, "%u fibers waited on sockets", SOCKET_FIBERS_COUNT);
+
+    return 0;
+}
+#endif /* !defined(ROMANO_WIN) */
+
+int main(void)
+{
+    logger_init();
+
+    ThreadPool* tp = threadpool_init(2);
+    FiberRuntime* runtime = fiber_runtime_new(tp, 0);
+    ThreadPoolWaiter waiter = threadpool_waiter_new();
+    int32_t counter = 0;
+    uint32_t i;
+
+    if(runtime == NULL)
+    {
+        logger_log_error("Cannot create fiber runtime");
+        return 1;
+    }
+
+    if(fiber_is_in_fiber())
+    {
+        logger_log_error("Main thread reported as a fiber");
+        return 1;
+    }
+
+    for(i = 0; i < FIBERS_COUNT; i++)
+    {
+        if(!fiber_spawn(runtime, yield_fiber_func, &counter, &waiter))
+        {
+            logger_log_error("Cannot spawn fiber");
+            return 1;
+        }
+    }
+
+    threadpool_waiter_wait(&waiter);
+
+    if(atomic_load_32((Atomic32*)&counter, MemoryOrder_Relax) != FIBERS_COUNT * FIBERS_YIELDS)
+    {
+        logger_log_error("Fibers did not complete");
+        return 1;
+    }
+
+    logger_log(LogLevel_Info, "%u fibers yielded %u times", FIBERS_COUNT, FIBERS_YIELDS);
+
+#if !defined(ROMANO_WIN)
+    if(test_fiber_sockets(runtime) != 0)
+        return 1;
+#endif /* !defined(ROMANO_WIN) */
+
+    if(test_fiber_nested_resumes() != 0)
+        return 1;
+
+    fiber_runtime_free(runtime);
+
+    threadpool_release(tp);
+
+    logger_release();
+
+    return 0;
+}
@@ -3,9 +3,168 @@
 /* All rights reserved. */
 
 #include "libromano/fmt.h"
+#include "libromano/logger.h"
 
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* Checks that fmt_f64_shortest round-trips, and is not longer than the shortest %.*e round-trip */
+int check_f64_shortest(double f64)
+{
+    char buffer[FMT_F64_SHORTEST_MAX_SIZE + 1];
+    char printf_buffer[32];
+    size_t significant_digits;
+    int precision;
+    int size;
+    char* start;
+    char* end;
+    char* c;
+
+    size = fmt_f64_shortest(buffer, f64);
+
+    if(size <= 0 || size > FMT_F64_SHORTEST_MAX_SIZE)
+    {
+        logger_log_error("Invalid fmt_f64_shortest size for %.17g", f64);
+        return 1;
+    }
+
+    buffer[size] = '\0';
+
+    if(strtod(buffer, NULL) != f64)
+    {
+        logger_log_error("fmt_f64_shortest(%.17g) does not round-trip: %s", f64, buffer);
+        return 1;
+    }
+
+    start = buffer + (buffer[0] == '-');
+    end = strchr(start, 'e');
+
+    if(end == NULL)
+        end = buffer + size;
+
+    significant_digits = 0;
+
+    for(c = start; c < end; c++)
+        if(*c != '.')
+            significant_digits++;
+
+    while(start < end && (*start == '0' || *start == '.'))
+    {
+        significant_digits -= *start == '0';
+        start++;
+    }
+
+    while(end > start && (end[-1] == '0' || end[-1] == '.'))
+    {
+        significant_digits -= end[-1] == '0';
+        end--;
+    }
+
+    for(precision = 1; precision < 17; precision++)
+    {
+        snprintf(printf_buffer, sizeof(printf_buffer), "%.*e", precision - 1, f64);
+
+        if(strtod(printf_buffer, NULL) == f64)
+            break;
+    }
+
+    if(significant_digits > (size_t)precision)
+    {
+        logger_log_error("fmt_f64_shortest(%.17g) is not the shortest: %s", f64, buffer);
+        return 1;
+    }
+
+    return 0;
+}
+
+typedef struct ShortestCase {
+    double value;
+    const char* expected;
+} ShortestCase;
+
+int test_fmt_f64_shortest(void)
+{
+    const ShortestCase cases[] = {
+        { 0.0, "0.0" },
+        { -0.0, "-0.0" },
+        { 1.0, "1.0" },
+        { -2.5, "-2.5" },
+        { 0.1, "0.1" },
+        { 0.1 + 0.2, "0.30000000000000004" },
+        { 1.0 / 3.0, "0.3333333333333333" },
+        { 123456.789, "123456.789" },
+        { 100.0, "100.0" },
+        { 0.0001, "0.0001" },
+        { 0.00001, "1e-5" },
+        { 1234567890123456.0, "1234567890123456.0" },
+        { 1e16, "1e16" },
+        { 1.5e300, "1.5e300" },
+        { -1.5e-300, "-1.5e-300" },
+        { 9007199254740993.0, "9007199254740992.0" },
+        { 1.7976931348623157e308, "1.7976931348623157e308" },
+        { 2.2250738585072014e-308, "2.2250738585072014e-308" },
+        { 5e-324, "5e-324" },
+        { -4.9406564584124654e-324, "-5e-324" },
+        { 2.0 * 1e-323, "2e-323" },
+        { (double)INFINITY, "inf" },
+        { -(double)INFINITY, "-inf" },
+        { (double)NAN, "nan" },
+    };
+    char buffer[FMT_F64_SHORTEST_MAX_SIZE];
+    uint64_t f64_bits;
+    double f64_random;
+    int size;
+    size_t i;
+
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        size = fmt_f64_shortest(buffer, cases[i].value);
+
+        if(size != (int)strlen(cases[i].expected) || memcmp(buffer, cases[i].expected, (size_t)size) != 0)
+        {
+            logger_log_error("fmt_f64_shortest(%.17g) should be %s", cases[i].value, cases[i].expected);
+            return 1;
+        }
+    }
+
+    /* Powers of ten and their neighbours hit the interval edge cases */
+    for(i = 0; i <= 631; i++)
+    {
+        char pow10_str[16];
+        double pow10;
+
+        snprintf(pow10_str, sizeof(pow10_str), "1e%d", (int)i - 323);
+        pow10 = strtod(pow10_str, NULL);
+
+        if(check_f64_shortest(pow10) != 0 ||
+           check_f64_shortest(nextafter(pow10, 0.0)) != 0 ||
+           check_f64_shortest(nextafter(pow10, INFINITY)) != 0)
+            return 1;
+    }
+
+    /* Random bit patterns cover all exponents, subnormals included */
+    f64_bits = 0x9E3779B97F4A7C15ULL;
+
+    for(i = 0; i < 100000; i++)
+    {
+        f64_bits ^= f64_bits << 13;
+        f64_bits ^= f64_bits >> 7;
+        f64_bits ^= f64_bits << 17;
+
+        memcpy(&f64_random, &f64_bits, sizeof(double));
+
+        if(!isfinite(f64_random))
+            continue;
+
+        if(check_f64_shortest(f64_random) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
 int main(void)
 {
     ROMANO_ASSERT(fmt_size_i64(0) == 1, "");
@@ -742,5 +901,12 @@ int main(void)
     ROMANO_ASSERT(f64_fmt_sz == 31, "f64_fmt_sz should be 31");
     ROMANO_ASSERT(memcmp(f64_buffer, "212912976183047040.000000000000", f64_fmt_sz) == 0, "fmt_f64(2.1291297618304704e+17) should be 2.1291297618304704e+17");
 
+    logger_init();
+
+    if(test_fmt_f64_shortest() != 0)
+        return 1;
+
+    logger_release();
+
     return 0;
 }
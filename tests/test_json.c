@@ -7,9 +7,1387 @@
 #include "libromano/filesystem.h"
 #include "libromano/string.h"
 
+#include <math.h>
+#include <string.h>
+
 #define ROMANO_ENABLE_PROFILING
 #include "libromano/profiling.h"
 
+#define GENERATED_JSON_RECORDS 100000
+#define DICT_INDEX_KEYS 10000
+#define ARRAY_VALUES 10000
+#define INSITU_FILE_PATH "test_json_insitu.json"
+
+int test_json_parse_values(void)
+{
+    const char* doc_str = "  {\"a\": 1, \"b\" :[true,false ,null, -12, 3.5e2, \"x\"],\n"
+                          "\t\"c\": {\"d\": \"e\\\"f\\\\\"}, \"empty\": [], \"empty_dict\": {}}  ";
+    Json* doc;
+    JsonValue* value;
+    JsonValue* element;
+    JsonArrayIterator iterator;
+
+    doc = json_loads(doc_str, strlen(doc_str));
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot parse json");
+        return 1;
+    }
+
+    if(!json_is_dict(doc->root))
+    {
+        logger_log_error("Root is not a dict");
+        return 1;
+    }
+
+    if(json_dict_get_size(doc->root) != 5)
+    {
+        logger_log_error("Invalid root size");
+        return 1;
+    }
+
+    if(json_u64_get(json_dict_find(doc, doc->root, "a")) != 1)
+    {
+        logger_log_error("Invalid u64");
+        return 1;
+    }
+
+    value = json_dict_find(doc, doc->root, "b");
+
+    if(json_array_get_size(value) != 6)
+    {
+        logger_log_error("Invalid array size");
+        return 1;
+    }
+
+    memset(&iterator, 0, sizeof(JsonArrayIterator));
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(!json_is_bool(element) || !json_bool_get(element))
+    {
+        logger_log_error("Invalid true");
+        return 1;
+    }
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(!json_is_bool(element) || json_bool_get(element))
+    {
+        logger_log_error("Invalid false");
+        return 1;
+    }
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(!json_is_null(element))
+    {
+        logger_log_error("Invalid null");
+        return 1;
+    }
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(json_i64_get(element) != -12)
+    {
+        logger_log_error("Invalid i64");
+        return 1;
+    }
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(json_f64_get(element) != 350.0)
+    {
+        logger_log_error("Invalid f64");
+        return 1;
+    }
+
+    element = json_array_get_next(doc, value, &iterator);
+
+    if(strcmp(json_str_get(element), "x") != 0)
+    {
+        logger_log_error("Invalid str");
+        return 1;
+    }
+
+    if(json_str_get_size(element) != 1)
+    {
+        logger_log_error("Invalid str size");
+        return 1;
+    }
+
+    value = json_dict_find(doc, json_dict_find(doc, doc->root, "c"), "d");
+
+    if(strcmp(json_str_get(value), "e\"f\\") != 0)
+    {
+        logger_log_error("Invalid escaped str");
+        return 1;
+    }
+
+    if(json_str_get_size(value) != 4)
+    {
+        logger_log_error("Invalid escaped str size");
+        return 1;
+    }
+
+    if(json_array_get_size(json_dict_find(doc, doc->root, "empty")) != 0)
+    {
+        logger_log_error("Invalid empty array");
+        return 1;
+    }
+
+    if(json_dict_get_size(json_dict_find(doc, doc->root, "empty_dict")) != 0)
+    {
+        logger_log_error("Invalid empty dict");
+        return 1;
+    }
+
+    json_free(doc);
+
+    return 0;
+}
+
+int test_json_parse_invalid(void)
+{
+    const char* const invalid_docs[] = {
+        "",
+        "   ",
+        "[1,]",
+        "[1 2]",
+        "{\"a\" 1}",
+        "{1: 2}",
+        "{\"a\": 1,}",
+        "[1\"a\"]",
+        "[truex]",
+        "[1.2.3]",
+        "\"abc",
+        "[\"a\\\"]",
+        "[\"\\x\"]",
+        "[\"\\u12\"]",
+        "[\"a\nb\"]",
+        "[1] 2",
+        "[\\\"a\"]",
+        "{\"a\": [1, {\"b\": \"c}]}",
+        "[01]",
+        "[1.]",
+        "[.5]",
+        "[+1]",
+        "[1e]",
+        "[-]",
+    };
+    size_t i;
+
+    for(i = 0; i < sizeof(invalid_docs) / sizeof(invalid_docs[0]); i++)
+    {
+        Json* doc = json_loads(invalid_docs[i], strlen(invalid_docs[i]));
+
+        if(doc != NULL)
+        {
+            logger_log_error("Invalid json parsed: %s", invalid_docs[i]);
+            json_free(doc);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_json_parse_block_boundaries(void)
+{
+    /* Moves escape sequences and quotes across the 64 bytes blocks boundaries of the indexer */
+    char doc_str[256];
+    char expected[256];
+    size_t padding;
+    size_t backslashes;
+
+    for(padding = 0; padding < 70; padding++)
+    {
+        for(backslashes = 0; backslashes < 5; backslashes++)
+        {
+            size_t doc_sz = 0;
+            size_t expected_sz = 0;
+            size_t i;
+            Json* doc;
+            JsonValue* value;
+
+            doc_str[doc_sz++] = '[';
+
+            for(i = 0; i < padding; i++)
+                doc_str[doc_sz++] = ' ';
+
+            doc_str[doc_sz++] = '"';
+
+            for(i = 0; i < backslashes; i++)
+            {
+                doc_str[doc_sz++] = '\\';
+                doc_str[doc_sz++] = '\\';
+                expected[expected_sz++] = '\\';
+            }
+
+            doc_str[doc_sz++] = '\\';
+            doc_str[doc_sz++] = '"';
+            expected[expected_sz++] = '"';
+
+            memcpy(doc_str + doc_sz, "[,]{:}", 6);
+            memcpy(expected + expected_sz, "[,]{:}", 6);
+            doc_sz += 6;
+            expected_sz += 6;
+
+            memcpy(doc_str + doc_sz, "\", 123, true]", 13);
+            doc_sz += 13;
+            expected[expected_sz] = '\0';
+
+            doc = json_loads(doc_str, doc_sz);
+
+            if(doc == NULL)
+            {
+                logger_log_error("Cannot parse json");
+                return 1;
+            }
+
+            if(json_array_get_size(doc->root) != 3)
+            {
+                logger_log_error("Invalid array size");
+                return 1;
+            }
+
+            value = json_array_get(doc->root, 0);
+
+            if(strcmp(json_str_get(value), expected) != 0)
+            {
+                logger_log_error("Invalid str");
+                return 1;
+            }
+
+            if(json_str_get_size(value) != expected_sz)
+            {
+                logger_log_error("Invalid str size");
+                return 1;
+            }
+
+            json_free(doc);
+        }
+    }
+
+    return 0;
+}
+
+int test_json_parse_numbers(void)
+{
+    const char* doc_str = "[0.1, 2.2250738585072011e-308, 1e-400, 1.7976931348623159e308, 18446744073709551615,"
+                          " 18446744073709551616, -9223372036854775808, -9223372036854775809,"
+                          " 3.14159265358979323846264338327950288]";
+    JsonValue* root;
+    Json* doc;
+
+    doc = json_loads(doc_str, strlen(doc_str));
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot parse numbers");
+        return 1;
+    }
+
+    root = doc->root;
+
+    /* Doubles are correctly rounded */
+    if(json_f64_get(json_array_get(root, 0)) != 0.1)
+    {
+        logger_log_error("Invalid 0.1");
+        return 1;
+    }
+
+    if(json_f64_get(json_array_get(root, 1)) != 2.2250738585072011e-308)
+    {
+        logger_log_error("Invalid near subnormal");
+        return 1;
+    }
+
+    if(json_f64_get(json_array_get(root, 2)) != 0.0)
+    {
+        logger_log_error("Invalid underflow");
+        return 1;
+    }
+
+    if(!isinf(json_f64_get(json_array_get(root, 3))))
+    {
+        logger_log_error("Invalid overflow");
+        return 1;
+    }
+
+    if(json_f64_get(json_array_get(root, 8)) != 3.14159265358979323846)
+    {
+        logger_log_error("Invalid long double");
+        return 1;
+    }
+
+    /* Integers that do not fit in 64 bits become doubles */
+    if(json_u64_get(json_array_get(root, 4)) != UINT64_MAX)
+    {
+        logger_log_error("Invalid u64 max");
+        return 1;
+    }
+
+    if(!json_is_f64(json_array_get(root, 5)) || json_f64_get(json_array_get(root, 5)) != 18446744073709551616.0)
+    {
+        logger_log_error("Invalid u64 overflow");
+        return 1;
+    }
+
+    if(json_i64_get(json_array_get(root, 6)) != INT64_MIN)
+    {
+        logger_log_error("Invalid i64 min");
+        return 1;
+    }
+
+    if(!json_is_f64(json_array_get(root, 7)) || json_f64_get(json_array_get(root, 7)) != -9223372036854775809.0)
+    {
+        logger_log_error("Invalid i64 overflow");
+        return 1;
+    }
+
+    json_free(doc);
+
+    return 0;
+}
+
+int test_json_array(void)
+{
+    const char* doc_str = "[1, -2, 3.5, [4], 5]";
+    Json* doc;
+    JsonValue* array;
+    double values[ARRAY_VALUES];
+    size_t i;
+    bool converted;
+
+    doc = json_loads(doc_str, strlen(doc_str));
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot parse json");
+        return 1;
+    }
+
+    if(json_array_get_size(doc->root) != 5)
+    {
+        logger_log_error("Invalid array size");
+        return 1;
+    }
+
+    if(json_u64_get(json_array_get(doc->root, 4)) != 5)
+    {
+        logger_log_error("Invalid array element");
+        return 1;
+    }
+
+    if(json_array_get(doc->root, 5) != NULL)
+    {
+        logger_log_error("Out of bounds element found");
+        return 1;
+    }
+
+    converted = json_array_to_f64(doc->root, values);
+
+    if(converted)
+    {
+        logger_log_error("Non-numeric array converted");
+        return 1;
+    }
+
+    json_array_pop(doc, doc->root, 3);
+
+    if(json_array_get_size(doc->root) != 4)
+    {
+        logger_log_error("Invalid array size after pop");
+        return 1;
+    }
+
+    converted = json_array_to_f64(doc->root, values);
+
+    if(!converted)
+    {
+        logger_log_error("Cannot convert numeric array");
+        return 1;
+    }
+
+    if(values[0] != 1.0 || values[1] != -2.0 || values[2] != 3.5 || values[3] != 5.0)
+    {
+        logger_log_error("Invalid converted values");
+        return 1;
+    }
+
+    json_array_pop(doc, doc->root, 0);
+
+    if(json_i64_get(json_array_get(doc->root, 0)) != -2)
+    {
+        logger_log_error("Invalid array element after pop");
+        return 1;
+    }
+
+    array = json_array_new(doc);
+
+    for(i = 0; i < ARRAY_VALUES; i++)
+        json_array_append(doc, array, json_f64_new(doc, (double)i * 0.5), true);
+
+    if(json_array_get_size(array) != ARRAY_VALUES)
+    {
+        logger_log_error("Invalid array size");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_array_to_f64);
+    converted = json_array_to_f64(array, values);
+    SCOPED_PROFILE_MS_END(json_array_to_f64);
+
+    if(!converted)
+    {
+        logger_log_error("Cannot convert numeric array");
+        return 1;
+    }
+
+    for(i = 0; i < ARRAY_VALUES; i++)
+    {
+        if(values[i] != (double)i * 0.5)
+        {
+            logger_log_error("Invalid converted value");
+            return 1;
+        }
+    }
+
+    json_free(doc);
+
+    return 0;
+}
+
+int test_json_dict_index(void)
+{
+    Json* doc;
+    JsonValue* dict;
+    JsonKeyValue* key_value;
+    JsonDictIterator iterator;
+    char key[32];
+    size_t i;
+    size_t count;
+
+    doc = json_new();
+    dict = json_dict_new(doc, NULL);
+
+    /* Small dicts are searched linearly */
+    json_dict_append(doc, dict, "first", json_u64_new(doc, 0), true);
+    json_dict_append(doc, dict, "second", json_u64_new(doc, 1), true);
+    json_dict_pop(doc, dict, "first");
+
+    if(json_dict_get_size(dict) != 1)
+    {
+        logger_log_error("Invalid dict size after pop");
+        return 1;
+    }
+
+    if(json_dict_find(doc, dict, "first") != NULL)
+    {
+        logger_log_error("Popped key found");
+        return 1;
+    }
+
+    if(json_u64_get(json_dict_find(doc, dict, "second")) != 1)
+    {
+        logger_log_error("Cannot find key");
+        return 1;
+    }
+
+    json_dict_pop(doc, dict, "second");
+
+    if(json_dict_get_size(dict) != 0)
+    {
+        logger_log_error("Invalid dict size after pop");
+        return 1;
+    }
+
+    for(i = 0; i < DICT_INDEX_KEYS; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+        json_dict_append(doc, dict, key, json_u64_new(doc, i), true);
+    }
+
+    /* The first lookup builds the index, further appends grow it */
+    SCOPED_PROFILE_MS_START(json_dict_find_indexed);
+
+    for(i = 0; i < DICT_INDEX_KEYS; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+
+        if(json_u64_get(json_dict_find(doc, dict, key)) != i)
+        {
+            logger_log_error("Cannot find key");
+            return 1;
+        }
+    }
+
+    SCOPED_PROFILE_MS_END(json_dict_find_indexed);
+
+    for(i = DICT_INDEX_KEYS; i < DICT_INDEX_KEYS * 2; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+        json_dict_append(doc, dict, key, json_u64_new(doc, i), true);
+    }
+
+    if(json_dict_find(doc, dict, "missing") != NULL)
+    {
+        logger_log_error("Missing key found");
+        return 1;
+    }
+
+    /* Pop every odd key */
+    for(i = 1; i < DICT_INDEX_KEYS * 2; i += 2)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+        json_dict_pop(doc, dict, key);
+    }
+
+    if(json_dict_get_size(dict) != DICT_INDEX_KEYS)
+    {
+        logger_log_error("Invalid dict size after pops");
+        return 1;
+    }
+
+    for(i = 0; i < DICT_INDEX_KEYS * 2; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+
+        if((json_dict_find(doc, dict, key) != NULL) != ((i & 1) == 0))
+        {
+            logger_log_error("Invalid find after pops");
+            return 1;
+        }
+    }
+
+    /* Insertion order is preserved */
+    memset(&iterator, 0, sizeof(JsonDictIterator));
+    count = 0;
+
+    while((key_value = json_dict_get_next(doc, dict, &iterator)) != NULL)
+    {
+        if(json_u64_get(key_value->value) != count * 2)
+        {
+            logger_log_error("Invalid dict order");
+            return 1;
+        }
+
+        count++;
+    }
+
+    if(count != DICT_INDEX_KEYS)
+    {
+        logger_log_error("Invalid dict iteration count");
+        return 1;
+    }
+
+    /* With duplicated keys, the first one is found and the next one shows up once popped */
+    json_dict_append(doc, dict, "key_0", json_u64_new(doc, 42), true);
+
+    if(json_u64_get(json_dict_find(doc, dict, "key_0")) != 0)
+    {
+        logger_log_error("Invalid duplicated key");
+        return 1;
+    }
+
+    json_dict_pop(doc, dict, "key_0");
+
+    if(json_u64_get(json_dict_find(doc, dict, "key_0")) != 42)
+    {
+        logger_log_error("Invalid duplicated key after pop");
+        return 1;
+    }
+
+    json_free(doc);
+
+    return 0;
+}
+
+int test_json_parse_insitu(void)
+{
+    char str[] = "{\"key\": \"plain\", \"esc\\u00e9\": [\"a\\nb\", \"\\ud83d\\ude00\", 12]}";
+    const size_t str_sz = sizeof(str) - 1;
+    JsonKeyValue* key_value;
+    JsonDictIterator iterator;
+    JsonValue* value;
+    Json* doc;
+
+    doc = json_loads_insitu(str, str_sz);
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot parse json in-situ");
+        return 1;
+    }
+
+    value = json_dict_find(doc, doc->root, "key");
+
+    if(value == NULL || strcmp(json_str_get(value), "plain") != 0)
+    {
+        logger_log_error("Invalid in-situ str");
+        return 1;
+    }
+
+    if(json_str_get(value) < str || json_str_get(value) >= str + str_sz)
+    {
+        logger_log_error("In-situ str has been copied");
+        return 1;
+    }
+
+    memset(&iterator, 0, sizeof(JsonDictIterator));
+
+    while((key_value = json_dict_get_next(doc, doc->root, &iterator)) != NULL)
+    {
+        if(key_value->key < str || key_value->key >= str + str_sz)
+        {
+            logger_log_error("In-situ key has been copied");
+            return 1;
+        }
+    }
+
+    value = json_dict_find(doc, doc->root, "esc\xc3\xa9");
+
+    if(value == NULL || json_array_get_size(value) != 3)
+    {
+        logger_log_error("Invalid in-situ escaped key");
+        return 1;
+    }
+
+    if(strcmp(json_str_get(json_array_get(value, 0)), "a\nb") != 0)
+    {
+        logger_log_error("Invalid in-situ escaped str");
+        return 1;
+    }
+
+    if(strcmp(json_str_get(json_array_get(value, 1)), "\xf0\x9f\x98\x80") != 0)
+    {
+        logger_log_error("Invalid in-situ surrogate pair");
+        return 1;
+    }
+
+    if(json_str_get_size(json_array_get(value, 1)) != 4)
+    {
+        logger_log_error("Invalid in-situ str size");
+        return 1;
+    }
+
+    if(json_u64_get(json_array_get(value, 2)) != 12)
+    {
+        logger_log_error("Invalid in-situ u64");
+        return 1;
+    }
+
+    json_free(doc);
+
+    return 0;
+}
+
+int test_json_reuse(void)
+{
+    char insitu[] = "{\"name\": \"in\\tsitu\"}";
+    char buffer[256];
+    JsonValue* value;
+    Json* pooled[JSON_POOL_SIZE + 1];
+    Json* doc;
+    size_t i;
+    int written;
+    bool loaded;
+
+    doc = json_new();
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot create json");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_loads_into_small);
+
+    for(i = 0; i < 100000; i++)
+    {
+        written = snprintf(buffer,
+                           sizeof(buffer),
+                           "{\"id\": %zu, \"user\": {\"name\": \"user_%zu\", \"roles\": [\"a\", \"b\"]}, \"ok\": true}",
+                           i,
+                           i);
+
+        loaded = json_loads_into(doc, buffer, (size_t)written);
+
+        if(!loaded)
+        {
+            logger_log_error("Cannot parse json into document");
+            return 1;
+        }
+
+        value = json_dict_find(doc, doc->root, "id");
+
+        if(value == NULL || json_u64_get(value) != i)
+        {
+            logger_log_error("Invalid reused document value");
+            return 1;
+        }
+    }
+
+    SCOPED_PROFILE_MS_END(json_loads_into_small);
+
+    SCOPED_PROFILE_MS_START(json_loads_small);
+
+    for(i = 0; i < 100000; i++)
+    {
+        Json* tmp;
+
+        written = snprintf(buffer,
+                           sizeof(buffer),
+                           "{\"id\": %zu, \"user\": {\"name\": \"user_%zu\", \"roles\": [\"a\", \"b\"]}, \"ok\": true}",
+                           i,
+                           i);
+
+        tmp = json_loads(buffer, (size_t)written);
+
+        if(tmp == NULL)
+        {
+            logger_log_error("Cannot parse json");
+            return 1;
+        }
+
+        json_free(tmp);
+    }
+
+    SCOPED_PROFILE_MS_END(json_loads_small);
+
+    loaded = json_loads_into(doc, "[1, 2", 5);
+
+    if(loaded)
+    {
+        logger_log_error("Invalid json parsed into document");
+        return 1;
+    }
+
+    if(doc->root != NULL)
+    {
+        logger_log_error("Document not reset after error");
+        return 1;
+    }
+
+    loaded = json_loads_insitu_into(doc, insitu, sizeof(insitu) - 1);
+
+    if(!loaded)
+    {
+        logger_log_error("Cannot parse json in-situ into document");
+        return 1;
+    }
+
+    value = json_dict_find(doc, doc->root, "name");
+
+    if(value == NULL || strcmp(json_str_get(value), "in\tsitu") != 0)
+    {
+        logger_log_error("Invalid in-situ reused value");
+        return 1;
+    }
+
+    if(json_str_get(value) < insitu || json_str_get(value) >= insitu + sizeof(insitu))
+    {
+        logger_log_error("In-situ str has been copied");
+        return 1;
+    }
+
+    json_reset(doc);
+
+    if(doc->root != NULL)
+    {
+        logger_log_error("Document not reset");
+        return 1;
+    }
+
+    json_free(doc);
+
+    for(i = 0; i < JSON_POOL_SIZE + 1; i++)
+    {
+        pooled[i] = json_pool_acquire();
+
+        if(pooled[i] == NULL)
+        {
+            logger_log_error("Cannot acquire pooled json");
+            return 1;
+        }
+
+        loaded = json_loads_into(pooled[i], "[true]", 6);
+
+        if(!loaded)
+        {
+            logger_log_error("Cannot parse json into pooled document");
+            return 1;
+        }
+    }
+
+    for(i = 0; i < JSON_POOL_SIZE + 1; i++)
+        json_pool_release(pooled[i]);
+
+    /* The last released document is the first acquired, reset */
+    doc = json_pool_acquire();
+
+    if(doc != pooled[JSON_POOL_SIZE - 1])
+    {
+        logger_log_error("Pooled document not reused");
+        return 1;
+    }
+
+    if(doc->root != NULL)
+    {
+        logger_log_error("Pooled document not reset");
+        return 1;
+    }
+
+    json_pool_release(doc);
+
+    json_pool_clear();
+
+    return 0;
+}
+
+int test_json_ondemand(void)
+{
+    const char* str = "{\"skip\": {\"a\": [1, [2, {\"b\": 3}]], \"c\": \"}\"}, \"k\\u00e9y\": -12,"
+                      " \"list\": [true, null, 2.5, \"s\\n\", {}, []], \"last\": 18446744073709551615}";
+    const char* escaped_str = "{\"a\\nb\": 1}";
+    const char* const invalid_docs[] = {
+        "[1, 2",
+        "{\"a\": [1}",
+        "]",
+        "[1] [2]",
+        "\"abc",
+    };
+    JsonOnDemand* doc;
+    JsonCursor root;
+    JsonCursor value;
+    JsonCursor element;
+    const char* key;
+    size_t key_sz;
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+    bool b;
+    bool found;
+    size_t i;
+
+    doc = json_ondemand_new(str, strlen(str));
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot create on-demand json");
+        return 1;
+    }
+
+    found = json_ondemand_get_root(doc, &root);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get on-demand root");
+        return 1;
+    }
+
+    if(json_cursor_get_type(&root) != JsonCursorType_Dict)
+    {
+        logger_log_error("Invalid on-demand root type");
+        return 1;
+    }
+
+    if(json_cursor_get_size(&root) != 4)
+    {
+        logger_log_error("Invalid on-demand dict size");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "k\xc3\xa9y", &value);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find escaped key");
+        return 1;
+    }
+
+    if(!json_cursor_get_i64(&value, &i64) || i64 != -12)
+    {
+        logger_log_error("Invalid on-demand i64");
+        return 1;
+    }
+
+    if(json_cursor_get_u64(&value, &u64))
+    {
+        logger_log_error("Negative number read as u64");
+        return 1;
+    }
+
+    key = json_cursor_get_key(&value, &key_sz);
+
+    if(key == NULL || key_sz != 4 || strcmp(key, "k\xc3\xa9y") != 0)
+    {
+        logger_log_error("Invalid on-demand key");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "last", &value);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find last key");
+        return 1;
+    }
+
+    if(!json_cursor_get_u64(&value, &u64) || u64 != UINT64_MAX)
+    {
+        logger_log_error("Invalid on-demand u64");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&value);
+
+    if(found)
+    {
+        logger_log_error("Element after the last one");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "b", &value);
+
+    if(found)
+    {
+        logger_log_error("Nested key found at the top-level");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "k", &value);
+
+    if(found)
+    {
+        logger_log_error("Key prefix found");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "list", &value);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find list key");
+        return 1;
+    }
+
+    if(json_cursor_get_type(&value) != JsonCursorType_Array)
+    {
+        logger_log_error("Invalid on-demand array type");
+        return 1;
+    }
+
+    if(json_cursor_get_size(&value) != 6)
+    {
+        logger_log_error("Invalid on-demand array size");
+        return 1;
+    }
+
+    found = json_cursor_first_element(&value, &element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get first element");
+        return 1;
+    }
+
+    if(!json_cursor_get_bool(&element, &b) || !b)
+    {
+        logger_log_error("Invalid on-demand bool");
+        return 1;
+    }
+
+    if(json_cursor_get_key(&element, NULL) != NULL)
+    {
+        logger_log_error("Array element has a key");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get next element");
+        return 1;
+    }
+
+    if(json_cursor_get_type(&element) != JsonCursorType_Null)
+    {
+        logger_log_error("Invalid on-demand null");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get next element");
+        return 1;
+    }
+
+    if(!json_cursor_get_f64(&element, &f64) || f64 != 2.5)
+    {
+        logger_log_error("Invalid on-demand f64");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get next element");
+        return 1;
+    }
+
+    if(strcmp(json_cursor_get_str(&element, &key_sz), "s\n") != 0 || key_sz != 2)
+    {
+        logger_log_error("Invalid on-demand str");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get next element");
+        return 1;
+    }
+
+    if(json_cursor_get_size(&element) != 0)
+    {
+        logger_log_error("Invalid on-demand empty dict size");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get next element");
+        return 1;
+    }
+
+    found = json_cursor_first_element(&element, &value);
+
+    if(found)
+    {
+        logger_log_error("Empty array has an element");
+        return 1;
+    }
+
+    found = json_cursor_next_element(&element);
+
+    if(found)
+    {
+        logger_log_error("Element after the last one");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "skip", &value);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find skip key");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&value, "c", &element);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find nested key");
+        return 1;
+    }
+
+    if(strcmp(json_cursor_get_str(&element, NULL), "}") != 0)
+    {
+        logger_log_error("Invalid nested str");
+        return 1;
+    }
+
+    if(json_dict_get_size(json_cursor_get_value(&value)) != 2)
+    {
+        logger_log_error("Invalid materialized dict");
+        return 1;
+    }
+
+    json_ondemand_free(doc);
+
+    /* Escaped keys are compared decoded, never by their raw text */
+    doc = json_ondemand_new(escaped_str, strlen(escaped_str));
+
+    if(doc == NULL)
+    {
+        logger_log_error("Cannot create on-demand json");
+        return 1;
+    }
+
+    found = json_ondemand_get_root(doc, &root);
+
+    if(!found)
+    {
+        logger_log_error("Cannot get on-demand root");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "a\\nb", &value);
+
+    if(found)
+    {
+        logger_log_error("Raw escaped key matched");
+        return 1;
+    }
+
+    found = json_cursor_find_field(&root, "a\nb", &value);
+
+    if(!found)
+    {
+        logger_log_error("Cannot find escaped key");
+        return 1;
+    }
+
+    json_ondemand_free(doc);
+
+    for(i = 0; i < sizeof(invalid_docs) / sizeof(invalid_docs[0]); i++)
+    {
+        doc = json_ondemand_new(invalid_docs[i], strlen(invalid_docs[i]));
+
+        if(doc != NULL)
+        {
+            logger_log_error("Invalid on-demand json has been indexed: %s", invalid_docs[i]);
+            json_ondemand_free(doc);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_json_parse_generated(void)
+{
+    Json* doc;
+    Json* doc2;
+    JsonValue* record;
+    JsonValue* tags;
+    char* dumps;
+    char* dumps2;
+    size_t dumps_sz;
+    size_t dumps2_sz;
+    size_t i;
+    char name[64];
+    char* insitu;
+    JsonOnDemand* ondemand;
+    JsonCursor cursor;
+    JsonCursor element;
+    JsonCursor field;
+    uint64_t ids_sum;
+    uint64_t id;
+
+    doc = json_new();
+    json_set_root(doc, json_array_new(doc));
+
+    for(i = 0; i < GENERATED_JSON_RECORDS; i++)
+    {
+        record = json_dict_new(doc, NULL);
+
+        snprintf(name, sizeof(name), "record \"%zu\"\t\\", i);
+
+        json_dict_append(doc, record, "id", json_u64_new(doc, i), true);
+        json_dict_append(doc, record, "offset", json_i64_new(doc, -(int64_t)i), true);
+        json_dict_append(doc, record, "name", json_str_new(doc, name), true);
+        json_dict_append(doc, record, "active", json_bool_new(doc, (i & 1) == 0), true);
+        json_dict_append(doc, record, "parent", json_null_new(doc), true);
+
+        tags = json_array_new(doc);
+        json_array_append(doc, tags, json_str_new(doc, "{tag}"), true);
+        json_array_append(doc, tags, json_str_new(doc, "[tag]"), true);
+        json_dict_append(doc, record, "tags", tags, true);
+
+        json_array_append(doc, doc->root, record, true);
+    }
+
+    dumps = json_dumps(doc, 2, &dumps_sz);
+
+    if(dumps == NULL)
+    {
+        logger_log_error("Cannot dump json");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_loads_generated);
+    doc2 = json_loads(dumps, dumps_sz);
+    SCOPED_PROFILE_MS_END(json_loads_generated);
+
+    if(doc2 == NULL)
+    {
+        logger_log_error("Cannot parse generated json");
+        return 1;
+    }
+
+    if(json_array_get_size(doc2->root) != GENERATED_JSON_RECORDS)
+    {
+        logger_log_error("Invalid generated size");
+        return 1;
+    }
+
+    dumps2 = json_dumps(doc2, 2, &dumps2_sz);
+
+    if(dumps2 == NULL)
+    {
+        logger_log_error("Cannot dump json");
+        return 1;
+    }
+
+    if(dumps_sz != dumps2_sz || memcmp(dumps, dumps2, dumps_sz) != 0)
+    {
+        logger_log_error("Generated json round-trip mismatch");
+        return 1;
+    }
+
+    logger_log_info("Parsed %zu bytes of generated json", dumps_sz);
+
+    /* On-demand access to a few fields of each record */
+    SCOPED_PROFILE_MS_START(json_ondemand_generated);
+    ondemand = json_ondemand_new(dumps, dumps_sz);
+
+    if(ondemand == NULL)
+    {
+        logger_log_error("Cannot create on-demand json");
+        return 1;
+    }
+
+    if(!json_ondemand_get_root(ondemand, &cursor))
+    {
+        logger_log_error("Cannot get on-demand root");
+        return 1;
+    }
+
+    ids_sum = 0;
+    i = 0;
+
+    if(json_cursor_first_element(&cursor, &element))
+    {
+        do
+        {
+            if(!json_cursor_find_field(&element, "id", &field))
+            {
+                logger_log_error("Cannot find on-demand id");
+                return 1;
+            }
+
+            if(!json_cursor_get_u64(&field, &id))
+            {
+                logger_log_error("Invalid on-demand id");
+                return 1;
+            }
+
+            ids_sum += id;
+            i++;
+        }
+        while(json_cursor_next_element(&element));
+    }
+
+    json_ondemand_free(ondemand);
+    SCOPED_PROFILE_MS_END(json_ondemand_generated);
+
+    if(i != GENERATED_JSON_RECORDS)
+    {
+        logger_log_error("Invalid on-demand records count");
+        return 1;
+    }
+
+    if(ids_sum != (uint64_t)GENERATED_JSON_RECORDS * (GENERATED_JSON_RECORDS - 1) / 2)
+    {
+        logger_log_error("Invalid on-demand ids sum");
+        return 1;
+    }
+
+    /* In-situ parsing of a mutable copy */
+    json_free(doc2);
+    free(dumps2);
+
+    insitu = (char*)malloc(dumps_sz);
+
+    if(insitu == NULL)
+    {
+        logger_log_error("Cannot allocate in-situ buffer");
+        return 1;
+    }
+
+    memcpy(insitu, dumps, dumps_sz);
+
+    SCOPED_PROFILE_MS_START(json_loads_insitu_generated);
+    doc2 = json_loads_insitu(insitu, dumps_sz);
+    SCOPED_PROFILE_MS_END(json_loads_insitu_generated);
+
+    if(doc2 == NULL)
+    {
+        logger_log_error("Cannot parse generated json in-situ");
+        return 1;
+    }
+
+    dumps2 = json_dumps(doc2, 2, &dumps2_sz);
+
+    if(dumps2 == NULL)
+    {
+        logger_log_error("Cannot dump json");
+        return 1;
+    }
+
+    if(dumps_sz != dumps2_sz || memcmp(dumps, dumps2, dumps_sz) != 0)
+    {
+        logger_log_error("In-situ json round-trip mismatch");
+        return 1;
+    }
+
+    json_free(doc2);
+    free(dumps2);
+    free(insitu);
+
+    /* Memory-mapped file */
+    if(!json_dumpf(doc, 2, INSITU_FILE_PATH))
+    {
+        logger_log_error("Cannot dump json file");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_loadf_generated);
+    doc2 = json_loadf(INSITU_FILE_PATH);
+    SCOPED_PROFILE_MS_END(json_loadf_generated);
+
+    if(doc2 == NULL)
+    {
+        logger_log_error("Cannot load generated json file");
+        return 1;
+    }
+
+    dumps2 = json_dumps(doc2, 2, &dumps2_sz);
+
+    if(dumps2 == NULL)
+    {
+        logger_log_error("Cannot dump json");
+        return 1;
+    }
+
+    if(dumps_sz != dumps2_sz || memcmp(dumps, dumps2, dumps_sz) != 0)
+    {
+        logger_log_error("Mapped json round-trip mismatch");
+        return 1;
+    }
+
+    fs_remove(INSITU_FILE_PATH);
+
+    free(dumps);
+    free(dumps2);
+    json_free(doc);
+    json_free(doc2);
+
+    return 0;
+}
+
 int main(void)
 {
     logger_init();
@@ -18,6 +1396,37 @@ int main(void)
 
     logger_log_info("Starting Json test");
 
+    if(test_json_parse_values() != 0)
+        return 1;
+
+    if(test_json_parse_invalid() != 0)
+        return 1;
+
+    if(test_json_parse_block_boundaries() != 0)
+        return 1;
+
+    if(test_json_parse_numbers() != 0)
+        return 1;
+
+    if(test_json_array() != 0)
+        return 1;
+
+    if(test_json_dict_index() != 0)
+        return 1;
+
+    if(test_json_parse_insitu() != 0)
+        return 1;
+
+    if(test_json_reuse() != 0)
+        return 1;
+
+    if(test_json_ondemand() != 0)
+        return 1;
+
+
+    if(test_json_parse_generated() != 0)
+        return 1;
+
     if(!fs_path_exists(TESTS_DATA_DIR))
     {
         logger_log_warning("Can't find tests data dir, silently failing Json test");
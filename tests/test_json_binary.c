@@ -0,0 +1,694 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_binary.h"
+#include "libromano/filesystem.h"
+#include "libromano/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define BINARY_FILE_PATH "test_json_binary.rjsb"
+#define BINARY_RECORDS 20000
+
+static const char* binary_doc = "{\"name\": \"libromano\", \"version\": 3, \"offset\": -42, \"ratio\": 0.25,"
+                                " \"enabled\": true, \"parent\": null, \"empty\": \"\", \"escaped\": \"a\\\"b\\nc\","
+                                " \"tags\": [\"json\", \"binary\", \"json\", \"\"], \"nested\": {\"list\": [1, -1, 1.5, [], {}]}}";
+
+int test_json_binary_values(void)
+{
+    JsonBinaryValue root;
+    JsonBinaryValue value;
+    JsonBinaryValue element;
+    JsonBinary* binary;
+    const char* key;
+    const char* str;
+    char* data;
+    size_t data_sz;
+    size_t str_sz;
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+    bool b;
+
+    data = json_binary_encode_text(binary_doc, strlen(binary_doc), &data_sz);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot encode json");
+        return 1;
+    }
+
+    binary = json_binary_open(data, data_sz);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Cannot open binary json");
+        return 1;
+    }
+
+    root = json_binary_get_root(binary);
+
+    if(json_binary_get_type(root) != JsonBinaryType_Dict)
+    {
+        logger_log_error("Invalid root type");
+        return 1;
+    }
+
+    if(json_binary_get_size(root) != 10)
+    {
+        logger_log_error("Invalid root size");
+        return 1;
+    }
+
+    if(!json_binary_dict_get(root, 0, &key, &value) || strcmp(key, "name") != 0)
+    {
+        logger_log_error("Invalid first key");
+        return 1;
+    }
+
+    str = json_binary_get_str(value, &str_sz);
+
+    if(str == NULL || str_sz != 9 || strcmp(str, "libromano") != 0)
+    {
+        logger_log_error("Invalid str");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "version", &value) || !json_binary_get_u64(value, &u64) || u64 != 3)
+    {
+        logger_log_error("Invalid u64");
+        return 1;
+    }
+
+    if(!json_binary_get_i64(value, &i64) || i64 != 3)
+    {
+        logger_log_error("Invalid u64 to i64 conversion");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "offset", &value) || !json_binary_get_i64(value, &i64) || i64 != -42)
+    {
+        logger_log_error("Invalid i64");
+        return 1;
+    }
+
+    if(json_binary_get_u64(value, &u64))
+    {
+        logger_log_error("i64 read as u64");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "ratio", &value) || !json_binary_get_f64(value, &f64) || f64 != 0.25)
+    {
+        logger_log_error("Invalid f64");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "enabled", &value) || !json_binary_get_bool(value, &b) || !b)
+    {
+        logger_log_error("Invalid bool");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "parent", &value) || json_binary_get_type(value) != JsonBinaryType_Null)
+    {
+        logger_log_error("Invalid null");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "empty", &value) || json_binary_get_str(value, &str_sz) == NULL || str_sz != 0)
+    {
+        logger_log_error("Invalid empty str");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "escaped", &value) || strcmp(json_binary_get_str(value, NULL), "a\"b\nc") != 0)
+    {
+        logger_log_error("Invalid escaped str");
+        return 1;
+    }
+
+    if(json_binary_dict_find(root, "missing", &value))
+    {
+        logger_log_error("Missing key found");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "tags", &value) || json_binary_get_size(value) != 4)
+    {
+        logger_log_error("Invalid array");
+        return 1;
+    }
+
+    if(!json_binary_array_get(value, 2, &element) || strcmp(json_binary_get_str(element, NULL), "json") != 0)
+    {
+        logger_log_error("Invalid array element");
+        return 1;
+    }
+
+    if(json_binary_array_get(value, 4, &element))
+    {
+        logger_log_error("Out of bounds element found");
+        return 1;
+    }
+
+    if(!json_binary_dict_find(root, "nested", &value) || !json_binary_dict_find(value, "list", &value))
+    {
+        logger_log_error("Invalid nested dict");
+        return 1;
+    }
+
+    if(!json_binary_array_get(value, 1, &element) || !json_binary_get_i64(element, &i64) || i64 != -1)
+    {
+        logger_log_error("Invalid nested i64");
+        return 1;
+    }
+
+    if(!json_binary_array_get(value, 3, &element) ||
+       json_binary_get_type(element) != JsonBinaryType_Array ||
+       json_binary_get_size(element) != 0)
+    {
+        logger_log_error("Invalid empty array");
+        return 1;
+    }
+
+    if(!json_binary_array_get(value, 4, &element) ||
+       json_binary_get_type(element) != JsonBinaryType_Dict ||
+       json_binary_get_size(element) != 0)
+    {
+        logger_log_error("Invalid empty dict");
+        return 1;
+    }
+
+    json_binary_free(binary);
+    free(data);
+
+    return 0;
+}
+
+int test_json_binary_dict_index(void)
+{
+    JsonBinaryValue root;
+    JsonBinaryValue value;
+    JsonBinary* binary;
+    JsonValue* dict;
+    Json* json;
+    char key[32];
+    char* data;
+    size_t data_sz;
+    uint64_t u64;
+    size_t i;
+
+    json = json_new();
+    dict = json_dict_new(json, NULL);
+
+    /* Insertion order differs from key order */
+    for(i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", (i * 7919) % 1000);
+        json_dict_append(json, dict, key, json_u64_new(json, (i * 7919) % 1000), true);
+    }
+
+    json_set_root(json, dict);
+
+    data = json_binary_encode(json, &data_sz);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot encode json");
+        return 1;
+    }
+
+    binary = json_binary_open(data, data_sz);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Cannot open binary json");
+        return 1;
+    }
+
+    root = json_binary_get_root(binary);
+
+    for(i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "key_%zu", i);
+
+        if(!json_binary_dict_find(root, key, &value) || !json_binary_get_u64(value, &u64) || u64 != i)
+        {
+            logger_log_error("Invalid indexed dict find");
+            return 1;
+        }
+    }
+
+    if(json_binary_dict_find(root, "key_1000", &value))
+    {
+        logger_log_error("Missing key found");
+        return 1;
+    }
+
+    if(json_binary_dict_find(root, "", &value))
+    {
+        logger_log_error("Empty key found");
+        return 1;
+    }
+
+    json_binary_free(binary);
+    free(data);
+    json_free(json);
+
+    return 0;
+}
+
+int test_json_binary_invalid(void)
+{
+    JsonBinaryValue root;
+    JsonBinaryValue value;
+    JsonBinary* binary;
+    char* data;
+    size_t data_sz;
+    size_t i;
+
+    if(json_binary_open("RJSB", 4) != NULL)
+    {
+        logger_log_error("Truncated header opened");
+        return 1;
+    }
+
+    if(json_binary_open(binary_doc, strlen(binary_doc)) != NULL)
+    {
+        logger_log_error("Text opened as binary");
+        return 1;
+    }
+
+    data = json_binary_encode_text(binary_doc, strlen(binary_doc), &data_sz);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot encode json");
+        return 1;
+    }
+
+    if(json_binary_open(data, data_sz - 1) != NULL)
+    {
+        logger_log_error("Truncated binary opened");
+        return 1;
+    }
+
+    data[4] = JSON_BINARY_VERSION + 1;
+
+    if(json_binary_open(data, data_sz) != NULL)
+    {
+        logger_log_error("Invalid version opened");
+        return 1;
+    }
+
+    data[4] = JSON_BINARY_VERSION;
+
+    /* Corrupting any byte of the values must not read out of bounds */
+    for(i = 20; i < data_sz; i++)
+    {
+        const char saved = data[i];
+
+        data[i] = (char)0xFF;
+
+        binary = json_binary_open(data, data_sz);
+
+        if(binary != NULL)
+        {
+            Json* json;
+
+            root = json_binary_get_root(binary);
+
+            if(json_binary_dict_find(root, "escaped", &value))
+                json_binary_get_str(value, NULL);
+
+            json = json_binary_to_json(binary);
+
+            if(json != NULL)
+                json_free(json);
+
+            json_binary_free(binary);
+        }
+
+        data[i] = saved;
+    }
+
+    free(data);
+
+    return 0;
+}
+
+/* A string missing its terminator must be rejected */
+
+int test_json_binary_corrupted_strings(void)
+{
+    const char* doc = "[\"libromano\"]";
+    JsonBinaryValue root;
+    JsonBinaryValue value;
+    JsonBinary* binary;
+    char* data;
+    char* text;
+    char* str;
+    size_t data_sz;
+    size_t i;
+
+    data = json_binary_encode_text(doc, strlen(doc), &data_sz);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot encode json");
+        return 1;
+    }
+
+    str = NULL;
+
+    for(i = 0; i + 10 <= data_sz; i++)
+    {
+        if(memcmp(data + i, "libromano", 10) == 0)
+        {
+            str = data + i;
+            break;
+        }
+    }
+
+    if(str == NULL)
+    {
+        logger_log_error("Cannot find the encoded string");
+        return 1;
+    }
+
+    str[9] = 'x';
+
+    binary = json_binary_open(data, data_sz);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Cannot open binary");
+        return 1;
+    }
+
+    root = json_binary_get_root(binary);
+
+    if(!json_binary_array_get(root, 0, &value))
+    {
+        logger_log_error("Cannot get array element");
+        return 1;
+    }
+
+    if(json_binary_get_str(value, NULL) != NULL)
+    {
+        logger_log_error("Unterminated string returned");
+        return 1;
+    }
+
+    text = json_binary_to_text(binary, 0, NULL);
+
+    if(text != NULL)
+    {
+        logger_log_error("Unterminated string decoded");
+        return 1;
+    }
+
+    json_binary_free(binary);
+
+    str[9] = '\0';
+
+    /* Flipping every bit of every byte, then decoding everything, must not read out of bounds */
+    for(i = 20 * 8; i < data_sz * 8; i++)
+    {
+        data[i / 8] ^= (char)(1 << (i % 8));
+
+        binary = json_binary_open(data, data_sz);
+
+        if(binary != NULL)
+        {
+            text = json_binary_to_text(binary, 0, NULL);
+
+            if(text != NULL)
+                free(text);
+
+            json_binary_free(binary);
+        }
+
+        data[i / 8] ^= (char)(1 << (i % 8));
+    }
+
+    free(data);
+
+    return 0;
+}
+
+/* Strings holding nulls keep their size, as in json documents */
+
+int test_json_binary_null_strings(void)
+{
+    const char* doc = "[\"x\\u0000y\", {\"key\": \"\\u0000\"}]";
+    JsonBinary* binary;
+    Json* json;
+    char* data;
+    char* dumped;
+    char* binary_dumped;
+    size_t data_sz;
+    size_t dumped_sz;
+    size_t binary_dumped_sz;
+
+    json = json_loads(doc, strlen(doc));
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot parse json with null strings");
+        return 1;
+    }
+
+    dumped = json_dumps(json, 0, &dumped_sz);
+    data = json_binary_encode(json, &data_sz);
+
+    if(dumped == NULL || data == NULL)
+    {
+        logger_log_error("Cannot dump or encode json with null strings");
+        return 1;
+    }
+
+    binary = json_binary_open(data, data_sz);
+    binary_dumped = binary != NULL ? json_binary_to_text(binary, 0, &binary_dumped_sz) : NULL;
+
+    if(binary_dumped == NULL)
+    {
+        logger_log_error("Cannot decode binary with null strings");
+        return 1;
+    }
+
+    if(binary_dumped_sz != dumped_sz || memcmp(binary_dumped, dumped, dumped_sz) != 0)
+    {
+        logger_log_error("Binary round-trip of null strings differs from text: %s", binary_dumped);
+        return 1;
+    }
+
+    free(binary_dumped);
+    json_binary_free(binary);
+    free(data);
+    free(dumped);
+    json_free(json);
+
+    return 0;
+}
+
+int test_json_binary_roundtrip(void)
+{
+    JsonBinary* binary;
+    Json* json;
+    char* text;
+    char* records;
+    char* dumped;
+    char* binary_dumped;
+    char* data;
+    size_t records_sz;
+    size_t dumped_sz;
+    size_t binary_dumped_sz;
+    size_t data_sz;
+    size_t offset;
+    size_t i;
+    int written;
+
+    records_sz = BINARY_RECORDS * 192 + 2;
+    records = (char*)malloc(records_sz);
+
+    if(records == NULL)
+    {
+        logger_log_error("Cannot allocate records");
+        return 1;
+    }
+
+    offset = 0;
+    records[offset++] = '[';
+
+    for(i = 0; i < BINARY_RECORDS; i++)
+    {
+        written = snprintf(records + offset,
+                           records_sz - offset,
+                           "%s{\"id\": %zu, \"delta\": %d, \"score\": %zu.5, \"kind\": \"%s\", \"valid\": %s,"
+                           " \"tags\": [\"a\", \"b\"]}",
+                           i > 0 ? ", " : "",
+                           i,
+                           -(int)(i % 100),
+                           i % 1000,
+                           i % 3 == 0 ? "alpha" : "beta",
+                           i % 2 == 0 ? "true" : "false");
+        offset += (size_t)written;
+    }
+
+    records[offset++] = ']';
+
+    json = json_loads(records, offset);
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot parse records");
+        return 1;
+    }
+
+    dumped = json_dumps(json, 0, &dumped_sz);
+
+    if(dumped == NULL)
+    {
+        logger_log_error("Cannot dump records");
+        return 1;
+    }
+
+    data = json_binary_encode(json, &data_sz);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot encode records");
+        return 1;
+    }
+
+    logger_log_info("Text size: %zu, binary size: %zu", offset, data_sz);
+
+    if(data_sz >= offset)
+    {
+        logger_log_error("Binary encoding is larger than text");
+        return 1;
+    }
+
+    binary = json_binary_open(data, data_sz);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Cannot open binary records");
+        return 1;
+    }
+
+    binary_dumped = json_binary_to_text(binary, 0, &binary_dumped_sz);
+
+    if(binary_dumped == NULL)
+    {
+        logger_log_error("Cannot decode binary records");
+        return 1;
+    }
+
+    if(binary_dumped_sz != dumped_sz || memcmp(binary_dumped, dumped, dumped_sz) != 0)
+    {
+        logger_log_error("Binary round-trip differs from text");
+        return 1;
+    }
+
+    json_binary_free(binary);
+    free(binary_dumped);
+
+    if(!json_binary_dumpf(json, BINARY_FILE_PATH))
+    {
+        logger_log_error("Cannot dump binary file");
+        return 1;
+    }
+
+    json_free(json);
+
+    SCOPED_PROFILE_MS_START(json_loads_records);
+
+    json = json_loads(records, offset);
+
+    SCOPED_PROFILE_MS_END(json_loads_records);
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot parse records");
+        return 1;
+    }
+
+    json_free(json);
+
+    SCOPED_PROFILE_MS_START(json_binary_loadf_records);
+
+    binary = json_binary_loadf(BINARY_FILE_PATH);
+
+    SCOPED_PROFILE_MS_END(json_binary_loadf_records);
+
+    if(binary == NULL)
+    {
+        logger_log_error("Cannot load binary file");
+        return 1;
+    }
+
+    if(json_binary_get_size(json_binary_get_root(binary)) != BINARY_RECORDS)
+    {
+        logger_log_error("Invalid loaded records");
+        return 1;
+    }
+
+    text = json_binary_to_text(binary, 0, &binary_dumped_sz);
+
+    if(text == NULL || binary_dumped_sz != dumped_sz || memcmp(text, dumped, dumped_sz) != 0)
+    {
+        logger_log_error("Binary file round-trip differs from text");
+        return 1;
+    }
+
+    free(text);
+    json_binary_free(binary);
+
+    fs_remove(BINARY_FILE_PATH);
+
+    free(data);
+    free(dumped);
+    free(records);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    logger_log_info("Starting JsonBinary test");
+
+    if(test_json_binary_values() != 0)
+        return 1;
+
+    if(test_json_binary_dict_index() != 0)
+        return 1;
+
+    if(test_json_binary_invalid() != 0)
+        return 1;
+
+    if(test_json_binary_corrupted_strings() != 0)
+        return 1;
+
+    if(test_json_binary_roundtrip() != 0)
+        return 1;
+
+    if(test_json_binary_null_strings() != 0)
+        return 1;
+
+    logger_log_info("Finished JsonBinary test");
+
+    logger_release();
+
+    return 0;
+}
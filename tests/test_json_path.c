@@ -0,0 +1,445 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_path.h"
+#include "libromano/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define PATH_DOCUMENTS 20000
+#define PATH_ITEMS 4
+
+static const char* path_doc = "{\"payload\": {\"items\": [{\"price\": 1.5, \"name\": \"a\"},"
+                              " {\"price\": 2, \"name\": \"b\"}, {\"name\": \"c\"}, {\"price\": -3, \"name\": \"d\"}],"
+                              " \"a/b\": {\"m~n\": true}, \"key with spaces\": [10, 20, 30], \"0\": \"zero\"}}";
+
+int test_json_path_compile(void)
+{
+    const char* const valid_paths[] = {
+        "",
+        "/payload/items/0/price",
+        "/payload/items/*/price",
+        "/a~1b/m~0n",
+        "$",
+        "$.payload.items[*].price",
+        "$['key with spaces'][2]",
+        "$.payload.*",
+    };
+    const char* const invalid_paths[] = {
+        "payload",
+        "/a~2",
+        "/a~",
+        "$.",
+        "$.a[",
+        "$.a[01]",
+        "$.a[x]",
+        "$['a'",
+        "$a",
+    };
+    JsonPath* path;
+    size_t i;
+
+    for(i = 0; i < sizeof(valid_paths) / sizeof(valid_paths[0]); i++)
+    {
+        path = json_path_compile(valid_paths[i]);
+
+        if(path == NULL)
+        {
+            logger_log_error("Cannot compile path: %s", valid_paths[i]);
+            return 1;
+        }
+
+        if(json_path_has_wildcard(path) != (strchr(valid_paths[i], '*') != NULL))
+        {
+            logger_log_error("Invalid path wildcard: %s", valid_paths[i]);
+            return 1;
+        }
+
+        json_path_free(path);
+    }
+
+    for(i = 0; i < sizeof(invalid_paths) / sizeof(invalid_paths[0]); i++)
+    {
+        path = json_path_compile(invalid_paths[i]);
+
+        if(path != NULL)
+        {
+            logger_log_error("Invalid path compiled: %s", invalid_paths[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_json_path_dom(void)
+{
+    JsonValue* results[8];
+    JsonValue* value;
+    JsonPath* path;
+    double prices[8];
+    int64_t integers[8];
+    const char* names[8];
+    Json* json;
+
+    json = json_loads(path_doc, strlen(path_doc));
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot parse json");
+        return 1;
+    }
+
+    path = json_path_compile("");
+
+    if(json_path_find(path, json, json->root) != json->root)
+    {
+        logger_log_error("Invalid root path");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/items/1/price");
+    value = json_path_find(path, json, json->root);
+
+    if(value == NULL || json_u64_get(value) != 2)
+    {
+        logger_log_error("Invalid pointer result");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/a~1b/m~0n");
+
+    if(json_path_find(path, json, json->root) != NULL)
+    {
+        logger_log_error("Pointer matched a missing value");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/a~1b/m~0n");
+    value = json_path_find(path, json, json->root);
+
+    if(value == NULL || !json_bool_get(value))
+    {
+        logger_log_error("Invalid escaped pointer result");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    /* Numeric segments are keys in dicts */
+    path = json_path_compile("/payload/0");
+    value = json_path_find(path, json, json->root);
+
+    if(value == NULL || strcmp(json_str_get(value), "zero") != 0)
+    {
+        logger_log_error("Invalid numeric key result");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/items/*/price");
+
+    if(json_path_find_all(path, json, json->root, results, 8) != 3)
+    {
+        logger_log_error("Invalid wildcard matches count");
+        return 1;
+    }
+
+    if(json_path_find_all(path, json, json->root, results, 2) != 2)
+    {
+        logger_log_error("Results capacity exceeded");
+        return 1;
+    }
+
+    if(json_path_extract(path, json, json->root, JsonPathOutput_F64, prices, 8) != 3)
+    {
+        logger_log_error("Invalid f64 extraction");
+        return 1;
+    }
+
+    if(prices[0] != 1.5 || prices[1] != 2.0 || prices[2] != -3.0)
+    {
+        logger_log_error("Invalid extracted prices");
+        return 1;
+    }
+
+    if(json_path_extract(path, json, json->root, JsonPathOutput_I64, integers, 8) != 2)
+    {
+        logger_log_error("Invalid i64 extraction");
+        return 1;
+    }
+
+    if(integers[0] != 2 || integers[1] != -3)
+    {
+        logger_log_error("Invalid extracted integers");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("$.payload.items[*].name");
+
+    if(json_path_extract(path, json, json->root, JsonPathOutput_Str, names, 8) != 4)
+    {
+        logger_log_error("Invalid str extraction");
+        return 1;
+    }
+
+    if(strcmp(names[0], "a") != 0 || strcmp(names[3], "d") != 0)
+    {
+        logger_log_error("Invalid extracted names");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("$.payload['key with spaces'][2]");
+    value = json_path_find(path, json, json->root);
+
+    if(value == NULL || json_u64_get(value) != 30)
+    {
+        logger_log_error("Invalid jsonpath result");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("$.payload.items[4].price");
+
+    if(json_path_find(path, json, json->root) != NULL)
+    {
+        logger_log_error("Out of bounds index matched");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    json_free(json);
+
+    return 0;
+}
+
+int test_json_path_cursor(void)
+{
+    const char* escaped_doc = "{\"a\\nb\": 1}";
+    JsonOnDemand* doc;
+    JsonCursor root;
+    JsonCursor result;
+    JsonPath* path;
+    double prices[8];
+    bool flags[2];
+    uint64_t u64;
+
+    doc = json_ondemand_new(path_doc, strlen(path_doc));
+
+    if(doc == NULL || !json_ondemand_get_root(doc, &root))
+    {
+        logger_log_error("Cannot create on-demand json");
+        return 1;
+    }
+
+    path = json_path_compile("$.payload['key with spaces'][1]");
+
+    if(!json_path_find_cursor(path, &root, &result))
+    {
+        logger_log_error("Cannot find cursor path");
+        return 1;
+    }
+
+    if(!json_cursor_get_u64(&result, &u64) || u64 != 20)
+    {
+        logger_log_error("Invalid cursor path result");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/items/*/price");
+
+    if(json_path_extract_cursor(path, &root, JsonPathOutput_F64, prices, 8) != 3)
+    {
+        logger_log_error("Invalid cursor extraction");
+        return 1;
+    }
+
+    if(prices[0] != 1.5 || prices[1] != 2.0 || prices[2] != -3.0)
+    {
+        logger_log_error("Invalid cursor extracted prices");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/a~1b/*");
+
+    if(json_path_extract_cursor(path, &root, JsonPathOutput_Bool, flags, 2) != 1 || !flags[0])
+    {
+        logger_log_error("Invalid cursor bool");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/payload/missing/0");
+
+    if(json_path_find_cursor(path, &root, &result))
+    {
+        logger_log_error("Missing cursor path found");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    json_ondemand_free(doc);
+
+    /* Escaped keys are matched decoded, never by their raw text */
+    doc = json_ondemand_new(escaped_doc, strlen(escaped_doc));
+
+    if(doc == NULL || !json_ondemand_get_root(doc, &root))
+    {
+        logger_log_error("Cannot create on-demand json");
+        return 1;
+    }
+
+    path = json_path_compile("/a\\nb");
+
+    if(json_path_find_cursor(path, &root, &result))
+    {
+        logger_log_error("Raw escaped key matched");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    path = json_path_compile("/a\nb");
+
+    if(!json_path_find_cursor(path, &root, &result))
+    {
+        logger_log_error("Cannot find escaped key");
+        return 1;
+    }
+
+    json_path_free(path);
+
+    json_ondemand_free(doc);
+
+    return 0;
+}
+
+int test_json_path_batch(void)
+{
+    JsonPath* path;
+    Json* json;
+    double* prices;
+    char buffer[512];
+    size_t count;
+    size_t i;
+    size_t j;
+    double sum;
+
+    path = json_path_compile("/payload/items/*/price");
+
+    if(path == NULL)
+    {
+        logger_log_error("Cannot compile path");
+        return 1;
+    }
+
+    prices = (double*)malloc(PATH_DOCUMENTS * PATH_ITEMS * sizeof(double));
+
+    if(prices == NULL)
+    {
+        logger_log_error("Cannot allocate prices");
+        return 1;
+    }
+
+    json = json_new();
+    count = 0;
+
+    SCOPED_PROFILE_MS_START(json_path_batch);
+
+    for(i = 0; i < PATH_DOCUMENTS; i++)
+    {
+        int written = snprintf(buffer,
+                               sizeof(buffer),
+                               "{\"header\": {\"id\": %zu}, \"payload\": {\"items\": [{\"price\": %zu},"
+                               " {\"price\": 0.5}, {\"price\": 1}, {\"price\": 2.5}]}}",
+                               i,
+                               i);
+
+        json_free(json);
+        json = json_loads(buffer, (size_t)written);
+
+        if(json == NULL)
+        {
+            logger_log_error("Cannot parse batch json");
+            return 1;
+        }
+
+        count += json_path_extract(path, json, json->root, JsonPathOutput_F64, prices + count, PATH_ITEMS);
+    }
+
+    SCOPED_PROFILE_MS_END(json_path_batch);
+
+    json_free(json);
+
+    if(count != PATH_DOCUMENTS * PATH_ITEMS)
+    {
+        logger_log_error("Invalid batch results count");
+        return 1;
+    }
+
+    sum = 0.0;
+
+    for(j = 0; j < count; j++)
+        sum += prices[j];
+
+    if(sum != (double)PATH_DOCUMENTS * (PATH_DOCUMENTS - 1) / 2.0 + PATH_DOCUMENTS * 4.0)
+    {
+        logger_log_error("Invalid batch sum");
+        return 1;
+    }
+
+    free(prices);
+    json_path_free(path);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    logger_log_info("Starting JsonPath test");
+
+    if(test_json_path_compile() != 0)
+        return 1;
+
+    if(test_json_path_dom() != 0)
+        return 1;
+
+    if(test_json_path_cursor() != 0)
+        return 1;
+
+    if(test_json_path_batch() != 0)
+        return 1;
+
+    logger_log_info("Finished JsonPath test");
+
+    logger_release();
+
+    return 0;
+}
@@ -0,0 +1,938 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_stream.h"
+#include "libromano/error.h"
+#include "libromano/filesystem.h"
+#include "libromano/logger.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define STREAM_FILE_PATH "test_json_stream.json"
+#define STREAM_RECORDS 200000
+#define WRITER_FILE_PATH "test_json_stream_writer.json"
+
+static const char* tokens_doc = "{\"a\": [1, -2, 3.5e1, true, false, null], \"b\\u00e9\": {\"c\": \"d\\n\\ud83d\\ude00\"}} [] 42";
+
+static const JsonTokenType tokens_expected[] = {
+    JsonTokenType_BeginDict,
+    JsonTokenType_Key,
+    JsonTokenType_BeginArray,
+    JsonTokenType_U64,
+    JsonTokenType_I64,
+    JsonTokenType_F64,
+    JsonTokenType_Bool,
+    JsonTokenType_Bool,
+    JsonTokenType_Null,
+    JsonTokenType_EndArray,
+    JsonTokenType_Key,
+    JsonTokenType_BeginDict,
+    JsonTokenType_Key,
+    JsonTokenType_Str,
+    JsonTokenType_EndDict,
+    JsonTokenType_EndDict,
+    JsonTokenType_BeginArray,
+    JsonTokenType_EndArray,
+    JsonTokenType_U64,
+    JsonTokenType_End,
+};
+
+#define TOKENS_EXPECTED_COUNT (sizeof(tokens_expected) / sizeof(tokens_expected[0]))
+
+int check_token(const JsonToken* token, size_t i)
+{
+    if(token->type != tokens_expected[i])
+    {
+        logger_log_error("Invalid token type");
+        return 1;
+    }
+
+    switch(i)
+    {
+        case 1:
+            if(strcmp(token->value.str, "a") != 0)
+            {
+                logger_log_error("Invalid key");
+                return 1;
+            }
+
+            break;
+        case 4:
+            if(token->value.i64 != -2)
+            {
+                logger_log_error("Invalid i64");
+                return 1;
+            }
+
+            break;
+        case 5:
+            if(token->value.f64 != 35.0)
+            {
+                logger_log_error("Invalid f64");
+                return 1;
+            }
+
+            break;
+        case 10:
+            if(strcmp(token->value.str, "b\xc3\xa9") != 0)
+            {
+                logger_log_error("Invalid unicode key");
+                return 1;
+            }
+
+            if(token->str_size != 3)
+            {
+                logger_log_error("Invalid unicode key size");
+                return 1;
+            }
+
+            break;
+        case 13:
+            if(strcmp(token->value.str, "d\n\xf0\x9f\x98\x80") != 0)
+            {
+                logger_log_error("Invalid escaped str");
+                return 1;
+            }
+
+            if(token->str_size != 6)
+            {
+                logger_log_error("Invalid escaped str size");
+                return 1;
+            }
+
+            break;
+        case 18:
+            if(token->value.u64 != 42)
+            {
+                logger_log_error("Invalid u64");
+                return 1;
+            }
+
+            break;
+    }
+
+    return 0;
+}
+
+int test_json_stream_feed(size_t feed_size)
+{
+    JsonStream* stream;
+    JsonToken token;
+    size_t doc_sz;
+    size_t fed;
+    size_t i;
+
+    stream = json_stream_new(NULL, NULL, 16);
+
+    if(stream == NULL)
+    {
+        logger_log_error("Cannot create json stream");
+        return 1;
+    }
+
+    doc_sz = strlen(tokens_doc);
+    fed = 0;
+    i = 0;
+
+    while(i < TOKENS_EXPECTED_COUNT)
+    {
+        json_stream_next(stream, &token);
+
+        if(token.type == JsonTokenType_NeedMoreData)
+        {
+            size_t feed = doc_sz - fed < feed_size ? doc_sz - fed : feed_size;
+
+            if(fed >= doc_sz && feed != 0)
+            {
+                logger_log_error("Stream needs more data than available");
+                return 1;
+            }
+
+            if(feed == 0)
+            {
+                json_stream_finish(stream);
+            }
+            else
+            {
+                if(!json_stream_feed(stream, tokens_doc + fed, feed))
+                {
+                    logger_log_error("Cannot feed json stream");
+                    return 1;
+                }
+
+                fed += feed;
+            }
+
+            continue;
+        }
+
+        if(check_token(&token, i) != 0)
+            return 1;
+
+        i++;
+    }
+
+    json_stream_free(stream);
+
+    return 0;
+}
+
+int test_json_stream_invalid(void)
+{
+    const char* const invalid_docs[] = {
+        "[1,]",
+        "[1 2]",
+        "{\"a\" 1}",
+        "{1: 2}",
+        "{\"a\": 1,}",
+        "[1\"a\"]",
+        "[truex]",
+        "[01]",
+        "[1.]",
+        "\"abc",
+        "[\"\\x\"]",
+        "[\"\\u12\"]",
+        "[\"a\nb\"]",
+        "[1}",
+        "{\"a\": 1]",
+        "[[1]",
+        "]",
+    };
+    JsonStream* stream;
+    JsonToken token;
+    size_t i;
+
+    for(i = 0; i < sizeof(invalid_docs) / sizeof(invalid_docs[0]); i++)
+    {
+        stream = json_stream_new(NULL, NULL, 0);
+        json_stream_feed(stream, invalid_docs[i], strlen(invalid_docs[i]));
+        json_stream_finish(stream);
+
+        while(json_stream_next(stream, &token) != JsonTokenType_End && token.type != JsonTokenType_Error);
+
+        json_stream_free(stream);
+
+        if(token.type != JsonTokenType_Error)
+        {
+            logger_log_error("Invalid json tokenized: %s", invalid_docs[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+typedef struct SaxCounter {
+    size_t dicts;
+    size_t keys;
+    size_t strs;
+    uint64_t ids_sum;
+    bool next_is_id;
+} SaxCounter;
+
+bool sax_begin_dict(void* user_data)
+{
+    ((SaxCounter*)user_data)->dicts++;
+    return true;
+}
+
+bool sax_key(void* user_data, const char* key, size_t key_size)
+{
+    SaxCounter* counter = (SaxCounter*)user_data;
+
+    counter->keys++;
+    counter->next_is_id = key_size == 2 && memcmp(key, "id", 2) == 0;
+
+    return true;
+}
+
+bool sax_scalar(void* user_data, const JsonToken* token)
+{
+    SaxCounter* counter = (SaxCounter*)user_data;
+
+    if(counter->next_is_id && token->type == JsonTokenType_U64)
+        counter->ids_sum += token->value.u64;
+
+    if(token->type == JsonTokenType_Str)
+        counter->strs++;
+
+    counter->next_is_id = false;
+
+    return true;
+}
+
+int test_json_stream_file(void)
+{
+    JsonSaxCallbacks callbacks;
+    SaxCounter counter;
+    JsonStream* stream;
+    FILE* file;
+    size_t i;
+
+    file = fopen(STREAM_FILE_PATH, "wb");
+
+    if(file == NULL)
+    {
+        logger_log_error("Cannot create json stream test file");
+        return 1;
+    }
+
+    fputs("[\n", file);
+
+    for(i = 0; i < STREAM_RECORDS; i++)
+    {
+        fprintf(file,
+                "  {\"id\": %zu, \"name\": \"a rather long name \\\"%zu\\\" spanning chunks\", \"tags\": [\"x\", 1.5, null]}%s\n",
+                i,
+                i,
+                i + 1 < STREAM_RECORDS ? "," : "");
+    }
+
+    fputs("]\n", file);
+    fclose(file);
+
+    memset(&callbacks, 0, sizeof(JsonSaxCallbacks));
+    callbacks.begin_dict = sax_begin_dict;
+    callbacks.key = sax_key;
+    callbacks.scalar = sax_scalar;
+
+    memset(&counter, 0, sizeof(SaxCounter));
+
+    /* Small chunks to exercise tokens crossing chunk boundaries */
+    stream = json_stream_new_from_file(STREAM_FILE_PATH, 61);
+
+    if(stream == NULL)
+    {
+        logger_log_error("Cannot open json stream test file");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_stream_parse);
+
+    if(!json_stream_parse(stream, &callbacks, &counter))
+    {
+        logger_log_error("Error during json stream parsing");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_END(json_stream_parse);
+
+    if(json_stream_get_depth(stream) != 0)
+    {
+        logger_log_error("Invalid json stream depth");
+        return 1;
+    }
+
+    if(counter.dicts != STREAM_RECORDS)
+    {
+        logger_log_error("Invalid dicts count");
+        return 1;
+    }
+
+    if(counter.keys != STREAM_RECORDS * 3)
+    {
+        logger_log_error("Invalid keys count");
+        return 1;
+    }
+
+    if(counter.strs != STREAM_RECORDS * 2)
+    {
+        logger_log_error("Invalid strings count");
+        return 1;
+    }
+
+    if(counter.ids_sum != (uint64_t)STREAM_RECORDS * (STREAM_RECORDS - 1) / 2)
+    {
+        logger_log_error("Invalid ids sum");
+        return 1;
+    }
+
+    json_stream_free(stream);
+
+    fs_remove(STREAM_FILE_PATH);
+
+    return 0;
+}
+
+bool write_document(JsonStreamWriter* writer)
+{
+    return json_stream_writer_begin_dict(writer) &&
+           json_stream_writer_key(writer, "a", 1) &&
+           json_stream_writer_begin_array(writer) &&
+           json_stream_writer_u64(writer, 18446744073709551615ULL) &&
+           json_stream_writer_i64(writer, -9223372036854775807LL - 1) &&
+           json_stream_writer_bool(writer, true) &&
+           json_stream_writer_null(writer) &&
+           json_stream_writer_end_array(writer) &&
+           json_stream_writer_key(writer, "b", 1) &&
+           json_stream_writer_begin_dict(writer) &&
+           json_stream_writer_end_dict(writer) &&
+           json_stream_writer_key(writer, "c", 1) &&
+           json_stream_writer_str(writer, "d", 1) &&
+           json_stream_writer_end_dict(writer);
+}
+
+int test_json_stream_writer_buffer(void)
+{
+    const char* compact = "{\"a\": [18446744073709551615,-9223372036854775808,true,null],\"b\": {},\"c\": \"d\"}";
+    const char* indented = "{\n  \"a\": [\n    18446744073709551615,\n    -9223372036854775808,\n    true,\n"
+                           "    null\n  ],\n  \"b\": {\n  },\n  \"c\": \"d\"\n}";
+    JsonStreamWriter* writer;
+    Buffer buffer;
+
+    if(!buffer_init(&buffer, 64))
+    {
+        logger_log_error("Cannot initialize buffer");
+        return 1;
+    }
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!write_document(writer))
+    {
+        logger_log_error("Cannot write document");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != strlen(compact) || memcmp(buffer_front(&buffer), compact, strlen(compact)) != 0)
+    {
+        logger_log_error("Invalid compact document");
+        return 1;
+    }
+
+    buffer_reset(&buffer);
+
+    /* Tiny buffer to flush on every write */
+    writer = json_stream_writer_new_to_buffer(&buffer, 4, 2);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!write_document(writer))
+    {
+        logger_log_error("Cannot write document");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != strlen(indented) || memcmp(buffer_front(&buffer), indented, strlen(indented)) != 0)
+    {
+        logger_log_error("Invalid indented document");
+        return 1;
+    }
+
+    buffer_reset(&buffer);
+
+    /* Top-level values are separated by newlines */
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_u64(writer, 1) ||
+       !json_stream_writer_begin_array(writer) ||
+       !json_stream_writer_end_array(writer) ||
+       !json_stream_writer_str(writer, "", 0))
+    {
+        logger_log_error("Cannot write multiple values");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != 7 || memcmp(buffer_front(&buffer), "1\n[]\n\"\"", 7) != 0)
+    {
+        logger_log_error("Invalid multiple values");
+        return 1;
+    }
+
+    buffer_reset(&buffer);
+
+    /* Floats are written with the fewest digits that round-trip */
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_begin_array(writer) ||
+       !json_stream_writer_f64(writer, 0.1) ||
+       !json_stream_writer_f64(writer, -2.0) ||
+       !json_stream_writer_f64(writer, 1e300) ||
+       !json_stream_writer_f64(writer, 0.1 + 0.2) ||
+       !json_stream_writer_f64(writer, (double)NAN) ||
+       !json_stream_writer_end_array(writer))
+    {
+        logger_log_error("Cannot write floats");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != 41 ||
+       memcmp(buffer_front(&buffer), "[0.1,-2.0,1e300,0.30000000000000004,null]", 41) != 0)
+    {
+        logger_log_error("Invalid floats");
+        return 1;
+    }
+
+    buffer_release(&buffer);
+
+    return 0;
+}
+
+int test_json_stream_writer_escapes(void)
+{
+    const char str[] = "quote\" backslash\\ slash/ apos' \b\f\n\r\t\v\x01\x1f\x7f caf\xc3\xa9";
+    const char* expected = "\"quote\\\" backslash\\\\ slash/ apos' \\b\\f\\n\\r\\t\\u000b\\u0001\\u001f\x7f"
+                           " caf\xc3\xa9\"";
+    JsonStreamWriter* writer;
+    Buffer buffer;
+    char long_str[1000];
+    Json* json;
+    size_t i;
+
+    if(!buffer_init(&buffer, 64))
+    {
+        logger_log_error("Cannot initialize buffer");
+        return 1;
+    }
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_str(writer, str, sizeof(str) - 1))
+    {
+        logger_log_error("Cannot write escaped string");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != strlen(expected) || memcmp(buffer_front(&buffer), expected, strlen(expected)) != 0)
+    {
+        logger_log_error("Invalid escaped string");
+        return 1;
+    }
+
+    buffer_reset(&buffer);
+
+    /* Strings larger than the writer buffer, with escapes at every alignment */
+    for(i = 0; i < sizeof(long_str); i++)
+        long_str[i] = i % 37 == 0 ? '\n' : (char)('a' + i % 26);
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 16, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_str(writer, long_str, sizeof(long_str)))
+    {
+        logger_log_error("Cannot write long string");
+        return 1;
+    }
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer");
+        return 1;
+    }
+
+    json = json_loads((const char*)buffer_front(&buffer), buffer_size(&buffer));
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot parse long string");
+        return 1;
+    }
+
+    if(json_str_get_size(json->root) != sizeof(long_str) ||
+       memcmp(json_str_get(json->root), long_str, sizeof(long_str)) != 0)
+    {
+        logger_log_error("Invalid long string round-trip");
+        return 1;
+    }
+
+    json_free(json);
+    buffer_release(&buffer);
+
+    return 0;
+}
+
+int test_json_stream_writer_invalid(void)
+{
+    JsonStreamWriter* writer;
+    Buffer buffer;
+
+    if(!buffer_init(&buffer, 64))
+    {
+        logger_log_error("Cannot initialize buffer");
+        return 1;
+    }
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_begin_dict(writer))
+    {
+        logger_log_error("Cannot begin dict");
+        return 1;
+    }
+
+    if(json_stream_writer_u64(writer, 1))
+    {
+        logger_log_error("Value without key written");
+        return 1;
+    }
+
+    if(json_stream_writer_end_dict(writer))
+    {
+        logger_log_error("Writer error is not sticky");
+        return 1;
+    }
+
+    if(json_stream_writer_free(writer))
+    {
+        logger_log_error("Failed writer freed successfully");
+        return 1;
+    }
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(json_stream_writer_key(writer, "a", 1))
+    {
+        logger_log_error("Key written outside of dict");
+        return 1;
+    }
+
+    json_stream_writer_free(writer);
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_begin_array(writer))
+    {
+        logger_log_error("Cannot begin array");
+        return 1;
+    }
+
+    if(json_stream_writer_end_dict(writer))
+    {
+        logger_log_error("Mismatched container ended");
+        return 1;
+    }
+
+    json_stream_writer_free(writer);
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_begin_dict(writer) || !json_stream_writer_key(writer, "a", 1))
+    {
+        logger_log_error("Cannot write key");
+        return 1;
+    }
+
+    if(json_stream_writer_key(writer, "b", 1))
+    {
+        logger_log_error("Key written after key");
+        return 1;
+    }
+
+    json_stream_writer_free(writer);
+
+    writer = json_stream_writer_new_to_buffer(&buffer, 0, 0);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer");
+        return 1;
+    }
+
+    if(!json_stream_writer_begin_array(writer))
+    {
+        logger_log_error("Cannot begin array");
+        return 1;
+    }
+
+    if(!json_stream_writer_flush(writer))
+    {
+        logger_log_error("Cannot flush an open array");
+        return 1;
+    }
+
+    if(json_stream_writer_free(writer))
+    {
+        logger_log_error("Truncated document freed successfully");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_JsonUnexpectedCharacter)
+    {
+        logger_log_error("Invalid truncated document error");
+        return 1;
+    }
+
+    if(json_stream_writer_new_to_file("", 0, 0) != NULL)
+    {
+        logger_log_error("Writer created to invalid path");
+        return 1;
+    }
+
+    buffer_release(&buffer);
+
+    return 0;
+}
+
+int test_json_stream_writer_file(void)
+{
+    JsonStreamWriter* writer;
+    JsonValue* value;
+    Json* json;
+    char* dumped;
+    size_t dumped_sz;
+    size_t i;
+
+    writer = json_stream_writer_new_to_file(WRITER_FILE_PATH, 0, 2);
+
+    if(writer == NULL)
+    {
+        logger_log_error("Cannot create json stream writer file");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_START(json_stream_writer_records);
+
+    if(!json_stream_writer_begin_array(writer))
+    {
+        logger_log_error("Cannot begin array");
+        return 1;
+    }
+
+    for(i = 0; i < STREAM_RECORDS; i++)
+    {
+        if(!json_stream_writer_begin_dict(writer) ||
+           !json_stream_writer_key(writer, "id", 2) ||
+           !json_stream_writer_u64(writer, i) ||
+           !json_stream_writer_key(writer, "name", 4) ||
+           !json_stream_writer_str(writer, "a rather long \"name\"", 20) ||
+           !json_stream_writer_key(writer, "delta", 5) ||
+           !json_stream_writer_i64(writer, -(int64_t)i) ||
+           !json_stream_writer_key(writer, "score", 5) ||
+           !json_stream_writer_f64(writer, 0.5) ||
+           !json_stream_writer_end_dict(writer))
+        {
+            logger_log_error("Cannot write record");
+            return 1;
+        }
+    }
+
+    if(!json_stream_writer_end_array(writer))
+    {
+        logger_log_error("Cannot end array");
+        return 1;
+    }
+
+    SCOPED_PROFILE_MS_END(json_stream_writer_records);
+
+    if(!json_stream_writer_free(writer))
+    {
+        logger_log_error("Cannot free json stream writer file");
+        return 1;
+    }
+
+    json = json_loadf(WRITER_FILE_PATH);
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot load written file");
+        return 1;
+    }
+
+    if(json_array_get_size(json->root) != STREAM_RECORDS)
+    {
+        logger_log_error("Invalid written records");
+        return 1;
+    }
+
+    value = json_array_get(json->root, STREAM_RECORDS - 1);
+
+    if(json_u64_get(json_dict_find(json, value, "id")) != STREAM_RECORDS - 1)
+    {
+        logger_log_error("Invalid written id");
+        return 1;
+    }
+
+    if(strcmp(json_str_get(json_dict_find(json, value, "name")), "a rather long \"name\"") != 0)
+    {
+        logger_log_error("Invalid written name");
+        return 1;
+    }
+
+    dumped = json_dumps(json, 2, &dumped_sz);
+
+    if(dumped == NULL)
+    {
+        logger_log_error("Cannot dump written file");
+        return 1;
+    }
+
+    if(dumped[dumped_sz] != '\0')
+    {
+        logger_log_error("Dumped json is not null-terminated");
+        return 1;
+    }
+
+    json_free(json);
+
+    /* Dumping what was loaded must give back the same document */
+    json = json_loads(dumped, dumped_sz);
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot load dumped json");
+        return 1;
+    }
+
+    if(!json_dumpf(json, 2, WRITER_FILE_PATH))
+    {
+        logger_log_error("Cannot dump json file");
+        return 1;
+    }
+
+    json_free(json);
+
+    json = json_loadf(WRITER_FILE_PATH);
+
+    if(json == NULL)
+    {
+        logger_log_error("Cannot load dumped json file");
+        return 1;
+    }
+
+    if(json_array_get_size(json->root) != STREAM_RECORDS)
+    {
+        logger_log_error("Invalid dumped records");
+        return 1;
+    }
+
+    json_free(json);
+
+    free(dumped);
+
+    fs_remove(WRITER_FILE_PATH);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    logger_log_info("Starting JsonStream test");
+
+    if(test_json_stream_feed(1) != 0)
+        return 1;
+
+    if(test_json_stream_feed(7) != 0)
+        return 1;
+
+    if(test_json_stream_feed(4096) != 0)
+        return 1;
+
+    if(test_json_stream_invalid() != 0)
+        return 1;
+
+    if(test_json_stream_file() != 0)
+        return 1;
+
+    if(test_json_stream_writer_buffer() != 0)
+        return 1;
+
+    if(test_json_stream_writer_escapes() != 0)
+        return 1;
+
+    if(test_json_stream_writer_invalid() != 0)
+        return 1;
+
+    if(test_json_stream_writer_file() != 0)
+        return 1;
+
+    logger_log_info("Finished JsonStream test");
+
+    logger_release();
+
+    return 0;
+}
@@ -0,0 +1,550 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/json_struct.h"
+#include "libromano/json.h"
+#include "libromano/error.h"
+#include "libromano/logger.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define STRUCT_MESSAGES 100000
+
+typedef struct Address {
+    char city[16];
+    uint32_t zip;
+} Address;
+
+typedef struct Order {
+    uint64_t id;
+    int32_t delta;
+    int64_t balance;
+    double price;
+    float ratio;
+    bool paid;
+    const char* customer;
+    Address address;
+    int64_t* quantities;
+    size_t quantities_count;
+    Address* stops;
+    size_t stops_count;
+    const char** tags;
+    size_t tags_count;
+} Order;
+
+static const JsonField address_fields[] = {
+    JSON_FIELD_STR_BUFFER("city", Address, city, JsonFieldFlag_Required),
+    JSON_FIELD("zip", Address, zip, JsonFieldType_U32, 0),
+};
+
+static const JsonStruct address_struct = JSON_STRUCT(Address, address_fields);
+
+static const JsonField order_fields[] = {
+    JSON_FIELD("id", Order, id, JsonFieldType_U64, JsonFieldFlag_Required),
+    JSON_FIELD("delta", Order, delta, JsonFieldType_I32, 0),
+    JSON_FIELD("balance", Order, balance, JsonFieldType_I64, 0),
+    JSON_FIELD("price", Order, price, JsonFieldType_F64, 0),
+    JSON_FIELD("ratio", Order, ratio, JsonFieldType_F32, 0),
+    JSON_FIELD("paid", Order, paid, JsonFieldType_Bool, 0),
+    JSON_FIELD("customer", Order, customer, JsonFieldType_Str, 0),
+    JSON_FIELD_STRUCT("address", Order, address, &address_struct, 0),
+    JSON_FIELD_ARRAY("quantities", Order, quantities, quantities_count, JsonFieldType_I64, NULL, 0),
+    JSON_FIELD_ARRAY("stops", Order, stops, stops_count, JsonFieldType_Struct, &address_struct, 0),
+    JSON_FIELD_ARRAY("tags", Order, tags, tags_count, JsonFieldType_Str, NULL, 0),
+};
+
+static const JsonStruct order_struct = JSON_STRUCT(Order, order_fields);
+
+static const char* order_doc = "{\"unknown\": {\"nested\": [1, {\"a\": \"]\"}, null]}, \"id\": 18446744073709551615,"
+                               " \"delta\": -2147483648, \"balance\": -9223372036854775808, \"price\": 0.1,"
+                               " \"ratio\": 1.5e-1, \"paid\": true, \"customer\": \"J\\u00e9r\\u00f4me \\\"jj\\\"\","
+                               " \"address\": {\"zip\": 75001, \"city\": \"Paris\"},"
+                               " \"quantities\": [1, -2, 3], \"stops\": [{\"city\": \"Lyon\"}, {\"city\": \"Nice\", \"zip\": 6000}],"
+                               " \"tags\": [\"a\", null, \"c\\n\"], \"extra\": false}";
+
+int test_json_struct_decode(void)
+{
+    Order order;
+    Arena arena;
+
+    if(!arena_init(&arena, 4096))
+    {
+        logger_log_error("Cannot init arena");
+        return 1;
+    }
+
+    memset(&order, 0, sizeof(Order));
+
+    if(!json_struct_decode(&order_struct, order_doc, strlen(order_doc), &order, &arena))
+    {
+        logger_log_error("Cannot decode order");
+        return 1;
+    }
+
+    if(order.id != UINT64_MAX)
+    {
+        logger_log_error("Invalid u64 field");
+        return 1;
+    }
+
+    if(order.delta != INT32_MIN)
+    {
+        logger_log_error("Invalid i32 field");
+        return 1;
+    }
+
+    if(order.balance != INT64_MIN)
+    {
+        logger_log_error("Invalid i64 field");
+        return 1;
+    }
+
+    if(order.price != 0.1)
+    {
+        logger_log_error("Invalid f64 field");
+        return 1;
+    }
+
+    if(order.ratio != 0.15f)
+    {
+        logger_log_error("Invalid f32 field");
+        return 1;
+    }
+
+    if(!order.paid)
+    {
+        logger_log_error("Invalid bool field");
+        return 1;
+    }
+
+    if(strcmp(order.customer, "J\xc3\xa9r\xc3\xb4me \"jj\"") != 0)
+    {
+        logger_log_error("Invalid str field");
+        return 1;
+    }
+
+    if(strcmp(order.address.city, "Paris") != 0 || order.address.zip != 75001)
+    {
+        logger_log_error("Invalid struct field");
+        return 1;
+    }
+
+    if(order.quantities_count != 3 || order.quantities[1] != -2)
+    {
+        logger_log_error("Invalid i64 array field");
+        return 1;
+    }
+
+    if(((uintptr_t)order.quantities & (sizeof(int64_t) - 1)) != 0)
+    {
+        logger_log_error("Unaligned array");
+        return 1;
+    }
+
+    if(order.stops_count != 2)
+    {
+        logger_log_error("Invalid struct array size");
+        return 1;
+    }
+
+    if(strcmp(order.stops[0].city, "Lyon") != 0 || order.stops[0].zip != 0)
+    {
+        logger_log_error("Invalid struct array element");
+        return 1;
+    }
+
+    if(strcmp(order.stops[1].city, "Nice") != 0 || order.stops[1].zip != 6000)
+    {
+        logger_log_error("Invalid struct array element");
+        return 1;
+    }
+
+    if(order.tags_count != 3 || order.tags[1] != NULL || strcmp(order.tags[2], "c\n") != 0)
+    {
+        logger_log_error("Invalid str array field");
+        return 1;
+    }
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+int test_json_struct_invalid(void)
+{
+    const char* const mismatches[] = {
+        "{\"id\": -1}",
+        "{\"id\": 1.5}",
+        "{\"id\": \"1\"}",
+        "{\"id\": 18446744073709551616}",
+        "{\"id\": 1, \"delta\": 2147483648}",
+        "{\"id\": 1, \"paid\": 1}",
+        "{\"id\": 1, \"ratio\": 1e40}",
+        "{\"id\": 1, \"ratio\": -3.5e38}",
+        "{\"id\": 1, \"price\": 1e400}",
+        "{\"id\": 1, \"address\": {\"city\": \"A city name too long\"}}",
+        "{\"id\": 1, \"address\": {\"city\": \"\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\"}}",
+        "{\"id\": 1, \"quantities\": [1, \"2\"]}",
+        "[]",
+    };
+    const char* const missing[] = {
+        "{}",
+        "{\"id\": null}",
+        "{\"id\": 1, \"address\": {\"zip\": 1}}",
+    };
+    const char* const invalid[] = {
+        "{\"id\": 1",
+        "{\"id\": 1,}",
+        "{\"id\": 01}",
+        "{\"id\": 1} 2",
+        "{\"id\": 1, \"unknown\": [1, 2}",
+        "{\"id\": 1, \"customer\": \"a\nb\"}",
+        "{\"id\": 1, \"tags\": [\"a\" \"b\"]}",
+    };
+    const char* str;
+    Order order;
+    Arena arena;
+    size_t i;
+
+    if(!arena_init(&arena, 4096))
+    {
+        logger_log_error("Cannot init arena");
+        return 1;
+    }
+
+    for(i = 0; i < sizeof(mismatches) / sizeof(mismatches[0]); i++)
+    {
+        memset(&order, 0, sizeof(Order));
+
+        if(json_struct_decode(&order_struct, mismatches[i], strlen(mismatches[i]), &order, &arena))
+        {
+            logger_log_error("Mismatching json decoded: %s", mismatches[i]);
+            return 1;
+        }
+
+        if(error_get_last() != ErrorCode_JsonSchemaMismatch)
+        {
+            logger_log_error("Schema mismatch not detected: %s", mismatches[i]);
+            return 1;
+        }
+    }
+
+    for(i = 0; i < sizeof(missing) / sizeof(missing[0]); i++)
+    {
+        memset(&order, 0, sizeof(Order));
+
+        if(json_struct_decode(&order_struct, missing[i], strlen(missing[i]), &order, &arena))
+        {
+            logger_log_error("Json with missing field decoded: %s", missing[i]);
+            return 1;
+        }
+
+        if(error_get_last() != ErrorCode_JsonMissingField)
+        {
+            logger_log_error("Missing field not detected: %s", missing[i]);
+            return 1;
+        }
+    }
+
+    for(i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        memset(&order, 0, sizeof(Order));
+
+        if(json_struct_decode(&order_struct, invalid[i], strlen(invalid[i]), &order, &arena))
+        {
+            logger_log_error("Invalid json decoded: %s", invalid[i]);
+            return 1;
+        }
+    }
+
+    /* Strings need an arena */
+    str = "{\"id\": 1, \"customer\": \"a\"}";
+
+    if(json_struct_decode(&order_struct, str, strlen(str), &order, NULL))
+    {
+        logger_log_error("String decoded without arena");
+        return 1;
+    }
+
+    str = "{\"id\": 1, \"delta\": -1}";
+
+    if(!json_struct_decode(&order_struct, str, strlen(str), &order, NULL) || order.delta != -1)
+    {
+        logger_log_error("Cannot decode scalars without arena");
+        return 1;
+    }
+
+    /* Rounds to the largest float instead of overflowing */
+    str = "{\"id\": 1, \"ratio\": 3.4028235e38}";
+
+    if(!json_struct_decode(&order_struct, str, strlen(str), &order, NULL) || order.ratio != FLT_MAX)
+    {
+        logger_log_error("Cannot decode the largest float");
+        return 1;
+    }
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+int test_json_struct_roundtrip(void)
+{
+    Order order;
+    Order decoded;
+    Arena arena;
+    Buffer buffer;
+    Address stops[2];
+    int64_t quantities[2] = { INT64_MAX, -7 };
+    const char* tags[2] = { "ctrl\x01", NULL };
+    Json* json;
+
+    if(!arena_init(&arena, 4096))
+    {
+        logger_log_error("Cannot init arena");
+        return 1;
+    }
+
+    if(!buffer_init(&buffer, 256))
+    {
+        logger_log_error("Cannot init buffer");
+        return 1;
+    }
+
+    memset(&order, 0, sizeof(Order));
+    memset(stops, 0, sizeof(stops));
+
+    order.id = 42;
+    order.delta = -12;
+    order.balance = INT64_MIN;
+    order.price = 1.0 / 3.0;
+    order.ratio = 0.1f;
+    order.paid = false;
+    order.customer = "tab\tquote\"backslash\\";
+    strcpy(order.address.city, "Bordeaux");
+    order.address.zip = 33000;
+    order.quantities = quantities;
+    order.quantities_count = 2;
+    strcpy(stops[1].city, "Caen");
+    order.stops = stops;
+    order.stops_count = 2;
+    order.tags = tags;
+    order.tags_count = 2;
+
+    if(!json_struct_encode(&order_struct, &order, &buffer))
+    {
+        logger_log_error("Cannot encode order");
+        return 1;
+    }
+
+    /* The encoded text is valid json */
+    json = json_loads((const char*)buffer_front(&buffer), buffer_size(&buffer));
+
+    if(json == NULL)
+    {
+        logger_log_error("Encoded order is not valid json");
+        return 1;
+    }
+
+    json_free(json);
+
+    memset(&decoded, 0, sizeof(Order));
+
+    if(!json_struct_decode(&order_struct, (const char*)buffer_front(&buffer), buffer_size(&buffer), &decoded, &arena))
+    {
+        logger_log_error("Cannot decode encoded order");
+        return 1;
+    }
+
+    if(decoded.id != 42 || decoded.delta != -12 || decoded.balance != INT64_MIN)
+    {
+        logger_log_error("Invalid round-trip integers");
+        return 1;
+    }
+
+    if(decoded.price != order.price || decoded.ratio != order.ratio)
+    {
+        logger_log_error("Invalid round-trip floats");
+        return 1;
+    }
+
+    if(decoded.paid || strcmp(decoded.customer, order.customer) != 0)
+    {
+        logger_log_error("Invalid round-trip str");
+        return 1;
+    }
+
+    if(strcmp(decoded.address.city, "Bordeaux") != 0 || decoded.address.zip != 33000)
+    {
+        logger_log_error("Invalid round-trip struct");
+        return 1;
+    }
+
+    if(decoded.quantities_count != 2 || decoded.quantities[0] != INT64_MAX)
+    {
+        logger_log_error("Invalid round-trip array");
+        return 1;
+    }
+
+    if(decoded.stops_count != 2 || strcmp(decoded.stops[1].city, "Caen") != 0)
+    {
+        logger_log_error("Invalid round-trip struct array");
+        return 1;
+    }
+
+    if(decoded.tags_count != 2 || strcmp(decoded.tags[0], "ctrl\x01") != 0 || decoded.tags[1] != NULL)
+    {
+        logger_log_error("Invalid round-trip str array");
+        return 1;
+    }
+
+    buffer_reset(&buffer);
+
+    if(!json_struct_encode_array(&address_struct, stops, 2, &buffer))
+    {
+        logger_log_error("Cannot encode struct array");
+        return 1;
+    }
+
+    if(buffer_size(&buffer) != strlen("[{\"city\":\"\",\"zip\":0},{\"city\":\"Caen\",\"zip\":0}]") ||
+       memcmp(buffer_front(&buffer), "[{\"city\":\"\",\"zip\":0},{\"city\":\"Caen\",\"zip\":0}]", buffer_size(&buffer)) != 0)
+    {
+        logger_log_error("Invalid encoded struct array");
+        return 1;
+    }
+
+    buffer_release(&buffer);
+    arena_release(&arena);
+
+    return 0;
+}
+
+int test_json_struct_batch(void)
+{
+    Address* addresses;
+    const char* str;
+    JsonValue* value;
+    Address address;
+    Arena arena;
+    Json* json;
+    char message[128];
+    size_t count;
+    size_t i;
+    uint64_t zip_sum_struct;
+    uint64_t zip_sum_dom;
+    int written;
+
+    if(!arena_init(&arena, 4096))
+    {
+        logger_log_error("Cannot init arena");
+        return 1;
+    }
+
+    zip_sum_struct = 0;
+
+    SCOPED_PROFILE_MS_START(json_struct_decode_messages);
+
+    for(i = 0; i < STRUCT_MESSAGES; i++)
+    {
+        written = snprintf(message, sizeof(message), "{\"zip\": %zu, \"country\": \"fr\", \"city\": \"city_%zu\"}", i, i % 100);
+
+        if(!json_struct_decode(&address_struct, message, (size_t)written, &address, NULL))
+        {
+            logger_log_error("Cannot decode message");
+            return 1;
+        }
+
+        zip_sum_struct += address.zip;
+    }
+
+    SCOPED_PROFILE_MS_END(json_struct_decode_messages);
+
+    zip_sum_dom = 0;
+    json = json_new();
+
+    SCOPED_PROFILE_MS_START(json_dom_decode_messages);
+
+    for(i = 0; i < STRUCT_MESSAGES; i++)
+    {
+        written = snprintf(message, sizeof(message), "{\"zip\": %zu, \"country\": \"fr\", \"city\": \"city_%zu\"}", i, i % 100);
+
+        if(!json_loads_into(json, message, (size_t)written))
+        {
+            logger_log_error("Cannot parse message");
+            return 1;
+        }
+
+        value = json_dict_find(json, json->root, "zip");
+        address.zip = (uint32_t)json_u64_get(value);
+        value = json_dict_find(json, json->root, "city");
+        strncpy(address.city, json_str_get(value), sizeof(address.city) - 1);
+
+        zip_sum_dom += address.zip;
+    }
+
+    SCOPED_PROFILE_MS_END(json_dom_decode_messages);
+
+    json_free(json);
+
+    if(zip_sum_struct != zip_sum_dom)
+    {
+        logger_log_error("Invalid decoded messages");
+        return 1;
+    }
+
+    str = "[{\"city\": \"a\", \"zip\": 1}, {\"city\": \"b\", \"zip\": 2}]";
+
+    if(!json_struct_decode_array(&address_struct, str, strlen(str), &arena, (void**)&addresses, &count))
+    {
+        logger_log_error("Cannot decode struct array");
+        return 1;
+    }
+
+    if(count != 2 || addresses[1].zip != 2 || strcmp(addresses[1].city, "b") != 0)
+    {
+        logger_log_error("Invalid decoded struct array");
+        return 1;
+    }
+
+    if(!json_struct_decode_array(&address_struct, " [ ] ", 5, &arena, (void**)&addresses, &count) || count != 0)
+    {
+        logger_log_error("Cannot decode empty struct array");
+        return 1;
+    }
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    logger_log_info("Starting JsonStruct test");
+
+    if(test_json_struct_decode() != 0)
+        return 1;
+
+    if(test_json_struct_invalid() != 0)
+        return 1;
+
+    if(test_json_struct_roundtrip() != 0)
+        return 1;
+
+    if(test_json_struct_batch() != 0)
+        return 1;
+
+    logger_log_info("Finished JsonStruct test");
+
+    logger_release();
+
+    return 0;
+}
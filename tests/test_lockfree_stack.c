@@ -0,0 +1,303 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/lockfree_stack.h"
+#include "libromano/thread.h"
+#include "libromano/time.h"
+#include "libromano/logger.h"
+
+#define POOL_NODES 1000
+#define POOL_THREADS 4
+#define POOL_ITERATIONS 200000
+#define TREE_DEPTH 18
+#define TREE_THREADS 4
+
+typedef struct PoolNode {
+    LockFreeStackNode node;
+    uint32_t id;
+    Atomic32 owned;
+} PoolNode;
+
+int test_single_thread(void)
+{
+    LockFreeStack stack;
+    PoolNode nodes[8];
+    LockFreeStackNode* list;
+    uint32_t i;
+
+    lockfreestack_init(&stack);
+
+    if(!lockfreestack_is_empty(&stack))
+    {
+        logger_log_error("New stack is not empty");
+        return 1;
+    }
+
+    if(lockfreestack_pop(&stack) != NULL)
+    {
+        logger_log_error("Empty stack popped a node");
+        return 1;
+    }
+
+    for(i = 0; i < 4; i++)
+    {
+        nodes[i].id = i;
+        lockfreestack_push(&stack, &nodes[i].node);
+    }
+
+    if(((PoolNode*)lockfreestack_pop(&stack))->id != 3)
+    {
+        logger_log_error("Stack is not LIFO");
+        return 1;
+    }
+
+    /* Batch of nodes 4 -> 5 -> 6 -> 7 */
+    for(i = 4; i < 8; i++)
+    {
+        nodes[i].id = i;
+        nodes[i].node.next = i < 7 ? &nodes[i + 1].node : NULL;
+    }
+
+    lockfreestack_push_batch(&stack, &nodes[4].node, &nodes[7].node);
+
+    if(((PoolNode*)lockfreestack_pop(&stack))->id != 4)
+    {
+        logger_log_error("Batch has not been pushed in order");
+        return 1;
+    }
+
+    list = lockfreestack_pop_all(&stack);
+
+    if(!lockfreestack_is_empty(&stack))
+    {
+        logger_log_error("Stack is not empty after pop all");
+        return 1;
+    }
+
+    /* Expects 5, 6, 7, 2, 1, 0 */
+    for(i = 0; list != NULL; list = list->next, i++)
+    {
+        if(((PoolNode*)list)->id != (i < 3 ? 5 + i : 5 - i))
+        {
+            logger_log_error("Invalid pop all order");
+            return 1;
+        }
+    }
+
+    if(i != 6)
+    {
+        logger_log_error("Pop all did not return all the nodes");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* The stack is used as a shared free list, each node must be owned by a single thread */
+
+typedef struct PoolData {
+    LockFreeStack stack;
+    Atomic32 failures;
+} PoolData;
+
+void* pool_thread_func(void* arg)
+{
+    PoolData* data = (PoolData*)arg;
+    PoolNode* taken[4];
+    uint32_t i;
+    uint32_t j;
+
+    for(i = 0; i < POOL_ITERATIONS; i++)
+    {
+        uint32_t count = 1 + i % 4;
+
+        for(j = 0; j < count; j++)
+        {
+            taken[j] = (PoolNode*)lockfreestack_pop(&data->stack);
+
+            /* The pool holds more nodes than the threads can take at once */
+            if(taken[j] == NULL)
+            {
+                atomic_add_32(&data->failures, 1, MemoryOrder_Relax);
+                count = j;
+                break;
+            }
+
+            if(atomic_exchange_32(&taken[j]->owned, 1, MemoryOrder_Relax) != 0)
+                atomic_add_32(&data->failures, 1, MemoryOrder_Relax);
+        }
+
+        for(j = 0; j < count; j++)
+        {
+            atomic_store_32(&taken[j]->owned, 0, MemoryOrder_Relax);
+            lockfreestack_push(&data->stack, &taken[j]->node);
+        }
+    }
+
+    return NULL;
+}
+
+int test_concurrent_pool(void)
+{
+    PoolData data;
+    PoolNode* nodes = (PoolNode*)calloc(POOL_NODES, sizeof(PoolNode));
+    Thread* threads[POOL_THREADS];
+    LockFreeStackNode* list;
+    uint64_t start;
+    uint32_t count = 0;
+    uint32_t i;
+
+    if(nodes == NULL)
+    {
+        logger_log_error("Cannot allocate the pool nodes");
+        return 1;
+    }
+
+    lockfreestack_init(&data.stack);
+    data.failures = 0;
+
+    for(i = 0; i < POOL_NODES; i++)
+    {
+        nodes[i].id = i;
+        lockfreestack_push(&data.stack, &nodes[i].node);
+    }
+
+    start = time_get_monotonic_ns();
+
+    for(i = 0; i < POOL_THREADS; i++)
+    {
+        threads[i] = thread_create(pool_thread_func, &data);
+        thread_start(threads[i]);
+    }
+
+    for(i = 0; i < POOL_THREADS; i++)
+        thread_join(threads[i]);
+
+    logger_log(LogLevel_Info,
+               "Lock-free pool: %u threads, %.2f ns per pop/push",
+               POOL_THREADS,
+               (double)(time_get_monotonic_ns() - start) / (POOL_THREADS * POOL_ITERATIONS * 2.5));
+
+    if(atomic_load_32(&data.failures, MemoryOrder_Relax) != 0)
+    {
+        logger_log_error("Nodes have been popped by two threads or the pool ran empty");
+        free(nodes);
+        return 1;
+    }
+
+    for(list = lockfreestack_pop_all(&data.stack); list != NULL; list = list->next)
+        count++;
+
+    free(nodes);
+
+    if(count != POOL_NODES)
+    {
+        logger_log_error("Nodes have been lost or duplicated");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Parallel traversal of an implicit binary tree, node i has children 2i + 1 and 2i + 2 */
+
+typedef struct TreeData {
+    WorkStack* stack;
+    Atomic64 pending;
+    Atomic64 visited;
+} TreeData;
+
+void* tree_thread_func(void* arg)
+{
+    TreeData* data = (TreeData*)arg;
+    WorkStackCache* cache = workstack_cache_new(data->stack);
+    const uintptr_t nodes_count = ((uintptr_t)1 << TREE_DEPTH) - 1;
+    int64_t visited = 0;
+
+    while(atomic_load_64(&data->pending, MemoryOrder_Acquire) > 0)
+    {
+        void* value;
+        uintptr_t node;
+
+        if(!workstack_pop(cache, &value))
+        {
+            thread_yield();
+            continue;
+        }
+
+        /* Values are stored + 1 so the root is not NULL */
+        node = (uintptr_t)value - 1;
+        visited++;
+
+        if(2 * node + 2 < nodes_count)
+        {
+            atomic_add_64(&data->pending, 2, MemoryOrder_Relax);
+            workstack_push(cache, (void*)(2 * node + 2));
+            workstack_push(cache, (void*)(2 * node + 3));
+        }
+
+        atomic_sub_64(&data->pending, 1, MemoryOrder_Release);
+    }
+
+    workstack_cache_free(cache);
+
+    atomic_add_64(&data->visited, visited, MemoryOrder_Relax);
+
+    return NULL;
+}
+
+int test_work_stack(void)
+{
+    TreeData data;
+    Thread* threads[TREE_THREADS];
+    WorkStackCache* cache;
+    uint32_t i;
+
+    data.stack = workstack_new();
+    data.pending = 1;
+    data.visited = 0;
+
+    cache = workstack_cache_new(data.stack);
+    workstack_push(cache, (void*)1);
+    workstack_cache_free(cache);
+
+    for(i = 0; i < TREE_THREADS; i++)
+    {
+        threads[i] = thread_create(tree_thread_func, &data);
+        thread_start(threads[i]);
+    }
+
+    for(i = 0; i < TREE_THREADS; i++)
+        thread_join(threads[i]);
+
+    workstack_free(data.stack);
+
+    if(atomic_load_64(&data.visited, MemoryOrder_Relax) != ((int64_t)1 << TREE_DEPTH) - 1)
+    {
+        logger_log_error("Tree traversal did not visit all the nodes");
+        return 1;
+    }
+
+    logger_log(LogLevel_Info, "Work stack: visited %u tree nodes with %u threads", (1u << TREE_DEPTH) - 1, TREE_THREADS);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    if(test_single_thread() != 0)
+        return 1;
+
+    if(test_concurrent_pool() != 0)
+        return 1;
+
+    if(test_work_stack() != 0)
+        return 1;
+
+    logger_release();
+
+    return 0;
+}
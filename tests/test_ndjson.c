@@ -0,0 +1,349 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/ndjson.h"
+#include "libromano/atomic.h"
+#include "libromano/filesystem.h"
+#include "libromano/logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define NDJSON_FILE_PATH "test_ndjson.ndjson"
+#define NDJSON_RECORDS 200000
+#define NDJSON_STOP_AFTER 1000
+
+typedef struct OrderedCounter {
+    uint64_t next_id;
+    uint64_t stop_after;
+    uint64_t errors;
+} OrderedCounter;
+
+typedef struct UnorderedCounter {
+    Atomic64 count;
+    Atomic64 ids_sum;
+    Atomic64 errors;
+} UnorderedCounter;
+
+static char* ndjson_generate(size_t records, size_t* size)
+{
+    size_t capacity = records * 128 + 1;
+    char* data = (char*)malloc(capacity);
+    size_t i;
+
+    if(data == NULL)
+        return NULL;
+
+    *size = 0;
+
+    for(i = 0; i < records; i++)
+    {
+        /* Blank lines and \r\n line endings every now and then */
+        *size += (size_t)snprintf(data + *size,
+                                  capacity - *size,
+                                  "{\"id\": %zu, \"name\": \"record %zu\", \"values\": [1, 2.5, null]}%s",
+                                  i,
+                                  i,
+                                  i % 7 == 0 ? "\r\n" : (i % 11 == 0 ? "\n  \n" : "\n"));
+    }
+
+    return data;
+}
+
+bool ordered_record(Json* json, void* user_data)
+{
+    OrderedCounter* counter = (OrderedCounter*)user_data;
+    JsonValue* id = json_dict_find(json, json->root, "id");
+
+    if(id == NULL || !json_is_u64(id) || json_u64_get(id) != counter->next_id)
+    {
+        logger_log_error("Invalid or out of order ndjson record");
+        counter->errors++;
+        return false;
+    }
+
+    counter->next_id++;
+
+    return counter->next_id != counter->stop_after;
+}
+
+bool unordered_record(Json* json, void* user_data)
+{
+    UnorderedCounter* counter = (UnorderedCounter*)user_data;
+    JsonValue* id = json_dict_find(json, json->root, "id");
+
+    if(id == NULL || !json_is_u64(id))
+    {
+        logger_log_error("Invalid ndjson record");
+        atomic_add_64(&counter->errors, 1, MemoryOrder_Relax);
+        return false;
+    }
+
+    atomic_add_64(&counter->count, 1, MemoryOrder_Relax);
+    atomic_add_64(&counter->ids_sum, (Atomic64)json_u64_get(id), MemoryOrder_Relax);
+
+    return true;
+}
+
+int test_ndjson_ordered(ThreadPool* threadpool, const char* data, size_t size)
+{
+    OrderedCounter counter;
+    bool loaded;
+
+    counter.next_id = 0;
+    counter.stop_after = UINT64_MAX;
+    counter.errors = 0;
+
+    SCOPED_PROFILE_MS_START(ndjson_ordered);
+    loaded = ndjson_loads(threadpool, data, size, NDJsonOrder_Ordered, ordered_record, &counter);
+    SCOPED_PROFILE_MS_END(ndjson_ordered);
+
+    if(!loaded)
+    {
+        logger_log_error("Error during ordered ndjson loading");
+        return 1;
+    }
+
+    if(counter.errors != 0)
+    {
+        logger_log_error("Invalid ordered records");
+        return 1;
+    }
+
+    if(counter.next_id != NDJSON_RECORDS)
+    {
+        logger_log_error("Invalid ordered records count");
+        return 1;
+    }
+
+    /* Early stop from the callback */
+    counter.next_id = 0;
+    counter.stop_after = NDJSON_STOP_AFTER;
+
+    loaded = ndjson_loads(threadpool, data, size, NDJsonOrder_Ordered, ordered_record, &counter);
+
+    if(loaded)
+    {
+        logger_log_error("Stopped ndjson loading returned true");
+        return 1;
+    }
+
+    if(counter.errors != 0)
+    {
+        logger_log_error("Invalid ordered records");
+        return 1;
+    }
+
+    if(counter.next_id != NDJSON_STOP_AFTER)
+    {
+        logger_log_error("Records delivered after stopping");
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_ndjson_unordered(ThreadPool* threadpool, const char* data, size_t size)
+{
+    UnorderedCounter counter;
+    bool loaded;
+
+    counter.count = 0;
+    counter.ids_sum = 0;
+    counter.errors = 0;
+
+    SCOPED_PROFILE_MS_START(ndjson_unordered);
+    loaded = ndjson_loads(threadpool, data, size, NDJsonOrder_Unordered, unordered_record, &counter);
+    SCOPED_PROFILE_MS_END(ndjson_unordered);
+
+    if(!loaded)
+    {
+        logger_log_error("Error during unordered ndjson loading");
+        return 1;
+    }
+
+    if(counter.errors != 0)
+    {
+        logger_log_error("Invalid unordered records");
+        return 1;
+    }
+
+    if(counter.count != NDJSON_RECORDS)
+    {
+        logger_log_error("Invalid unordered records count");
+        return 1;
+    }
+
+    if((uint64_t)counter.ids_sum != (uint64_t)NDJSON_RECORDS * (NDJSON_RECORDS - 1) / 2)
+    {
+        logger_log_error("Invalid unordered ids sum");
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_ndjson_invalid(ThreadPool* threadpool)
+{
+    const char* invalid = "{\"id\": 0}\n{\"id\": 1}\n{\"id\": 2,}\n{\"id\": 3}\n";
+    OrderedCounter ordered;
+    UnorderedCounter unordered;
+    bool loaded;
+
+    ordered.next_id = 0;
+    ordered.stop_after = UINT64_MAX;
+    ordered.errors = 0;
+
+    loaded = ndjson_loads(threadpool, invalid, strlen(invalid), NDJsonOrder_Ordered, ordered_record, &ordered);
+
+    if(loaded)
+    {
+        logger_log_error("Invalid ndjson has been loaded");
+        return 1;
+    }
+
+    if(ordered.errors != 0)
+    {
+        logger_log_error("Invalid ordered records");
+        return 1;
+    }
+
+    if(ordered.next_id != 2)
+    {
+        logger_log_error("Records before the invalid one have not been delivered");
+        return 1;
+    }
+
+    unordered.count = 0;
+    unordered.ids_sum = 0;
+    unordered.errors = 0;
+
+    loaded = ndjson_loads(threadpool, invalid, strlen(invalid), NDJsonOrder_Unordered, unordered_record, &unordered);
+
+    if(loaded)
+    {
+        logger_log_error("Invalid ndjson has been loaded");
+        return 1;
+    }
+
+    if(unordered.errors != 0)
+    {
+        logger_log_error("Invalid unordered records");
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_ndjson_file(ThreadPool* threadpool, const char* data, size_t size)
+{
+    OrderedCounter counter;
+    FILE* file;
+    size_t written;
+    bool loaded;
+
+    file = fopen(NDJSON_FILE_PATH, "wb");
+
+    if(file == NULL)
+    {
+        logger_log_error("Cannot create ndjson test file");
+        return 1;
+    }
+
+    written = fwrite(data, 1, size, file);
+    fclose(file);
+
+    if(written != size)
+    {
+        logger_log_error("Cannot write ndjson test file");
+        return 1;
+    }
+
+    counter.next_id = 0;
+    counter.stop_after = UINT64_MAX;
+    counter.errors = 0;
+
+    loaded = ndjson_loadf(threadpool, NDJSON_FILE_PATH, NDJsonOrder_Ordered, ordered_record, &counter);
+
+    fs_remove(NDJSON_FILE_PATH);
+
+    if(!loaded)
+    {
+        logger_log_error("Error during ndjson file loading");
+        return 1;
+    }
+
+    if(counter.errors != 0)
+    {
+        logger_log_error("Invalid file records");
+        return 1;
+    }
+
+    if(counter.next_id != NDJSON_RECORDS)
+    {
+        logger_log_error("Invalid file records count");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    ThreadPool* threadpool;
+    size_t size;
+    char* data;
+
+    logger_init();
+
+    logger_log_info("Starting NDJson test");
+
+    threadpool = threadpool_init(4);
+
+    if(threadpool == NULL)
+    {
+        logger_log_error("Cannot create threadpool");
+        return 1;
+    }
+
+    data = ndjson_generate(NDJSON_RECORDS, &size);
+
+    if(data == NULL)
+    {
+        logger_log_error("Cannot allocate ndjson data");
+        return 1;
+    }
+
+    if(test_ndjson_ordered(threadpool, data, size) != 0)
+        return 1;
+
+    if(test_ndjson_ordered(NULL, data, size) != 0)
+        return 1;
+
+    if(test_ndjson_unordered(threadpool, data, size) != 0)
+        return 1;
+
+    if(test_ndjson_unordered(NULL, data, size) != 0)
+        return 1;
+
+    if(test_ndjson_invalid(threadpool) != 0)
+        return 1;
+
+    if(test_ndjson_file(threadpool, data, size) != 0)
+        return 1;
+
+    free(data);
+
+    threadpool_release(threadpool);
+
+    logger_log_info("Finished NDJson test");
+
+    logger_release();
+
+    return 0;
+}
@@ -0,0 +1,534 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/parse.h"
+#include "libromano/error.h"
+#include "libromano/fmt.h"
+#include "libromano/logger.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROMANO_ENABLE_PROFILING
+#include "libromano/profiling.h"
+
+#define RANDOM_NUMBERS 200000
+#define BENCHMARK_NUMBERS 1000000
+
+static uint64_t g_random_state = 0x9E3779B97F4A7C15ULL;
+
+uint64_t random_next(void)
+{
+    g_random_state ^= g_random_state << 13;
+    g_random_state ^= g_random_state >> 7;
+    g_random_state ^= g_random_state << 17;
+
+    return g_random_state;
+}
+
+/* Checks that parse_f64 gives the same double as strtod, bit for bit */
+int check_f64(const char* str)
+{
+    double expected;
+    double parsed;
+    size_t pos;
+
+    expected = strtod(str, NULL);
+
+    if(!parse_f64(str, strlen(str), &parsed, &pos))
+    {
+        logger_log_error("Cannot parse double: %s", str);
+        return 1;
+    }
+
+    if(pos != strlen(str))
+    {
+        logger_log_error("Invalid parsed double size: %s", str);
+        return 1;
+    }
+
+    if(memcmp(&expected, &parsed, sizeof(double)) != 0)
+    {
+        logger_log_error("Parsed %s as %.17g instead of %.17g", str, parsed, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+int check_invalid(const char* str, uint32_t flags, size_t expected_pos)
+{
+    ParsedNumber number;
+    size_t pos;
+
+    if(parse_number(str, strlen(str), flags, &number, &pos))
+    {
+        logger_log_error("Invalid number parsed: %s", str);
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseInvalidNumber)
+    {
+        logger_log_error("Invalid error code for %s", str);
+        return 1;
+    }
+
+    if(pos != expected_pos)
+    {
+        logger_log_error("Error position of %s is %zu instead of %zu", str, pos, expected_pos);
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_parse_integers(void)
+{
+    uint64_t u64;
+    int64_t i64;
+    size_t pos;
+
+    if(!parse_u64("0", 1, &u64, &pos) || u64 != 0 || pos != 1)
+    {
+        logger_log_error("Invalid u64 zero");
+        return 1;
+    }
+
+    if(!parse_u64("12345678901234567", 17, &u64, &pos) || u64 != 12345678901234567ULL || pos != 17)
+    {
+        logger_log_error("Invalid u64");
+        return 1;
+    }
+
+    if(!parse_u64("18446744073709551615", 20, &u64, &pos) || u64 != UINT64_MAX)
+    {
+        logger_log_error("Invalid u64 max");
+        return 1;
+    }
+
+    if(!parse_u64("00018446744073709551615", 23, &u64, &pos) || u64 != UINT64_MAX)
+    {
+        logger_log_error("Invalid u64 with leading zeros");
+        return 1;
+    }
+
+    if(!parse_u64("123abc", 6, &u64, &pos) || u64 != 123 || pos != 3)
+    {
+        logger_log_error("Invalid u64 prefix");
+        return 1;
+    }
+
+    /* Not null-terminated, only the first 3 digits are parsed */
+    if(!parse_u64("12345678", 3, &u64, &pos) || u64 != 123 || pos != 3)
+    {
+        logger_log_error("Invalid u64 size");
+        return 1;
+    }
+
+    if(parse_u64("18446744073709551616", 20, &u64, &pos))
+    {
+        logger_log_error("u64 overflow parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseNumberOutOfRange || pos != 0)
+    {
+        logger_log_error("Invalid u64 overflow error");
+        return 1;
+    }
+
+    if(parse_u64("-1", 2, &u64, &pos))
+    {
+        logger_log_error("Negative u64 parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseInvalidNumber || pos != 0)
+    {
+        logger_log_error("Invalid negative u64 error");
+        return 1;
+    }
+
+    if(parse_u64("", 0, &u64, &pos))
+    {
+        logger_log_error("Empty u64 parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseInvalidNumber)
+    {
+        logger_log_error("Invalid empty u64 error");
+        return 1;
+    }
+
+    if(!parse_i64("-9223372036854775808", 20, &i64, &pos) || i64 != INT64_MIN || pos != 20)
+    {
+        logger_log_error("Invalid i64 min");
+        return 1;
+    }
+
+    if(!parse_i64("+9223372036854775807", 20, &i64, &pos) || i64 != INT64_MAX)
+    {
+        logger_log_error("Invalid i64 max");
+        return 1;
+    }
+
+    if(!parse_i64("-42 ", 4, &i64, &pos) || i64 != -42 || pos != 3)
+    {
+        logger_log_error("Invalid i64");
+        return 1;
+    }
+
+    if(parse_i64("9223372036854775808", 19, &i64, &pos))
+    {
+        logger_log_error("i64 overflow parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseNumberOutOfRange || pos != 0)
+    {
+        logger_log_error("Invalid i64 overflow error");
+        return 1;
+    }
+
+    if(parse_i64("--1", 3, &i64, &pos))
+    {
+        logger_log_error("Double sign parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseInvalidNumber || pos != 1)
+    {
+        logger_log_error("Invalid double sign error");
+        return 1;
+    }
+
+    if(parse_i64("-x", 2, &i64, &pos))
+    {
+        logger_log_error("Sign without digits parsed");
+        return 1;
+    }
+
+    if(error_get_last() != ErrorCode_ParseInvalidNumber || pos != 1)
+    {
+        logger_log_error("Invalid sign error");
+        return 1;
+    }
+
+    return 0;
+}
+
+typedef struct InvalidNumber {
+    const char* str;
+    uint32_t flags;
+    size_t expected_pos;
+} InvalidNumber;
+
+int test_parse_numbers(void)
+{
+    const InvalidNumber invalid_numbers[] = {
+        { "", ParseFlags_Json, 0 },
+        { "-", ParseFlags_Json, 1 },
+        { "+1", ParseFlags_Json, 0 },
+        { "01", ParseFlags_Json, 1 },
+        { "1.", ParseFlags_Json, 2 },
+        { ".5", ParseFlags_Json, 0 },
+        { "1.5e", ParseFlags_Json, 4 },
+        { "1e+x", ParseFlags_Json, 3 },
+        { "inf", ParseFlags_Json, 0 },
+        { "-.", 0, 2 },
+        { "none", 0, 0 },
+    };
+    ParsedNumber number;
+    size_t pos;
+    size_t i;
+
+    if(!parse_number("42,", 3, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_U64 ||
+       number.value.u64 != 42 ||
+       pos != 2)
+    {
+        logger_log_error("Invalid u64 number");
+        return 1;
+    }
+
+    if(!parse_number("-0", 2, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_I64 ||
+       number.value.i64 != 0)
+    {
+        logger_log_error("Invalid negative zero");
+        return 1;
+    }
+
+    if(!parse_number("-9223372036854775808", 20, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_I64 ||
+       number.value.i64 != INT64_MIN)
+    {
+        logger_log_error("Invalid i64 number");
+        return 1;
+    }
+
+    if(!parse_number("1.0", 3, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != 1.0)
+    {
+        logger_log_error("Integral float parsed as integer");
+        return 1;
+    }
+
+    if(!parse_number("1e2", 3, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != 100.0)
+    {
+        logger_log_error("Invalid exponent");
+        return 1;
+    }
+
+    /* Integers that do not fit in 64 bits become doubles */
+    if(!parse_number("18446744073709551616", 20, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != 18446744073709551616.0)
+    {
+        logger_log_error("Invalid u64 overflow");
+        return 1;
+    }
+
+    if(!parse_number("-9223372036854775809", 20, ParseFlags_Json, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != -9223372036854775809.0)
+    {
+        logger_log_error("Invalid i64 overflow");
+        return 1;
+    }
+
+    /* Relaxed syntax */
+    if(!parse_number("+.5", 3, 0, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != 0.5 ||
+       pos != 3)
+    {
+        logger_log_error("Invalid relaxed float");
+        return 1;
+    }
+
+    if(!parse_number("007", 3, 0, &number, &pos) || number.type != ParsedNumberType_U64 || number.value.u64 != 7)
+    {
+        logger_log_error("Invalid leading zeros");
+        return 1;
+    }
+
+    if(!parse_number("5.e", 3, 0, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != 5.0 ||
+       pos != 2)
+    {
+        logger_log_error("Invalid incomplete exponent");
+        return 1;
+    }
+
+    if(!parse_number("-Infinity", 9, 0, &number, &pos) ||
+       number.type != ParsedNumberType_F64 ||
+       number.value.f64 != -(double)INFINITY ||
+       pos != 9)
+    {
+        logger_log_error("Invalid infinity");
+        return 1;
+    }
+
+    if(!parse_number("NaN", 3, 0, &number, &pos) || number.type != ParsedNumberType_F64 || !isnan(number.value.f64))
+    {
+        logger_log_error("Invalid nan");
+        return 1;
+    }
+
+    /* Error positions */
+    for(i = 0; i < sizeof(invalid_numbers) / sizeof(invalid_numbers[0]); i++)
+    {
+        if(check_invalid(invalid_numbers[i].str, invalid_numbers[i].flags, invalid_numbers[i].expected_pos) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+int test_parse_f64(void)
+{
+    const char* const doubles[] = {
+        "0",
+        "-0",
+        "-0.0",
+        "-0e0",
+        "0.1",
+        "3.14159265358979323846264338327950288",
+        "9007199254740993",
+        "9007199254740993.0000000000000000001",
+        "2.2250738585072011e-308",
+        "2.2250738585072014e-308",
+        "4.9406564584124654e-324",
+        "2.4703282292062327e-324",
+        "2.4703282292062328e-324",
+        "1e-400",
+        "1.7976931348623157e308",
+        "1.7976931348623158e308",
+        "1.7976931348623159e308",
+        "1e400",
+        "7.038531e-26",
+        "1448997445238699",
+        "123456789012345678901234567890e-30",
+        "0.000000000000000000000000000000000000000000001e45",
+        "1e99999999999",
+        "1e-99999999999",
+    };
+    char buffer[512];
+    double f64;
+    size_t i;
+    int size;
+
+    for(i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    {
+        if(check_f64(doubles[i]) != 0)
+            return 1;
+    }
+
+    /* Long halfway case, decided by the last digit */
+    memset(buffer, '0', sizeof(buffer));
+    memcpy(buffer, "9007199254740993.", 17);
+    buffer[sizeof(buffer) - 2] = '1';
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    if(check_f64(buffer) != 0)
+        return 1;
+
+    /* Shortest and 17 digits representations of random doubles */
+    for(i = 0; i < RANDOM_NUMBERS; i++)
+    {
+        uint64_t bits = random_next();
+
+        memcpy(&f64, &bits, sizeof(double));
+
+        if(!isfinite(f64))
+            continue;
+
+        size = fmt_f64_shortest(buffer, f64);
+        buffer[size] = '\0';
+
+        if(check_f64(buffer) != 0)
+            return 1;
+
+        snprintf(buffer, sizeof(buffer), "%.17e", f64);
+
+        if(check_f64(buffer) != 0)
+            return 1;
+    }
+
+    /* Random digits, exponents and lengths, including more than 19 digits */
+    for(i = 0; i < RANDOM_NUMBERS; i++)
+    {
+        size_t digits = 1 + random_next() % 30;
+        size_t point = random_next() % (digits + 1);
+        size_t offset = 0;
+        size_t j;
+
+        for(j = 0; j < digits; j++)
+        {
+            if(j == point && j > 0)
+                buffer[offset++] = '.';
+
+            buffer[offset++] = (char)('0' + random_next() % 10);
+        }
+
+        snprintf(buffer + offset, sizeof(buffer) - offset, "e%d", (int)(random_next() % 700) - 350);
+
+        if(check_f64(buffer) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+int test_parse_benchmark(void)
+{
+    char* numbers;
+    size_t* offsets;
+    double parse_sum;
+    double strtod_sum;
+    double f64;
+    size_t i;
+
+    numbers = (char*)malloc(BENCHMARK_NUMBERS * FMT_F64_SHORTEST_MAX_SIZE);
+    offsets = (size_t*)malloc((BENCHMARK_NUMBERS + 1) * sizeof(size_t));
+
+    if(numbers == NULL || offsets == NULL)
+    {
+        logger_log_error("Cannot allocate numbers");
+        return 1;
+    }
+
+    offsets[0] = 0;
+
+    for(i = 0; i < BENCHMARK_NUMBERS; i++)
+    {
+        f64 = (double)(random_next() >> 11) / (double)(1ULL << 53) * 1000.0;
+        offsets[i + 1] = offsets[i] + (size_t)fmt_f64_shortest(numbers + offsets[i], f64);
+        numbers[offsets[i + 1]++] = '\0';
+    }
+
+    parse_sum = 0.0;
+    strtod_sum = 0.0;
+
+    SCOPED_PROFILE_MS_START(parse_f64);
+
+    for(i = 0; i < BENCHMARK_NUMBERS; i++)
+    {
+        parse_f64(numbers + offsets[i], offsets[i + 1] - offsets[i] - 1, &f64, NULL);
+        parse_sum += f64;
+    }
+
+    SCOPED_PROFILE_MS_END(parse_f64);
+
+    SCOPED_PROFILE_MS_START(strtod);
+
+    for(i = 0; i < BENCHMARK_NUMBERS; i++)
+        strtod_sum += strtod(numbers + offsets[i], NULL);
+
+    SCOPED_PROFILE_MS_END(strtod);
+
+    if(parse_sum != strtod_sum)
+    {
+        logger_log_error("parse_f64 and strtod differ");
+        return 1;
+    }
+
+    free(offsets);
+    free(numbers);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    logger_log_info("Starting Parse test");
+
+    if(test_parse_integers() != 0)
+        return 1;
+
+    if(test_parse_numbers() != 0)
+        return 1;
+
+    if(test_parse_f64() != 0)
+        return 1;
+
+    if(test_parse_benchmark() != 0)
+        return 1;
+
+    logger_log_info("Finished Parse test");
+
+    logger_release();
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/reclamation.h"
+#include "libromano/thread.h"
+#include "libromano/atomic.h"
+#include "libromano/logger.h"
+
+#define READERS_COUNT 3
+#define UPDATES_COUNT 100000
+
+/* A writer keeps replacing a shared node while readers dereference it */
+
+typedef struct Node {
+    uint64_t value;
+    uint64_t check;
+} Node;
+
+static Atomic64 g_allocated = 0;
+static Atomic64 g_freed = 0;
+
+Node* node_new(uint64_t value)
+{
+    Node* node = (Node*)malloc(sizeof(Node));
+    node->value = value;
+    node->check = ~value;
+
+    atomic_add_64(&g_allocated, 1, MemoryOrder_Relax);
+
+    return node;
+}
+
+void node_free(void* ptr)
+{
+    Node* node = (Node*)ptr;
+
+    /* Poisons the node so a reader accessing it after free is likely to notice */
+    node->check = node->value;
+    free(node);
+
+    atomic_add_64(&g_freed, 1, MemoryOrder_Relax);
+}
+
+typedef struct SharedData {
+    void* node;
+    Atomic32 done;
+    Atomic32 freed_reads;
+    EpochDomain* epoch_domain;
+    HazardDomain* hazard_domain;
+} SharedData;
+
+void* epoch_reader_func(void* arg)
+{
+    SharedData* data = (SharedData*)arg;
+    EpochThread* thread = epoch_thread_register(data->epoch_domain);
+
+    while(atomic_load_32(&data->done, MemoryOrder_Relax) == 0)
+    {
+        Node* node;
+
+        epoch_enter(thread);
+
+        node = (Node*)atomic_load_ptr(&data->node, MemoryOrder_Acquire);
+
+        if(node->check != ~node->value)
+            atomic_add_32(&data->freed_reads, 1, MemoryOrder_Relax);
+
+        epoch_exit(thread);
+    }
+
+    epoch_thread_unregister(thread);
+
+    return NULL;
+}
+
+int test_epochs(void)
+{
+    SharedData data;
+    Thread* readers[READERS_COUNT];
+    EpochThread* writer;
+    uint32_t i;
+
+    data.node = node_new(0);
+    data.done = 0;
+    data.freed_reads = 0;
+    data.epoch_domain = epoch_domain_new();
+
+    for(i = 0; i < READERS_COUNT; i++)
+    {
+        readers[i] = thread_create(epoch_reader_func, &data);
+        thread_start(readers[i]);
+    }
+
+    writer = epoch_thread_register(data.epoch_domain);
+
+    for(i = 1; i <= UPDATES_COUNT; i++)
+    {
+        Node* old = (Node*)atomic_exchange_ptr(&data.node, node_new(i), MemoryOrder_AcqRel);
+        epoch_retire(writer, old, node_free);
+    }
+
+    atomic_store_32(&data.done, 1, MemoryOrder_Relax);
+
+    for(i = 0; i < READERS_COUNT; i++)
+        thread_join(readers[i]);
+
+    /* Without readers, the epoch advances on each attempt */
+    for(i = 0; i < 3; i++)
+        epoch_reclaim(writer);
+
+    if(atomic_load_32(&data.freed_reads, MemoryOrder_Relax) != 0)
+    {
+        logger_log_error("Epoch readers accessed freed nodes");
+        return 1;
+    }
+
+    if(epoch_reclaim(writer) != 0)
+    {
+        logger_log_error("Retired nodes are still pending without readers");
+        return 1;
+    }
+
+    if(atomic_load_64(&g_freed, MemoryOrder_Relax) != UPDATES_COUNT)
+    {
+        logger_log_error("Retired nodes have not been freed");
+        return 1;
+    }
+
+    epoch_thread_unregister(writer);
+    epoch_domain_free(data.epoch_domain);
+
+    node_free(data.node);
+
+    logger_log(LogLevel_Info, "Epochs: %u nodes retired and reclaimed", UPDATES_COUNT);
+
+    return 0;
+}
+
+int test_epoch_nesting(void)
+{
+    EpochDomain* domain = epoch_domain_new();
+    EpochThread* reader = epoch_thread_register(domain);
+    EpochThread* writer = epoch_thread_register(domain);
+    int64_t freed = atomic_load_64(&g_freed, MemoryOrder_Relax);
+    uint32_t i;
+
+    epoch_enter(reader);
+    epoch_enter(reader);
+    epoch_exit(reader);
+
+    /* The reader is still in its outer critical section, nothing can be freed */
+    epoch_retire(writer, node_new(0), node_free);
+
+    for(i = 0; i < 3; i++)
+    {
+        if(epoch_reclaim(writer) != 1)
+        {
+            logger_log_error("Node freed while a reader is in a critical section");
+            return 1;
+        }
+    }
+
+    epoch_exit(reader);
+
+    for(i = 0; i < 3; i++)
+        epoch_reclaim(writer);
+
+    if(atomic_load_64(&g_freed, MemoryOrder_Relax) != freed + 1)
+    {
+        logger_log_error("Node has not been freed");
+        return 1;
+    }
+
+    epoch_thread_unregister(reader);
+
+    /* The record of the unregistered thread is reused */
+    if(epoch_thread_register(domain) != reader)
+    {
+        logger_log_error("Thread record has not been reused");
+        return 1;
+    }
+
+    epoch_domain_free(domain);
+
+    return 0;
+}
+
+void* hazard_reader_func(void* arg)
+{
+    SharedData* data = (SharedData*)arg;
+    HazardThread* thread = hazard_thread_register(data->hazard_domain);
+
+    while(atomic_load_32(&data->done, MemoryOrder_Relax) == 0)
+    {
+        Node* node = (Node*)hazard_protect(thread, 0, &data->node);
+
+        if(node->check != ~node->value)
+            atomic_add_32(&data->freed_reads, 1, MemoryOrder_Relax);
+
+        hazard_clear(thread, 0);
+    }
+
+    hazard_thread_unregister(thread);
+
+    return NULL;
+}
+
+int test_hazard_pointers(void)
+{
+    SharedData data;
+    Thread* readers[READERS_COUNT];
+    HazardThread* writer;
+    int64_t freed = atomic_load_64(&g_freed, MemoryOrder_Relax);
+    uint32_t i;
+
+    data.node = node_new(0);
+    data.done = 0;
+    data.freed_reads = 0;
+    data.hazard_domain = hazard_domain_new(1);
+
+    for(i = 0; i < READERS_COUNT; i++)
+    {
+        readers[i] = thread_create(hazard_reader_func, &data);
+        thread_start(readers[i]);
+    }
+
+    writer = hazard_thread_register(data.hazard_domain);
+
+    for(i = 1; i <= UPDATES_COUNT; i++)
+    {
+        Node* old = (Node*)atomic_exchange_ptr(&data.node, node_new(i), MemoryOrder_AcqRel);
+        hazard_retire(writer, old, node_free);
+    }
+
+    atomic_store_32(&data.done, 1, MemoryOrder_Relax);
+
+    for(i = 0; i < READERS_COUNT; i++)
+        thread_join(readers[i]);
+
+    if(atomic_load_32(&data.freed_reads, MemoryOrder_Relax) != 0)
+    {
+        logger_log_error("Hazard readers accessed freed nodes");
+        return 1;
+    }
+
+    if(hazard_reclaim(writer) != 0)
+    {
+        logger_log_error("Retired nodes are still pending without readers");
+        return 1;
+    }
+
+    if(atomic_load_64(&g_freed, MemoryOrder_Relax) != freed + UPDATES_COUNT)
+    {
+        logger_log_error("Retired nodes have not been freed");
+        return 1;
+    }
+
+    hazard_thread_unregister(writer);
+    hazard_domain_free(data.hazard_domain);
+
+    node_free(data.node);
+
+    logger_log(LogLevel_Info, "Hazard pointers: %u nodes retired and reclaimed", UPDATES_COUNT);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    if(test_epochs() != 0)
+        return 1;
+
+    if(test_epoch_nesting() != 0)
+        return 1;
+
+    if(test_hazard_pointers() != 0)
+        return 1;
+
+    if(atomic_load_64(&g_allocated, MemoryOrder_Relax) != atomic_load_64(&g_freed, MemoryOrder_Relax))
+    {
+        logger_log_error("Nodes have been leaked");
+        return 1;
+    }
+
+    logger_release();
+
+    return 0;
+}
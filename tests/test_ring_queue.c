@@ -0,0 +1,372 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/ring_queue.h"
+#include "libromano/thread.h"
+#include "libromano/atomic.h"
+#include "libromano/logger.h"
+
+#define QUEUE_CAPACITY 1000
+#define SPSC_VALUES 1000000
+#define MPMC_PRODUCERS 4
+#define MPMC_CONSUMERS 4
+#define MPMC_VALUES_PER_PRODUCER 100000
+
+int test_spsc_single_thread(void)
+{
+    SPSCQueue* queue = spscqueue_new(QUEUE_CAPACITY);
+    void* values[64];
+    void* value;
+    uint32_t i;
+
+    if(queue == NULL)
+    {
+        logger_log_error("Cannot create spsc queue");
+        return 1;
+    }
+
+    if(spscqueue_capacity(queue) != 1024)
+    {
+        logger_log_error("Invalid spsc queue capacity");
+        return 1;
+    }
+
+    if(spscqueue_try_pop(queue, &value))
+    {
+        logger_log_error("Empty spsc queue popped a value");
+        return 1;
+    }
+
+    for(i = 0; i < spscqueue_capacity(queue); i++)
+    {
+        if(!spscqueue_try_push(queue, (void*)(uintptr_t)(i + 1)))
+        {
+            logger_log_error("Cannot push in spsc queue");
+            return 1;
+        }
+    }
+
+    if(spscqueue_try_push(queue, (void*)1))
+    {
+        logger_log_error("Full spsc queue accepted a value");
+        return 1;
+    }
+
+    if(spscqueue_size_approx(queue) != 1024)
+    {
+        logger_log_error("Invalid spsc queue size");
+        return 1;
+    }
+
+    for(i = 0; i < spscqueue_capacity(queue); i++)
+    {
+        if(!spscqueue_try_pop(queue, &value) || (uintptr_t)value != i + 1)
+        {
+            logger_log_error("Invalid spsc queue order");
+            return 1;
+        }
+    }
+
+    for(i = 0; i < 64; i++)
+        values[i] = (void*)(uintptr_t)i;
+
+    if(spscqueue_try_push_batch(queue, values, 64) != 64)
+    {
+        logger_log_error("Cannot push batch in spsc queue");
+        return 1;
+    }
+
+    if(spscqueue_try_pop_batch(queue, values, 64) != 64 || (uintptr_t)values[63] != 63)
+    {
+        logger_log_error("Invalid spsc queue batch");
+        return 1;
+    }
+
+    if(spscqueue_try_pop_batch(queue, values, 64) != 0)
+    {
+        logger_log_error("Empty spsc queue popped a batch");
+        return 1;
+    }
+
+    spscqueue_free(queue);
+
+    return 0;
+}
+
+void* spsc_producer_func(void* arg)
+{
+    SPSCQueue* queue = (SPSCQueue*)arg;
+    void* values[32];
+    uintptr_t i = 1;
+
+    while(i <= SPSC_VALUES)
+    {
+        uint32_t count = 0;
+
+        while(count < 32 && i + count <= SPSC_VALUES)
+        {
+            values[count] = (void*)(i + count);
+            count++;
+        }
+
+        count = spscqueue_try_push_batch(queue, values, count);
+
+        if(count == 0)
+            spscqueue_push(queue, (void*)i++);
+        else
+            i += count;
+    }
+
+    return NULL;
+}
+
+int test_spsc_threads(void)
+{
+    SPSCQueue* queue = spscqueue_new(QUEUE_CAPACITY);
+    Thread* producer;
+    uintptr_t expected;
+    int result = 0;
+
+    if(queue == NULL)
+    {
+        logger_log_error("Cannot create spsc queue");
+        return 1;
+    }
+
+    producer = thread_create(spsc_producer_func, queue);
+    thread_start(producer);
+
+    /* Everything is popped even on error, the producer would block on a full queue otherwise */
+    for(expected = 1; expected <= SPSC_VALUES; expected++)
+    {
+        void* value = spscqueue_pop(queue);
+
+        if((uintptr_t)value != expected)
+            result = 1;
+    }
+
+    thread_join(producer);
+
+    spscqueue_free(queue);
+
+    if(result != 0)
+    {
+        logger_log_error("Invalid spsc queue order");
+        return 1;
+    }
+
+    logger_log(LogLevel_Info, "Transferred %u values through the spsc queue", SPSC_VALUES);
+
+    return 0;
+}
+
+int test_mpmc_single_thread(void)
+{
+    MPMCQueue* queue = mpmcqueue_new(QUEUE_CAPACITY);
+    void* values[64];
+    void* value;
+    uint32_t i;
+
+    if(queue == NULL)
+    {
+        logger_log_error("Cannot create mpmc queue");
+        return 1;
+    }
+
+    if(mpmcqueue_capacity(queue) != 1024)
+    {
+        logger_log_error("Invalid mpmc queue capacity");
+        return 1;
+    }
+
+    if(mpmcqueue_try_pop(queue, &value))
+    {
+        logger_log_error("Empty mpmc queue popped a value");
+        return 1;
+    }
+
+    for(i = 0; i < mpmcqueue_capacity(queue); i++)
+    {
+        if(!mpmcqueue_try_push(queue, (void*)(uintptr_t)(i + 1)))
+        {
+            logger_log_error("Cannot push in mpmc queue");
+            return 1;
+        }
+    }
+
+    if(mpmcqueue_try_push(queue, (void*)1))
+    {
+        logger_log_error("Full mpmc queue accepted a value");
+        return 1;
+    }
+
+    if(mpmcqueue_size_approx(queue) != 1024)
+    {
+        logger_log_error("Invalid mpmc queue size");
+        return 1;
+    }
+
+    for(i = 0; i < mpmcqueue_capacity(queue); i++)
+    {
+        if(!mpmcqueue_try_pop(queue, &value) || (uintptr_t)value != i + 1)
+        {
+            logger_log_error("Invalid mpmc queue order");
+            return 1;
+        }
+    }
+
+    for(i = 0; i < 64; i++)
+        values[i] = (void*)(uintptr_t)i;
+
+    /* Batches wrap around the end of the ring */
+    for(i = 0; i < 100; i++)
+    {
+        if(mpmcqueue_try_push_batch(queue, values, 64) != 64)
+        {
+            logger_log_error("Cannot push batch in mpmc queue");
+            return 1;
+        }
+
+        if(mpmcqueue_try_pop_batch(queue, values, 64) != 64 || (uintptr_t)values[63] != 63)
+        {
+            logger_log_error("Invalid mpmc queue batch");
+            return 1;
+        }
+    }
+
+    if(mpmcqueue_try_pop_batch(queue, values, 64) != 0)
+    {
+        logger_log_error("Empty mpmc queue popped a batch");
+        return 1;
+    }
+
+    mpmcqueue_free(queue);
+
+    return 0;
+}
+
+typedef struct MPMCTestData {
+    MPMCQueue* queue;
+    Atomic64 sum;
+    Atomic64 popped;
+} MPMCTestData;
+
+void* mpmc_producer_func(void* arg)
+{
+    MPMCTestData* data = (MPMCTestData*)arg;
+    uintptr_t i;
+
+    for(i = 1; i <= MPMC_VALUES_PER_PRODUCER; i++)
+        mpmcqueue_push(data->queue, (void*)i);
+
+    return NULL;
+}
+
+void* mpmc_consumer_func(void* arg)
+{
+    MPMCTestData* data = (MPMCTestData*)arg;
+    void* values[16];
+    int64_t total = (int64_t)MPMC_PRODUCERS * MPMC_VALUES_PER_PRODUCER;
+
+    while(atomic_load_64(&data->popped, MemoryOrder_Relax) < total)
+    {
+        uint32_t count = mpmcqueue_try_pop_batch(data->queue, values, 16);
+        uint32_t i;
+
+        if(count == 0)
+        {
+            thread_yield();
+            continue;
+        }
+
+        for(i = 0; i < count; i++)
+            atomic_add_64(&data->sum, (int64_t)(uintptr_t)values[i], MemoryOrder_Relax);
+
+        atomic_add_64(&data->popped, (int64_t)count, MemoryOrder_Relax);
+    }
+
+    return NULL;
+}
+
+int test_mpmc_threads(void)
+{
+    MPMCTestData data;
+    Thread* producers[MPMC_PRODUCERS];
+    Thread* consumers[MPMC_CONSUMERS];
+    int64_t expected_sum;
+    uint32_t i;
+
+    data.queue = mpmcqueue_new(QUEUE_CAPACITY);
+    data.sum = 0;
+    data.popped = 0;
+
+    if(data.queue == NULL)
+    {
+        logger_log_error("Cannot create mpmc queue");
+        return 1;
+    }
+
+    for(i = 0; i < MPMC_CONSUMERS; i++)
+    {
+        consumers[i] = thread_create(mpmc_consumer_func, &data);
+        thread_start(consumers[i]);
+    }
+
+    for(i = 0; i < MPMC_PRODUCERS; i++)
+    {
+        producers[i] = thread_create(mpmc_producer_func, &data);
+        thread_start(producers[i]);
+    }
+
+    for(i = 0; i < MPMC_PRODUCERS; i++)
+        thread_join(producers[i]);
+
+    for(i = 0; i < MPMC_CONSUMERS; i++)
+        thread_join(consumers[i]);
+
+    expected_sum = (int64_t)MPMC_PRODUCERS * MPMC_VALUES_PER_PRODUCER * (MPMC_VALUES_PER_PRODUCER + 1) / 2;
+
+    if(atomic_load_64(&data.sum, MemoryOrder_Relax) != expected_sum)
+    {
+        logger_log_error("Invalid mpmc queue sum");
+        return 1;
+    }
+
+    if(mpmcqueue_size_approx(data.queue) != 0)
+    {
+        logger_log_error("Mpmc queue is not empty");
+        return 1;
+    }
+
+    mpmcqueue_free(data.queue);
+
+    logger_log(LogLevel_Info,
+               "Transferred %u values through the mpmc queue (%u producers, %u consumers)",
+               MPMC_PRODUCERS * MPMC_VALUES_PER_PRODUCER,
+               MPMC_PRODUCERS,
+               MPMC_CONSUMERS);
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    if(test_spsc_single_thread() != 0)
+        return 1;
+
+    if(test_spsc_threads() != 0)
+        return 1;
+
+    if(test_mpmc_single_thread() != 0)
+        return 1;
+
+    if(test_mpmc_threads() != 0)
+        return 1;
+
+    logger_release();
+
+    return 0;
+}
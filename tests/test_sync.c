@@ -0,0 +1,520 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/sync.h"
+#include "libromano/thread.h"
+#include "libromano/time.h"
+#include "libromano/logger.h"
+
+#define CONTENTION_THREADS 4
+#define CONTENTION_ITERATIONS 200000
+#define RWLOCK_READERS 3
+#define RWLOCK_ITERATIONS 100000
+#define SEQLOCK_ITERATIONS 100000
+
+/* Contention benchmark: each thread increments a shared counter under the lock */
+
+typedef struct LockBenchmark {
+    const char* name;
+    void* lock;
+    void (*lock_func)(void*);
+    void (*unlock_func)(void*);
+    uint64_t counter;
+} LockBenchmark;
+
+void bench_mutex_lock(void* lock) { mutex_lock((Mutex*)lock); }
+void bench_mutex_unlock(void* lock) { mutex_unlock((Mutex*)lock); }
+void bench_spinlock_lock(void* lock) { spinlock_lock((SpinLock*)lock); }
+void bench_spinlock_unlock(void* lock) { spinlock_unlock((SpinLock*)lock); }
+void bench_ticketlock_lock(void* lock) { ticketlock_lock((TicketLock*)lock); }
+void bench_ticketlock_unlock(void* lock) { ticketlock_unlock((TicketLock*)lock); }
+void bench_fastmutex_lock(void* lock) { fastmutex_lock((FastMutex*)lock); }
+void bench_fastmutex_unlock(void* lock) { fastmutex_unlock((FastMutex*)lock); }
+void bench_rwlock_lock(void* lock) { rwlock_write_lock((RWLock*)lock); }
+void bench_rwlock_unlock(void* lock) { rwlock_write_unlock((RWLock*)lock); }
+
+void* contention_thread_func(void* arg)
+{
+    LockBenchmark* bench = (LockBenchmark*)arg;
+    uint32_t i;
+
+    for(i = 0; i < CONTENTION_ITERATIONS; i++)
+    {
+        bench->lock_func(bench->lock);
+        bench->counter++;
+        bench->unlock_func(bench->lock);
+    }
+
+    return NULL;
+}
+
+int run_contention_benchmark(LockBenchmark* bench)
+{
+    Thread* threads[CONTENTION_THREADS];
+    uint64_t start;
+    uint64_t elapsed;
+    uint32_t i;
+
+    bench->counter = 0;
+
+    start = time_get_monotonic_ns();
+
+    for(i = 0; i < CONTENTION_THREADS; i++)
+    {
+        threads[i] = thread_create(contention_thread_func, bench);
+        thread_start(threads[i]);
+    }
+
+    for(i = 0; i < CONTENTION_THREADS; i++)
+        thread_join(threads[i]);
+
+    elapsed = time_get_monotonic_ns() - start;
+
+    if(bench->counter != (uint64_t)CONTENTION_THREADS * CONTENTION_ITERATIONS)
+    {
+        logger_log_error("%s did not provide mutual exclusion", bench->name);
+        return 1;
+    }
+
+    logger_log(LogLevel_Info,
+               "%-10s: %u threads, %.2f ns per lock/unlock",
+               bench->name,
+               CONTENTION_THREADS,
+               (double)elapsed / (double)(CONTENTION_THREADS * CONTENTION_ITERATIONS));
+
+    return 0;
+}
+
+int test_contention(void)
+{
+    Mutex mutex;
+    SpinLock spinlock;
+    TicketLock ticketlock;
+    FastMutex fastmutex;
+    RWLock rwlock;
+
+    LockBenchmark benchs[] = {
+        { "Mutex", &mutex, bench_mutex_lock, bench_mutex_unlock, 0 },
+        { "SpinLock", &spinlock, bench_spinlock_lock, bench_spinlock_unlock, 0 },
+        { "TicketLock", &ticketlock, bench_ticketlock_lock, bench_ticketlock_unlock, 0 },
+        { "FastMutex", &fastmutex, bench_fastmutex_lock, bench_fastmutex_unlock, 0 },
+        { "RWLock", &rwlock, bench_rwlock_lock, bench_rwlock_unlock, 0 },
+    };
+
+    uint32_t i;
+    int result = 0;
+
+    mutex_init(&mutex);
+    spinlock_init(&spinlock);
+    ticketlock_init(&ticketlock);
+    fastmutex_init(&fastmutex);
+    rwlock_init(&rwlock);
+
+    for(i = 0; i < sizeof(benchs) / sizeof(LockBenchmark) && result == 0; i++)
+        result = run_contention_benchmark(&benchs[i]);
+
+    mutex_release(&mutex);
+
+    return result;
+}
+
+int test_try_locks(void)
+{
+    SpinLock spinlock;
+    TicketLock ticketlock;
+    FastMutex fastmutex;
+    RWLock rwlock;
+
+    spinlock_init(&spinlock);
+
+    if(!spinlock_try_lock(&spinlock))
+    {
+        logger_log_error("Cannot lock a free spinlock");
+        return 1;
+    }
+
+    if(spinlock_try_lock(&spinlock))
+    {
+        logger_log_error("Locked spinlock has been locked twice");
+        return 1;
+    }
+
+    spinlock_unlock(&spinlock);
+
+    ticketlock_init(&ticketlock);
+
+    if(!ticketlock_try_lock(&ticketlock))
+    {
+        logger_log_error("Cannot lock a free ticketlock");
+        return 1;
+    }
+
+    if(ticketlock_try_lock(&ticketlock))
+    {
+        logger_log_error("Locked ticketlock has been locked twice");
+        return 1;
+    }
+
+    ticketlock_unlock(&ticketlock);
+
+    if(!ticketlock_try_lock(&ticketlock))
+    {
+        logger_log_error("Cannot relock a ticketlock");
+        return 1;
+    }
+
+    ticketlock_unlock(&ticketlock);
+
+    /* Tickets wrap around after 2^32 acquisitions */
+    ticketlock.next = INT32_MAX;
+    ticketlock.serving = INT32_MAX;
+
+    if(!ticketlock_try_lock(&ticketlock))
+    {
+        logger_log_error("Cannot lock a ticketlock about to wrap");
+        return 1;
+    }
+
+    ticketlock_unlock(&ticketlock);
+    ticketlock_lock(&ticketlock);
+    ticketlock_unlock(&ticketlock);
+
+    if(ticketlock.next != ticketlock.serving)
+    {
+        logger_log_error("Invalid ticketlock state after wrapping");
+        return 1;
+    }
+
+    fastmutex_init(&fastmutex);
+
+    if(!fastmutex_try_lock(&fastmutex))
+    {
+        logger_log_error("Cannot lock a free fastmutex");
+        return 1;
+    }
+
+    if(fastmutex_try_lock(&fastmutex))
+    {
+        logger_log_error("Locked fastmutex has been locked twice");
+        return 1;
+    }
+
+    fastmutex_unlock(&fastmutex);
+
+    rwlock_init(&rwlock);
+
+    if(!rwlock_try_read_lock(&rwlock))
+    {
+        logger_log_error("Cannot read lock a free rwlock");
+        return 1;
+    }
+
+    if(!rwlock_try_read_lock(&rwlock))
+    {
+        logger_log_error("Cannot share a read locked rwlock");
+        return 1;
+    }
+
+    if(rwlock_try_write_lock(&rwlock))
+    {
+        logger_log_error("Read locked rwlock has been write locked");
+        return 1;
+    }
+
+    rwlock_read_unlock(&rwlock);
+    rwlock_read_unlock(&rwlock);
+
+    if(!rwlock_try_write_lock(&rwlock))
+    {
+        logger_log_error("Cannot write lock a free rwlock");
+        return 1;
+    }
+
+    if(rwlock_try_read_lock(&rwlock))
+    {
+        logger_log_error("Write locked rwlock has been read locked");
+        return 1;
+    }
+
+    rwlock_write_unlock(&rwlock);
+
+    return 0;
+}
+
+/* RWLock: the writer keeps both values equal, readers must never see them differ */
+
+typedef struct RWLockTestData {
+    RWLock lock;
+    uint64_t a;
+    uint64_t b;
+    Atomic32 done;
+    Atomic32 partial_reads;
+} RWLockTestData;
+
+void* rwlock_reader_func(void* arg)
+{
+    RWLockTestData* data = (RWLockTestData*)arg;
+
+    while(atomic_load_32(&data->done, MemoryOrder_Relax) == 0)
+    {
+        rwlock_read_lock(&data->lock);
+
+        if(data->a != data->b)
+            atomic_add_32(&data->partial_reads, 1, MemoryOrder_Relax);
+
+        rwlock_read_unlock(&data->lock);
+    }
+
+    return NULL;
+}
+
+int test_rwlock(void)
+{
+    RWLockTestData data;
+    Thread* readers[RWLOCK_READERS];
+    uint32_t i;
+
+    rwlock_init(&data.lock);
+    data.a = 0;
+    data.b = 0;
+    data.done = 0;
+    data.partial_reads = 0;
+
+    for(i = 0; i < RWLOCK_READERS; i++)
+    {
+        readers[i] = thread_create(rwlock_reader_func, &data);
+        thread_start(readers[i]);
+    }
+
+    /* Writer preference guarantees the writer is not starved by the readers */
+    for(i = 0; i < RWLOCK_ITERATIONS; i++)
+    {
+        rwlock_write_lock(&data.lock);
+        data.a++;
+        data.b++;
+        rwlock_write_unlock(&data.lock);
+    }
+
+    atomic_store_32(&data.done, 1, MemoryOrder_Relax);
+
+    for(i = 0; i < RWLOCK_READERS; i++)
+        thread_join(readers[i]);
+
+    if(atomic_load_32(&data.partial_reads, MemoryOrder_Relax) != 0)
+    {
+        logger_log_error("RWLock readers saw partial writes");
+        return 1;
+    }
+
+    if(data.a != RWLOCK_ITERATIONS)
+    {
+        logger_log_error("RWLock writer lost updates");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* SeqLock */
+
+typedef struct SeqLockTestData {
+    SeqLock lock;
+    Atomic64 a;
+    Atomic64 b;
+    Atomic32 done;
+    uint64_t reads;
+    uint64_t partial_reads;
+} SeqLockTestData;
+
+void* seqlock_reader_func(void* arg)
+{
+    SeqLockTestData* data = (SeqLockTestData*)arg;
+
+    while(atomic_load_32(&data->done, MemoryOrder_Relax) == 0)
+    {
+        uint32_t sequence;
+        int64_t a;
+        int64_t b;
+
+        do
+        {
+            sequence = seqlock_read_begin(&data->lock);
+            a = atomic_load_64(&data->a, MemoryOrder_Relax);
+            b = atomic_load_64(&data->b, MemoryOrder_Relax);
+        } while(seqlock_read_retry(&data->lock, sequence));
+
+        if(a != b)
+            data->partial_reads++;
+
+        data->reads++;
+    }
+
+    return NULL;
+}
+
+int test_seqlock(void)
+{
+    SeqLockTestData data;
+    Thread* reader;
+    uint32_t i;
+
+    seqlock_init(&data.lock);
+    data.a = 0;
+    data.b = 0;
+    data.done = 0;
+    data.reads = 0;
+    data.partial_reads = 0;
+
+    reader = thread_create(seqlock_reader_func, &data);
+    thread_start(reader);
+
+    for(i = 0; i < SEQLOCK_ITERATIONS; i++)
+    {
+        seqlock_write_begin(&data.lock);
+        atomic_store_64(&data.a, (Atomic64)i, MemoryOrder_Relax);
+        atomic_store_64(&data.b, (Atomic64)i, MemoryOrder_Relax);
+        seqlock_write_end(&data.lock);
+    }
+
+    atomic_store_32(&data.done, 1, MemoryOrder_Relax);
+
+    thread_join(reader);
+
+    if(data.partial_reads != 0)
+    {
+        logger_log_error("SeqLock reader saw %zu partial writes", data.partial_reads);
+        return 1;
+    }
+
+    logger_log(LogLevel_Info, "SeqLock: %u writes, %zu consistent reads", SEQLOCK_ITERATIONS, data.reads);
+
+    return 0;
+}
+
+/* Events */
+
+typedef struct EventTestData {
+    Event start;
+    Event ping;
+    Event pong;
+    Atomic32 started;
+} EventTestData;
+
+void* event_waiter_func(void* arg)
+{
+    EventTestData* data = (EventTestData*)arg;
+
+    event_wait(&data->start);
+    atomic_add_32(&data->started, 1, MemoryOrder_Relax);
+
+    return NULL;
+}
+
+void* event_pong_func(void* arg)
+{
+    EventTestData* data = (EventTestData*)arg;
+    uint32_t i;
+
+    for(i = 0; i < 1000; i++)
+    {
+        event_wait(&data->ping);
+        event_set(&data->pong);
+    }
+
+    return NULL;
+}
+
+int test_events(void)
+{
+    EventTestData data;
+    Thread* waiters[4];
+    Thread* pong;
+    uint64_t start;
+    uint32_t i;
+
+    event_init(&data.start, EventMode_OneShot);
+    event_init(&data.ping, EventMode_AutoReset);
+    event_init(&data.pong, EventMode_AutoReset);
+    data.started = 0;
+
+    start = time_get_monotonic_ns();
+
+    if(event_wait_for(&data.start, 10000000))
+    {
+        logger_log_error("Unset event has been waited");
+        return 1;
+    }
+
+    if(time_get_monotonic_ns() - start < 10000000)
+    {
+        logger_log_error("Event wait timed out too early");
+        return 1;
+    }
+
+    for(i = 0; i < 4; i++)
+    {
+        waiters[i] = thread_create(event_waiter_func, &data);
+        thread_start(waiters[i]);
+    }
+
+    event_set(&data.start);
+
+    for(i = 0; i < 4; i++)
+        thread_join(waiters[i]);
+
+    if(atomic_load_32(&data.started, MemoryOrder_Relax) != 4)
+    {
+        logger_log_error("One-shot event did not release all waiters");
+        return 1;
+    }
+
+    if(!event_try_wait(&data.start))
+    {
+        logger_log_error("One-shot event has been reset");
+        return 1;
+    }
+
+    pong = thread_create(event_pong_func, &data);
+    thread_start(pong);
+
+    for(i = 0; i < 1000; i++)
+    {
+        event_set(&data.ping);
+        event_wait(&data.pong);
+    }
+
+    thread_join(pong);
+
+    if(event_try_wait(&data.ping) || event_try_wait(&data.pong))
+    {
+        logger_log_error("Auto-reset events are still set");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    logger_init();
+
+    if(test_try_locks() != 0)
+        return 1;
+
+    if(test_contention() != 0)
+        return 1;
+
+    if(test_rwlock() != 0)
+        return 1;
+
+    if(test_seqlock() != 0)
+        return 1;
+
+    if(test_events() != 0)
+        return 1;
+
+    logger_release();
+
+    return 0;
+}
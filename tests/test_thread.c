@@ -3,6 +3,8 @@
 /* All rights reserved. */
 
 #include "libromano/thread.h"
+#include "libromano/atomic.h"
+#include "libromano/time.h"
 #include "libromano/logger.h"
 #include "libromano/backtrace.h"
 #include "libromano/profiling.h"
@@ -47,6 +49,449 @@ void* tpool_func(void* data)
     return NULL;
 }
 
+typedef struct GraphStage {
+    int32_t* order;
+    int32_t* order_index;
+    int32_t stage;
+} GraphStage;
+
+void* graph_stage_func(void* data)
+{
+    GraphStage* stage = (GraphStage*)data;
+
+    int32_t index = atomic_fetch_add_32((Atomic32*)stage->order_index, 1, MemoryOrder_AcqRel) - 1;
+
+    stage->order[index] = stage->stage;
+
+    return NULL;
+}
+
+int test_taskgraph(ThreadPool* tp)
+{
+    /* parse -> (transform a, transform b) -> write */
+    int32_t order[4];
+    int32_t order_index;
+    GraphStage stages[4];
+    uint32_t tasks[4];
+    size_t i, run;
+
+    TaskGraph* graph = taskgraph_new();
+
+    if(graph == NULL)
+    {
+        logger_log_error("Cannot create task graph");
+        return 1;
+    }
+
+    for(i = 0; i < 4; i++)
+    {
+        stages[i].order = order;
+        stages[i].order_index = &order_index;
+        stages[i].stage = (int32_t)i;
+        tasks[i] = taskgraph_add_task(graph, graph_stage_func, &stages[i]);
+
+        if(tasks[i] == TASKGRAPH_INVALID_TASK)
+        {
+            logger_log_error("Cannot add task to the graph");
+            taskgraph_free(graph);
+            return 1;
+        }
+    }
+
+    if(!taskgraph_add_dependency(graph, tasks[1], tasks[0]) ||
+       !taskgraph_add_dependency(graph, tasks[2], tasks[0]) ||
+       !taskgraph_add_dependency(graph, tasks[3], tasks[1]) ||
+       !taskgraph_add_dependency(graph, tasks[3], tasks[2]))
+    {
+        logger_log_error("Cannot add dependency to the graph");
+        taskgraph_free(graph);
+        return 1;
+    }
+
+    /* The same graph is submitted several times */
+    for(run = 0; run < 8; run++)
+    {
+        ThreadPoolWaiter waiter = threadpool_waiter_new();
+        order_index = 0;
+
+        if(!threadpool_graph_submit(tp, graph, &waiter))
+        {
+            logger_log_error("Cannot submit task graph");
+            taskgraph_free(graph);
+            return 1;
+        }
+
+        threadpool_waiter_wait(&waiter);
+
+        while(taskgraph_is_running(graph))
+            thread_yield();
+
+        if(order_index != 4)
+        {
+            logger_log_error("All the tasks should have been executed");
+            taskgraph_free(graph);
+            return 1;
+        }
+
+        if(order[0] != 0 || order[3] != 3)
+        {
+            logger_log_error("Tasks executed in the wrong order");
+            taskgraph_free(graph);
+            return 1;
+        }
+    }
+
+    /* Cycles are refused */
+    if(!taskgraph_add_dependency(graph, tasks[0], tasks[3]))
+    {
+        logger_log_error("Cannot add dependency to the graph");
+        taskgraph_free(graph);
+        return 1;
+    }
+
+    if(threadpool_graph_submit(tp, graph, NULL))
+    {
+        logger_log_error("Cyclic graph should not be submitted");
+        taskgraph_free(graph);
+        return 1;
+    }
+
+    taskgraph_free(graph);
+
+    logger_log(LogLevel_Info, "Task graph test done");
+
+    return 0;
+}
+
+#define FUTURES_COUNT 64
+
+void* future_square_func(void* data)
+{
+    intptr_t x = (intptr_t)data;
+
+    return (void*)(x * x);
+}
+
+void* future_add_one_func(void* data)
+{
+    return (void*)((intptr_t)data + 1);
+}
+
+void* future_gate_func(void* data)
+{
+    int32_t* gate = (int32_t*)data;
+
+    atomic_store_32((Atomic32*)&gate[0], 1, MemoryOrder_Release);
+
+    while(atomic_load_32((Atomic32*)&gate[1], MemoryOrder_Acquire) == 0)
+        thread_yield();
+
+    return NULL;
+}
+
+int test_futures(ThreadPool* tp)
+{
+    Future* futures[FUTURES_COUNT];
+    Future* continuation;
+    Future* all;
+    intptr_t i;
+
+    for(i = 0; i < FUTURES_COUNT; i++)
+    {
+        futures[i] = threadpool_work_add_future(tp, future_square_func, (void*)i);
+
+        if(futures[i] == NULL)
+        {
+            logger_log_error("Cannot add future work");
+            return 1;
+        }
+    }
+
+    continuation = future_then(futures[7], future_add_one_func);
+
+    if(continuation == NULL)
+    {
+        logger_log_error("Cannot add continuation");
+        return 1;
+    }
+
+    all = future_when_all(tp, futures, FUTURES_COUNT);
+
+    if(all == NULL)
+    {
+        logger_log_error("Cannot create when all future");
+        return 1;
+    }
+
+    future_get(all);
+
+    if(future_get_state(all) != FutureState_Done)
+    {
+        logger_log_error("When all future not done");
+        return 1;
+    }
+
+    for(i = 0; i < FUTURES_COUNT; i++)
+    {
+        if(future_get_state(futures[i]) != FutureState_Done)
+        {
+            logger_log_error("Future not done after when all");
+            return 1;
+        }
+
+        if((intptr_t)future_get(futures[i]) != i * i)
+        {
+            logger_log_error("Invalid future value");
+            return 1;
+        }
+
+        future_release(futures[i]);
+    }
+
+    if((intptr_t)future_get(continuation) != 50)
+    {
+        logger_log_error("Invalid continuation value");
+        return 1;
+    }
+
+    future_release(continuation);
+    future_release(all);
+
+    logger_log(LogLevel_Info, "Futures test done");
+
+    return 0;
+}
+
+int test_futures_cancel(void)
+{
+    ThreadPool* tp = threadpool_init(1);
+    int32_t gate[2] = { 0, 0 };
+    Future* gate_future;
+    Future* future;
+    Future* continuation;
+    Future* all;
+    Future* inputs[2];
+    int result = 1;
+
+    if(tp == NULL)
+    {
+        logger_log_error("Cannot create threadpool");
+        return 1;
+    }
+
+    /* Keeps the only worker busy so the next future cannot start */
+    gate_future = threadpool_work_add_future(tp, future_gate_func, gate);
+
+    if(gate_future == NULL)
+    {
+        logger_log_error("Cannot add future work");
+        threadpool_release(tp);
+        return 1;
+    }
+
+    while(atomic_load_32((Atomic32*)&gate[0], MemoryOrder_Acquire) == 0)
+        thread_yield();
+
+    future = threadpool_work_add_future(tp, future_square_func, (void*)(intptr_t)3);
+    continuation = future != NULL ? future_then(future, future_add_one_func) : NULL;
+
+    inputs[0] = gate_future;
+    inputs[1] = future;
+    all = future != NULL ? future_when_all(tp, inputs, 2) : NULL;
+
+    if(all == NULL || continuation == NULL)
+        logger_log_error("Cannot create futures");
+    else if(!future_cancel(future))
+        logger_log_error("Cannot cancel a pending future");
+    else if(future_get_state(continuation) != FutureState_Cancelled)
+        logger_log_error("Continuation not cancelled");
+    else if(future_get(future) != NULL)
+        logger_log_error("Cancelled future has a value");
+    else if(future_get_state(all) != FutureState_Pending)
+        logger_log_error("When all future completed before all its futures");
+    else
+        result = 0;
+
+    atomic_store_32((Atomic32*)&gate[1], 1, MemoryOrder_Release);
+
+    if(result == 0)
+    {
+        future_get(all);
+
+        if(future_get_state(all) != FutureState_Cancelled)
+        {
+            logger_log_error("When all future not cancelled with one of its futures");
+            result = 1;
+        }
+        else if(future_cancel(gate_future))
+        {
+            logger_log_error("Cancelled a finished future");
+            result = 1;
+        }
+    }
+
+    if(all != NULL)
+        future_release(all);
+
+    if(continuation != NULL)
+        future_release(continuation);
+
+    if(future != NULL)
+        future_release(future);
+
+    future_release(gate_future);
+
+    threadpool_release(tp);
+
+    if(result == 0)
+        logger_log(LogLevel_Info, "Futures cancellation test done");
+
+    return result;
+}
+
+typedef struct PriorityTask {
+    int32_t* order;
+    int32_t* order_index;
+    int32_t id;
+} PriorityTask;
+
+void* priority_task_func(void* data)
+{
+    PriorityTask* task = (PriorityTask*)data;
+
+    int32_t index = atomic_fetch_add_32((Atomic32*)task->order_index, 1, MemoryOrder_AcqRel) - 1;
+
+    task->order[index] = task->id;
+
+    return NULL;
+}
+
+#define PRIORITY_HIGH_COUNT 64
+#define PRIORITY_LOW_COUNT 8
+#define PRIORITY_DEADLINE_COUNT 3
+#define PRIORITY_TASKS_COUNT (PRIORITY_HIGH_COUNT + 2 * PRIORITY_LOW_COUNT + PRIORITY_DEADLINE_COUNT)
+
+/* Ids: [0, 64) high, [100, 108) normal, [200, 208) background, [300, 303) deadline */
+int test_priorities(void)
+{
+    ThreadPool* tp = threadpool_init(1);
+    ThreadPoolWaiter waiter = threadpool_waiter_new();
+    PriorityTask tasks[PRIORITY_TASKS_COUNT];
+    int32_t order[PRIORITY_TASKS_COUNT];
+    int32_t order_index = 0;
+    int32_t gate[2] = { 0, 0 };
+    int32_t last_high = 0;
+    int32_t first_normal = PRIORITY_TASKS_COUNT;
+    int32_t first_background = PRIORITY_TASKS_COUNT;
+    uint64_t now;
+    int32_t i;
+    int32_t n = 0;
+
+    if(tp == NULL)
+    {
+        logger_log_error("Cannot create threadpool");
+        return 1;
+    }
+
+    /* Keeps the only worker busy while the lanes are filled */
+    threadpool_work_add(tp, future_gate_func, gate, &waiter);
+
+    while(atomic_load_32((Atomic32*)&gate[0], MemoryOrder_Acquire) == 0)
+        thread_yield();
+
+    for(i = 0; i < PRIORITY_LOW_COUNT; i++, n++)
+    {
+        tasks[n].order = order;
+        tasks[n].order_index = &order_index;
+        tasks[n].id = 200 + i;
+        threadpool_work_add_with_priority(tp, priority_task_func, &tasks[n], &waiter, ThreadPoolPriority_Background);
+    }
+
+    for(i = 0; i < PRIORITY_LOW_COUNT; i++, n++)
+    {
+        tasks[n].order = order;
+        tasks[n].order_index = &order_index;
+        tasks[n].id = 100 + i;
+        threadpool_work_add_with_priority(tp, priority_task_func, &tasks[n], &waiter, ThreadPoolPriority_Normal);
+    }
+
+    for(i = 0; i < PRIORITY_HIGH_COUNT; i++, n++)
+    {
+        tasks[n].order = order;
+        tasks[n].order_index = &order_index;
+        tasks[n].id = i;
+        threadpool_work_add_with_priority(tp, priority_task_func, &tasks[n], &waiter, ThreadPoolPriority_High);
+    }
+
+    /* Submitted with decreasing deadlines, they must run in the reverse order */
+    now = time_get_monotonic_ns();
+
+    for(i = 0; i < PRIORITY_DEADLINE_COUNT; i++, n++)
+    {
+        tasks[n].order = order;
+        tasks[n].order_index = &order_index;
+        tasks[n].id = 300 + (PRIORITY_DEADLINE_COUNT - 1 - i);
+        threadpool_work_add_with_deadline(tp,
+                                          priority_task_func,
+                                          &tasks[n],
+                                          &waiter,
+                                          now + (uint64_t)(PRIORITY_DEADLINE_COUNT - i) * 1000000ULL);
+    }
+
+    atomic_store_32((Atomic32*)&gate[1], 1, MemoryOrder_Release);
+
+    threadpool_waiter_wait(&waiter);
+
+    threadpool_release(tp);
+
+    if(order_index != PRIORITY_TASKS_COUNT)
+    {
+        logger_log_error("Missing priority tasks");
+        return 1;
+    }
+
+    for(i = 0; i < PRIORITY_DEADLINE_COUNT; i++)
+    {
+        if(order[i] != 300 + i)
+        {
+            logger_log_error("Deadline tasks not executed in earliest deadline first order");
+            return 1;
+        }
+    }
+
+    for(i = 0; i < PRIORITY_TASKS_COUNT; i++)
+    {
+        if(order[i] < 100)
+            last_high = i;
+        else if(order[i] < 200 && first_normal == PRIORITY_TASKS_COUNT)
+            first_normal = i;
+        else if(order[i] >= 200 && order[i] < 300 && first_background == PRIORITY_TASKS_COUNT)
+            first_background = i;
+    }
+
+    if(order[PRIORITY_DEADLINE_COUNT] >= 100)
+    {
+        logger_log_error("High priority lane not drained first");
+        return 1;
+    }
+
+    if(first_normal >= last_high)
+    {
+        logger_log_error("Normal lane starved by the high priority lane");
+        return 1;
+    }
+
+    if(first_background >= last_high)
+    {
+        logger_log_error("Background lane starved by the high priority lane");
+        return 1;
+    }
+
+    logger_log(LogLevel_Info, "Priorities test done");
+
+    return 0;
+}
+
 int main(void)
 {
     backtrace_install_signal_handler();
@@ -73,6 +518,8 @@ int main(void)
 
     ThreadPoolWaiter waiter = threadpool_waiter_new();
 
+    threadpool_set_stats_log_interval(tp, 250);
+
     int* work_data = malloc(sizeof(int) * WORK_COUNT);
 
     logger_log(LogLevel_Info, "Adding work to the threadpool");
@@ -89,12 +536,92 @@ int main(void)
 
     logger_log(LogLevel_Info, "Threadpool work done");
 
-    free(work_data);
+    if(test_taskgraph(tp) != 0)
+        return 1;
+
+    if(test_futures(tp) != 0)
+        return 1;
+
+    if(test_futures_cancel() != 0)
+        return 1;
+
+    if(test_priorities() != 0)
+        return 1;
 
     logger_log(LogLevel_Info, "Releasing threadpool");
 
     threadpool_release(tp);
 
+    logger_log(LogLevel_Info, "Initializing threadpool pinned per physical core");
+
+    tp = threadpool_init_with_placement(0, ThreadPoolPlacement_PerPhysicalCore);
+
+    if(tp == NULL)
+    {
+        logger_log_error("Failed to create the pinned threadpool");
+        return 1;
+    }
+
+    waiter = threadpool_waiter_new();
+
+    for(i = 0; i < WORK_COUNT; i++)
+        threadpool_work_add(tp, tpool_func, (void*)&work_data[i], &waiter);
+
+    threadpool_waiter_wait(&waiter);
+
+    logger_log(LogLevel_Info, "Pinned threadpool work done");
+
+    ThreadPoolWorkerStats* stats = malloc(threadpool_get_workers_count(tp) * sizeof(ThreadPoolWorkerStats));
+
+    if(stats == NULL)
+    {
+        logger_log_error("Cannot allocate the stats");
+        return 1;
+    }
+    uint64_t executed = 0;
+    uint32_t stats_count;
+
+    /* The waiter is released before the worker accounts the last task */
+    while(executed != WORK_COUNT)
+    {
+        stats_count = threadpool_get_stats(tp, stats, threadpool_get_workers_count(tp));
+
+        if(stats_count != threadpool_get_workers_count(tp))
+        {
+            logger_log_error("Invalid stats count");
+            return 1;
+        }
+
+        executed = 0;
+
+        for(i = 0; i < stats_count; i++)
+        {
+            if(stats[i].tasks_stolen > stats[i].tasks_executed)
+            {
+                logger_log_error("Invalid stolen count");
+                return 1;
+            }
+
+            executed += stats[i].tasks_executed;
+        }
+
+        if(executed > WORK_COUNT)
+        {
+            logger_log_error("Invalid executed tasks count");
+            return 1;
+        }
+
+        thread_yield();
+    }
+
+    threadpool_log_stats(tp);
+
+    free(stats);
+
+    threadpool_release(tp);
+
+    free(work_data);
+
     logger_release();
 
     return 0;
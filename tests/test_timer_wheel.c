@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2023 - Present Romain Augier */
+/* All rights reserved. */
+
+#include "libromano/timer_wheel.h"
+#include "libromano/atomic.h"
+#include "libromano/random.h"
+#include "libromano/time.h"
+#include "libromano/logger.h"
+
+#define MS 1000000ULL
+#define SECOND (1000 * MS)
+#define HOUR (3600 * SECOND)
+
+#define MANY_TIMERS 1000000
+#define THREADED_TIMERS 100
+
+void* count_func(void* arg)
+{
+    atomic_add_32((Atomic32*)arg, 1, MemoryOrder_Relax);
+    return NULL;
+}
+
+ROMANO_FORCE_INLINE int32_t get_count(int32_t* counter)
+{
+    return atomic_load_32((Atomic32*)counter, MemoryOrder_Relax);
+}
+
+/* The wheel is driven manually, a 2 ticks margin covers the time spent between two calls */
+int test_levels(void)
+{
+    const uint64_t delays[] = { 5 * MS, 300 * MS, 70 * SECOND, 5 * HOUR, 100 * 24 * HOUR };
+    TimerWheel* wheel = timerwheel_new(MS);
+    uint64_t base = time_get_monotonic_ns();
+    int32_t counters[5] = { 0 };
+    uint32_t i;
+
+    if(wheel == NULL)
+    {
+        logger_log_error("Cannot create timer wheel");
+        return 1;
+    }
+
+    if(timerwheel_next_expiry(wheel) != TIMERWHEEL_NO_EXPIRY)
+    {
+        logger_log_error("Empty wheel has an expiry");
+        return 1;
+    }
+
+    for(i = 0; i < 5; i++)
+    {
+        if(timerwheel_add(wheel, delays[i], 0, count_func, &counters[i]) == TIMER_INVALID_ID)
+        {
+            logger_log_error("Cannot add timer");
+            return 1;
+        }
+    }
+
+    if(timerwheel_get_timers_count(wheel) != 5)
+    {
+        logger_log_error("Invalid timers count");
+        return 1;
+    }
+
+    for(i = 0; i < 5; i++)
+    {
+        timerwheel_advance(wheel, base + delays[i] - 2 * MS);
+
+        if(get_count(&counters[i]) != 0)
+        {
+            logger_log_error("Timer fired too early");
+            return 1;
+        }
+
+        timerwheel_advance(wheel, base + delays[i] + 2 * MS);
+
+        if(get_count(&counters[i]) != 1)
+        {
+            logger_log_error("Timer did not fire");
+            return 1;
+        }
+    }
+
+    if(timerwheel_get_timers_count(wheel) != 0)
+    {
+        logger_log_error("Fired timers are still pending");
+        return 1;
+    }
+
+    timerwheel_free(wheel);
+
+    return 0;
+}
+
+int test_cancel_and_periodic(void)
+{
+    TimerWheel* wheel = timerwheel_new(MS);
+    uint64_t base = time_get_monotonic_ns();
+    TimerId timers[1000];
+    TimerId periodic;
+    int32_t counter = 0;
+    int32_t periodic_counter = 0;
+    uint32_t i;
+
+    if(wheel == NULL)
+    {
+        logger_log_error("Cannot create timer wheel");
+        return 1;
+    }
+
+    for(i = 0; i < 1000; i++)
+        timers[i] = timerwheel_add(wheel, (10 + i) * MS, 0, count_func, &counter);
+
+    for(i = 0; i < 1000; i += 2)
+    {
+        if(!timerwheel_cancel(wheel, timers[i]))
+        {
+            logger_log_error("Cannot cancel timer");
+            return 1;
+        }
+    }
+
+    if(timerwheel_cancel(wheel, timers[0]))
+    {
+        logger_log_error("Timer cancelled twice");
+        return 1;
+    }
+
+    periodic = timerwheel_add(wheel, 10 * MS, 10 * MS, count_func, &periodic_counter);
+
+    /* A single large step still fires the periodic timer at each period */
+    timerwheel_advance(wheel, base + 2 * SECOND);
+
+    if(get_count(&counter) != 500)
+    {
+        logger_log_error("Cancelled timers fired");
+        return 1;
+    }
+
+    if(get_count(&periodic_counter) < 199 || get_count(&periodic_counter) > 200)
+    {
+        logger_log_error("Periodic timer did not fire at each period");
+        return 1;
+    }
+
+    if(timerwheel_cancel(wheel, timers[1]))
+    {
+        logger_log_error("Fired timer has been cancelled");
+        return 1;
+    }
+
+    if(!timerwheel_cancel(wheel, periodic))
+    {
+        logger_log_error("Cannot cancel periodic timer");
+        return 1;
+    }
+
+    if(timerwheel_get_timers_count(wheel) != 0)
+    {
+        logger_log_error("Timers are still pending");
+        return 1;
+    }
+
+    timerwheel_free(wheel);
+
+    return 0;
+}
+
+int test_many_timers(void)
+{
+    TimerWheel* wheel = timerwheel_new(MS);
+    uint64_t base = time_get_monotonic_ns();
+    uint64_t start;
+    uint64_t now;
+    int32_t counter = 0;
+    size_t fired = 0;
+    uint32_t i;
+
+    if(wheel == NULL)
+    {
+        logger_log_error("Cannot create timer wheel");
+        return 1;
+    }
+
+    start = time_get_monotonic_ns();
+
+    for(i = 0; i < MANY_TIMERS; i++)
+        timerwheel_add(wheel, random_next_uint64() % HOUR, 0, count_func, &counter);
+
+    logger_log(LogLevel_Info,
+               "Added %u timers in %.2f ns per timer",
+               MANY_TIMERS,
+               (double)(time_get_monotonic_ns() - start) / MANY_TIMERS);
+
+    start = time_get_monotonic_ns();
+
+    for(now = base; now <= base + HOUR + SECOND; now += SECOND)
+        fired += timerwheel_advance(wheel, now);
+
+    logger_log(LogLevel_Info,
+               "Fired %zu timers in %.2f ns per timer",
+               fired,
+               (double)(time_get_monotonic_ns() - start) / MANY_TIMERS);
+
+    if(fired != MANY_TIMERS || get_count(&counter) != MANY_TIMERS)
+    {
+        logger_log_error("Not all timers fired");
+        return 1;
+    }
+
+    if(timerwheel_next_expiry(wheel) != TIMERWHEEL_NO_EXPIRY)
+    {
+        logger_log_error("Timers are still pending");
+        return 1;
+    }
+
+    timerwheel_free(wheel);
+
+    return 0;
+}
+
+int test_threaded(void)
+{
+    ThreadPool* threadpool = threadpool_init(2);
+    TimerWheel* wheel = timerwheel_new(MS);
+    uint64_t start;
+    int32_t counter = 0;
+    uint32_t i;
+    int result = 0;
+
+    if(threadpool == NULL || wheel == NULL)
+    {
+        logger_log_error("Cannot create timer wheel");
+        return 1;
+    }
+
+    if(!timerwheel_start(wheel, threadpool))
+    {
+        logger_log_error("Cannot start timer wheel thread");
+        return 1;
+    }
+
+    if(timerwheel_start(wheel, threadpool))
+    {
+        logger_log_error("Timer wheel thread started twice");
+        result = 1;
+    }
+
+    /* The thread sleeps until the earliest timer, adding an earlier one must wake it */
+    timerwheel_add(wheel, 10 * SECOND, 0, count_func, &counter);
+
+    for(i = 0; i < THREADED_TIMERS; i++)
+        timerwheel_add(wheel, (10 + i % 40) * MS, 0, count_func, &counter);
+
+    start = time_get_monotonic_ns();
+
+    while(get_count(&counter) < THREADED_TIMERS && time_get_monotonic_ns() - start < 5 * SECOND)
+        thread_sleep(1);
+
+    threadpool_wait(threadpool);
+
+    if(get_count(&counter) != THREADED_TIMERS)
+    {
+        logger_log_error("Timer wheel thread did not fire the timers");
+        result = 1;
+    }
+    else if(timerwheel_get_timers_count(wheel) != 1)
+    {
+        logger_log_error("Invalid timers count");
+        result = 1;
+    }
+    else
+    {
+        logger_log(LogLevel_Info,
+                   "Timer wheel thread fired %u timers in %.2f ms",
+                   THREADED_TIMERS,
+                   (double)(time_get_monotonic_ns() - start) / (double)MS);
+    }
+
+    /* The thread is stopped even on failure, releasing the pool would wait for it */
+    timerwheel_stop(wheel);
+    timerwheel_free(wheel);
+
+    threadpool_release(threadpool);
+
+    return result;
+}
+
+int main(void)
+{
+    logger_init();
+
+    if(test_levels() != 0)
+        return 1;
+
+    if(test_cancel_and_periodic() != 0)
+        return 1;
+
+    if(test_many_timers() != 0)
+        return 1;
+
+    if(test_threaded() != 0)
+        return 1;
+
+    logger_release();
+
+    return 0;
+}